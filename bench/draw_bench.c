@@ -0,0 +1,376 @@
+/*
+ * draw_bench: times the draw functions without a display.
+ *
+ * Renders into an off-screen 800x600 ARGB8888 surface through SDL's software
+ * renderer, so it needs no window, video driver or GPU. For each count n the
+ * scene holds n enemies (cycling through every type) and n bullets scattered
+ * over the area the camera flies over, and every camera path is played frame
+ * by frame:
+ *   static   the camera stays over the middle of the scene
+ *   pan      the camera crosses the scene diagonally
+ *   orbit    the camera circles the middle, the ship turning along
+ * Each frame draws what game_loop draws, in the same order: draw_background,
+ * render_text of the HUD, draw_bullets, draw_enemies and draw_player. Every
+ * call is timed on its own (the renderer is flushed inside the timing).
+ *
+ * One JSON object per path, with one point per count:
+ *   {"n", "reps", "frame_ns", "checksum", "<function>":{"ns_per_frame", "min_ns"}, ...}
+ * A path is replayed until min_ms of timed work; min_ns is the fastest pass.
+ * checksum is an FNV-1a hash over the pixels of every frame of the path, so
+ * a faster draw function can be checked to draw exactly the same frames.
+ * With -d, every frame is also saved as dir/<path>-<n>-<frame>.bmp, and
+ * dir/checksums.txt lists the checksum of each frame to find the first one
+ * that differs.
+ *
+ * Usage: draw_bench [-n count,count,...] [-f frames] [-t min_ms] [-d dir]
+ */
+#include "background.h"
+#include "bullet.h"
+#include "enemy.h"
+#include "player.h"
+#include "text.h"
+#include "config.h"
+#include "debug.h"
+#include "memtrack.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+int g_dev_auto_mode = 0;
+int g_testing_mode = 0;
+int g_forced_enemy_type = -1;
+
+#define MAX_COUNTS 16
+#define MAX_REPS 100000L
+#define SCREEN_W 800
+#define SCREEN_H 600
+#define SCENE_SIZE 4000.0f   // side of the square holding the entities
+#define BACKGROUND_SEED 12345u
+#define FONT_PATH "src/Arial.ttf"
+#define ENEMY_TYPE_COUNT (ENEMY_BOSS3 + 1)
+
+typedef enum {
+    FN_BACKGROUND,
+    FN_HUD,
+    FN_BULLETS,
+    FN_ENEMIES,
+    FN_PLAYER,
+    FN_COUNT
+} DrawFn;
+
+static const char *fn_names[FN_COUNT] = {
+    "draw_background", "render_text", "draw_bullets", "draw_enemies", "draw_player"
+};
+
+typedef enum {
+    PATH_STATIC,
+    PATH_PAN,
+    PATH_ORBIT,
+    PATH_COUNT
+} CameraPath;
+
+static const char *path_names[PATH_COUNT] = { "static", "pan", "orbit" };
+
+typedef struct {
+    int n;
+    Enemy *enemies, *enemies_init;
+    BulletPool pool;
+    Player player;
+} Scene;
+
+typedef struct {
+    SDL_Surface *surface;
+    SDL_Renderer *renderer;
+    TTF_Font *font;
+} Target;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static float frand(float lo, float hi) {
+    return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+static int scene_init(Scene *scene, int n) {
+    memset(scene, 0, sizeof(*scene));
+    scene->n = n;
+    scene->enemies = malloc(n * sizeof(Enemy));
+    scene->enemies_init = malloc(n * sizeof(Enemy));
+    scene->pool.bullets = mem_calloc(MEM_BULLETS, n, sizeof(Bullet));
+    if (!scene->enemies || !scene->enemies_init || !scene->pool.bullets)
+        return 0;
+    scene->pool.count = n;
+    scene->pool.high_water = n;
+
+    srand(12345u + (unsigned)n);
+    init_enemies(scene->enemies_init, n);
+    for (int i = 0; i < n; i++) {
+        Enemy *e = &scene->enemies_init[i];
+        e->x = frand(-SCENE_SIZE / 2, SCENE_SIZE / 2);
+        e->y = frand(-SCENE_SIZE / 2, SCENE_SIZE / 2);
+        e->type = (EnemyType)(i % ENEMY_TYPE_COUNT);
+        e->health = 3;
+        e->active = 1;
+        e->visible = 1;
+        e->shieldActive = e->type == ENEMY_SHIELD;
+        e->angle = frand(0.0f, 360.0f);
+    }
+    for (int i = 0; i < n; i++) {
+        Bullet *b = &scene->pool.bullets[i];
+        float angle = frand(0.0f, 2.0f * (float)M_PI);
+        b->x = frand(-SCENE_SIZE / 2, SCENE_SIZE / 2);
+        b->y = frand(-SCENE_SIZE / 2, SCENE_SIZE / 2);
+        b->dx = cosf(angle) * BULLET_SPEED;
+        b->dy = sinf(angle) * BULLET_SPEED;
+        b->spawn_x = b->x;
+        b->spawn_y = b->y;
+        b->active = 1;
+        b->isEnemy = i & 1;
+        b->damage = 1;
+    }
+    init_player(&scene->player, SCREEN_W, SCREEN_H);
+    return 1;
+}
+
+static void scene_free(Scene *scene) {
+    free(scene->enemies);
+    free(scene->enemies_init);
+    free_bullet_pool(&scene->pool);
+}
+
+// Places the ship (and so the camera, which centres on it) for frame f of
+// a path of frames frames.
+static void place_camera(Player *player, CameraPath path, int f, int frames) {
+    float t = frames > 1 ? (float)f / (float)(frames - 1) : 0.0f;
+    switch (path) {
+    case PATH_STATIC:
+        player->x = 0.0f;
+        player->y = 0.0f;
+        player->angle = 0.0f;
+        break;
+    case PATH_PAN:
+        player->x = (t - 0.5f) * SCENE_SIZE * 0.6f;
+        player->y = (t - 0.5f) * SCENE_SIZE * 0.4f;
+        player->angle = atan2f(0.4f, 0.6f) * 180.0f / (float)M_PI;
+        break;
+    case PATH_ORBIT: {
+        float theta = 2.0f * (float)M_PI * (float)f / (float)frames;
+        player->x = cosf(theta) * SCENE_SIZE * 0.25f;
+        player->y = sinf(theta) * SCENE_SIZE * 0.25f;
+        player->angle = fmodf(theta * 180.0f / (float)M_PI + 90.0f, 360.0f);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// Times one draw call, flushing the renderer so queued commands are counted.
+#define TIME_DRAW(slot, call) do {                  \
+        uint64_t t0 = now_ns();                     \
+        call;                                       \
+        SDL_RenderFlush(target->renderer);          \
+        (slot) += now_ns() - t0;                    \
+    } while (0)
+
+// Draws frame f the way game_loop does and adds each call's time to ns.
+static void draw_frame(Target *target, Scene *scene, CameraPath path, int f, int frames, uint64_t ns[FN_COUNT]) {
+    SDL_Renderer *renderer = target->renderer;
+    Player *player = &scene->player;
+    place_camera(player, path, f, frames);
+    float cam_x = player->x - SCREEN_W / 2;
+    float cam_y = player->y - SCREEN_H / 2;
+    SDL_Color white = {255, 255, 255, 255};
+    char hud[200];
+    sprintf(hud, "Health: %d  Energy: %.1f  Score: %d  X: %.1f  Y: %.1f  Angle: %.1f",
+            player->health, player->energy, f, player->x, player->y, player->angle);
+
+    TIME_DRAW(ns[FN_BACKGROUND], draw_background(renderer, cam_x, cam_y, SCREEN_W, SCREEN_H));
+    TIME_DRAW(ns[FN_HUD], render_text(renderer, target->font, 10, 10, hud, white));
+    TIME_DRAW(ns[FN_BULLETS], draw_bullets(&scene->pool, renderer, cam_x, cam_y));
+    TIME_DRAW(ns[FN_ENEMIES], draw_enemies(scene->enemies, scene->n, renderer, cam_x, cam_y));
+    TIME_DRAW(ns[FN_PLAYER], draw_player(player, renderer, SCREEN_W / 2, SCREEN_H / 2));
+}
+
+// FNV-1a over the visible pixels of the surface, row by row (the pitch may pad rows).
+static uint64_t frame_checksum(SDL_Surface *surface, uint64_t hash) {
+    if (SDL_MUSTLOCK(surface))
+        SDL_LockSurface(surface);
+    for (int y = 0; y < surface->h; y++) {
+        const unsigned char *row = (const unsigned char*)surface->pixels + (size_t)y * surface->pitch;
+        for (int x = 0; x < surface->w * 4; x++) {
+            hash ^= row[x];
+            hash *= 1099511628211ull;
+        }
+    }
+    if (SDL_MUSTLOCK(surface))
+        SDL_UnlockSurface(surface);
+    return hash;
+}
+
+#define FNV_OFFSET 14695981039346656037ull
+
+// Plays path over a scene of n entities until min_ns of timed work and
+// prints one curve point. The first pass is also checksummed (and dumped).
+static int run_point(Target *target, CameraPath path, int n, int frames, uint64_t min_ns,
+                     const char *dump_dir, FILE *checksums, int first) {
+    Scene scene;
+    if (!scene_init(&scene, n)) {
+        fprintf(stderr, "draw_bench: out of memory for %d entities\n", n);
+        scene_free(&scene);
+        return 0;
+    }
+    // Same sky every run; the first draw lays it out, outside the timing.
+    seed_background(BACKGROUND_SEED);
+    draw_background(target->renderer, 0.0f, 0.0f, SCREEN_W, SCREEN_H);
+
+    uint64_t total[FN_COUNT] = {0}, best[FN_COUNT], all = 0, path_hash = FNV_OFFSET;
+    for (int i = 0; i < FN_COUNT; i++)
+        best[i] = UINT64_MAX;
+    long reps = 0;
+    do {
+        memcpy(scene.enemies, scene.enemies_init, n * sizeof(Enemy));
+        uint64_t pass[FN_COUNT] = {0};
+        for (int f = 0; f < frames; f++) {
+            draw_frame(target, &scene, path, f, frames, pass);
+            if (reps > 0)
+                continue;
+            uint64_t hash = frame_checksum(target->surface, FNV_OFFSET);
+            path_hash = (path_hash ^ hash) * 1099511628211ull;
+            if (checksums)
+                fprintf(checksums, "%s %d %d %016llx\n", path_names[path], n, f, (unsigned long long)hash);
+            if (dump_dir) {
+                char file[4096];
+                snprintf(file, sizeof(file), "%s/%s-%d-%04d.bmp", dump_dir, path_names[path], n, f);
+                if (SDL_SaveBMP(target->surface, file) != 0)
+                    fprintf(stderr, "draw_bench: cannot save %s: %s\n", file, SDL_GetError());
+            }
+        }
+        for (int i = 0; i < FN_COUNT; i++) {
+            total[i] += pass[i];
+            all += pass[i];
+            if (pass[i] < best[i])
+                best[i] = pass[i];
+        }
+        reps++;
+    } while (all < min_ns && reps < MAX_REPS);
+
+    double frames_timed = (double)reps * frames;
+    printf("%s{\"n\":%d, \"reps\":%ld, \"frame_ns\":%.1f, \"checksum\":\"%016llx\"",
+           first ? "" : ", ", n, reps, (double)all / frames_timed, (unsigned long long)path_hash);
+    for (int i = 0; i < FN_COUNT; i++)
+        printf(", \"%s\":{\"ns_per_frame\":%.1f, \"min_ns\":%.1f}", fn_names[i],
+               (double)total[i] / frames_timed, (double)best[i] / frames);
+    printf("}");
+    scene_free(&scene);
+    return 1;
+}
+
+static int run_path(Target *target, CameraPath path, const int *counts, int count_n, int frames,
+                    uint64_t min_ns, const char *dump_dir, FILE *checksums) {
+    printf("{\"path\":\"%s\", \"frames\":%d, \"points\":[", path_names[path], frames);
+    for (int i = 0; i < count_n; i++) {
+        if (!run_point(target, path, counts[i], frames, min_ns, dump_dir, checksums, i == 0))
+            return 0;
+        fflush(stdout);
+    }
+    printf("]}\n");
+    return 1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-n count,count,...] [-f frames] [-t min_ms] [-d dir]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    int counts[MAX_COUNTS] = { 50, 500, 5000 };
+    int count_n = 3;
+    int frames = 120;
+    long min_ms = 500;
+    const char *dump_dir = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:f:t:d:")) != -1) {
+        switch (opt) {
+        case 'n': {
+            count_n = 0;
+            for (char *p = optarg; *p && count_n < MAX_COUNTS; ) {
+                counts[count_n] = (int)strtol(p, &p, 10);
+                if (counts[count_n] <= 0) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                count_n++;
+                if (*p == ',')
+                    p++;
+                else if (*p)
+                    break;
+            }
+            break;
+        }
+        case 'f': frames = atoi(optarg); break;
+        case 't': min_ms = atol(optarg); break;
+        case 'd': dump_dir = optarg; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind != argc || count_n == 0 || frames <= 0 || min_ms <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    uint64_t min_ns = (uint64_t)min_ms * 1000000ull;
+
+    FILE *checksums = NULL;
+    if (dump_dir) {
+        if (mkdir(dump_dir, 0755) != 0 && errno != EEXIST) {
+            fprintf(stderr, "draw_bench: cannot create %s: %s\n", dump_dir, strerror(errno));
+            return 1;
+        }
+        char file[4096];
+        snprintf(file, sizeof(file), "%s/checksums.txt", dump_dir);
+        if (!(checksums = fopen(file, "w"))) {
+            fprintf(stderr, "draw_bench: cannot write %s: %s\n", file, strerror(errno));
+            return 1;
+        }
+    }
+
+    // Draw calls go straight to the surface rather than being queued, so
+    // each is timed where it happens.
+    SDL_SetHint(SDL_HINT_RENDER_BATCHING, "0");
+    Target target = {0};
+    target.surface = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_W, SCREEN_H, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (target.surface)
+        target.renderer = SDL_CreateSoftwareRenderer(target.surface);
+    if (!target.renderer) {
+        fprintf(stderr, "draw_bench: cannot create the software renderer: %s\n", SDL_GetError());
+        return 1;
+    }
+    if (TTF_Init() != 0 || !(target.font = TTF_OpenFont(FONT_PATH, 16))) {
+        fprintf(stderr, "draw_bench: cannot open %s (run from the repository root): %s\n",
+                FONT_PATH, TTF_GetError());
+        return 1;
+    }
+
+    int ok = 1;
+    for (int path = 0; ok && path < PATH_COUNT; path++)
+        ok = run_path(&target, (CameraPath)path, counts, count_n, frames, min_ns, dump_dir, checksums);
+
+    if (checksums)
+        fclose(checksums);
+    free_text_atlas();
+    TTF_CloseFont(target.font);
+    TTF_Quit();
+    SDL_DestroyRenderer(target.renderer);
+    SDL_FreeSurface(target.surface);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+/*
+ * ledger_bench: times the ledger code paths on a chain made by chaingen.
+ *
+ * Runs inside <dir> (the game's relative paths) and prints one JSON object:
+ *   parse        parse_score_block over the whole blockchain.txt
+ *   leaderboard  display_highscores with every signature verified (audit mode)
+ *   verify       verify_score_signature, one block at a time on one thread
+ *   chain        verify_blockchain over the first user's chain
+ *   sign         sign_score with the .username user's session key
+ *   pow          add_score_block proof-of-work at the given difficulty, and
+ *                the difficulty adaptive sealing picks for POW_LATENCY_BUDGET_MS
+ *
+ * Usage: ledger_bench [-d pow_difficulty] [-p pow_blocks] [-s sign_ops]
+ *                     [-v verify_ops] <dir>
+ */
+#include "blockchain.h"
+#include "checkpoint.h"
+#include "encryption.h"
+#include "highscores.h"
+#include "memtrack.h"
+#include "score_buckets.h"
+#include "score.h"
+#include "signature.h"
+#include "config.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double per_second(double count, double seconds) {
+    return seconds > 0 ? count / seconds : 0;
+}
+
+// Reads every well-formed block; returns them in *out (caller frees).
+static long load_blocks(ScoreBlock **out, long *bytes) {
+    FILE *fp = fopen(BLOCKCHAIN_FILE, "r");
+    if (!fp)
+        return -1;
+    long count = 0, capacity = 0;
+    ScoreBlock *blocks = NULL;
+    char line[2048];
+    *bytes = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        *bytes += (long)strlen(line);
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            ScoreBlock *grown = realloc(blocks, capacity * sizeof(ScoreBlock));
+            if (!grown)
+                break;
+            blocks = grown;
+        }
+        if (parse_score_block(line, &blocks[count]))
+            count++;
+    }
+    fclose(fp);
+    *out = blocks;
+    return count;
+}
+
+// Runs display_highscores with stdout discarded; returns the elapsed time.
+static double time_leaderboard(void) {
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    if (saved < 0 || devnull < 0)
+        return -1;
+    dup2(devnull, STDOUT_FILENO);
+    close(devnull);
+    double start = now_seconds();
+    display_highscores(SCORE_DAY_FIRST, SCORE_DAY_LAST);
+    fflush(stdout);
+    double elapsed = now_seconds() - start;
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    return elapsed;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-d pow_difficulty] [-p pow_blocks] [-s sign_ops] [-v verify_ops] <dir>\n", prog);
+}
+
+int main(int argc, char **argv) {
+    int difficulty = 3, pow_blocks = 100, sign_ops = 2000, verify_ops = 2000;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:p:s:v:")) != -1) {
+        switch (opt) {
+        case 'd': difficulty = atoi(optarg); break;
+        case 'p': pow_blocks = atoi(optarg); break;
+        case 's': sign_ops = atoi(optarg); break;
+        case 'v': verify_ops = atoi(optarg); break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind != argc - 1 || difficulty < 0 || difficulty > 8 || pow_blocks <= 0 ||
+        sign_ops <= 0 || verify_ops <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (chdir(argv[optind]) != 0) {
+        fprintf(stderr, "ledger_bench: cannot enter %s\n", argv[optind]);
+        return 1;
+    }
+    // Measure full verification: no checkpoints and no verified-block cache.
+    checkpoint_set_audit(1);
+
+    long bytes = 0;
+    ScoreBlock *blocks = NULL;
+    double start = now_seconds();
+    long count = load_blocks(&blocks, &bytes);
+    double parse_time = now_seconds() - start;
+    if (count <= 0) {
+        fprintf(stderr, "ledger_bench: no blocks in %s/%s\n", argv[optind], BLOCKCHAIN_FILE);
+        free(blocks);
+        return 1;
+    }
+
+    clear_public_key_cache();
+    double leaderboard_time = time_leaderboard();
+
+    // Cold key cache again, so per-user key loading is part of the figure.
+    clear_public_key_cache();
+    long verify_count = count < verify_ops ? count : verify_ops;
+    long verified = 0;
+    char signer[USERNAME_MAX];
+    start = now_seconds();
+    for (long i = 0; i < verify_count; i++) {
+        block_signer_name(&blocks[i], signer, sizeof(signer));
+        verified += verify_score_signature(&blocks[i], signer);
+    }
+    double verify_time = now_seconds() - start;
+
+    // The first user's own chain, in file order.
+    long chain_count = 0;
+    for (long i = 0; i < count; i++) {
+        if (strcmp(blocks[i].username, blocks[0].username) == 0)
+            blocks[chain_count++] = blocks[i];
+    }
+    start = now_seconds();
+    int chain_ok = verify_blockchain(blocks, (int)chain_count, 0);
+    double chain_time = now_seconds() - start;
+
+    char *username = load_username();
+    double sign_time = -1;
+    if (username && signing_session_begin(username)) {
+        ScoreBlock block = blocks[chain_count - 1];
+        start = now_seconds();
+        for (int i = 0; i < sign_ops; i++) {
+            block.nonce = (unsigned int)i;
+            if (!sign_score(&block))
+                break;
+        }
+        sign_time = now_seconds() - start;
+        signing_session_end();
+    }
+    mem_free(username);
+
+    ScoreBlock prev = blocks[chain_count - 1];
+    double hashes = 0;
+    start = now_seconds();
+    for (int i = 0; i < pow_blocks; i++) {
+        ScoreBlock block = prev;
+        block.score = i;
+        add_score_block(&block, &prev, difficulty);
+        hashes += (double)block.nonce + 1;
+        prev = block;
+    }
+    double pow_time = now_seconds() - start;
+    int auto_difficulty = pow_auto_difficulty(POW_LATENCY_BUDGET_MS);
+
+    printf("{\"blocks\":%ld, \"bytes\":%ld, \"block_struct_bytes\":%zu, "
+           "\"parse_sec\":%.6f, \"parse_blocks_per_sec\":%.0f, "
+           "\"leaderboard_sec\":%.6f, "
+           "\"verify_blocks\":%ld, \"verify_valid\":%ld, \"verify_ops_per_sec\":%.0f, "
+           "\"chain_blocks\":%ld, \"chain_valid\":%d, \"chain_blocks_per_sec\":%.0f, "
+           "\"sign_ops\":%d, \"sign_ops_per_sec\":%.0f, "
+           "\"pow_difficulty\":%d, \"pow_blocks\":%d, \"pow_hashes_per_sec\":%.0f, "
+           "\"pow_budget_ms\":%d, \"pow_auto_difficulty\":%d}\n",
+           count, bytes, sizeof(ScoreBlock),
+           parse_time, per_second(count, parse_time),
+           leaderboard_time,
+           verify_count, verified, per_second(verify_count, verify_time),
+           chain_count, chain_ok, per_second(chain_count, chain_time),
+           sign_ops, sign_time < 0 ? 0 : per_second(sign_ops, sign_time),
+           difficulty, pow_blocks, per_second(hashes, pow_time),
+           POW_LATENCY_BUDGET_MS, auto_difficulty);
+    free(blocks);
+    return 0;
+}
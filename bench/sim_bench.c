@@ -0,0 +1,342 @@
+/*
+ * sim_bench: times the simulation hot paths without opening a window.
+ *
+ * Every operation runs on a synthetic scene of n entities for each count and
+ * prints one JSON object per operation with its scaling curve:
+ *   update_bullets            one update_bullets over n live bullets
+ *   shoot_bullet              one shot, averaged over filling an empty pool
+ *                             with n bullets (add_bullet's slot search and growth)
+ *   update_enemies/<TYPE>     one update_enemies over n enemies of that type
+ *   resolve_enemy_collisions  one pass over n enemies packed so neighbours overlap
+ *   hit_enemies               one pass of n player bullets against n enemies
+ *   spawn_enemy               one spawn, averaged over filling n empty slots
+ *   dev_ai_control            one auto-mode AI step with n enemies and n enemy bullets
+ *
+ * Each point is {"n", "ns_per_op", "ns_per_entity", "min_ns", "reps"}: the scene
+ * is rebuilt before every repetition (untimed) until min_ms of timed work.
+ *
+ * Usage: sim_bench [-n count,count,...] [-t min_ms]
+ */
+#include "bullet.h"
+#include "collisions.h"
+#include "dev_ai.h"
+#include "enemy.h"
+#include "player.h"
+#include "config.h"
+#include "debug.h"
+#include "memtrack.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+int g_dev_auto_mode = 0;
+int g_testing_mode = 0;
+int g_forced_enemy_type = -1;
+
+#define MAX_COUNTS 16
+#define MAX_REPS 1000000L
+#define SCREEN_W 800
+#define SCREEN_H 600
+
+static const char *enemy_type_names[] = {
+    "ENEMY_BASIC", "ENEMY_SHOOTER", "ENEMY_TANK", "ENEMY_EVASIVE", "ENEMY_FAST", "ENEMY_SPLITTER",
+    "ENEMY_STEALTH", "ENEMY_SHIELD", "ENEMY_BOSS1", "ENEMY_BOSS2", "ENEMY_BOSS3"
+};
+#define ENEMY_TYPE_COUNT (int)(sizeof(enemy_type_names) / sizeof(enemy_type_names[0]))
+
+// Working state of one operation, restored from the *_init copies before
+// every repetition.
+typedef struct {
+    int n;
+    Enemy *enemies, *enemies_init;
+    Bullet *bullets_init;
+    int bullets_init_count;
+    BulletPool pool;
+    Player player, player_init;
+    Explosion explosions[MAX_EXPLOSIONS];
+    int auto_mode;   // value of g_dev_auto_mode while timing
+} Scene;
+
+typedef void (*SceneOp)(Scene *scene, int arg);
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static float frand(float lo, float hi) {
+    return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+// Side of the square holding n entities spaced spacing apart, centred on 0,0.
+static float field_size(int n, float spacing) {
+    return ceilf(sqrtf((float)n)) * spacing;
+}
+
+static int scene_init(Scene *scene, int n) {
+    memset(scene, 0, sizeof(*scene));
+    scene->n = n;
+    scene->enemies = malloc(n * sizeof(Enemy));
+    scene->enemies_init = malloc(n * sizeof(Enemy));
+    // Room for n bullets plus what a repetition may add.
+    scene->bullets_init = malloc((n > INITIAL_BULLET_CAPACITY ? n : INITIAL_BULLET_CAPACITY) * sizeof(Bullet));
+    init_bullet_pool(&scene->pool);
+    if (!scene->enemies || !scene->enemies_init || !scene->bullets_init || !scene->pool.bullets)
+        return 0;
+    init_enemies(scene->enemies_init, n);
+    init_player(&scene->player_init, SCREEN_W, SCREEN_H);
+    return 1;
+}
+
+static void scene_free(Scene *scene) {
+    free(scene->enemies);
+    free(scene->enemies_init);
+    free(scene->bullets_init);
+    free_bullet_pool(&scene->pool);
+}
+
+// An empty pool of the game's initial capacity.
+static void set_empty_pool(Scene *scene) {
+    scene->bullets_init_count = INITIAL_BULLET_CAPACITY;
+    memset(scene->bullets_init, 0, INITIAL_BULLET_CAPACITY * sizeof(Bullet));
+}
+
+// n live bullets scattered over the field, each well short of its despawn distance.
+static void set_bullets(Scene *scene, float field, int is_enemy) {
+    int count = scene->n > INITIAL_BULLET_CAPACITY ? scene->n : INITIAL_BULLET_CAPACITY;
+    memset(scene->bullets_init, 0, count * sizeof(Bullet));
+    for (int i = 0; i < scene->n; i++) {
+        Bullet *b = &scene->bullets_init[i];
+        float angle = frand(0.0f, 2.0f * (float)M_PI);
+        b->x = frand(-field / 2, field / 2);
+        b->y = frand(-field / 2, field / 2);
+        b->dx = cosf(angle) * BULLET_SPEED;
+        b->dy = sinf(angle) * BULLET_SPEED;
+        b->spawn_x = b->x - b->dx * frand(0.0f, 50.0f);
+        b->spawn_y = b->y - b->dy * frand(0.0f, 50.0f);
+        b->active = 1;
+        b->isEnemy = is_enemy;
+        b->damage = 1;
+    }
+    scene->bullets_init_count = count;
+}
+
+// n active enemies on a grid around the player; type < 0 cycles through every type.
+static void set_enemies(Scene *scene, int type, float spacing) {
+    int side = (int)ceilf(sqrtf((float)scene->n));
+    float origin = -(side - 1) * spacing / 2;
+    for (int i = 0; i < scene->n; i++) {
+        Enemy *e = &scene->enemies_init[i];
+        e->x = origin + (i % side) * spacing;
+        e->y = origin + (i / side) * spacing;
+        e->type = type < 0 ? (EnemyType)(i % ENEMY_TYPE_COUNT) : (EnemyType)type;
+        e->health = 3;
+        e->active = 1;
+        e->timer = rand() % 200;
+        e->shootTimer = rand() % 120;
+        e->visible = 1;
+        e->shieldActive = 0;
+        e->angle = frand(0.0f, 360.0f);
+    }
+}
+
+static void scene_reset(Scene *scene) {
+    memcpy(scene->enemies, scene->enemies_init, scene->n * sizeof(Enemy));
+    if (scene->pool.count != scene->bullets_init_count) {
+        Bullet *resized = mem_realloc(MEM_BULLETS, scene->pool.bullets, scene->bullets_init_count * sizeof(Bullet));
+        if (!resized) {
+            fprintf(stderr, "sim_bench: out of memory\n");
+            exit(1);
+        }
+        scene->pool.bullets = resized;
+        scene->pool.count = scene->bullets_init_count;
+    }
+    memcpy(scene->pool.bullets, scene->bullets_init, scene->bullets_init_count * sizeof(Bullet));
+    scene->player = scene->player_init;
+    memset(scene->explosions, 0, sizeof(scene->explosions));
+    srand(1);
+}
+
+static void op_update_bullets(Scene *scene, int arg) {
+    (void)arg;
+    update_bullets(&scene->pool);
+}
+
+static void op_shoot_bullet(Scene *scene, int arg) {
+    (void)arg;
+    for (int i = 0; i < scene->n; i++)
+        shoot_bullet(&scene->pool, 0.0f, 0.0f, (float)(i % 360), 0);
+}
+
+static void op_update_enemies(Scene *scene, int arg) {
+    (void)arg;
+    update_enemies(scene->enemies, scene->n, scene->player.x, scene->player.y, scene->player.angle, 2.0f, &scene->pool);
+}
+
+static void op_resolve_collisions(Scene *scene, int arg) {
+    (void)arg;
+    resolve_enemy_collisions(scene->enemies, scene->n);
+}
+
+static void op_hit_enemies(Scene *scene, int arg) {
+    (void)arg;
+    hit_enemies(&scene->pool, scene->enemies, scene->n, scene->explosions);
+}
+
+static void op_spawn_enemy(Scene *scene, int arg) {
+    for (int i = 0; i < scene->n; i++)
+        spawn_enemy(scene->enemies, scene->n, scene->player.x, scene->player.y, arg);
+}
+
+static void op_dev_ai(Scene *scene, int arg) {
+    (void)arg;
+    dev_ai_control(&scene->player, scene->enemies, scene->n, &scene->pool, SCREEN_W, SCREEN_H);
+}
+
+// Times op on scene until min_ns of timed work; ops_per_run is how many
+// operations one call of op performs. Prints one curve point.
+static void measure(Scene *scene, SceneOp op, int arg, int ops_per_run, uint64_t min_ns, int first) {
+    uint64_t total = 0, best = UINT64_MAX;
+    long reps = 0;
+    g_dev_auto_mode = scene->auto_mode;
+    do {
+        scene_reset(scene);
+        uint64_t start = now_ns();
+        op(scene, arg);
+        uint64_t elapsed = now_ns() - start;
+        total += elapsed;
+        if (elapsed < best)
+            best = elapsed;
+        reps++;
+    } while (total < min_ns && reps < MAX_REPS);
+    g_dev_auto_mode = 0;
+    double per_op = (double)total / reps / ops_per_run;
+    printf("%s{\"n\":%d, \"ns_per_op\":%.1f, \"ns_per_entity\":%.2f, \"min_ns\":%.1f, \"reps\":%ld}",
+           first ? "" : ", ", scene->n, per_op, per_op / scene->n,
+           (double)best / ops_per_run, reps);
+}
+
+typedef enum {
+    BENCH_UPDATE_BULLETS,
+    BENCH_SHOOT_BULLET,
+    BENCH_UPDATE_ENEMIES,
+    BENCH_RESOLVE_COLLISIONS,
+    BENCH_HIT_ENEMIES,
+    BENCH_SPAWN_ENEMY,
+    BENCH_DEV_AI
+} BenchOp;
+
+// Builds the scene of one operation at count n and measures it.
+static int run_point(BenchOp bench, int type, int n, uint64_t min_ns, int first) {
+    Scene scene;
+    if (!scene_init(&scene, n)) {
+        fprintf(stderr, "sim_bench: out of memory for %d entities\n", n);
+        scene_free(&scene);
+        return 0;
+    }
+    srand(12345u + (unsigned)n);
+    switch (bench) {
+    case BENCH_UPDATE_BULLETS:
+        set_bullets(&scene, field_size(n, 40.0f), 0);
+        measure(&scene, op_update_bullets, 0, 1, min_ns, first);
+        break;
+    case BENCH_SHOOT_BULLET:
+        set_empty_pool(&scene);
+        measure(&scene, op_shoot_bullet, 0, n, min_ns, first);
+        break;
+    case BENCH_UPDATE_ENEMIES:
+        set_empty_pool(&scene);
+        set_enemies(&scene, type, 40.0f);
+        measure(&scene, op_update_enemies, 0, 1, min_ns, first);
+        break;
+    case BENCH_RESOLVE_COLLISIONS:
+        set_empty_pool(&scene);
+        set_enemies(&scene, -1, 30.0f);
+        measure(&scene, op_resolve_collisions, 0, 1, min_ns, first);
+        break;
+    case BENCH_HIT_ENEMIES:
+        set_enemies(&scene, -1, 40.0f);
+        set_bullets(&scene, field_size(n, 40.0f), 0);
+        measure(&scene, op_hit_enemies, 0, 1, min_ns, first);
+        break;
+    case BENCH_SPAWN_ENEMY:
+        set_empty_pool(&scene);
+        measure(&scene, op_spawn_enemy, 2500, n, min_ns, first);
+        break;
+    case BENCH_DEV_AI:
+        set_enemies(&scene, -1, 40.0f);
+        set_bullets(&scene, field_size(n, 40.0f), 1);
+        scene.auto_mode = 1;
+        measure(&scene, op_dev_ai, 0, 1, min_ns, first);
+        break;
+    }
+    scene_free(&scene);
+    return 1;
+}
+
+static int run_curve(const char *name, BenchOp bench, int type, const int *counts, int count_n, uint64_t min_ns) {
+    printf("{\"op\":\"%s\", \"points\":[", name);
+    for (int i = 0; i < count_n; i++) {
+        if (!run_point(bench, type, counts[i], min_ns, i == 0))
+            return 0;
+        fflush(stdout);
+    }
+    printf("]}\n");
+    return 1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-n count,count,...] [-t min_ms]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    int counts[MAX_COUNTS] = { 50, 500, 5000, 50000 };
+    int count_n = 4;
+    long min_ms = 200;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:")) != -1) {
+        switch (opt) {
+        case 'n': {
+            count_n = 0;
+            for (char *p = optarg; *p && count_n < MAX_COUNTS; ) {
+                counts[count_n] = (int)strtol(p, &p, 10);
+                if (counts[count_n] <= 0) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                count_n++;
+                if (*p == ',')
+                    p++;
+                else if (*p)
+                    break;
+            }
+            break;
+        }
+        case 't': min_ms = atol(optarg); break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind != argc || count_n == 0 || min_ms <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    uint64_t min_ns = (uint64_t)min_ms * 1000000ull;
+
+    int ok = run_curve("update_bullets", BENCH_UPDATE_BULLETS, 0, counts, count_n, min_ns) &&
+             run_curve("shoot_bullet", BENCH_SHOOT_BULLET, 0, counts, count_n, min_ns);
+    for (int type = 0; ok && type < ENEMY_TYPE_COUNT; type++) {
+        char name[64];
+        snprintf(name, sizeof(name), "update_enemies/%s", enemy_type_names[type]);
+        ok = run_curve(name, BENCH_UPDATE_ENEMIES, type, counts, count_n, min_ns);
+    }
+    ok = ok && run_curve("resolve_enemy_collisions", BENCH_RESOLVE_COLLISIONS, 0, counts, count_n, min_ns) &&
+               run_curve("hit_enemies", BENCH_HIT_ENEMIES, 0, counts, count_n, min_ns) &&
+               run_curve("spawn_enemy", BENCH_SPAWN_ENEMY, 0, counts, count_n, min_ns) &&
+               run_curve("dev_ai_control", BENCH_DEV_AI, 0, counts, count_n, min_ns);
+    return ok ? 0 : 1;
+}
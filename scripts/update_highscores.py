@@ -2,8 +2,10 @@
 import os
 import re
 import sys
+import socket
 import json
 import hashlib
+import zlib
 import time
 
 # ANSI color codes for debug messages:
@@ -27,7 +29,11 @@ def debug_print(level, message):
 BASE_DIR = os.path.abspath(os.path.join(os.path.dirname(__file__), ".."))
 BLOCKCHAIN_FILE = os.path.join(BASE_DIR, "highscore", "blockchain.txt")
 README_PATH = os.path.join(BASE_DIR, "README.md")
-DIFFICULTY = 4  # Must match the C side
+LEDGERD_SOCKET = os.path.join(BASE_DIR, "highscore", ".ledgerd.sock")
+# Blocks record the difficulty they were sealed at; records without one
+# predate per-block difficulty. Both must match the C side (blockchain.h).
+DIFFICULTY = 4  # leading zeros of records without a "difficulty" field
+MIN_DIFFICULTY = 3  # lowest difficulty a block may claim
 
 def hash_score(data):
     return hashlib.sha256(data.encode()).hexdigest()
@@ -46,8 +52,12 @@ def verify_proof_of_work(block):
     if stored != computed:
         print(f"Invalid PoW: expected '{computed}' but found '{stored}'")
         return False
-    if not computed.startswith("0" * DIFFICULTY):
-        print(f"Difficulty not met: '{computed}' does not start with {'0'*DIFFICULTY}")
+    difficulty = block.get("difficulty", DIFFICULTY)
+    if not isinstance(difficulty, int) or difficulty < MIN_DIFFICULTY:
+        print(f"Difficulty {difficulty} is below the minimum of {MIN_DIFFICULTY}")
+        return False
+    if not computed.startswith("0" * difficulty):
+        print(f"Difficulty not met: '{computed}' does not start with {'0'*difficulty}")
         return False
     return True
 
@@ -59,6 +69,13 @@ def verify_signature(block):
     debug_print(2, f"Signature present (length {len(sig)}) for user '{block.get('username','')}'")
     return True
 
+def record_checksum_ok(line):
+    # Records appended by the game end with a CRC-32 of everything before ', "crc"'.
+    idx = line.rfind(', "crc":"')
+    if idx < 0:
+        return True
+    return zlib.crc32(line[:idx].encode()) == int(line[idx + 9:idx + 17], 16)
+
 def load_blockchain():
     blocks = []
     if not os.path.exists(BLOCKCHAIN_FILE):
@@ -70,6 +87,9 @@ def load_blockchain():
             if not line:
                 continue
             try:
+                if not record_checksum_ok(line):
+                    print("Skipping block with a bad checksum (torn or damaged record)")
+                    continue
                 block = json.loads(line)
                 blocks.append(block)
             except Exception as e:
@@ -77,6 +97,51 @@ def load_blockchain():
     debug_print(2, f"Loaded {len(blocks)} block(s) from {BLOCKCHAIN_FILE}")
     return blocks
 
+def ledgerd_request(request):
+    """Sends one request to a running ledgerd (see src/ledgerd.h) and returns
+    the reply lines after the "OK <n>" header, or None if no daemon answers."""
+    if not os.path.exists(LEDGERD_SOCKET):
+        return None
+    try:
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+            sock.settimeout(5)
+            sock.connect(LEDGERD_SOCKET)
+            sock.sendall((request + "\n").encode())
+            sock.shutdown(socket.SHUT_WR)
+            data = b""
+            while True:
+                chunk = sock.recv(65536)
+                if not chunk:
+                    break
+                data += chunk
+    except OSError as e:
+        debug_print(2, f"ledgerd not reachable ({e}); reading the blockchain file")
+        return None
+    lines = data.decode().splitlines()
+    if not lines or not lines[0].startswith("OK "):
+        return None
+    return lines[1:]
+
+def ledgerd_scores(limit):
+    """Top scores and cheater blocks from a running ledgerd, which keeps both
+    verified in memory. Returns (top_scores, cheater_blocks) or None."""
+    top = ledgerd_request(f"TOP {limit}")
+    invalid = ledgerd_request("INVALID")
+    if top is None or invalid is None:
+        return None
+    top_scores = []
+    for line in top:
+        score, timestamp, username = line.split(" ", 2)
+        top_scores.append((username, int(score), {"timestamp": int(timestamp)}))
+    cheater_blocks = []
+    for line in invalid:
+        reasons, record = line.split(" ", 1)
+        block = json.loads(record)
+        block["_reasons"] = ["Invalid PoW" if r == "pow" else "Invalid Signature" for r in reasons.split(",")]
+        cheater_blocks.append(block)
+    debug_print(2, f"ledgerd served {len(top_scores)} top score(s) and {len(cheater_blocks)} cheater block(s)")
+    return top_scores, cheater_blocks
+
 def partition_blocks(blocks):
     valid_blocks = []
     cheater_blocks = []
@@ -124,11 +189,13 @@ def generate_cheaters_table(cheater_blocks):
         username = block.get("username", "")
         score = block.get("score", 0)
         ts = time.strftime('%Y-%m-%d %H:%M:%S', time.localtime(block.get("timestamp",0)))
-        reasons = []
-        if not verify_proof_of_work(block):
-            reasons.append("Invalid PoW")
-        if not verify_signature(block):
-            reasons.append("Invalid Signature")
+        reasons = block.get("_reasons")
+        if reasons is None:
+            reasons = []
+            if not verify_proof_of_work(block):
+                reasons.append("Invalid PoW")
+            if not verify_signature(block):
+                reasons.append("Invalid Signature")
         reason_str = ", ".join(reasons)
         rows.append(f"| {username:<18} | {score:<5} | {ts} | {reason_str} |")
     table = header + "\n".join(rows)
@@ -215,15 +282,19 @@ def check_version_consistency():
 
 def main():
     print("Starting high score update...")
-    all_blocks = load_blockchain()
-    if not all_blocks:
-        print("No blockchain data found.")
-        sys.exit(0)
-    
-    valid_blocks, cheater_blocks = partition_blocks(all_blocks)
-    debug_print(2, f"Valid blocks: {len(valid_blocks)}, Cheater blocks: {len(cheater_blocks)}")
-    
-    top_scores = get_top_scores(valid_blocks)
+    served = ledgerd_scores(limit=3)
+    if served:
+        top_scores, cheater_blocks = served
+    else:
+        all_blocks = load_blockchain()
+        if not all_blocks:
+            print("No blockchain data found.")
+            sys.exit(0)
+
+        valid_blocks, cheater_blocks = partition_blocks(all_blocks)
+        debug_print(2, f"Valid blocks: {len(valid_blocks)}, Cheater blocks: {len(cheater_blocks)}")
+
+        top_scores = get_top_scores(valid_blocks)
     if not top_scores:
         print("No top scores found.")
         sys.exit(0)
@@ -10,6 +10,7 @@ digital signature are correct. This script is intended for development and CI ve
 import os
 import json
 import hashlib
+import zlib
 import time
 
 # ANSI color codes for debug messages:
@@ -30,7 +31,10 @@ def debug_print(message, level=2):
 
 # Adjust BLOCKCHAIN_FILE so that it points to the same file your game writes.
 BLOCKCHAIN_FILE = "../highscore/blockchain.txt"
-DIFFICULTY = 4  # number of leading zeros required
+# Blocks record the difficulty they were sealed at; records without one
+# predate per-block difficulty. Both must match the C side (blockchain.h).
+DIFFICULTY = 4  # leading zeros of records without a "difficulty" field
+MIN_DIFFICULTY = 3  # lowest difficulty a block may claim
 
 def compute_block_hash(block):
     # Format: username|score|timestamp|prev_hash|nonce
@@ -46,8 +50,12 @@ def verify_proof_of_work(block):
     if stored != computed:
         print(f"Invalid proof-of-work hash in block: expected '{computed}' but found '{stored}'")
         return False
-    if not computed.startswith("0" * DIFFICULTY):
-        print(f"Block does not meet difficulty requirement: '{computed}' does not start with {'0'*DIFFICULTY}")
+    difficulty = block.get("difficulty", DIFFICULTY)
+    if not isinstance(difficulty, int) or difficulty < MIN_DIFFICULTY:
+        print(f"Difficulty {difficulty} is below the minimum of {MIN_DIFFICULTY}")
+        return False
+    if not computed.startswith("0" * difficulty):
+        print(f"Block does not meet difficulty requirement: '{computed}' does not start with {'0'*difficulty}")
         return False
     return True
 
@@ -59,6 +67,13 @@ def verify_signature(block):
     debug_print(f"Signature present (length {len(sig)}) for user '{block.get('username','')}'", level=2)
     return True
 
+def record_checksum_ok(line):
+    # Records appended by the game end with a CRC-32 of everything before ', "crc"'.
+    idx = line.rfind(', "crc":"')
+    if idx < 0:
+        return True
+    return zlib.crc32(line[:idx].encode()) == int(line[idx + 9:idx + 17], 16)
+
 def load_blockchain():
     blocks = []
     if not os.path.exists(BLOCKCHAIN_FILE):
@@ -70,6 +85,9 @@ def load_blockchain():
             if not line:
                 continue
             try:
+                if not record_checksum_ok(line):
+                    print("Skipping block with a bad checksum (torn or damaged record)")
+                    continue
                 block = json.loads(line)
                 blocks.append(block)
             except Exception as e:
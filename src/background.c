@@ -1,4 +1,5 @@
 #include "background.h"
+#include "trace.h"
 #include <SDL2/SDL.h>
 #include <stdlib.h>
 #include <time.h>
@@ -8,6 +9,12 @@
 static BGObject bgObjects[NUM_BG_OBJECTS];
 static int bgInitialized = 0;
 
+/* The background has its own random sequence so that drawing it never
+ * consumes numbers from the simulation's rand() (which a replay relies on). */
+static unsigned int bgSeed = 1;
+static unsigned int bgFixedSeed = 0;   // 0 = seed from the clock
+#define bg_rand() rand_r(&bgSeed)
+
 /* Helper: check if two circles (centered at (x,y) with radius r) overlap */
 static int overlaps(float x, float y, int size, float x2, float y2, int size2) {
     float dx = x - x2;
@@ -54,7 +61,7 @@ static void draw_filled_circle(SDL_Renderer* renderer, int cx, int cy, int radiu
 /* Drawing routines for each BGType */
 static void draw_bg_star(SDL_Renderer* renderer, int x, int y, int size, SDL_Color color) {
     /* Twinkle effect by slightly varying brightness */
-    int flicker = rand() % 30;
+    int flicker = bg_rand() % 30;
     SDL_Color modColor = { 
         (Uint8)fmin(255, color.r + flicker), 
         (Uint8)fmin(255, color.g + flicker), 
@@ -112,9 +119,9 @@ static void draw_bg_nebula(SDL_Renderer* renderer, int x, int y, int size, SDL_C
 static void draw_bg_star_cluster(SDL_Renderer* renderer, int x, int y, int size, SDL_Color color) {
     int clusterSize = size;
     for (int i = 0; i < 8; i++) {
-        int offsetX = rand() % clusterSize - clusterSize/2;
-        int offsetY = rand() % clusterSize - clusterSize/2;
-        int starSize = 2 + rand() % 3;
+        int offsetX = bg_rand() % clusterSize - clusterSize/2;
+        int offsetY = bg_rand() % clusterSize - clusterSize/2;
+        int starSize = 2 + bg_rand() % 3;
         SDL_Color starInner = { color.r, color.g, color.b, 255 };
         SDL_Color starOuter = { color.r, color.g, color.b, 0 };
         draw_radial_gradient(renderer, x + offsetX, y + offsetY, starSize, starInner, starOuter);
@@ -137,71 +144,71 @@ static void draw_bg_blackhole(SDL_Renderer* renderer, int x, int y, int size, SD
 */
 static void init_background_objects() {
     DEBUG_PRINT(3, 2, "Initializing background objects...");
-    srand((unsigned int)time(NULL));
+    bgSeed = bgFixedSeed ? bgFixedSeed : (unsigned int)time(NULL);
     int i = 0;
     int maxAttempts = 100;
     while (i < NUM_BG_OBJECTS) {
         BGObject obj;
-        int r = rand() % 100;
+        int r = bg_rand() % 100;
         if (r < 40) {
             obj.type = BG_STAR;
-            obj.size = 1 + rand() % 3;
-            obj.color.r = 200 + rand() % 56;
-            obj.color.g = 200 + rand() % 56;
-            obj.color.b = 200 + rand() % 56;
+            obj.size = 1 + bg_rand() % 3;
+            obj.color.r = 200 + bg_rand() % 56;
+            obj.color.g = 200 + bg_rand() % 56;
+            obj.color.b = 200 + bg_rand() % 56;
             obj.color.a = 255;
         } else if (r < 55) {
             obj.type = BG_PLANET;
-            obj.size = 40 + rand() % 40;
-            obj.color.r = rand() % 256;
-            obj.color.g = rand() % 256;
-            obj.color.b = rand() % 256;
+            obj.size = 40 + bg_rand() % 40;
+            obj.color.r = bg_rand() % 256;
+            obj.color.g = bg_rand() % 256;
+            obj.color.b = bg_rand() % 256;
             obj.color.a = 255;
         } else if (r < 65) {
             obj.type = BG_MOON;
-            obj.size = 20 + rand() % 20;
-            obj.color.r = 180 + rand() % 76;
-            obj.color.g = 180 + rand() % 76;
-            obj.color.b = 180 + rand() % 76;
+            obj.size = 20 + bg_rand() % 20;
+            obj.color.r = 180 + bg_rand() % 76;
+            obj.color.g = 180 + bg_rand() % 76;
+            obj.color.b = 180 + bg_rand() % 76;
             obj.color.a = 255;
         } else if (r < 75) {
             obj.type = BG_ASTEROID;
-            obj.size = 15 + rand() % 15;
-            obj.color.r = 100 + rand() % 156;
-            obj.color.g = 100 + rand() % 156;
-            obj.color.b = 100 + rand() % 156;
+            obj.size = 15 + bg_rand() % 15;
+            obj.color.r = 100 + bg_rand() % 156;
+            obj.color.g = 100 + bg_rand() % 156;
+            obj.color.b = 100 + bg_rand() % 156;
             obj.color.a = 255;
         } else if (r < 80) {
             obj.type = BG_NEUTRON_STAR;
-            obj.size = 8 + rand() % 5;
+            obj.size = 8 + bg_rand() % 5;
             obj.color.r = 255;
             obj.color.g = 255;
             obj.color.b = 255;
             obj.color.a = 255;
         } else if (r < 85) {
             obj.type = BG_GALAXY;
-            obj.size = 80 + rand() % 40;
-            obj.color.r = rand() % 256;
-            obj.color.g = rand() % 256;
-            obj.color.b = rand() % 256;
+            obj.size = 80 + bg_rand() % 40;
+            obj.color.r = bg_rand() % 256;
+            obj.color.g = bg_rand() % 256;
+            obj.color.b = bg_rand() % 256;
             obj.color.a = 200;
         } else if (r < 90) {
             obj.type = BG_NEBULA;
-            obj.size = 100 + rand() % 50;
-            obj.color.r = rand() % 256;
-            obj.color.g = rand() % 256;
-            obj.color.b = rand() % 256;
+            obj.size = 100 + bg_rand() % 50;
+            obj.color.r = bg_rand() % 256;
+            obj.color.g = bg_rand() % 256;
+            obj.color.b = bg_rand() % 256;
             obj.color.a = 150;
         } else if (r < 95) {
             obj.type = BG_STAR_CLUSTER;
-            obj.size = 30 + rand() % 20;
-            obj.color.r = 200 + rand() % 56;
-            obj.color.g = 200 + rand() % 56;
-            obj.color.b = 200 + rand() % 56;
+            obj.size = 30 + bg_rand() % 20;
+            obj.color.r = 200 + bg_rand() % 56;
+            obj.color.g = 200 + bg_rand() % 56;
+            obj.color.b = 200 + bg_rand() % 56;
             obj.color.a = 255;
         } else {
             obj.type = BG_BLACKHOLE;
-            obj.size = 50 + rand() % 30;
+            obj.size = 50 + bg_rand() % 30;
             obj.color.r = 0;
             obj.color.g = 0;
             obj.color.b = 0;
@@ -211,8 +218,8 @@ static void init_background_objects() {
            WORLD_BORDER should be defined in config.h (default 10000).
            We use a coordinate system centered at 0 (from -WORLD_BORDER/2 to WORLD_BORDER/2).
         */
-        obj.x = -(WORLD_BORDER / 2) + rand() % WORLD_BORDER;
-        obj.y = -(WORLD_BORDER / 2) + rand() % WORLD_BORDER;
+        obj.x = -(WORLD_BORDER / 2) + bg_rand() % WORLD_BORDER;
+        obj.y = -(WORLD_BORDER / 2) + bg_rand() % WORLD_BORDER;
         
         /* Check for overlap with already placed objects. */
         int attempts = 0;
@@ -222,8 +229,8 @@ static void init_background_objects() {
             for (int j = 0; j < i; j++) {
                 if (overlaps(obj.x, obj.y, obj.size, bgObjects[j].x, bgObjects[j].y, bgObjects[j].size)) {
                     conflict = 1;
-                    obj.x = -(WORLD_BORDER / 2) + rand() % WORLD_BORDER;
-                    obj.y = -(WORLD_BORDER / 2) + rand() % WORLD_BORDER;
+                    obj.x = -(WORLD_BORDER / 2) + bg_rand() % WORLD_BORDER;
+                    obj.y = -(WORLD_BORDER / 2) + bg_rand() % WORLD_BORDER;
                     break;
                 }
             }
@@ -237,11 +244,16 @@ static void init_background_objects() {
     DEBUG_PRINT(3, 3, "Initialized %d background objects", NUM_BG_OBJECTS);
 }
 
+void seed_background(unsigned int seed) {
+    bgFixedSeed = seed;
+    bgInitialized = 0;
+}
+
 /* Main draw function.
    If ENABLE_GRID is true, draws grid lines over the background.
    Then draws each background object using its dedicated drawing routine.
 */
-void draw_background(SDL_Renderer* renderer, float cam_x, float cam_y, int screen_width, int screen_height) {
+int draw_background(SDL_Renderer* renderer, float cam_x, float cam_y, int screen_width, int screen_height) {
     /* Fill with deep-space background color. */
     SDL_SetRenderDrawColor(renderer, 0, 0, 20, 255);
     SDL_RenderClear(renderer);
@@ -268,16 +280,19 @@ void draw_background(SDL_Renderer* renderer, float cam_x, float cam_y, int scree
 
     if (!bgInitialized) {
         DEBUG_PRINT(3, 2, "Background objects not initialized, initializing now.");
-        init_background_objects();
+        TRACE_SCOPE("init_background_objects")
+            init_background_objects();
     }
     
     /* Draw each background object if it is within the view (with margin) */
+    int visible = 0;
     for (int i = 0; i < NUM_BG_OBJECTS; i++) {
         float objScreenX = bgObjects[i].x - cam_x;
         float objScreenY = bgObjects[i].y - cam_y;
         if (objScreenX < -150 || objScreenX > screen_width + 150 ||
             objScreenY < -150 || objScreenY > screen_height + 150)
             continue;
+        visible++;
         switch (bgObjects[i].type) {
             case BG_STAR:
                 draw_bg_star(renderer, (int)objScreenX, (int)objScreenY, bgObjects[i].size, bgObjects[i].color);
@@ -310,4 +325,5 @@ void draw_background(SDL_Renderer* renderer, float cam_x, float cam_y, int scree
                 break;
         }
     }
+    return visible;
 }
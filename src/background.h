@@ -27,7 +27,14 @@ typedef struct {
 } BGObject;
 
 
-void draw_background(SDL_Renderer* renderer, float cam_x, float cam_y, int screen_width, int screen_height);
+// Makes the next draw_background lay out the objects again from seed
+// instead of the clock, so the same seed gives the same sky (draw_bench
+// uses this to compare frames). A seed of 0 goes back to the clock.
+void seed_background(unsigned int seed);
+
+// Draws the background for the camera position; returns the number of
+// background objects in view.
+int draw_background(SDL_Renderer* renderer, float cam_x, float cam_y, int screen_width, int screen_height);
 
 #endif
 
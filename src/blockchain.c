@@ -1,102 +1,249 @@
 #include "blockchain.h"
-#include "encryption.h"   // for hash_score function
+#include "encryption.h"   // for hash_score and the hex codecs
+#include "config.h"
 #include "debug.h"
+#include "trace.h"
+#include "memtrack.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
-#define HASH_STR_LEN 65  // assuming SHA-256 hex string length (64 + null terminator)
+// CRC-32 (IEEE, as in zlib) four bits at a time.
+static const unsigned int crc32_nibbles[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
 
-// Helper: Check if a hash (hex string) meets difficulty requirement (leading zeros).
-static int hash_meets_difficulty(const char *hash, int difficulty) {
+static unsigned int record_crc32(const char *data, size_t len) {
+    unsigned int crc = 0xffffffffu;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char b = (unsigned char)data[i];
+        crc = crc32_nibbles[(crc ^ b) & 0x0f] ^ (crc >> 4);
+        crc = crc32_nibbles[(crc ^ (b >> 4)) & 0x0f] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+// Longest decimal nonce (UINT_MAX has 10 digits).
+#define NONCE_DIGITS_MAX 10
+
+// Check if a raw hash has the required number of leading zero hex digits.
+int hash_meets_difficulty(const unsigned char *hash, int difficulty) {
     for (int i = 0; i < difficulty; i++) {
-        if (hash[i] != '0')
+        unsigned char nibble = (i & 1) ? (hash[i / 2] & 0x0f) : (hash[i / 2] >> 4);
+        if (nibble != 0)
             return 0;
     }
     return 1;
 }
 
+// Writes the decimal digits of value (no terminator) and returns their count.
+static int format_nonce(unsigned int value, char *out) {
+    char digits[NONCE_DIGITS_MAX];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    for (int i = 0; i < n; i++)
+        out[i] = digits[n - 1 - i];
+    return n;
+}
+
+// Writes the part of the block data string before the nonce.
+static int block_data_prefix(const ScoreBlock *block, char *out, size_t out_size) {
+    char prev_hex[HASH_STR_LEN];
+    hex_encode(block->prev_hash, HASH_LEN, prev_hex);
+    int len = snprintf(out, out_size, "%s|%d|%ld|%s|",
+                       block->username, block->score, block->timestamp, prev_hex);
+    if (len < 0 || (size_t)len + NONCE_DIGITS_MAX >= out_size)
+        return -1;
+    return len;
+}
+
+int block_data_string(const ScoreBlock *block, char *out, size_t out_size) {
+    int len = block_data_prefix(block, out, out_size);
+    if (len < 0)
+        return -1;
+    len += format_nonce(block->nonce, out + len);
+    out[len] = '\0';
+    return len;
+}
+
 // Compute hash over block data (excluding proof_of_work, signature, and nonce)
-// and write the hex digest into output_hash.
-void compute_block_hash(const ScoreBlock *block, char *output_hash) {
-    char buffer[512] = {0}; // zero initialize to avoid garbage
-    // Build a string from the block fields.
-    // Ensure we print the timestamp as a long and the nonce as unsigned int.
-    snprintf(buffer, sizeof(buffer), "%s|%d|%ld|%s|%u",
-             block->username,
-             block->score,
-             block->timestamp,
-             block->prev_hash,
-             block->nonce);
-    // Debug: output the buffer being hashed.
+// and write the raw digest into output_hash.
+void compute_block_hash(const ScoreBlock *block, unsigned char *output_hash) {
+    char buffer[BLOCK_DATA_MAX];
+    int len = block_data_string(block, buffer, sizeof(buffer));
+    if (len < 0) {
+        memset(output_hash, 0xff, HASH_LEN);  // never meets any difficulty
+        return;
+    }
     DEBUG_PRINT(2, 2, "compute_block_hash: buffer = \"%s\"", buffer);
-    hash_score(buffer, output_hash);
-    DEBUG_PRINT(2, 2, "compute_block_hash: computed hash = %s", output_hash);
+    hash_score(buffer, (size_t)len, output_hash);
+}
+
+// Hashes timed to estimate the local proof-of-work rate.
+#define POW_CALIBRATION_HASHES 4096
+
+// Nonces tried between clock reads while sealing against a budget.
+#define POW_DEADLINE_INTERVAL 1024
+
+// In adaptive mode the difficulty drops a level each time sealing has taken
+// this many budgets more, so an unlucky search still finishes.
+#define POW_RELAX_FACTOR 2
+
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1e6;
 }
 
 // Computes valid proof-of-work for the new block.
 // Adjusts block->nonce until the computed hash meets the specified difficulty.
-static void compute_proof_of_work(ScoreBlock *block, int difficulty) {
-    char hash[HASH_STR_LEN] = {0};
+// Only the nonce changes between attempts, so the rest of the data string is
+// formatted once. With budget_ms > 0 the difficulty is relaxed (never below
+// MIN_DIFFICULTY) when the search runs long; the difficulty is not part of the
+// hashed data, so the nonces already tried carry over. The difficulty met is
+// stored in block->difficulty.
+static void compute_proof_of_work(ScoreBlock *block, int difficulty, int budget_ms) {
+    char buffer[BLOCK_DATA_MAX];
+    unsigned char hash[HASH_LEN];
+    int prefix_len = block_data_prefix(block, buffer, sizeof(buffer));
     block->nonce = 0;
+    block->difficulty = difficulty;
+    if (prefix_len < 0) {
+        DEBUG_PRINT(2, 0, "Block data for %s is too long to hash", block->username);
+        return;
+    }
+    uint64_t trace_t0 = TRACE_BEGIN();
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int relaxed = 0;
     while (1) {
-        compute_block_hash(block, hash);
-        // Debug: log each nonce and its corresponding hash.
-        DEBUG_PRINT(2, 2, "Proof-of-Work: nonce = %u, hash = %s", block->nonce, hash);
+        int len = prefix_len + format_nonce(block->nonce, buffer + prefix_len);
+        hash_score(buffer, (size_t)len, hash);
         if (hash_meets_difficulty(hash, difficulty)) {
-            strncpy(block->proof_of_work, hash, HASH_STR_LEN - 1);
-            block->proof_of_work[HASH_STR_LEN - 1] = '\0';
-            DEBUG_PRINT(2, 3, "Valid PoW found: nonce = %u, hash = %s", block->nonce, hash);
+            memcpy(block->proof_of_work, hash, HASH_LEN);
+            block->difficulty = difficulty;
+            char hex[HASH_STR_LEN];
+            hex_encode(hash, HASH_LEN, hex);
+            DEBUG_PRINT(2, 3, "Valid PoW found: nonce = %u, hash = %s", block->nonce, hex);
             break;
         }
         block->nonce++;
+        if (budget_ms > 0 && difficulty > MIN_DIFFICULTY && block->nonce % POW_DEADLINE_INTERVAL == 0 &&
+            elapsed_ms(&start) > (double)budget_ms * POW_RELAX_FACTOR * (relaxed + 1)) {
+            difficulty--;
+            relaxed++;
+            DEBUG_PRINT(2, 1, "Proof-of-work over its %d ms budget, lowering difficulty to %d",
+                        budget_ms, difficulty);
+        }
+    }
+    TRACE_END("compute_proof_of_work", trace_t0);
+}
+
+// Times POW_CALIBRATION_HASHES attempts of the sealing loop on a typical
+// block; returns hashes per second.
+static double measure_hash_rate(void) {
+    ScoreBlock probe;
+    memset(&probe, 0, sizeof(probe));
+    strcpy(probe.username, "calibration");
+    probe.timestamp = time(NULL);
+    char buffer[BLOCK_DATA_MAX];
+    unsigned char hash[HASH_LEN];
+    int prefix_len = block_data_prefix(&probe, buffer, sizeof(buffer));
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned int nonce = 0; nonce < POW_CALIBRATION_HASHES; nonce++) {
+        int len = prefix_len + format_nonce(nonce, buffer + prefix_len);
+        hash_score(buffer, (size_t)len, hash);
+    }
+    double ms = elapsed_ms(&start);
+    return ms > 0 ? POW_CALIBRATION_HASHES * 1000.0 / ms : 0;
+}
+
+int pow_auto_difficulty(int budget_ms) {
+    static double hash_rate;
+    if (hash_rate <= 0) {
+        TRACE_SCOPE("measure_hash_rate")
+            hash_rate = measure_hash_rate();
+        DEBUG_PRINT(2, 3, "Proof-of-work rate: %.0f hashes/s", hash_rate);
+    }
+    // A difficulty of d takes 16^d attempts on average.
+    double attempts = 1;
+    for (int i = 0; i < MIN_DIFFICULTY; i++)
+        attempts *= 16;
+    int difficulty = MIN_DIFFICULTY;
+    while (difficulty < MAX_DIFFICULTY && hash_rate > 0 &&
+           attempts * 16 * 1000.0 / hash_rate <= budget_ms) {
+        attempts *= 16;
+        difficulty++;
     }
+    return difficulty;
 }
 
 // Adds a new block to the blockchain.
 // Fills in prev_hash and computes proof-of-work.
 void add_score_block(ScoreBlock *newBlock, const ScoreBlock *prev, int difficulty) {
     if (prev) {
-        // Copy only HASH_STR_LEN-1 characters and ensure null termination.
-        strncpy(newBlock->prev_hash, prev->proof_of_work, HASH_STR_LEN - 1);
-        newBlock->prev_hash[HASH_STR_LEN - 1] = '\0';
+        memcpy(newBlock->prev_hash, prev->proof_of_work, HASH_LEN);
     } else {
         // Genesis block: set prev_hash to all zeros.
-        memset(newBlock->prev_hash, '0', HASH_STR_LEN - 1);
-        newBlock->prev_hash[HASH_STR_LEN - 1] = '\0';
+        memset(newBlock->prev_hash, 0, HASH_LEN);
     }
     // Set the timestamp if not already set.
     if (newBlock->timestamp == 0)
         newBlock->timestamp = time(NULL);
 
-    DEBUG_PRINT(2, 2, "add_score_block: Before PoW: Username: %s, Score: %d, Timestamp: %ld, Prev_hash: %s",
-                newBlock->username, newBlock->score, newBlock->timestamp, newBlock->prev_hash);
+    int budget_ms = 0;
+    if (difficulty == POW_DIFFICULTY_AUTO) {
+        budget_ms = POW_LATENCY_BUDGET_MS;
+        difficulty = pow_auto_difficulty(budget_ms);
+    }
+
+    DEBUG_PRINT(2, 2, "add_score_block: Before PoW: Username: %s, Score: %d, Timestamp: %ld, Difficulty: %d",
+                newBlock->username, newBlock->score, newBlock->timestamp, difficulty);
 
-    // Compute proof-of-work; this updates newBlock->nonce and newBlock->proof_of_work.
-    compute_proof_of_work(newBlock, difficulty);
+    // Compute proof-of-work; this updates newBlock->nonce, proof_of_work and difficulty.
+    compute_proof_of_work(newBlock, difficulty, budget_ms);
 
-    DEBUG_PRINT(2, 2, "add_score_block: After PoW: Proof_of_work: %s, Nonce: %u", newBlock->proof_of_work, newBlock->nonce);
+    DEBUG_PRINT(2, 2, "add_score_block: After PoW: Nonce: %u", newBlock->nonce);
+}
+
+int verify_block_pow(const ScoreBlock *block, int min_difficulty) {
+    unsigned char hash[HASH_LEN];
+    compute_block_hash(block, hash);
+    return memcmp(hash, block->proof_of_work, HASH_LEN) == 0 &&
+           block->difficulty >= min_difficulty &&
+           hash_meets_difficulty(block->proof_of_work, block->difficulty);
 }
 
 // Verifies the blockchain integrity.
-int verify_blockchain(const ScoreBlock *chain, int count, int difficulty) {
-    char recomputed_hash[HASH_STR_LEN] = {0};
+int verify_blockchain(const ScoreBlock *chain, int count, int min_difficulty) {
+    unsigned char recomputed_hash[HASH_LEN];
     for (int i = 0; i < count; i++) {
         const ScoreBlock *block = &chain[i];
         compute_block_hash(block, recomputed_hash);
-        DEBUG_PRINT(2, 2, "verify_blockchain: Block %d: Stored PoW: %s", i, block->proof_of_work);
-        DEBUG_PRINT(2, 2, "verify_blockchain: Block %d: Recomputed hash: %s", i, recomputed_hash);
-        if (strncmp(block->proof_of_work, recomputed_hash, HASH_STR_LEN) != 0) {
+        if (memcmp(block->proof_of_work, recomputed_hash, HASH_LEN) != 0) {
             DEBUG_PRINT(2, 0, "Block %d: invalid proof-of-work hash.", i);
             return 0;
         }
-        if (!hash_meets_difficulty(block->proof_of_work, difficulty)) {
+        if (block->difficulty < min_difficulty) {
+            DEBUG_PRINT(2, 0, "Block %d: difficulty %d is below the minimum %d.", i, block->difficulty, min_difficulty);
+            return 0;
+        }
+        if (!hash_meets_difficulty(block->proof_of_work, block->difficulty)) {
             DEBUG_PRINT(2, 0, "Block %d: proof-of-work does not meet difficulty.", i);
             return 0;
         }
         if (i > 0) {
-            if (strncmp(block->prev_hash, chain[i-1].proof_of_work, HASH_STR_LEN) != 0) {
+            if (memcmp(block->prev_hash, chain[i-1].proof_of_work, HASH_LEN) != 0) {
                 DEBUG_PRINT(2, 0, "Block %d: previous hash does not match", i);
                 return 0;
             }
@@ -105,3 +252,252 @@ int verify_blockchain(const ScoreBlock *chain, int count, int difficulty) {
     return 1;
 }
 
+// Decodes a hex field that must be exactly 2 * len digits long.
+static int decode_hex_field(const char *hex, unsigned char *out, size_t len) {
+    return strlen(hex) == 2 * len && hex_decode(hex, out, len);
+}
+
+int parse_score_block(const char *line, ScoreBlock *block) {
+    char pow_hex[HASH_STR_LEN];
+    char sig_hex[SIG_STR_LEN];
+    char prev_hex[HASH_STR_LEN * 2];
+    int end = 0;
+    int ret = sscanf(line,
+        "{\"username\":\"%49[^\"]\", \"score\":%d, \"timestamp\":%ld, \"proof_of_work\":\"%64[^\"]\", \"signature\":\"%512[^\"]\", \"prev_hash\":\"%128[^\"]\", \"nonce\":%u%n",
+        block->username, &block->score, &block->timestamp,
+        pow_hex, sig_hex, prev_hex, &block->nonce, &end);
+    if (ret != 7 || end == 0)
+        return 0;
+    // Legacy records end right after the nonce; newer ones carry a version
+    // and the difficulty they were sealed at, and records written by
+    // append_score_block end with a checksum.
+    const char *rest = line + end;
+    int rest_end = 0;
+    block->version = BLOCK_VERSION_RSA;
+    if (sscanf(rest, ", \"version\":%d%n", &block->version, &rest_end) == 1 && rest_end > 0)
+        rest += rest_end;
+    block->difficulty = DIFFICULTY;
+    rest_end = 0;
+    if (sscanf(rest, ", \"difficulty\":%d%n", &block->difficulty, &rest_end) == 1 && rest_end > 0)
+        rest += rest_end;
+    if (block->difficulty < 0 || block->difficulty > 2 * HASH_LEN)
+        return 0;
+    unsigned int crc;
+    rest_end = 0;
+    if (sscanf(rest, ", \"crc\":\"%8x\"%n", &crc, &rest_end) == 1 && rest_end > 0) {
+        if (record_crc32(line, (size_t)(rest - line)) != crc) {
+            DEBUG_PRINT(2, 1, "Skipping a block record with a bad checksum");
+            return 0;
+        }
+        rest += rest_end;
+    }
+    if (rest[0] != '}')
+        return 0;
+    if (!decode_hex_field(pow_hex, block->proof_of_work, HASH_LEN) ||
+        !decode_hex_field(prev_hex, block->prev_hash, HASH_LEN))
+        return 0;
+    size_t sig_len = strlen(sig_hex) / 2;
+    if (sig_len > SIG_MAX_LEN || !decode_hex_field(sig_hex, block->signature, sig_len))
+        sig_len = 0;
+    block->signature_len = (unsigned short)sig_len;
+    return 1;
+}
+
+int format_score_block(const ScoreBlock *block, char *out, size_t out_size) {
+    char pow_hex[HASH_STR_LEN];
+    char sig_hex[SIG_STR_LEN];
+    char prev_hex[HASH_STR_LEN];
+    if (block->signature_len > SIG_MAX_LEN)
+        return -1;
+    hex_encode(block->proof_of_work, HASH_LEN, pow_hex);
+    hex_encode(block->signature, block->signature_len, sig_hex);
+    hex_encode(block->prev_hash, HASH_LEN, prev_hex);
+    int len = snprintf(out, out_size,
+        "{\"username\":\"%s\", \"score\":%d, \"timestamp\":%ld, \"proof_of_work\":\"%s\", \"signature\":\"%s\", \"prev_hash\":\"%s\", \"nonce\":%u",
+        block->username, block->score, block->timestamp,
+        pow_hex, sig_hex, prev_hex, block->nonce);
+    if (len < 0 || (size_t)len >= out_size)
+        return -1;
+    if (block->version != BLOCK_VERSION_RSA) {
+        int version_len = snprintf(out + len, out_size - len, ", \"version\":%d", block->version);
+        if (version_len < 0 || (size_t)version_len >= out_size - len)
+            return -1;
+        len += version_len;
+    }
+    int difficulty_len = snprintf(out + len, out_size - len, ", \"difficulty\":%d", block->difficulty);
+    if (difficulty_len < 0 || (size_t)difficulty_len >= out_size - len)
+        return -1;
+    len += difficulty_len;
+    int tail = snprintf(out + len, out_size - len, ", \"crc\":\"%08x\"}\n", record_crc32(out, (size_t)len));
+    if (tail < 0 || (size_t)tail >= out_size - len)
+        return -1;
+    return len + tail;
+}
+
+// Waits for a whole-file advisory lock of the given type (F_WRLCK or F_UNLCK).
+static int lock_file(int fd, short type) {
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    while (fcntl(fd, F_SETLKW, &fl) != 0) {
+        if (errno != EINTR)
+            return 0;
+    }
+    return 1;
+}
+
+// Repairs the end of the chain after a writer crashed mid-record: a final
+// line without its newline is completed if it is a whole record, otherwise
+// cut off. Call with the chain locked.
+static int repair_torn_tail(int fd) {
+    struct stat st;
+    char c;
+    if (fstat(fd, &st) != 0)
+        return 0;
+    if (st.st_size == 0 || (pread(fd, &c, 1, st.st_size - 1) == 1 && c == '\n'))
+        return 1;
+
+    // Find the start of the final line.
+    char buf[BLOCK_LINE_MAX * 2];
+    off_t end = st.st_size, cut = 0;
+    while (end > 0 && cut == 0) {
+        off_t start = end > (off_t)sizeof(buf) ? end - (off_t)sizeof(buf) : 0;
+        if (pread(fd, buf, (size_t)(end - start), start) != end - start)
+            return 0;
+        for (off_t i = end - start; i > 0; i--) {
+            if (buf[i - 1] == '\n') {
+                cut = start + i;
+                break;
+            }
+        }
+        end = start;
+    }
+
+    off_t tail_len = st.st_size - cut;
+    ScoreBlock block;
+    if (tail_len < (off_t)sizeof(buf) && pread(fd, buf, (size_t)tail_len, cut) == tail_len) {
+        buf[tail_len] = '\0';
+        if (parse_score_block(buf, &block)) {
+            DEBUG_PRINT(2, 1, "Last record of %s has no newline; adding it", BLOCKCHAIN_FILE);
+            return write(fd, "\n", 1) == 1;
+        }
+    }
+    DEBUG_PRINT(2, 1, "Removing a torn %ld-byte record from the end of %s", (long)tail_len, BLOCKCHAIN_FILE);
+    return ftruncate(fd, cut) == 0;
+}
+
+// Writes all len bytes of data to fd.
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+// Makes the chain durable up to offset end. The sync sidecar records how far
+// the chain is known to be on disk; a writer whose record is already covered
+// by another writer's fsync skips its own, so concurrent appends share one.
+static int sync_chain(int fd, off_t end) {
+    int sync_fd = open(BLOCKCHAIN_SYNC_FILE, O_RDWR | O_CREAT, 0644);
+    if (sync_fd < 0 || !lock_file(sync_fd, F_WRLCK)) {
+        // No sidecar: fall back to a private fsync.
+        if (sync_fd >= 0)
+            close(sync_fd);
+        return fdatasync(fd) == 0;
+    }
+    struct stat st;
+    char state[64] = {0};
+    unsigned long inode = 0;
+    long durable = 0;
+    int ok = fstat(fd, &st) == 0;
+    if (ok && pread(sync_fd, state, sizeof(state) - 1, 0) > 0 &&
+        sscanf(state, "%lu %ld", &inode, &durable) == 2 &&
+        inode == (unsigned long)st.st_ino && durable >= (long)end && durable <= (long)st.st_size) {
+        DEBUG_PRINT(2, 2, "Block at offset %ld already synced by another writer", (long)end);
+    } else if (ok) {
+        // Everything appended so far is covered by this fsync; read the size
+        // under the chain lock so it falls on a record boundary.
+        ok = lock_file(fd, F_WRLCK) && fstat(fd, &st) == 0;
+        lock_file(fd, F_UNLCK);
+        ok = ok && fdatasync(fd) == 0;
+        if (ok) {
+            int len = snprintf(state, sizeof(state), "%lu %ld\n", (unsigned long)st.st_ino, (long)st.st_size);
+            if (pwrite(sync_fd, state, (size_t)len, 0) != len || ftruncate(sync_fd, len) != 0)
+                DEBUG_PRINT(2, 1, "Could not update %s: %s", BLOCKCHAIN_SYNC_FILE, strerror(errno));
+            DEBUG_PRINT(2, 2, "Synced %s up to offset %ld", BLOCKCHAIN_FILE, (long)st.st_size);
+        }
+    }
+    lock_file(sync_fd, F_UNLCK);
+    close(sync_fd);
+    return ok;
+}
+
+int append_score_block(const ScoreBlock *block) {
+    return append_score_blocks(block, 1);
+}
+
+int append_score_blocks(const ScoreBlock *blocks, int count) {
+    if (count <= 0)
+        return 1;
+    char *lines = mem_alloc(MEM_LEDGER, (size_t)count * BLOCK_LINE_MAX);
+    if (!lines) {
+        DEBUG_PRINT(2, 0, "Out of memory formatting %d block(s)", count);
+        return 0;
+    }
+    size_t len = 0;
+    for (int i = 0; i < count; i++) {
+        int n = format_score_block(&blocks[i], lines + len, BLOCK_LINE_MAX);
+        if (n < 0) {
+            DEBUG_PRINT(2, 0, "Block for %s does not fit in one record", blocks[i].username);
+            mem_free(lines);
+            return 0;
+        }
+        len += (size_t)n;
+    }
+    int fd = open(BLOCKCHAIN_FILE, O_RDWR | O_APPEND | O_CREAT, 0644);
+    if (fd < 0) {
+        DEBUG_PRINT(2, 0, "Failed to open %s for appending: %s", BLOCKCHAIN_FILE, strerror(errno));
+        mem_free(lines);
+        return 0;
+    }
+    // Hold the lock only for the write itself, not for the fsync.
+    uint64_t trace_t0 = TRACE_BEGIN();
+    int ok = lock_file(fd, F_WRLCK);
+    off_t start = -1;
+    if (ok && repair_torn_tail(fd) && (start = lseek(fd, 0, SEEK_END)) >= 0) {
+        ok = write_all(fd, lines, len);
+        if (!ok && ftruncate(fd, start) != 0)
+            DEBUG_PRINT(2, 0, "Could not remove a partial record from %s", BLOCKCHAIN_FILE);
+    } else {
+        ok = 0;
+    }
+    lock_file(fd, F_UNLCK);
+    if (ok)
+        ok = sync_chain(fd, start + (off_t)len);
+    TRACE_END("append_score_blocks", trace_t0);
+    if (!ok)
+        DEBUG_PRINT(2, 0, "Failed to append %d block(s) for %s to %s: %s",
+                    count, blocks[0].username, BLOCKCHAIN_FILE, strerror(errno));
+    close(fd);
+    mem_free(lines);
+    return ok;
+}
+
+void block_signer_name(const ScoreBlock *block, char *out, size_t out_size) {
+    const char *suffix = "DevAI";
+    size_t ulen = strlen(block->username);
+    size_t slen = strlen(suffix);
+    if (ulen >= slen && strcmp(block->username + ulen - slen, suffix) == 0)
+        ulen -= slen;
+    if (ulen >= out_size)
+        ulen = out_size - 1;
+    memcpy(out, block->username, ulen);
+    out[ulen] = '\0';
+}
@@ -2,34 +2,136 @@
 #define BLOCKCHAIN_H
 
 #include <time.h>
+#include <stddef.h>
 #include "debug.h"
 
+#ifndef BLOCKCHAIN_FILE
+#define BLOCKCHAIN_FILE "highscore/blockchain.txt"
+#endif
+
+// Sidecar recording how much of BLOCKCHAIN_FILE is known to be on disk, so
+// concurrent writers can share one fsync. Local only and safe to delete.
+#ifndef BLOCKCHAIN_SYNC_FILE
+#define BLOCKCHAIN_SYNC_FILE "highscore/.blockchain.sync"
+#endif
+
 #define USERNAME_MAX 50
+#define HASH_LEN 32         // Raw SHA-256 digest
 #define HASH_STR_LEN 65     // 64 hex digits + null terminator
-#define SIG_STR_LEN 513     // Example size for RSA signature in hex (256 + '\0')
+#define SIG_MAX_LEN 256     // Largest raw signature: RSA-2048
+#define SIG_STR_LEN 513     // Largest signature in hex + '\0'
 #define NONCE_STR_LEN 16    // Nonce field as string (if used)
 
-// Structure representing a high score block in the chain.
+// Block format versions. The version selects the signature scheme; it is not
+// part of the hashed/signed data, so both formats share the same PoW rules.
+#define BLOCK_VERSION_RSA 1      // legacy: RSA-2048 + SHA-256, no "version" field on disk
+#define BLOCK_VERSION_ED25519 2  // Ed25519, 64-byte signatures
+
+// Version used for newly created blocks and key pairs.
+#ifndef CURRENT_BLOCK_VERSION
+#define CURRENT_BLOCK_VERSION BLOCK_VERSION_ED25519
+#endif
+
+// Proof-of-work difficulty: number of leading zero hex digits required.
+// Each block records the difficulty it was sealed at; DIFFICULTY is the fixed
+// sealing difficulty and the one assumed for records without that field.
+#ifndef DIFFICULTY
+#define DIFFICULTY 4
+#endif
+
+// Verifiers reject blocks sealed below MIN_DIFFICULTY; adaptive sealing picks
+// a difficulty between the two bounds.
+#ifndef MIN_DIFFICULTY
+#define MIN_DIFFICULTY 3
+#endif
+#ifndef MAX_DIFFICULTY
+#define MAX_DIFFICULTY 8
+#endif
+
+// Pass as add_score_block's difficulty to seal within POW_LATENCY_BUDGET_MS.
+#define POW_DIFFICULTY_AUTO -1
+
+// Longest line format_score_block can produce, including the newline.
+#define BLOCK_LINE_MAX 1024
+
+// Longest block data string (see block_data_string), including the NUL.
+#define BLOCK_DATA_MAX 512
+
+// Structure representing a high score block in the chain. Digests and the
+// signature are kept raw; they are only hex-encoded in blockchain.txt.
 typedef struct {
     char username[USERNAME_MAX];
     int score;
     time_t timestamp;
-    char proof_of_work[HASH_STR_LEN];  // SHA-256 hash in hex
-    char signature[SIG_STR_LEN];       // Digital signature in hex
-    char prev_hash[HASH_STR_LEN];      // Previous block's hash
-    unsigned int nonce;                // Nonce used in proof-of-work
+    unsigned char proof_of_work[HASH_LEN];  // SHA-256 of the block data
+    unsigned char prev_hash[HASH_LEN];      // Previous block's proof_of_work (zeros for genesis)
+    unsigned char signature[SIG_MAX_LEN];   // Digital signature
+    unsigned short signature_len;           // Bytes used in signature; 0 if unsigned
+    unsigned int nonce;                     // Nonce used in proof-of-work
+    int version;                            // BLOCK_VERSION_*
+    int difficulty;                         // Leading zero hex digits of proof_of_work
 } ScoreBlock;
 
 // Adds a new block to the blockchain array.
 // prev is the previous block; if NULL, this is the genesis block.
+// difficulty is fixed, or POW_DIFFICULTY_AUTO to target POW_LATENCY_BUDGET_MS;
+// the difficulty actually met is stored in newBlock->difficulty.
 void add_score_block(ScoreBlock *newBlock, const ScoreBlock *prev, int difficulty);
 
-// Verifies the entire blockchain. Returns 1 if valid, 0 otherwise.
-int verify_blockchain(const ScoreBlock *chain, int count, int difficulty);
+// Returns the highest difficulty whose expected sealing time on this machine
+// fits in budget_ms, clamped to [MIN_DIFFICULTY, MAX_DIFFICULTY]. The local
+// hash rate is measured on the first call and reused afterwards.
+int pow_auto_difficulty(int budget_ms);
+
+// Returns 1 if block's proof_of_work matches its data and meets the
+// difficulty it records, which must be at least min_difficulty.
+int verify_block_pow(const ScoreBlock *block, int min_difficulty);
+
+// Verifies the entire blockchain: every block must meet the difficulty it
+// records, and that may not be below min_difficulty.
+// Returns 1 if valid, 0 otherwise.
+int verify_blockchain(const ScoreBlock *chain, int count, int min_difficulty);
+
+// Writes the string that is hashed for proof-of-work and signed:
+// "username|score|timestamp|prev_hash hex|nonce".
+// Returns its length, or -1 if it does not fit in out_size bytes.
+int block_data_string(const ScoreBlock *block, char *out, size_t out_size);
+
+// Returns 1 if hash (HASH_LEN raw bytes) starts with difficulty zero hex digits.
+int hash_meets_difficulty(const unsigned char *hash, int difficulty);
+
+// Computes SHA-256 over the block data string and writes the raw digest
+// (HASH_LEN bytes) into output_hash. (Used in PoW.)
+void compute_block_hash(const ScoreBlock *block, unsigned char *output_hash);
+
+// Parses one line of blockchain.txt into block, decoding the hex fields.
+// Lines without a "version" field are legacy RSA blocks; lines without a
+// "difficulty" field were sealed at DIFFICULTY. A signature that is
+// not valid hex leaves signature_len at 0, so the block fails verification.
+// Records with a "crc" field must match it; torn or damaged records are rejected.
+// Returns 1 on success, 0 if the line is not a well-formed block record.
+int parse_score_block(const char *line, ScoreBlock *block);
+
+// Formats block as one newline-terminated line of blockchain.txt, ending with
+// a CRC-32 of the record. Legacy RSA blocks have no "version" field.
+// The "difficulty" field is always written.
+// Returns the line length, or -1 if it does not fit in out_size bytes.
+int format_score_block(const ScoreBlock *block, char *out, size_t out_size);
+
+// Appends block to BLOCKCHAIN_FILE as one record under an advisory lock,
+// repairing a torn final record left by a crashed writer first, and returns
+// once the record is on disk. Concurrent appenders from several processes
+// share fsyncs through BLOCKCHAIN_SYNC_FILE. Returns 1 on success, 0 on failure.
+int append_score_block(const ScoreBlock *block);
+
+// Appends count blocks in order as one write under the same lock, with a
+// single fsync. Returns 1 on success, 0 on failure.
+int append_score_blocks(const ScoreBlock *blocks, int count);
 
-// Computes SHA-256 over a block (excluding the proof_of_work, signature, and nonce fields)
-// and writes the hex digest into output_hash. (Used in PoW.)
-void compute_block_hash(const ScoreBlock *block, char *output_hash);
+// Writes the name of the user whose key signs this block into out: the block's
+// username with any "DevAI" suffix stripped (dev auto mode signs with the
+// player's own key).
+void block_signer_name(const ScoreBlock *block, char *out, size_t out_size);
 
 #endif // BLOCKCHAIN_H
 
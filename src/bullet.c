@@ -1,6 +1,7 @@
 #include "bullet.h"
 #include "config.h"
 #include "debug.h"
+#include "memtrack.h"
 #include <stdlib.h>
 #include <math.h>
 #include <SDL2/SDL.h>
@@ -12,7 +13,8 @@
 // Initialize a dynamic bullet pool.
 void init_bullet_pool(BulletPool* pool) {
     pool->count = INITIAL_BULLET_CAPACITY;
-    pool->bullets = (Bullet*)malloc(pool->count * sizeof(Bullet));
+    pool->high_water = 0;
+    pool->bullets = (Bullet*)mem_alloc(MEM_BULLETS, pool->count * sizeof(Bullet));
     if (!pool->bullets) {
         DEBUG_PRINT(2, 0, "Failed to allocate bullet pool of size %d", pool->count);
         return;
@@ -29,7 +31,7 @@ void init_bullet_pool(BulletPool* pool) {
 
 // Free the bullet pool.
 void free_bullet_pool(BulletPool* pool) {
-    free(pool->bullets);
+    mem_free(pool->bullets);
     pool->bullets = NULL;
     pool->count = 0;
     DEBUG_PRINT(2, 3, "Bullet pool freed");
@@ -40,17 +42,20 @@ static void add_bullet(BulletPool* pool, Bullet b) {
     for (int i = 0; i < pool->count; i++) {
         if (!pool->bullets[i].active) {
             pool->bullets[i] = b;
+            if (i >= pool->high_water)
+                pool->high_water = i + 1;
             DEBUG_PRINT(3, 2, "Bullet added at index %d", i);
             return;
         }
     }
     int oldCount = pool->count;
-    pool->count *= 2;
-    pool->bullets = (Bullet*)realloc(pool->bullets, pool->count * sizeof(Bullet));
-    if (!pool->bullets) {
-        DEBUG_PRINT(2, 0, "Failed to reallocate bullet pool to size %d", pool->count);
+    Bullet *grown = (Bullet*)mem_realloc(MEM_BULLETS, pool->bullets, oldCount * 2 * sizeof(Bullet));
+    if (!grown) {
+        DEBUG_PRINT(2, 0, "Failed to reallocate bullet pool to size %d", oldCount * 2);
         return;
     }
+    pool->bullets = grown;
+    pool->count = oldCount * 2;
     for (int i = oldCount; i < pool->count; i++) {
         pool->bullets[i].active = 0;
         pool->bullets[i].isEnemy = 0;
@@ -59,6 +64,7 @@ static void add_bullet(BulletPool* pool, Bullet b) {
         pool->bullets[i].spawn_y = 0.0f;
     }
     pool->bullets[oldCount] = b;
+    pool->high_water = oldCount + 1;
     DEBUG_PRINT(3, 2, "Bullet pool expanded from %d to %d; bullet added at index %d", oldCount, pool->count, oldCount);
 }
 
@@ -16,6 +16,7 @@ typedef struct {
 typedef struct {
     Bullet* bullets;
     int count;      // capacity of the bullet pool
+    int high_water; // highest slot used so far, plus one
 } BulletPool;
 
 void init_bullet_pool(BulletPool* pool);
@@ -0,0 +1,518 @@
+#include "checkpoint.h"
+#include "signature.h"
+#include "encryption.h"
+#include "verify_pool.h"
+#include "verify_cache.h"
+#include "score.h"
+#include "memtrack.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <openssl/sha.h>
+
+/*
+ * A checkpoint commits to the first <count> well-formed records of
+ * BLOCKCHAIN_FILE through a Merkle tree:
+ *
+ *   leaf = SHA-256(0x00 || proof_of_work (32 raw bytes) || valid (1 byte))
+ *   node = SHA-256(0x01 || left || right)
+ *
+ * An odd node at the end of a level is carried up unchanged. The valid byte
+ * records whether the block passed verification when the checkpoint was made;
+ * rejected indices are listed in the record so verifiers can rebuild the
+ * leaves. Because proof_of_work is the hash of the block data, re-hashing a
+ * covered block and rebuilding the root replaces its signature check.
+ *
+ * Record format (one line):
+ *   {"count":N, "root":"<hex>", "rejected":[i,j,...], "signer":"<user>", "version":V, "signature":"<hex>"}
+ * The signature is over "checkpoint|<count>|<root hex>".
+ */
+#define MERKLE_HASH_LEN SHA256_DIGEST_LENGTH
+#define MERKLE_MAX_DEPTH 32
+#define CHECKPOINT_BATCH 1024
+#define PROOF_MAGIC "QSPROOF"
+
+typedef unsigned char MerkleHash[MERKLE_HASH_LEN];
+
+typedef struct {
+    int count;
+    char root[HASH_STR_LEN];
+    int *rejected;
+    int rejected_count;
+    char signer[USERNAME_MAX];
+    int version;
+    unsigned char signature[SIG_MAX_LEN];
+    size_t signature_len;
+} Checkpoint;
+
+static int g_loaded = 0;
+static int g_audit = 0;
+static int g_covered = 0;            // blocks covered by the trusted checkpoint
+static unsigned char *g_valid = NULL;  // per covered block: 1 valid, 0 rejected
+
+static void merkle_leaf(const unsigned char *pow, int valid, unsigned char *out) {
+    unsigned char buf[2 + MERKLE_HASH_LEN];
+    buf[0] = 0x00;
+    memcpy(buf + 1, pow, MERKLE_HASH_LEN);
+    buf[1 + MERKLE_HASH_LEN] = valid ? 1 : 0;
+    SHA256(buf, sizeof(buf), out);
+}
+
+// out may alias left or right.
+static void merkle_node(const unsigned char *left, const unsigned char *right, unsigned char *out) {
+    unsigned char buf[1 + 2 * MERKLE_HASH_LEN];
+    buf[0] = 0x01;
+    memcpy(buf + 1, left, MERKLE_HASH_LEN);
+    memcpy(buf + 1 + MERKLE_HASH_LEN, right, MERKLE_HASH_LEN);
+    SHA256(buf, sizeof(buf), out);
+}
+
+// Reduces nodes[0..n) in place; the root ends up in nodes[0]. If path is not
+// NULL, the siblings of leaf index are stored there bottom-up.
+// Returns the number of siblings written.
+static int merkle_reduce(MerkleHash *nodes, int n, int index, MerkleHash *path) {
+    int depth = 0;
+    while (n > 1) {
+        if (path && (index ^ 1) < n)
+            memcpy(path[depth++], nodes[index ^ 1], MERKLE_HASH_LEN);
+        for (int i = 0; i + 1 < n; i += 2)
+            merkle_node(nodes[i], nodes[i + 1], nodes[i / 2]);
+        if (n & 1)
+            memcpy(nodes[n / 2], nodes[n - 1], MERKLE_HASH_LEN);
+        index >>= 1;
+        n = (n + 1) / 2;
+    }
+    return depth;
+}
+
+// Folds leaf hash (at index of an n-leaf tree) up through path into the root.
+// Returns 0 if the path does not have the shape the tree size requires.
+static int merkle_walk(unsigned char *hash, int n, int index, const MerkleHash *path, int path_len) {
+    int used = 0;
+    while (n > 1) {
+        if (index & 1) {
+            if (used >= path_len)
+                return 0;
+            merkle_node(path[used++], hash, hash);
+        } else if (index + 1 < n) {
+            if (used >= path_len)
+                return 0;
+            merkle_node(hash, path[used++], hash);
+        }
+        index >>= 1;
+        n = (n + 1) / 2;
+    }
+    return used == path_len;
+}
+
+static void checkpoint_message(int count, const char *root_hex, char *out, size_t out_size) {
+    snprintf(out, out_size, "checkpoint|%d|%s", count, root_hex);
+}
+
+// Recomputes the block hash and checks it against the stored proof_of_work.
+static int pow_matches(const ScoreBlock *block) {
+    unsigned char hash[HASH_LEN];
+    compute_block_hash(block, hash);
+    return memcmp(hash, block->proof_of_work, HASH_LEN) == 0;
+}
+
+static int parse_checkpoint(const char *line, Checkpoint *cp) {
+    char sig_hex[SIG_STR_LEN];
+    int pos = 0;
+    memset(cp, 0, sizeof(*cp));
+    if (sscanf(line, "{\"count\":%d, \"root\":\"%64[0-9a-f]\", \"rejected\":[%n", &cp->count, cp->root, &pos) != 2 ||
+        pos == 0 || cp->count <= 0 || strlen(cp->root) != HASH_STR_LEN - 1)
+        return 0;
+    const char *p = line + pos;
+    int capacity = 0;
+    while (*p != ']') {
+        char *end;
+        long index = strtol(p, &end, 10);
+        if (end == p || index < 0 || index >= cp->count)
+            goto fail;
+        if (cp->rejected_count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            int *grown = realloc(cp->rejected, capacity * sizeof(int));
+            if (!grown)
+                goto fail;
+            cp->rejected = grown;
+        }
+        cp->rejected[cp->rejected_count++] = (int)index;
+        p = (*end == ',') ? end + 1 : end;
+    }
+    int rest = 0;
+    if (sscanf(p, "], \"signer\":\"%49[^\"]\", \"version\":%d, \"signature\":\"%512[^\"]\"}%n",
+               cp->signer, &cp->version, sig_hex, &rest) != 3 || rest == 0)
+        goto fail;
+    cp->signature_len = strlen(sig_hex) / 2;
+    if (cp->signature_len > SIG_MAX_LEN || strlen(sig_hex) != 2 * cp->signature_len ||
+        !hex_decode(sig_hex, cp->signature, cp->signature_len))
+        goto fail;
+    return 1;
+fail:
+    free(cp->rejected);
+    cp->rejected = NULL;
+    return 0;
+}
+
+// Finds the newest checkpoint in CHECKPOINT_FILE that is signed by
+// CHECKPOINT_SIGNER with a valid signature. If count > 0 only checkpoints over
+// exactly that many blocks are considered. Returns 1 and fills cp on success;
+// the caller frees cp->rejected.
+static int find_trusted_checkpoint(int count, Checkpoint *cp) {
+    FILE *fp = fopen(CHECKPOINT_FILE, "r");
+    if (!fp) {
+        DEBUG_PRINT(2, 1, "Checkpoint file %s not found", CHECKPOINT_FILE);
+        return 0;
+    }
+    char **lines = NULL;
+    int line_count = 0, capacity = 0;
+    char *line = NULL;
+    size_t line_size = 0;
+    Checkpoint candidate;
+    while (getline(&line, &line_size, fp) > 0) {
+        if (!parse_checkpoint(line, &candidate))
+            continue;
+        int wanted = strcmp(candidate.signer, CHECKPOINT_SIGNER) == 0 && (count <= 0 || candidate.count == count);
+        free(candidate.rejected);
+        if (!wanted)
+            continue;
+        if (line_count == capacity) {
+            capacity = capacity ? capacity * 2 : 8;
+            char **grown = realloc(lines, capacity * sizeof(char*));
+            if (!grown)
+                break;
+            lines = grown;
+        }
+        lines[line_count] = strdup(line);
+        if (lines[line_count])
+            line_count++;
+    }
+    free(line);
+    fclose(fp);
+
+    // Try the newest first; fall back to older ones if a signature is bad.
+    int found = 0;
+    for (int i = line_count - 1; i >= 0 && !found; i--) {
+        if (!parse_checkpoint(lines[i], cp))
+            continue;
+        char message[128];
+        checkpoint_message(cp->count, cp->root, message, sizeof(message));
+        if (verify_message_signature(message, cp->signer, cp->version, cp->signature, cp->signature_len)) {
+            found = 1;
+        } else {
+            DEBUG_PRINT(2, 0, "Checkpoint over %d block(s) has an invalid signature; ignoring it", cp->count);
+            free(cp->rejected);
+        }
+    }
+    for (int i = 0; i < line_count; i++)
+        free(lines[i]);
+    free(lines);
+    return found;
+}
+
+// Builds the per-block valid flags for cp from its rejected list.
+static unsigned char *checkpoint_valid_flags(const Checkpoint *cp) {
+    unsigned char *valid = malloc(cp->count);
+    if (!valid)
+        return NULL;
+    memset(valid, 1, cp->count);
+    for (int i = 0; i < cp->rejected_count; i++)
+        valid[cp->rejected[i]] = 0;
+    return valid;
+}
+
+// Reads the first count records of BLOCKCHAIN_FILE into leaves. Blocks flagged
+// valid must still hash to their proof_of_work. If find_pow is not NULL, the
+// index of the block with that proof_of_work is stored in *found (and the
+// block in *found_block). Returns 1 if all count leaves were rebuilt.
+static int read_leaves(int count, const unsigned char *valid, MerkleHash *leaves,
+                       const unsigned char *find_pow, int *found, ScoreBlock *found_block) {
+    FILE *fp = fopen(BLOCKCHAIN_FILE, "r");
+    if (!fp) {
+        DEBUG_PRINT(2, 1, "Blockchain file %s not found.", BLOCKCHAIN_FILE);
+        return 0;
+    }
+    char line[2048];
+    ScoreBlock block;
+    int n = 0;
+    while (n < count && fgets(line, sizeof(line), fp)) {
+        if (!parse_score_block(line, &block))
+            continue;
+        if (valid[n] && !pow_matches(&block)) {
+            DEBUG_PRINT(2, 0, "Block %d no longer matches its checkpointed proof_of_work", n);
+            break;
+        }
+        if (find_pow && memcmp(block.proof_of_work, find_pow, HASH_LEN) == 0) {
+            *found = n;
+            *found_block = block;
+        }
+        merkle_leaf(block.proof_of_work, valid[n], leaves[n]);
+        n++;
+    }
+    fclose(fp);
+    return n == count;
+}
+
+// Loads the newest trusted checkpoint and checks it against the ledger.
+static void load_checkpoint_state(void) {
+    g_loaded = 1;
+    if (g_audit)
+        return;
+    Checkpoint cp;
+    if (!find_trusted_checkpoint(0, &cp))
+        return;
+    unsigned char *valid = checkpoint_valid_flags(&cp);
+    MerkleHash *leaves = malloc(cp.count * sizeof(MerkleHash));
+    int ok = 0;
+    if (valid && leaves && read_leaves(cp.count, valid, leaves, NULL, NULL, NULL)) {
+        char root[HASH_STR_LEN];
+        merkle_reduce(leaves, cp.count, 0, NULL);
+        hex_encode(leaves[0], MERKLE_HASH_LEN, root);
+        ok = strcmp(root, cp.root) == 0;
+    }
+    if (ok) {
+        g_valid = valid;
+        g_covered = cp.count;
+        DEBUG_PRINT(2, 3, "Trusting checkpoint over the first %d block(s)", cp.count);
+    } else {
+        DEBUG_PRINT(2, 0, "Ledger does not match the checkpoint over %d block(s); verifying everything", cp.count);
+        free(valid);
+    }
+    free(leaves);
+    free(cp.rejected);
+}
+
+int checkpoint_block_status(int index) {
+    if (!g_loaded)
+        load_checkpoint_state();
+    if (index < 0 || index >= g_covered)
+        return CHECKPOINT_UNCOVERED;
+    return g_valid[index];
+}
+
+void checkpoint_set_audit(int audit) {
+    g_audit = audit;
+    verify_cache_set_enabled(!audit);
+}
+
+int checkpoint_audit_enabled(void) {
+    return g_audit;
+}
+
+// Appends leaves for a batch of parsed blocks, starting at ledger index base.
+// Blocks the current checkpoint already covers keep their recorded status.
+static int checkpoint_batch(const ScoreBlock *batch, int n, int base, MerkleHash *leaves,
+                            int **rejected, int *rejected_count, int *rejected_capacity) {
+    unsigned char results[CHECKPOINT_BATCH];
+    int covered = 0;
+    while (covered < n && checkpoint_block_status(base + covered) != CHECKPOINT_UNCOVERED) {
+        results[covered] = (unsigned char)checkpoint_block_status(base + covered);
+        covered++;
+    }
+    verify_blocks_parallel(batch + covered, n - covered, results + covered);
+    for (int i = 0; i < n; i++) {
+        int valid = results[i] && (i < covered || pow_matches(&batch[i]));
+        if (!valid) {
+            if (*rejected_count == *rejected_capacity) {
+                int new_capacity = *rejected_capacity ? *rejected_capacity * 2 : 16;
+                int *grown = realloc(*rejected, new_capacity * sizeof(int));
+                if (!grown)
+                    return 0;
+                *rejected = grown;
+                *rejected_capacity = new_capacity;
+            }
+            (*rejected)[(*rejected_count)++] = base + i;
+        }
+        merkle_leaf(batch[i].proof_of_work, valid, leaves[base + i]);
+    }
+    return 1;
+}
+
+int checkpoint_create(void) {
+    char *username = load_username();
+    if (!username || strcmp(username, CHECKPOINT_SIGNER) != 0) {
+        DEBUG_PRINT(1, 0, "Checkpoints must be signed by %s; the local user is %s",
+                    CHECKPOINT_SIGNER, username ? username : "(none)");
+        mem_free(username);
+        return -1;
+    }
+    FILE *fp = fopen(BLOCKCHAIN_FILE, "r");
+    if (!fp) {
+        DEBUG_PRINT(1, 0, "Blockchain file %s not found.", BLOCKCHAIN_FILE);
+        mem_free(username);
+        return -1;
+    }
+    ScoreBlock *batch = malloc(CHECKPOINT_BATCH * sizeof(ScoreBlock));
+    MerkleHash *leaves = NULL;
+    int *rejected = NULL;
+    int count = 0, leaf_capacity = 0, rejected_count = 0, rejected_capacity = 0;
+    int ret = -1, n = 0, eof = 0;
+    char line[2048];
+    while (batch && !eof) {
+        if (fgets(line, sizeof(line), fp)) {
+            if (parse_score_block(line, &batch[n]))
+                n++;
+        } else {
+            eof = 1;
+        }
+        if (n == CHECKPOINT_BATCH || (eof && n > 0)) {
+            if (count + n > leaf_capacity) {
+                leaf_capacity = leaf_capacity ? leaf_capacity * 2 : 4 * CHECKPOINT_BATCH;
+                MerkleHash *grown = realloc(leaves, leaf_capacity * sizeof(MerkleHash));
+                if (!grown)
+                    goto cleanup;
+                leaves = grown;
+            }
+            if (!checkpoint_batch(batch, n, count, leaves, &rejected, &rejected_count, &rejected_capacity))
+                goto cleanup;
+            count += n;
+            n = 0;
+        }
+    }
+    if (count == 0) {
+        DEBUG_PRINT(1, 1, "No blocks to checkpoint in %s", BLOCKCHAIN_FILE);
+        goto cleanup;
+    }
+
+    char root[HASH_STR_LEN];
+    char message[128];
+    unsigned char signature[SIG_MAX_LEN];
+    size_t signature_len = 0;
+    char signature_hex[SIG_STR_LEN];
+    merkle_reduce(leaves, count, 0, NULL);
+    hex_encode(leaves[0], MERKLE_HASH_LEN, root);
+    checkpoint_message(count, root, message, sizeof(message));
+    if (!sign_message(message, username, CURRENT_BLOCK_VERSION, signature, &signature_len)) {
+        DEBUG_PRINT(1, 0, "Failed to sign checkpoint over %d block(s)", count);
+        goto cleanup;
+    }
+    hex_encode(signature, signature_len, signature_hex);
+    FILE *out = fopen(CHECKPOINT_FILE, "a");
+    if (!out) {
+        DEBUG_PRINT(1, 0, "Error opening %s for appending: %s", CHECKPOINT_FILE, strerror(errno));
+        goto cleanup;
+    }
+    fprintf(out, "{\"count\":%d, \"root\":\"%s\", \"rejected\":[", count, root);
+    for (int i = 0; i < rejected_count; i++)
+        fprintf(out, i ? ",%d" : "%d", rejected[i]);
+    fprintf(out, "], \"signer\":\"%s\", \"version\":%d, \"signature\":\"%s\"}\n",
+            username, CURRENT_BLOCK_VERSION, signature_hex);
+    if (fclose(out) != 0) {
+        DEBUG_PRINT(1, 0, "Error writing %s: %s", CHECKPOINT_FILE, strerror(errno));
+        goto cleanup;
+    }
+    DEBUG_PRINT(1, 3, "Checkpoint over %d block(s) (%d rejected) appended to %s", count, rejected_count, CHECKPOINT_FILE);
+    // Later lookups should use the new checkpoint.
+    free(g_valid);
+    g_valid = NULL;
+    g_covered = 0;
+    g_loaded = 0;
+    ret = count;
+
+cleanup:
+    fclose(fp);
+    free(batch);
+    free(leaves);
+    free(rejected);
+    mem_free(username);
+    return ret;
+}
+
+int checkpoint_prove(const char *pow_hex, FILE *out) {
+    unsigned char pow[HASH_LEN];
+    if (strlen(pow_hex) != 2 * HASH_LEN || !hex_decode(pow_hex, pow, HASH_LEN)) {
+        DEBUG_PRINT(1, 0, "%s is not a proof_of_work hash", pow_hex);
+        return 0;
+    }
+    Checkpoint cp;
+    if (!find_trusted_checkpoint(0, &cp)) {
+        DEBUG_PRINT(1, 0, "No trusted checkpoint in %s", CHECKPOINT_FILE);
+        return 0;
+    }
+    unsigned char *valid = checkpoint_valid_flags(&cp);
+    MerkleHash *leaves = malloc(cp.count * sizeof(MerkleHash));
+    int index = -1, ret = 0;
+    ScoreBlock block;
+    if (!valid || !leaves || !read_leaves(cp.count, valid, leaves, pow, &index, &block)) {
+        DEBUG_PRINT(1, 0, "Ledger does not match the checkpoint over %d block(s)", cp.count);
+    } else if (index < 0) {
+        DEBUG_PRINT(1, 0, "Block %s is not covered by the checkpoint over %d block(s)", pow_hex, cp.count);
+    } else {
+        MerkleHash path[MERKLE_MAX_DEPTH];
+        int depth = merkle_reduce(leaves, cp.count, index, path);
+        char line[BLOCK_LINE_MAX];
+        char hex[HASH_STR_LEN];
+        if (format_score_block(&block, line, sizeof(line)) > 0) {
+            fputs(line, out);
+            fprintf(out, "%s %d %d %d ", PROOF_MAGIC, cp.count, index, valid[index]);
+            for (int i = 0; i < depth; i++) {
+                hex_encode(path[i], MERKLE_HASH_LEN, hex);
+                fprintf(out, i ? ",%s" : "%s", hex);
+            }
+            fputs(depth ? "\n" : "-\n", out);
+            ret = 1;
+        }
+    }
+    free(valid);
+    free(leaves);
+    free(cp.rejected);
+    return ret;
+}
+
+int checkpoint_verify_proof(FILE *in) {
+    char line[BLOCK_LINE_MAX];
+    char proof[BLOCK_LINE_MAX * 4];
+    ScoreBlock block;
+    int count, index, valid, pos = 0;
+    if (!fgets(line, sizeof(line), in) || !parse_score_block(line, &block) ||
+        !fgets(proof, sizeof(proof), in) ||
+        sscanf(proof, PROOF_MAGIC " %d %d %d %n", &count, &index, &valid, &pos) != 3 || pos == 0 ||
+        count <= 0 || index < 0 || index >= count) {
+        DEBUG_PRINT(1, 0, "Malformed inclusion proof");
+        return 0;
+    }
+    // The leaf commits to proof_of_work, which in turn commits to the block data.
+    unsigned char hash[MERKLE_HASH_LEN];
+    if (!pow_matches(&block)) {
+        DEBUG_PRINT(1, 0, "Block in proof does not hash to its proof_of_work");
+        return 0;
+    }
+    memcpy(hash, block.proof_of_work, sizeof(hash));
+    MerkleHash path[MERKLE_MAX_DEPTH];
+    int depth = 0;
+    const char *p = proof + pos;
+    while (*p && *p != '-' && *p != '\n') {
+        if (depth == MERKLE_MAX_DEPTH || !hex_decode(p, path[depth], MERKLE_HASH_LEN)) {
+            DEBUG_PRINT(1, 0, "Malformed Merkle path in proof");
+            return 0;
+        }
+        depth++;
+        p += 2 * MERKLE_HASH_LEN;
+        if (*p == ',')
+            p++;
+    }
+    merkle_leaf(hash, valid, hash);
+    if (!merkle_walk(hash, count, index, path, depth)) {
+        DEBUG_PRINT(1, 0, "Merkle path has the wrong length for a %d-block checkpoint", count);
+        return 0;
+    }
+    char root[HASH_STR_LEN];
+    hex_encode(hash, MERKLE_HASH_LEN, root);
+    Checkpoint cp;
+    if (!find_trusted_checkpoint(count, &cp)) {
+        DEBUG_PRINT(1, 0, "No trusted checkpoint over %d block(s)", count);
+        return 0;
+    }
+    int ok = strcmp(root, cp.root) == 0;
+    free(cp.rejected);
+    if (!ok) {
+        DEBUG_PRINT(1, 0, "Proof does not lead to the checkpoint's Merkle root");
+        return 0;
+    }
+    if (!valid)
+        DEBUG_PRINT(1, 1, "Block is in the chain but was rejected when checkpointed");
+    return valid;
+}
@@ -0,0 +1,50 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include "blockchain.h"
+
+// Signed checkpoints over a prefix of BLOCKCHAIN_FILE, one JSON line each.
+#ifndef CHECKPOINT_FILE
+#define CHECKPOINT_FILE "highscore/checkpoints.txt"
+#endif
+
+// Only checkpoints signed by this user are trusted by verifiers.
+#ifndef CHECKPOINT_SIGNER
+#define CHECKPOINT_SIGNER "kleinpanic"
+#endif
+
+// Returned by checkpoint_block_status for blocks no trusted checkpoint covers.
+#define CHECKPOINT_UNCOVERED -1
+
+// Status of the block at index (counting the well-formed records of
+// BLOCKCHAIN_FILE from 0) according to the newest trusted checkpoint:
+// 1 if it was valid when checkpointed, 0 if it was rejected, or
+// CHECKPOINT_UNCOVERED if it must be verified normally. The checkpoint is
+// loaded and matched against the file on first call; if the file no longer
+// matches its Merkle root, every block is reported as uncovered.
+int checkpoint_block_status(int index);
+
+// Audit mode ignores checkpoints and the verified-block cache so every block
+// is fully verified. Call before any verification happens.
+void checkpoint_set_audit(int audit);
+
+// Returns 1 if audit mode is on.
+int checkpoint_audit_enabled(void);
+
+// Verifies every block currently in BLOCKCHAIN_FILE and appends a checkpoint
+// over all of them to CHECKPOINT_FILE, signed by the local user (who must be
+// CHECKPOINT_SIGNER). Returns the number of blocks covered, or -1 on failure.
+int checkpoint_create(void);
+
+// Writes an inclusion proof for the block whose proof_of_work is pow_hex to
+// out: the block's record followed by its Merkle path to the newest trusted
+// checkpoint's root. Returns 1 on success, 0 if the block is not covered.
+int checkpoint_prove(const char *pow_hex, FILE *out);
+
+// Checks a proof written by checkpoint_prove against CHECKPOINT_FILE alone,
+// without reading BLOCKCHAIN_FILE. Returns 1 if the proof shows the block is
+// in the chain (and was valid when checkpointed), 0 otherwise.
+int checkpoint_verify_proof(FILE *in);
+
+#endif // CHECKPOINT_H
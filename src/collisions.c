@@ -0,0 +1,51 @@
+#include "collisions.h"
+#include "config.h"
+#include "debug.h"
+#include <math.h>
+
+int hit_enemies(BulletPool *pool, Enemy enemies[], int count, Explosion explosions[]) {
+    int killed = 0;
+    for (int i = 0; i < pool->count; i++) {
+        if (pool->bullets[i].active && pool->bullets[i].isEnemy == 0) {
+            for (int j = 0; j < count; j++) {
+                if (enemies[j].active) {
+                    float dx = pool->bullets[i].x - enemies[j].x;
+                    float dy = pool->bullets[i].y - enemies[j].y;
+                    float dist = sqrtf(dx * dx + dy * dy);
+                    if (dist < COLLISIONTHRESHOLD) {
+                        if (!(g_dev_auto_mode && AI_PIERCING_SHOT)) {
+                            pool->bullets[i].active = 0;
+                        }
+                        //enemies[j].health -= pool->bullets[i].damage;
+                        //DEBUG_PRINT(3, 2, "Player bullet hit enemy %d; new health = %d", j, enemies[j].health);
+                        if (enemies[j].type == ENEMY_SHIELD && enemies[j].shieldActive) {
+                            DEBUG_PRINT(3, 2, "Shielded enemy %d hit: no damage taken.", j);
+                            pool->bullets[i].active = 0;
+                        } else {
+                            enemies[j].health -= pool->bullets[i].damage;
+                            DEBUG_PRINT(3, 2, "Player bullet hit enemy %d; new health = %d", j, enemies[j].health);
+                        }
+                        if (enemies[j].health <= 0) {
+                            for (int k = 0; k < MAX_EXPLOSIONS; k++) {
+                                if (explosions[k].lifetime <= 0) {
+                                    explosions[k].x = enemies[j].x;
+                                    explosions[k].y = enemies[j].y;
+                                    explosions[k].radius = 5.0f;
+                                    explosions[k].lifetime = 30; // lasts 30 frames
+                                    if (enemies[j].type == ENEMY_SPLITTER) {
+                                        split_enemy(enemies, count, j);
+                                    }
+                                    break;
+                                }
+                            }
+                            enemies[j].active = 0;
+                            killed++;
+                            DEBUG_PRINT(3, 3, "Enemy %d destroyed", j);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return killed;
+}
@@ -0,0 +1,14 @@
+#ifndef COLLISIONS_H
+#define COLLISIONS_H
+
+#include "bullet.h"
+#include "enemy.h"
+#include "game.h"
+
+// Applies every active player bullet to the first count enemies: damage,
+// shields, piercing shots in auto mode, splitting and an explosion (if one of
+// the MAX_EXPLOSIONS is free) for each kill. Returns the number of enemies
+// destroyed.
+int hit_enemies(BulletPool *pool, Enemy enemies[], int count, Explosion explosions[]);
+
+#endif
@@ -7,6 +7,11 @@ extern int g_fullscreen;   // 0 = resizable, 1 = full screen
 extern int g_dev_auto_mode;
 extern int g_testing_mode;
 extern int g_forced_enemy_type;
+extern const char *g_record_path;    // --record: write the session's inputs here
+extern const char *g_replay_path;    // --replay: play this recording instead of the keyboard
+extern const char *g_scenario_path;  // --scenario: script the world from this file
+extern const char *g_telemetry_name; // --telemetry: shared-memory segment to publish frames in
+extern int g_headless;               // --headless: replay or run a scenario without a window
 extern int shakeTimer;
 extern float shakeMagnitude;
 extern volatile sig_atomic_t g_exit_requested;
@@ -56,7 +61,28 @@ extern volatile sig_atomic_t g_exit_requested;
 
 /* Highscores flag configuration */
 #define HIGHSCORE_FLAG_MAX_ENTRY_NUMBER 10
-#define MAX_BLOCKS 1000  // Maximum number of blocks to read from the blockchain file
+#define HIGHSCORE_BATCH_BLOCKS 1024  // Blocks parsed and verified per batch while streaming the chain
+#define VERIFY_MAX_THREADS 16  // Upper bound on signature verification worker threads
+#define POW_LATENCY_BUDGET_MS 250  // Target time to seal a score block at game over
+#define LEDGERD_TOP_MAX 100  // Users the leaderboard daemon keeps ranked
+#define LEDGERD_MAX_CLIENTS 32  // Connections the leaderboard daemon serves at once
+#define LEDGERD_TIMEOUT_MS 2000  // How long clients wait for the daemon before reading the file
+#define SCORE_BUCKET_TOP_K 100  // Users kept per day for --since/--until leaderboards
+
+/* Profiler */
+#define PROFILER_HISTORY 240  // Frames of stage timings kept for the statistics and overlay graph
+#define PROFILER_GRAPH_MS 33  // Frame time at the top of the overlay graph
+#define TRACE_CHUNK_EVENTS 4096  // Events per allocation of a thread's --trace buffer
+#define PERF_COUNTERS_DEPTH 16    // Nested --counters regions measured per thread
+#define PERF_COUNTERS_REGIONS 64  // Distinct region names --counters keeps totals for
+
+/* Debug log (--log) */
+#define DEBUG_LOG_SLOTS 1024  // Messages the log ring holds before new ones are dropped
+#define DEBUG_LOG_LINE 512  // Longest message kept in the log, including the terminator
+#define DEBUG_LOG_IDLE_MS 2  // How long the log writer sleeps when the ring is empty
+
+/* Telemetry (--telemetry) */
+#define TELEMETRY_READ_ATTEMPTS 1000  // Tries a reader makes for a frame the game is not writing
 
 /* Random */
 #ifndef M_PI
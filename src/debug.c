@@ -1,7 +1,172 @@
 #include "debug.h"
+#include "config.h"
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
 
 /* By default, debugging is disabled. Only critical errors (severity 0) are printed. */
 int g_debug_enabled = 0;
 int g_debug_level = 1;  // default level if debugging is enabled
 int g_always_print = 1;
 
+/* Bounded multi-producer ring for --log. Each slot carries a sequence number:
+ * a producer may fill slot (pos % DEBUG_LOG_SLOTS) once its sequence equals
+ * pos, and publishes it by setting pos + 1; the writer thread frees it again
+ * by setting pos + DEBUG_LOG_SLOTS. Producers only race on the enqueue
+ * position, with a compare-and-swap. */
+typedef struct {
+    size_t seq;
+    int severity;
+    double seconds;  // since the log was opened
+    char text[DEBUG_LOG_LINE];
+} LogSlot;
+
+static LogSlot *g_log_ring = NULL;
+static size_t g_log_enqueue = 0;
+static size_t g_log_dequeue = 0;   // writer thread only
+static long g_log_dropped = 0;
+static int g_log_open = 0;
+static int g_log_stop = 0;
+static FILE *g_log_file = NULL;
+static pthread_t g_log_thread;
+static struct timespec g_log_start;
+
+static const char *severity_color(int severity) {
+    switch (severity) {
+        case 0: return DEBUG_COLOR_ERROR;
+        case 1: return DEBUG_COLOR_WARNING;
+        case 2: return DEBUG_COLOR_DEBUG;
+        case 3: return DEBUG_COLOR_SUCCESS;
+        default: return "";
+    }
+}
+
+static void print_to_stderr(int severity, const char *text) {
+    fprintf(stderr, "%s%s%s\n", severity_color(severity), text, DEBUG_COLOR_RESET);
+}
+
+/* Queues a message; drops it (counting the loss) if the ring is full, so a
+ * slow disk never stalls the caller. */
+static void log_push(int severity, const char *text) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    size_t pos = __atomic_load_n(&g_log_enqueue, __ATOMIC_RELAXED);
+    for (;;) {
+        LogSlot *slot = &g_log_ring[pos % DEBUG_LOG_SLOTS];
+        size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&g_log_enqueue, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                slot->severity = severity;
+                slot->seconds = (now.tv_sec - g_log_start.tv_sec) + (now.tv_nsec - g_log_start.tv_nsec) / 1e9;
+                snprintf(slot->text, sizeof(slot->text), "%s", text);
+                __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+                return;
+            }
+        } else if (diff < 0) {
+            __atomic_fetch_add(&g_log_dropped, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            pos = __atomic_load_n(&g_log_enqueue, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/* Writes every published slot; returns the number written. */
+static int log_drain(void) {
+    static const char tags[] = "EWDS";
+    int written = 0;
+    for (;;) {
+        LogSlot *slot = &g_log_ring[g_log_dequeue % DEBUG_LOG_SLOTS];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != g_log_dequeue + 1)
+            break;
+        fprintf(g_log_file, "[%12.6f] %c %s\n", slot->seconds,
+                slot->severity >= 0 && slot->severity <= 3 ? tags[slot->severity] : '?', slot->text);
+        __atomic_store_n(&slot->seq, g_log_dequeue + DEBUG_LOG_SLOTS, __ATOMIC_RELEASE);
+        g_log_dequeue++;
+        written++;
+    }
+    return written;
+}
+
+static void *log_writer(void *arg) {
+    (void)arg;
+    struct timespec idle = { 0, DEBUG_LOG_IDLE_MS * 1000000L };
+    while (!__atomic_load_n(&g_log_stop, __ATOMIC_ACQUIRE)) {
+        if (log_drain() == 0) {
+            fflush(g_log_file);
+            nanosleep(&idle, NULL);
+        }
+    }
+    log_drain();
+    return NULL;
+}
+
+static void debug_log_close(void) {
+    if (!g_log_open)
+        return;
+    __atomic_store_n(&g_log_stop, 1, __ATOMIC_RELEASE);
+    pthread_join(g_log_thread, NULL);
+    g_log_open = 0;
+    long dropped = __atomic_load_n(&g_log_dropped, __ATOMIC_RELAXED);
+    if (dropped)
+        fprintf(g_log_file, "%ld message(s) dropped: the log ring was full\n", dropped);
+    fclose(g_log_file);
+}
+
+int debug_log_open(const char *path) {
+    if (!path)
+        path = DEBUG_LOG_DEFAULT_PATH;
+    if (g_log_open)
+        return 1;
+    g_log_file = fopen(path, "a");
+    g_log_ring = g_log_file ? calloc(DEBUG_LOG_SLOTS, sizeof(LogSlot)) : NULL;
+    if (!g_log_ring) {
+        if (g_log_file)
+            fclose(g_log_file);
+        fprintf(stderr, "%sCannot open log file %s%s\n", DEBUG_COLOR_ERROR, path, DEBUG_COLOR_RESET);
+        return 0;
+    }
+    for (size_t i = 0; i < DEBUG_LOG_SLOTS; i++)
+        g_log_ring[i].seq = i;
+    clock_gettime(CLOCK_MONOTONIC, &g_log_start);
+    if (pthread_create(&g_log_thread, NULL, log_writer, NULL) != 0) {
+        fclose(g_log_file);
+        free(g_log_ring);
+        g_log_ring = NULL;
+        fprintf(stderr, "%sCannot start the log writer thread%s\n", DEBUG_COLOR_ERROR, DEBUG_COLOR_RESET);
+        return 0;
+    }
+    __atomic_store_n(&g_log_open, 1, __ATOMIC_RELEASE);
+    atexit(debug_log_close);
+    return 1;
+}
+
+void debug_emit(int severity, const char *fmt, ...) {
+    char text[DEBUG_LOG_LINE];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+    if (__atomic_load_n(&g_log_open, __ATOMIC_ACQUIRE)) {
+        log_push(severity, text);
+        if (severity != 0)
+            return;
+    }
+    if (n >= (int)sizeof(text)) {
+        // Too long for the line buffer: stderr still gets all of it.
+        char *long_text = malloc((size_t)n + 1);
+        if (long_text) {
+            va_start(args, fmt);
+            vsnprintf(long_text, (size_t)n + 1, fmt, args);
+            va_end(args);
+            print_to_stderr(severity, long_text);
+            free(long_text);
+            return;
+        }
+    }
+    print_to_stderr(severity, text);
+}
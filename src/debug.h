@@ -6,7 +6,7 @@
 /* Global flag and level – set from main */
 extern int g_debug_enabled;   // 0 = off, 1 = on
 extern int g_debug_level;     // expected values 1, 2, or 3
-extern int g_always_print; // Always print message that use detail level 0. 
+extern int g_always_print; // Always print message that use detail level 0.
 
 /* ANSI color codes for printing */
 #define DEBUG_COLOR_ERROR   "\033[31m"  // red
@@ -15,12 +15,25 @@ extern int g_always_print; // Always print message that use detail level 0.
 #define DEBUG_COLOR_SUCCESS "\033[32m"  // green
 #define DEBUG_COLOR_RESET   "\033[0m"
 
+/* Highest detail level compiled in. Statements with a higher detail are
+ * removed at compile time (errors are always kept), e.g.
+ * make DEBUG_MAX_DETAIL=1 for a build with no per-frame or per-block
+ * debug statements at all. */
+#ifndef DEBUG_MAX_DETAIL
+#define DEBUG_MAX_DETAIL 3
+#endif
+
+/* Log file used by --log when no path is given. */
+#ifndef DEBUG_LOG_DEFAULT_PATH
+#define DEBUG_LOG_DEFAULT_PATH "/tmp/quantumstriker.log"
+#endif
+
 /*
  * DEBUG_PRINT(detail, severity, fmt, ...)
  *
  * detail: an integer (0-3) that tags the “depth” of the debug statement.
  *         Only debug statements whose detail equals g_debug_level will print.
- *         0 - will always print the statement regardless of detail or severity. 
+ *         0 - will always print the statement regardless of detail or severity.
  *
  * severity: a status code:
  *    0 = error/critical (always printed, in red)
@@ -31,23 +44,29 @@ extern int g_always_print; // Always print message that use detail level 0.
  * fmt, ...: standard printf-style format and arguments.
  *
  * By default (when g_debug_enabled==0) only severity 0 messages are printed.
+ * Arguments are only evaluated when the statement prints.
  */
 
 #define DEBUG_PRINT(detail, severity, fmt, ...)                             \
     do {                                                                    \
-        if ((severity) == 0 ||                                             \
-            (((detail) == 0) && g_always_print) ||                           \
-            (g_debug_enabled && (g_debug_level) == (detail))) {              \
-            const char* color = "";                                         \
-            if ((severity) == 0) { color = DEBUG_COLOR_ERROR; }             \
-            else if ((severity) == 1) { color = DEBUG_COLOR_WARNING; }        \
-            else if ((severity) == 2) { color = DEBUG_COLOR_DEBUG; }          \
-            else if ((severity) == 3) { color = DEBUG_COLOR_SUCCESS; }        \
-            fprintf(stderr, "%s", color);                                   \
-            fprintf(stderr, fmt, ##__VA_ARGS__);                            \
-            fprintf(stderr, "%s\n", DEBUG_COLOR_RESET);                     \
+        if ((severity) == 0 ||                                              \
+            ((detail) <= DEBUG_MAX_DETAIL &&                                \
+             ((((detail) == 0) && g_always_print) ||                        \
+              (g_debug_enabled && (g_debug_level) == (detail))))) {         \
+            debug_emit((severity), fmt, ##__VA_ARGS__);                     \
         }                                                                   \
     } while(0)
 
-#endif /* DEBUG_H */
+/* Formats one message and prints it to stderr with its severity color, or,
+ * while a log is open, queues it for the log writer thread (errors are also
+ * printed). Use DEBUG_PRINT rather than calling this directly. */
+void debug_emit(int severity, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
 
+/* Sends debug output to path (DEBUG_LOG_DEFAULT_PATH if NULL) from now on.
+ * Messages go through a lock-free ring buffer drained by a background thread,
+ * so callers never wait for the file; if the ring is full a message is
+ * dropped and counted. The log is flushed and closed at exit.
+ * Returns 1 on success, 0 if the file cannot be opened. */
+int debug_log_open(const char *path);
+
+#endif /* DEBUG_H */
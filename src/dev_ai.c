@@ -0,0 +1,218 @@
+#include "dev_ai.h"
+#include "config.h"
+#include "debug.h"
+#include <math.h>
+
+/*
+ * dev_ai_control controls the player AI behavior in auto dev mode.
+ *
+ * Operation Overview:
+ *
+ * 1. Visibility & Target Selection:
+ *    - The camera origin is computed from (player->x - screen_width/2, player->y - screen_height/2).
+ *    - For each active enemy, its screen position is computed.
+ *      Enemies outside a 50-pixel margin are skipped.
+ *    - The closest visible enemy is selected as the target.
+ *
+ * 2. Enemy Bullet Detection:
+ *    - The bullet pool is scanned for active enemy bullets.
+ *      Any enemy bullet within BULLET_DANGER_DISTANCE (150 units) adds a repulsion force (scaled by BULLET_REPULSION_FACTOR)
+ *      and sets a flag to force bullet-evading behavior.
+ *
+ * 3. Shield Activation & Evasion:
+ *    - The shield is activated if the target is very close (less than SHIELD_DISTANCE) or if an enemy bullet is dangerously close.
+ *    - If enemy bullets are dangerously close (enemyBulletTooClose is true), the AI forces the shield and immediately
+ *      rotates away from the bullet threat using the computed repulsion vector, applies reverse thrust, and returns.
+ *
+ * 4. Offensive Engagement:
+ *    - If no dangerous bullet is present and a target exists, the desired angle is computed using:
+ *         desired_angle = atan2(target->y - player->y, target->x - player->x) * (180/π) + 180
+ *      so that when drawn (using (player->angle - 90)) the ship’s tip (model point (0, -size)) points toward the target.
+ *    - The AI rotates toward that angle at OFFENSIVE_ROTATION_SPEED.
+ *    - If the target is far (distance > SHOOTING_RANGE) and nearly aligned (angle difference < 10°), thrust is applied.
+ *      If within range, the ship brakes to stabilize before shooting.
+ *    - If aligned within 5° and within range, a bullet is fired from the ship’s tip.
+ *
+ * Note: CENTER_BONUS is currently logged for potential future use.
+ */
+
+void dev_ai_control(Player *player, Enemy enemies[], int enemy_count, BulletPool *bulletPool, int screen_width, int screen_height) {
+
+    // AI parameters.
+    const float SHOOTING_RANGE            = 300.0f;
+    const float DANGER_DISTANCE           = 80.0f;
+    const float SHIELD_DISTANCE           = 50.0f;
+    const float BULLET_DANGER_DISTANCE    = 150.0f;  // Increased danger distance for bullets.
+    const float BULLET_REPULSION_FACTOR   = 3.0f;    // Scale factor for bullet repulsion.
+
+    float best_distance = 1e9;
+    Enemy *target = NULL;
+    float repulsion_x = 0.0f, repulsion_y = 0.0f;
+    int enemyBulletTooClose = 0;  // Flag to indicate dangerous enemy bullets.
+
+    // Calculate camera origin.
+    float cam_x = player->x - screen_width / 2.0f;
+    float cam_y = player->y - screen_height / 2.0f;
+
+    // Evaluate all active enemies.
+    for (int i = 0; i < enemy_count; i++) {
+        if (!enemies[i].active)
+            continue;
+
+        // Skip stealth enemies that are invisible
+        if (enemies[i].type == ENEMY_STEALTH && !enemies[i].visible)
+            continue;
+
+        float dx = enemies[i].x - player->x;
+        float dy = enemies[i].y - player->y;
+        float distance = sqrtf(dx * dx + dy * dy);
+
+        // Compute enemy's screen position.
+        float enemy_screen_x = enemies[i].x - cam_x;
+        float enemy_screen_y = enemies[i].y - cam_y;
+        if (enemy_screen_x < -50 || enemy_screen_x > screen_width + 50 ||
+            enemy_screen_y < -50 || enemy_screen_y > screen_height + 50) {
+            DEBUG_PRINT(1, 2, "Enemy %d: offscreen (screen pos: %.2f, %.2f), skipped", i, enemy_screen_x, enemy_screen_y);
+            continue;
+        }
+        float center_dx = enemy_screen_x - screen_width / 2.0f;
+        float center_dy = enemy_screen_y - screen_height / 2.0f;
+        float screen_dist = sqrtf(center_dx * center_dx + center_dy * center_dy);
+        DEBUG_PRINT(1, 2, "Enemy %d: distance=%.2f, screen pos=(%.2f, %.2f), center_dist=%.2f", i, distance, enemy_screen_x, enemy_screen_y, screen_dist);
+
+        if (distance < best_distance) {
+            best_distance = distance;
+            target = &enemies[i];
+            DEBUG_PRINT(1, 2, "New target selected: enemy %d, distance=%.2f", i, distance);
+        }
+        if (distance < DANGER_DISTANCE) {
+            repulsion_x -= (dx / distance) * (DANGER_DISTANCE - distance);
+            repulsion_y -= (dy / distance) * (DANGER_DISTANCE - distance);
+            DEBUG_PRINT(1, 2, "Enemy %d: repulsion added (%.2f, %.2f)", i, repulsion_x, repulsion_y);
+        }
+    }
+
+    // Evaluate enemy bullets.
+    for (int i = 0; i < bulletPool->count; i++) {
+        if (bulletPool->bullets[i].active && bulletPool->bullets[i].isEnemy == 1) {
+            float bx = bulletPool->bullets[i].x - player->x;
+            float by = bulletPool->bullets[i].y - player->y;
+            float bdist = sqrtf(bx * bx + by * by);
+            DEBUG_PRINT(1, 2, "Enemy bullet %d: bdist=%.2f", i, bdist);
+            if (bdist < BULLET_DANGER_DISTANCE) {
+                enemyBulletTooClose = 1;
+                repulsion_x -= (bx / bdist) * (BULLET_DANGER_DISTANCE - bdist) * BULLET_REPULSION_FACTOR;
+                repulsion_y -= (by / bdist) * (BULLET_DANGER_DISTANCE - bdist) * BULLET_REPULSION_FACTOR;
+                DEBUG_PRINT(1, 2, "Enemy bullet %d: repulsion added (%.2f, %.2f)", i, repulsion_x, repulsion_y);
+            }
+        }
+    }
+    if (enemyBulletTooClose) {
+        DEBUG_PRINT(1, 3, "Enemy bullets are dangerously close; forcing shield activation and bullet evasion.");
+        activate_shield(player, 1);
+        // Evasion for bullets takes precedence: rotate away from bullet threat.
+        float flee_angle = atan2f(repulsion_y, repulsion_x) * (180.0f / M_PI) + 90.0f;
+        float angle_adjust = flee_angle - player->angle;
+        while (angle_adjust > 180.0f) angle_adjust -= 360.0f;
+        while (angle_adjust < -180.0f) angle_adjust += 360.0f;
+        DEBUG_PRINT(1, 2, "Bullet Evasion: flee_angle=%.2f, angle_adjust=%.2f", flee_angle, angle_adjust);
+        if (fabs(angle_adjust) < AI_EVASION_ROTATION_SPEED)
+            player->angle = flee_angle;
+        else if (angle_adjust > 0)
+            player->angle += AI_EVASION_ROTATION_SPEED;
+        else
+            player->angle -= AI_EVASION_ROTATION_SPEED;
+        DEBUG_PRINT(1, 3, "Bullet Evasion: new angle=%.2f", player->angle);
+        reverse_thrust(player);
+        DEBUG_PRINT(1, 3, "Bullet Evasion: applying reverse thrust");
+        return; // Do not continue offensive behavior while bullets are too close.
+    }
+
+    // Shield activation based on enemy target (if no dangerous bullets).
+    if (target != NULL) {
+        float dx = target->x - player->x;
+        float dy = target->y - player->y;
+        float dist = sqrtf(dx * dx + dy * dy);
+        DEBUG_PRINT(1, 2, "Target distance for shield check: %.2f", dist);
+        if (dist < SHIELD_DISTANCE) {
+            activate_shield(player, 1);
+            DEBUG_PRINT(1, 3, "Shield activated (target distance %.2f < %.2f)", dist, SHIELD_DISTANCE);
+            float tip_x, tip_y;
+            get_ship_tip(player, &tip_x, &tip_y);
+            shoot_bullet(bulletPool, tip_x, tip_y, player->angle, 0);
+        } else {
+            activate_shield(player, 0);
+            DEBUG_PRINT(1, 3, "Shield deactivated (target distance %.2f >= %.2f)", dist, SHIELD_DISTANCE);
+        }
+    } else {
+        activate_shield(player, 0);
+        DEBUG_PRINT(1, 3, "No target found; shield deactivated");
+    }
+    
+    // Evasion from enemy repulsion (if any remains after bullet evasion).
+    if (fabs(repulsion_x) > 0.01f || fabs(repulsion_y) > 0.01f) {
+        float flee_angle = atan2f(repulsion_y, repulsion_x) * (180.0f / M_PI) + 90.0f;
+        float angle_adjust = flee_angle - player->angle;
+        while (angle_adjust > 180.0f) angle_adjust -= 360.0f;
+        while (angle_adjust < -180.0f) angle_adjust += 360.0f;
+        DEBUG_PRINT(1, 2, "Evasion (enemies): flee_angle=%.2f, angle_adjust=%.2f", flee_angle, angle_adjust);
+        if (fabs(angle_adjust) < AI_EVASION_ROTATION_SPEED)
+            player->angle = flee_angle;
+        else if (angle_adjust > 0)
+            player->angle += AI_EVASION_ROTATION_SPEED;
+        else
+            player->angle -= AI_EVASION_ROTATION_SPEED;
+        DEBUG_PRINT(1, 3, "Evasion (enemies): new angle=%.2f", player->angle);
+        reverse_thrust(player);
+        DEBUG_PRINT(1, 3, "Evasion (enemies): applying reverse thrust");
+        return; // Evasion takes precedence.
+    }
+    
+    // Offensive engagement.
+    if (target != NULL) {
+        float desired_angle = atan2f(target->y - player->y, target->x - player->x) * (180.0f / M_PI) + 180.0f;
+        float angle_adjust = desired_angle - player->angle;
+        while (angle_adjust > 180.0f) angle_adjust -= 360.0f;
+        while (angle_adjust < -180.0f) angle_adjust += 360.0f;
+        DEBUG_PRINT(1, 2, "Offense: desired_angle=%.2f, angle_adjust=%.2f", desired_angle, angle_adjust);
+        if (fabs(angle_adjust) < AI_OFFENSIVE_ROTATION_SPEED)
+            player->angle = desired_angle;
+        else if (angle_adjust > 0)
+            player->angle += AI_OFFENSIVE_ROTATION_SPEED;
+        else
+            player->angle -= AI_OFFENSIVE_ROTATION_SPEED;
+        DEBUG_PRINT(1, 3, "Offense: new angle=%.2f", player->angle);
+    
+        float dx = target->x - player->x;
+        float dy = target->y - player->y;
+        float distance = sqrtf(dx * dx + dy * dy);
+        DEBUG_PRINT(1, 2, "Offense: distance to target = %.2f", distance);
+        
+        if (distance > SHOOTING_RANGE) {
+            if (fabs(angle_adjust) < 10.0f) {
+                thrust_player(player);
+                DEBUG_PRINT(1, 3, "Offense: enemy far and aligned, applying thrust to approach");
+            } else {
+                DEBUG_PRINT(1, 3, "Offense: enemy far but not aligned (angle_adjust=%.2f), no thrust", angle_adjust);
+            }
+        } else {
+            player->vx *= 0.8f;
+            player->vy *= 0.8f;
+            DEBUG_PRINT(1, 3, "Offense: enemy within shooting range, braking to stabilize");
+            float tip_x, tip_y;
+            get_ship_tip(player, &tip_x, &tip_y);
+            shoot_bullet(bulletPool, tip_x, tip_y, player->angle, 0);
+        }
+    
+        if (fabs(angle_adjust) < 5.0f && distance <= SHOOTING_RANGE) {
+            float tip_x, tip_y;
+            get_ship_tip(player, &tip_x, &tip_y);
+            shoot_bullet(bulletPool, tip_x, tip_y, player->angle, 0);
+            DEBUG_PRINT(1, 3, "Offense: aligned (angle_adjust=%.2f) and within range, shooting", angle_adjust);
+        } else {
+            DEBUG_PRINT(1, 2, "Offense: not shooting (angle_adjust=%.2f, distance=%.2f)", angle_adjust, distance);
+        }
+    } else {
+        DEBUG_PRINT(1, 3, "No target detected: remaining stationary");
+    }
+}
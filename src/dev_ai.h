@@ -0,0 +1,12 @@
+#ifndef DEV_AI_H
+#define DEV_AI_H
+
+#include "player.h"
+#include "enemy.h"
+#include "bullet.h"
+
+// Steers, shields and fires for the player in --development auto mode,
+// looking at the first enemy_count enemies and every bullet in bulletPool.
+void dev_ai_control(Player *player, Enemy enemies[], int enemy_count, BulletPool *bulletPool, int screen_width, int screen_height);
+
+#endif
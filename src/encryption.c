@@ -1,10 +1,20 @@
 #include "encryption.h"
+#include "blockchain.h"
+#include "usermap.h"
 #include "debug.h"
+#include "trace.h"
+#include "memtrack.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <openssl/evp.h>
+#include <openssl/err.h>
 #include <openssl/pem.h>
 #include <openssl/sha.h>
 #include <errno.h>
@@ -13,26 +23,81 @@
 #define USERNAME_FILE ".username"
 #endif
 
-// Computes SHA-256 over input data and outputs a hex string.
-void hash_score(const char *data, char *output_hash) {
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256((const unsigned char*)data, strlen(data), hash);
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        sprintf(output_hash + (i * 2), "%02x", hash[i]);
+// Public key file names are <username><stem>.pem; the stem depends on the scheme.
+#define RSA_KEY_STEM "_public"
+#define ED25519_KEY_STEM "_ed25519"
+#define KEY_FILE_EXT ".pem"
+// PEM label of the RSA countersignature appended to a migrated Ed25519 key file.
+#define COUNTERSIGN_PEM_NAME "QS COUNTERSIGNATURE"
+#define KEYRING_MAGIC "QSKEYRING 3"
+
+static void forget_public_key(const char *key_name);
+static char *read_file(const char *path, size_t *len);
+
+static int supported_version(int version) {
+    return version == BLOCK_VERSION_RSA || version == BLOCK_VERSION_ED25519;
+}
+
+// Writes the file stem for username's public key of the given version,
+// e.g. "alice_ed25519". The stem also names the key in the cache and keyring.
+static void public_key_name(const char *username, int version, char *out, size_t out_size) {
+    snprintf(out, out_size, "%s%s", username,
+             version == BLOCK_VERSION_ED25519 ? ED25519_KEY_STEM : RSA_KEY_STEM);
+}
+
+static int key_matches_version(EVP_PKEY *pkey, int version) {
+    int id = EVP_PKEY_id(pkey);
+    return version == BLOCK_VERSION_ED25519 ? id == EVP_PKEY_ED25519 : id == EVP_PKEY_RSA;
+}
+
+// Computes SHA-256 over len bytes of data into output_hash (raw digest).
+void hash_score(const char *data, size_t len, unsigned char *output_hash) {
+    SHA256((const unsigned char*)data, len, output_hash);
+}
+
+void hex_encode(const unsigned char *in, size_t len, char *out) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        out[2*i] = digits[in[i] >> 4];
+        out[2*i + 1] = digits[in[i] & 0x0f];
+    }
+    out[2 * len] = '\0';
+}
+
+// Hex digit values plus one, indexed by character; 0 marks a non-hex character.
+static const unsigned char hex_values[256] = {
+    ['0'] = 1,  ['1'] = 2,  ['2'] = 3,  ['3'] = 4,  ['4'] = 5,
+    ['5'] = 6,  ['6'] = 7,  ['7'] = 8,  ['8'] = 9,  ['9'] = 10,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+int hex_decode(const char *hex, unsigned char *out, size_t out_len) {
+    const unsigned char *in = (const unsigned char*)hex;
+    for (size_t i = 0; i < out_len; i++) {
+        unsigned char hi = hex_values[in[2*i]];
+        if (!hi)
+            return 0;  // also stops at the terminator of a short string
+        unsigned char lo = hex_values[in[2*i + 1]];
+        if (!lo)
+            return 0;
+        out[i] = (unsigned char)(((hi - 1) << 4) | (lo - 1));
     }
-    output_hash[SHA256_DIGEST_LENGTH * 2] = '\0';
+    return 1;
 }
 
 // Helper: Write the private key to the .username file.
-// Format: first line is the username, then the PEM-encoded private key.
-static int write_private_key_to_username(const char *username, EVP_PKEY *pkey) {
-    FILE *fp = fopen(USERNAME_FILE, "w");
+// Format: first line is the username, then one PEM-encoded private key per scheme.
+// With append set, the key is added after the existing ones instead.
+static int write_private_key_to_username(const char *username, EVP_PKEY *pkey, int append) {
+    FILE *fp = fopen(USERNAME_FILE, append ? "a" : "w");
     if (!fp) {
         DEBUG_PRINT(1, 0, "Error opening %s for writing: %s", USERNAME_FILE, strerror(errno));
         return 0;
     }
     // Write the username on the first line.
-    fprintf(fp, "%s\n", username);
+    if (!append)
+        fprintf(fp, "%s\n", username);
     
     BIO *bio = BIO_new(BIO_s_mem());
     if (!bio) {
@@ -58,10 +123,26 @@ static int write_private_key_to_username(const char *username, EVP_PKEY *pkey) {
     return 1;
 }
 
-// Helper: Write the public key to highscore/public_keys/<username>_public.pem.
-// Ensures that the "highscore" and "highscore/public_keys" directories exist.
-static int write_public_key(const char *username, EVP_PKEY *pkey) {
-    const char *pub_dir = "highscore/public_keys";
+// Signs the DER encoding of pkey with the legacy RSA key (SHA-256).
+// Returns the signature length, or 0 on failure.
+static size_t countersign_key(EVP_PKEY *rsa_key, EVP_PKEY *pkey, unsigned char *sig, size_t sig_size) {
+    unsigned char *der = NULL;
+    int der_len = i2d_PUBKEY(pkey, &der);
+    if (der_len <= 0)
+        return 0;
+    size_t sig_len = sig_size;
+    EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
+    if (!mdctx || EVP_DigestSignInit(mdctx, NULL, EVP_sha256(), NULL, rsa_key) != 1 ||
+        EVP_DigestSign(mdctx, sig, &sig_len, der, (size_t)der_len) != 1)
+        sig_len = 0;
+    EVP_MD_CTX_free(mdctx);
+    OPENSSL_free(der);
+    return sig_len;
+}
+
+// Helper: Ensures that the "highscore" and "highscore/public_keys" directories exist.
+static int ensure_public_key_dir(void) {
+    const char *pub_dir = PUBLIC_KEY_DIR;
     struct stat st;
     if (stat("highscore", &st) != 0) {
         if (mkdir("highscore", 0755) != 0) {
@@ -75,157 +156,863 @@ static int write_public_key(const char *username, EVP_PKEY *pkey) {
             return 0;
         }
     }
-    char pub_filename[256];
-    snprintf(pub_filename, sizeof(pub_filename), "%s/%s_public.pem", pub_dir, username);
+    return 1;
+}
+
+// Helper: Write the public key to highscore/public_keys/<username><stem>.pem.
+// If countersigner is given, an RSA countersignature over the key is appended.
+static int write_public_key(const char *username, EVP_PKEY *pkey, int version, EVP_PKEY *countersigner) {
+    if (!ensure_public_key_dir())
+        return 0;
+    unsigned char sig[512];
+    size_t sig_len = 0;
+    if (countersigner) {
+        sig_len = countersign_key(countersigner, pkey, sig, sizeof(sig));
+        if (sig_len == 0) {
+            DEBUG_PRINT(1, 0, "Error countersigning new public key for user %s", username);
+            return 0;
+        }
+    }
+    char key_name[256];
+    char pub_filename[512];
+    public_key_name(username, version, key_name, sizeof(key_name));
+    snprintf(pub_filename, sizeof(pub_filename), "%s/%s%s", PUBLIC_KEY_DIR, key_name, KEY_FILE_EXT);
     FILE *fp = fopen(pub_filename, "wb");
     if (!fp) {
         DEBUG_PRINT(1, 0, "Error opening %s for writing: %s", pub_filename, strerror(errno));
         return 0;
     }
-    if (!PEM_write_PUBKEY(fp, pkey)) {
+    if (!PEM_write_PUBKEY(fp, pkey) ||
+        (sig_len > 0 && !PEM_write(fp, COUNTERSIGN_PEM_NAME, "", sig, (long)sig_len))) {
         DEBUG_PRINT(1, 0, "Error Writing public key for user %s", username);
         fclose(fp);
         return 0;
     }
     fclose(fp);
+    // The keyring and any cached handle no longer match this user's key.
+    if (unlink(KEYRING_FILE) == 0)
+        DEBUG_PRINT(2, 1, "Removed stale keyring %s", KEYRING_FILE);
+    forget_public_key(key_name);
     return 1;
 }
 
-// Generates a new RSA key pair for the given username.
-// The private key is stored in the .username file and the public key in highscore/public_keys.
-int generate_keypair(const char *username) {
-    int ret = 0;
+// Generates a fresh private key for the given block version's scheme.
+static EVP_PKEY *generate_key(const char *username, int version) {
     EVP_PKEY *pkey = NULL;
-    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+    int rsa = (version == BLOCK_VERSION_RSA);
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id(rsa ? EVP_PKEY_RSA : EVP_PKEY_ED25519, NULL);
     if (!ctx) {
         DEBUG_PRINT(2, 0, "Error creating EVP_PKEY_CTX for user %s", username);
-        return 0;
+        return NULL;
     }
     if (EVP_PKEY_keygen_init(ctx) <= 0) {
         DEBUG_PRINT(2, 0, "Error initializing key generation for user %s", username);
-        goto cleanup;
-    }
-    if (EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048) <= 0) {
+    } else if (rsa && EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048) <= 0) {
         DEBUG_PRINT(2, 0, "Error setting RSA key size for user %s", username);
-        goto cleanup;
-    }
-    if (EVP_PKEY_keygen(ctx, &pkey) <= 0) {
+    } else if (EVP_PKEY_keygen(ctx, &pkey) <= 0) {
         DEBUG_PRINT(2, 0, "Error during key generation for user %s", username);
-        goto cleanup;
+        pkey = NULL;
     }
+    EVP_PKEY_CTX_free(ctx);
+    return pkey;
+}
+
+// Generates a new key pair for the given username.
+// The private key is stored in the .username file and the public key in highscore/public_keys.
+int generate_keypair(const char *username) {
+    int ret = 0;
+    EVP_PKEY *pkey = generate_key(username, CURRENT_BLOCK_VERSION);
+    if (!pkey)
+        return 0;
     
-    if (!write_private_key_to_username(username, pkey)) {
+    if (!write_private_key_to_username(username, pkey, 0)) {
         DEBUG_PRINT(2, 0, "Error saving private key for user %s in %s", username, USERNAME_FILE);
         goto cleanup;
     }
-    if (!write_public_key(username, pkey)) {
+    if (!write_public_key(username, pkey, CURRENT_BLOCK_VERSION, NULL)) {
         DEBUG_PRINT(2, 0, "Error saving public key for user %s", username);
         goto cleanup;
     }
+    // A fresh identity replaces the old one, as overwriting the key file did
+    // before; a leftover key of the other scheme would no longer match .username.
+    for (int version = BLOCK_VERSION_RSA; version <= BLOCK_VERSION_ED25519; version++) {
+        if (version == CURRENT_BLOCK_VERSION)
+            continue;
+        char key_name[256];
+        char stale[512];
+        public_key_name(username, version, key_name, sizeof(key_name));
+        snprintf(stale, sizeof(stale), "%s/%s%s", PUBLIC_KEY_DIR, key_name, KEY_FILE_EXT);
+        if (unlink(stale) == 0) {
+            DEBUG_PRINT(2, 1, "Removed superseded public key %s", stale);
+            forget_public_key(key_name);
+        }
+    }
     
     DEBUG_PRINT(2, 3, "Key pair generated for user %s", username);
     ret = 1; // success
 
 cleanup:
-    if (pkey) EVP_PKEY_free(pkey);
-    if (ctx) EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(pkey);
     return ret;
 }
 
-// Loads the private key from the .username file.
-// Expects the file to have the username on the first line, followed by the PEM block.
-void* load_private_key(const char *username) {
+// Reads every private key stored in the .username file. Each output is set to
+// the key of that scheme, or NULL if absent. Returns 0 if the file is missing.
+static int read_private_keys(EVP_PKEY **rsa_key, EVP_PKEY **ed25519_key) {
+    *rsa_key = NULL;
+    *ed25519_key = NULL;
+    size_t len = 0;
+    char *file_contents = read_file(USERNAME_FILE, &len);
+    if (!file_contents)
+        return 0;
+    // Skip the username line; the PEM blocks follow it.
+    char *pem_start = strstr(file_contents, "-----BEGIN");
+    BIO *bio = pem_start ? BIO_new_mem_buf(pem_start, (int)(len - (pem_start - file_contents))) : NULL;
+    EVP_PKEY *pkey;
+    while (bio && (pkey = PEM_read_bio_PrivateKey(bio, NULL, NULL, NULL)) != NULL) {
+        EVP_PKEY **dest = key_matches_version(pkey, BLOCK_VERSION_ED25519) ? ed25519_key :
+                          key_matches_version(pkey, BLOCK_VERSION_RSA) ? rsa_key : NULL;
+        if (dest && !*dest) {
+            *dest = pkey;
+        } else {
+            DEBUG_PRINT(2, 1, "Ignoring unexpected private key in %s", USERNAME_FILE);
+            EVP_PKEY_free(pkey);
+        }
+    }
+    // Reading past the last PEM block leaves a "no start line" error queued.
+    ERR_clear_error();
+    BIO_free(bio);
+    mem_free(file_contents);
+    return 1;
+}
+
+// Loads the private key for the given block version from the .username file.
+// Expects the file to have the username on the first line, followed by the PEM blocks.
+void* load_private_key(const char *username, int version) {
     // Ensure a valid key pair exists.
     if (!ensure_keypair(username)) {
         DEBUG_PRINT(2, 0, "Failed to ensure key pair for %s", username);
         return NULL;
     }
-    FILE *fp = fopen(USERNAME_FILE, "r");
-    if (!fp) {
+    EVP_PKEY *rsa_key, *ed25519_key;
+    if (!read_private_keys(&rsa_key, &ed25519_key)) {
         DEBUG_PRINT(2, 0, "Could not open %s for reading private key for user %s", USERNAME_FILE, username);
         return NULL;
     }
-    char buffer[256];
-    if (!fgets(buffer, sizeof(buffer), fp)) {
-        fclose(fp);
+    EVP_PKEY *pkey = NULL;
+    if (version == BLOCK_VERSION_ED25519) {
+        pkey = ed25519_key;
+        ed25519_key = NULL;
+    } else if (version == BLOCK_VERSION_RSA) {
+        pkey = rsa_key;
+        rsa_key = NULL;
+    }
+    EVP_PKEY_free(rsa_key);
+    EVP_PKEY_free(ed25519_key);
+    if (!pkey)
+        DEBUG_PRINT(2, 0, "No private key for block version %d found in %s for user %s", version, USERNAME_FILE, username);
+    return pkey;
+}
+
+// Parses a public key file. If countersig is not NULL, the first
+// COUNTERSIGN_PEM_NAME block after the key is returned there (OPENSSL_free it).
+static EVP_PKEY *parse_public_key(const char *pem, size_t len, unsigned char **countersig, long *countersig_len) {
+    BIO *bio = BIO_new_mem_buf(pem, (int)len);
+    if (!bio)
         return NULL;
+    EVP_PKEY *pkey = PEM_read_bio_PUBKEY(bio, NULL, NULL, NULL);
+    if (pkey && countersig) {
+        *countersig = NULL;
+        char *name = NULL, *header = NULL;
+        unsigned char *data = NULL;
+        long data_len = 0;
+        while (!*countersig && PEM_read_bio(bio, &name, &header, &data, &data_len)) {
+            if (strcmp(name, COUNTERSIGN_PEM_NAME) == 0) {
+                *countersig = data;
+                *countersig_len = data_len;
+            } else {
+                OPENSSL_free(data);
+            }
+            OPENSSL_free(name);
+            OPENSSL_free(header);
+        }
+        ERR_clear_error();
     }
-    // Read the entire file into memory.
-    fseek(fp, 0, SEEK_END);
-    long fsize = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    char *file_contents = malloc(fsize + 1);
-    if (!file_contents) {
-        fclose(fp);
+    BIO_free(bio);
+    return pkey;
+}
+
+// Reads and parses PUBLIC_KEY_DIR/<key_name>.pem (see parse_public_key).
+static EVP_PKEY *read_public_key_file(const char *key_name, unsigned char **countersig, long *countersig_len) {
+    char pub_filename[512];
+    snprintf(pub_filename, sizeof(pub_filename), "%s/%s%s", PUBLIC_KEY_DIR, key_name, KEY_FILE_EXT);
+    size_t len = 0;
+    char *pem = read_file(pub_filename, &len);
+    if (!pem) {
+        DEBUG_PRINT(2, 1, "Public key file %s not found", pub_filename);
         return NULL;
     }
-    fread(file_contents, 1, fsize, fp);
-    file_contents[fsize] = '\0';
-    fclose(fp);
-    
-    // Look for the PEM header.
-    char *pem_start = strstr(file_contents, "-----BEGIN");
-    if (!pem_start) {
-        DEBUG_PRINT(2, 0, "Private key PEM block not found in %s", USERNAME_FILE);
-        free(file_contents);
-        // If no PEM block, regenerate keys.
-        if (generate_keypair(username)) {
-            return load_private_key(username);
+    EVP_PKEY *pkey = parse_public_key(pem, len, countersig, countersig_len);
+    mem_free(pem);
+    if (!pkey) {
+        DEBUG_PRINT(2, 0, "Error loading public key from %s", pub_filename);
+    }
+    return pkey;
+}
+
+// Loads the public key for the given username from PUBLIC_KEY_DIR/<username><stem>.pem.
+void* load_public_key(const char *username, int version) {
+    char key_name[256];
+    public_key_name(username, version, key_name, sizeof(key_name));
+    return read_public_key_file(key_name, NULL, NULL);
+}
+
+/*
+ * Public key cache and keyring.
+ *
+ * Parsed EVP_PKEY handles are cached per key name (the file stem, e.g.
+ * "alice_public" or "alice_ed25519") for the life of the process, including
+ * negative entries for missing or rejected keys. The keyring bundles every
+ * PEM in PUBLIC_KEY_DIR behind a small text index:
+ *
+ *   QSKEYRING 3 <count>
+ *   <offset> <length> <file identity> <key name>     (count lines)
+ *   <concatenated PEM data>           (offsets are relative to this point)
+ *
+ * The file identity is the size, inode, mtime and ctime (to the nanosecond)
+ * each key file had when the keyring was built. It is mapped once on first
+ * lookup and ignored if PUBLIC_KEY_DIR has changed since it was built; an
+ * entry whose key file no longer has the recorded identity (replaced within
+ * the same second, restored from a backup, ...) is skipped in favour of the
+ * file itself. Generating a key pair deletes the keyring.
+ *
+ * All cache state is guarded by g_key_cache_lock so verification threads can
+ * share it. Cached EVP_PKEY handles are only read after being published.
+ */
+typedef struct {
+    long long size, inode;
+    long long mtime_sec, mtime_nsec;
+    long long ctime_sec, ctime_nsec;
+} KeyFileId;
+
+typedef struct {
+    size_t offset;    // relative to the end of the index
+    size_t len;
+    KeyFileId id;     // of the key file the PEM was read from
+    const char *pem;  // points into the mapped keyring
+} KeyringEntry;
+
+static UserMap g_public_keys;    // key name -> CachedKey*
+static UserMap g_keyring_index;  // key name -> KeyringEntry*
+static KeyringEntry *g_keyring_entries = NULL;
+static void *g_keyring_map = NULL;
+static size_t g_keyring_size = 0;
+static int g_keyring_state = 0;  // 0 = not opened yet, 1 = mapped, -1 = unavailable
+static pthread_mutex_t g_key_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Fills id from the key file at path. Returns 0 if it cannot be stat'ed.
+static int key_file_id(const char *path, KeyFileId *id) {
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return 0;
+    id->size = (long long)st.st_size;
+    id->inode = (long long)st.st_ino;
+    id->mtime_sec = (long long)st.st_mtim.tv_sec;
+    id->mtime_nsec = (long long)st.st_mtim.tv_nsec;
+    id->ctime_sec = (long long)st.st_ctim.tv_sec;
+    id->ctime_nsec = (long long)st.st_ctim.tv_nsec;
+    return 1;
+}
+
+static int same_key_file(const KeyFileId *a, const KeyFileId *b) {
+    return a->size == b->size && a->inode == b->inode &&
+           a->mtime_sec == b->mtime_sec && a->mtime_nsec == b->mtime_nsec &&
+           a->ctime_sec == b->ctime_sec && a->ctime_nsec == b->ctime_nsec;
+}
+
+// Copies the next newline-terminated line of the mapped keyring into line.
+// Returns a pointer just past the newline, or NULL if no complete line fits.
+static const char *keyring_next_line(const char *pos, const char *end, char *line, size_t line_size) {
+    const char *nl = memchr(pos, '\n', end - pos);
+    if (!nl || (size_t)(nl - pos) >= line_size)
+        return NULL;
+    memcpy(line, pos, nl - pos);
+    line[nl - pos] = '\0';
+    return nl + 1;
+}
+
+static void close_keyring(void) {
+    usermap_free(&g_keyring_index, NULL);
+    free(g_keyring_entries);
+    g_keyring_entries = NULL;
+    if (g_keyring_map)
+        munmap(g_keyring_map, g_keyring_size);
+    g_keyring_map = NULL;
+    g_keyring_size = 0;
+}
+
+static void open_keyring(void) {
+    g_keyring_state = -1;
+    struct stat ring_st, dir_st;
+    if (stat(KEYRING_FILE, &ring_st) != 0 || ring_st.st_size <= 0)
+        return;
+    // A directory change in the same timestamp tick as the keyring counts as newer.
+    if (stat(PUBLIC_KEY_DIR, &dir_st) == 0 &&
+        (dir_st.st_mtim.tv_sec > ring_st.st_mtim.tv_sec ||
+         (dir_st.st_mtim.tv_sec == ring_st.st_mtim.tv_sec && dir_st.st_mtim.tv_nsec >= ring_st.st_mtim.tv_nsec))) {
+        DEBUG_PRINT(2, 1, "Keyring %s is older than %s; falling back to per-user key files", KEYRING_FILE, PUBLIC_KEY_DIR);
+        return;
+    }
+    int fd = open(KEYRING_FILE, O_RDONLY);
+    if (fd < 0) {
+        DEBUG_PRINT(2, 1, "Could not open keyring %s: %s", KEYRING_FILE, strerror(errno));
+        return;
+    }
+    g_keyring_size = (size_t)ring_st.st_size;
+    g_keyring_map = mmap(NULL, g_keyring_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (g_keyring_map == MAP_FAILED) {
+        DEBUG_PRINT(2, 1, "Could not map keyring %s: %s", KEYRING_FILE, strerror(errno));
+        g_keyring_map = NULL;
+        return;
+    }
+
+    const char *pos = g_keyring_map;
+    const char *end = pos + g_keyring_size;
+    char line[512];
+    int count = 0;
+    pos = keyring_next_line(pos, end, line, sizeof(line));
+    if (!pos || strncmp(line, KEYRING_MAGIC, strlen(KEYRING_MAGIC)) != 0 ||
+        sscanf(line + strlen(KEYRING_MAGIC), "%d", &count) != 1 || count < 0) {
+        DEBUG_PRINT(2, 1, "Keyring %s has an invalid header; ignoring it", KEYRING_FILE);
+        close_keyring();
+        return;
+    }
+    g_keyring_entries = calloc(count ? count : 1, sizeof(KeyringEntry));
+    if (!g_keyring_entries) {
+        close_keyring();
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        size_t offset, len;
+        KeyFileId *id = &g_keyring_entries[i].id;
+        int name_start = 0;
+        pos = pos ? keyring_next_line(pos, end, line, sizeof(line)) : NULL;
+        if (!pos || sscanf(line, "%zu %zu %lld %lld %lld %lld %lld %lld %n", &offset, &len,
+                           &id->size, &id->inode, &id->mtime_sec, &id->mtime_nsec,
+                           &id->ctime_sec, &id->ctime_nsec, &name_start) != 8 || name_start == 0) {
+            DEBUG_PRINT(2, 1, "Keyring %s has a corrupt index; ignoring it", KEYRING_FILE);
+            close_keyring();
+            return;
+        }
+        g_keyring_entries[i].offset = offset;
+        g_keyring_entries[i].len = len;
+        void **slot = usermap_slot(&g_keyring_index, line + name_start);
+        if (slot)
+            *slot = &g_keyring_entries[i];
+    }
+    // Offsets are relative to the end of the index; resolve them now.
+    for (int i = 0; i < count; i++) {
+        size_t offset = g_keyring_entries[i].offset;
+        if (offset > (size_t)(end - pos) || g_keyring_entries[i].len > (size_t)(end - pos) - offset) {
+            DEBUG_PRINT(2, 1, "Keyring %s entry %d is out of bounds; ignoring the keyring", KEYRING_FILE, i);
+            close_keyring();
+            return;
         }
+        g_keyring_entries[i].pem = pos + offset;
+    }
+    g_keyring_state = 1;
+    DEBUG_PRINT(2, 3, "Mapped keyring %s with %d key(s)", KEYRING_FILE, count);
+}
+
+// Identity of key_name's file, or has_file = 0 if there is none.
+typedef struct {
+    int has_file;
+    KeyFileId id;
+} KeyFileState;
+
+static void key_file_state(const char *key_name, KeyFileState *state) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s%s", PUBLIC_KEY_DIR, key_name, KEY_FILE_EXT);
+    memset(state, 0, sizeof(*state));
+    state->has_file = key_file_id(path, &state->id);
+}
+
+static int same_key_file_state(const KeyFileState *a, const KeyFileState *b) {
+    return a->has_file == b->has_file && (!a->has_file || same_key_file(&a->id, &b->id));
+}
+
+// Cache entry: the parsed key (NULL if the user has no usable key) plus a
+// SHA-256 fingerprint of its DER encoding, which lets other caches detect
+// that a user's key has changed. The entry is only used while the key file,
+// and for an Ed25519 key the RSA key file that may countersign it, still have
+// the identity they had when it was loaded; a key rewritten in place, which
+// leaves PUBLIC_KEY_DIR untouched, is reloaded on the next lookup.
+typedef struct {
+    EVP_PKEY *pkey;
+    unsigned char fingerprint[KEY_FINGERPRINT_LEN];
+    KeyFileState file;
+    KeyFileState rsa_file;  // Ed25519 keys only
+} CachedKey;
+
+static void free_cached_key(void *value) {
+    if (!value)
+        return;
+    CachedKey *entry = (CachedKey*)value;
+    EVP_PKEY_free(entry->pkey);
+    free(entry);
+}
+
+// Drops the cached handle for key_name so the next lookup reloads it.
+static void forget_public_key(const char *key_name) {
+    pthread_mutex_lock(&g_key_cache_lock);
+    void *cached = usermap_get(&g_public_keys, key_name);
+    if (cached) {
+        free_cached_key(cached);
+        *usermap_slot(&g_public_keys, key_name) = NULL;
+    }
+    pthread_mutex_unlock(&g_key_cache_lock);
+}
+
+static CachedKey *new_cached_key(EVP_PKEY *pkey) {
+    CachedKey *entry = calloc(1, sizeof(CachedKey));
+    if (!entry)
+        return NULL;
+    entry->pkey = pkey;
+    if (!pkey)
+        return entry;
+    unsigned char *der = NULL;
+    int der_len = i2d_PUBKEY(pkey, &der);
+    if (der_len <= 0) {
+        free(entry);
         return NULL;
     }
-    BIO *bio = BIO_new_mem_buf(pem_start, -1);
-    if (!bio) {
-        free(file_contents);
+    SHA256(der, (size_t)der_len, entry->fingerprint);
+    OPENSSL_free(der);
+    return entry;
+}
+
+static CachedKey *lookup_cached_key(const char *username, int version);
+
+// An Ed25519 key for a user who already has a legacy RSA key is only trusted
+// if that RSA key countersigned it. Must be called with g_key_cache_lock held.
+static int check_countersignature(const char *username, EVP_PKEY *pkey,
+                                  const unsigned char *sig, long sig_len) {
+    CachedKey *rsa = lookup_cached_key(username, BLOCK_VERSION_RSA);
+    if (!rsa)
+        return 1;  // New identity: nothing to migrate from.
+    if (!sig) {
+        DEBUG_PRINT(2, 0, "Ed25519 key for %s is not countersigned by the user's RSA key", username);
+        return 0;
+    }
+    unsigned char *der = NULL;
+    int der_len = i2d_PUBKEY(pkey, &der);
+    EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
+    int ok = der_len > 0 && mdctx &&
+             EVP_DigestVerifyInit(mdctx, NULL, EVP_sha256(), NULL, rsa->pkey) == 1 &&
+             EVP_DigestVerify(mdctx, sig, (size_t)sig_len, der, (size_t)der_len) == 1;
+    EVP_MD_CTX_free(mdctx);
+    OPENSSL_free(der);
+    if (!ok)
+        DEBUG_PRINT(2, 0, "Countersignature on the Ed25519 key for %s does not verify", username);
+    return ok;
+}
+
+// Returns the cache entry for username's key of the given version, loading it
+// on first use or when its key file changed. Must be called with
+// g_key_cache_lock held. Returns NULL if the user has no usable key.
+static CachedKey *lookup_cached_key(const char *username, int version) {
+    if (!supported_version(version))
         return NULL;
+    char key_name[256], rsa_name[256];
+    public_key_name(username, version, key_name, sizeof(key_name));
+    int want_countersig = (version == BLOCK_VERSION_ED25519);
+    public_key_name(username, BLOCK_VERSION_RSA, rsa_name, sizeof(rsa_name));
+    // Taken before the key is read, so a change while reading shows up next time.
+    KeyFileState file, rsa_file = {0};
+    key_file_state(key_name, &file);
+    if (want_countersig)
+        key_file_state(rsa_name, &rsa_file);
+    CachedKey *cached = usermap_get(&g_public_keys, key_name);
+    if (cached) {
+        if (same_key_file_state(&cached->file, &file) && same_key_file_state(&cached->rsa_file, &rsa_file))
+            return cached->pkey ? cached : NULL;
+        DEBUG_PRINT(2, 1, "Public key %s changed on disk; reloading it", key_name);
+        free_cached_key(cached);
+        *usermap_slot(&g_public_keys, key_name) = NULL;
     }
-    EVP_PKEY *pkey = PEM_read_bio_PrivateKey(bio, NULL, NULL, NULL);
-    if (!pkey) {
-        DEBUG_PRINT(2, 0, "Error reading private key from memory buffer for user %s", username);
+
+    unsigned char *countersig = NULL;
+    long countersig_len = 0;
+    EVP_PKEY *pkey = NULL;
+    if (g_keyring_state == 0)
+        open_keyring();
+    KeyringEntry *entry = (g_keyring_state == 1) ? usermap_get(&g_keyring_index, key_name) : NULL;
+    if (entry && (!file.has_file || !same_key_file(&file.id, &entry->id))) {
+        DEBUG_PRINT(2, 1, "Keyring entry for %s is stale; using the key file", key_name);
+        entry = NULL;
     }
-    BIO_free(bio);
-    free(file_contents);
+    if (entry) {
+        pkey = parse_public_key(entry->pem, entry->len, want_countersig ? &countersig : NULL, &countersig_len);
+        if (!pkey)
+            DEBUG_PRINT(2, 1, "Keyring entry for %s could not be parsed; trying the key file", key_name);
+    }
+    if (!pkey)
+        pkey = read_public_key_file(key_name, want_countersig ? &countersig : NULL, &countersig_len);
+    if (pkey && !key_matches_version(pkey, version)) {
+        DEBUG_PRINT(2, 0, "Public key %s is not of the type block version %d requires", key_name, version);
+        EVP_PKEY_free(pkey);
+        pkey = NULL;
+    }
+    if (pkey && want_countersig && !check_countersignature(username, pkey, countersig, countersig_len)) {
+        EVP_PKEY_free(pkey);
+        pkey = NULL;
+    }
+    OPENSSL_free(countersig);
+
+    CachedKey *key = new_cached_key(pkey);
+    if (!key) {
+        DEBUG_PRINT(2, 0, "Failed to cache public key for %s", key_name);
+        EVP_PKEY_free(pkey);
+        return NULL;
+    }
+    key->file = file;
+    key->rsa_file = rsa_file;
+    void **slot = usermap_slot(&g_public_keys, key_name);
+    if (slot) {
+        *slot = key;
+    } else {
+        free_cached_key(key);
+        return NULL;
+    }
+    return key->pkey ? key : NULL;
+}
+
+void* get_public_key(const char *username, int version) {
+    pthread_mutex_lock(&g_key_cache_lock);
+    CachedKey *key = lookup_cached_key(username, version);
+    // The cache may replace the entry once the key file changes, so the
+    // caller gets its own reference.
+    EVP_PKEY *pkey = key && EVP_PKEY_up_ref(key->pkey) == 1 ? key->pkey : NULL;
+    pthread_mutex_unlock(&g_key_cache_lock);
     return pkey;
 }
 
-// Loads the public key for the given username from highscore/public_keys/<username>_public.pem.
-void* load_public_key(const char *username) {
-    char pub_filename[256];
-    snprintf(pub_filename, sizeof(pub_filename), "highscore/public_keys/%s_public.pem", username);
-    FILE *fp = fopen(pub_filename, "rb");
-    if (!fp) {
-        DEBUG_PRINT(2, 0, "Public key file %s not found for user %s", pub_filename, username);
+int get_public_key_fingerprint(const char *username, int version, unsigned char *fingerprint) {
+    pthread_mutex_lock(&g_key_cache_lock);
+    CachedKey *key = lookup_cached_key(username, version);
+    if (key)
+        memcpy(fingerprint, key->fingerprint, KEY_FINGERPRINT_LEN);
+    pthread_mutex_unlock(&g_key_cache_lock);
+    return key != NULL;
+}
+
+void clear_public_key_cache(void) {
+    pthread_mutex_lock(&g_key_cache_lock);
+    usermap_free(&g_public_keys, free_cached_key);
+    close_keyring();
+    g_keyring_state = 0;
+    pthread_mutex_unlock(&g_key_cache_lock);
+}
+
+// Reads a whole file into a NUL-terminated heap buffer. Returns NULL on failure.
+static char *read_file(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
         return NULL;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *data = size > 0 ? mem_alloc(MEM_KEYS, (size_t)size + 1) : NULL;
+    if (data && fread(data, 1, (size_t)size, fp) != (size_t)size) {
+        mem_free(data);
+        data = NULL;
     }
-    EVP_PKEY *pkey = PEM_read_PUBKEY(fp, NULL, NULL, NULL);
+    if (data)
+        data[size] = '\0';
     fclose(fp);
-    if (!pkey) {
-        DEBUG_PRINT(2, 0, "Error loading public key from %s for user %s", pub_filename, username);
+    *len = data ? (size_t)size : 0;
+    return data;
+}
+
+int public_key_file_path(const char *username, int version, char *out, size_t out_size) {
+    if (!supported_version(version) || strchr(username, '/'))
+        return 0;
+    char key_name[256];
+    public_key_name(username, version, key_name, sizeof(key_name));
+    int n = snprintf(out, out_size, "%s/%s%s", PUBLIC_KEY_DIR, key_name, KEY_FILE_EXT);
+    return n > 0 && (size_t)n < out_size;
+}
+
+int install_public_key(const char *username, int version, const char *pem, size_t len) {
+    char path[512];
+    if (!public_key_file_path(username, version, path, sizeof(path)) || !ensure_public_key_dir())
+        return -1;
+    int fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+        return errno == EEXIST ? 0 : -1;
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(fd, pem + done, len - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += (size_t)n;
     }
-    return pkey;
+    if (close(fd) != 0 || done < len) {
+        unlink(path);
+        return -1;
+    }
+    char key_name[256];
+    public_key_name(username, version, key_name, sizeof(key_name));
+    forget_public_key(key_name);
+    DEBUG_PRINT(2, 3, "Installed public key %s", path);
+    return 1;
+}
+
+int build_keyring(void) {
+    DIR *dir = opendir(PUBLIC_KEY_DIR);
+    if (!dir) {
+        DEBUG_PRINT(1, 0, "Could not open %s: %s", PUBLIC_KEY_DIR, strerror(errno));
+        return -1;
+    }
+    char **names = NULL;
+    char **pems = NULL;
+    size_t *lens = NULL;
+    KeyFileId *ids = NULL;
+    int count = 0, capacity = 0, ret = -1;
+    size_t ext_len = strlen(KEY_FILE_EXT);
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        size_t name_len = strlen(ent->d_name);
+        if (name_len <= ext_len || strcmp(ent->d_name + name_len - ext_len, KEY_FILE_EXT) != 0)
+            continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            char **new_names = realloc(names, capacity * sizeof(char*));
+            if (new_names) names = new_names;
+            char **new_pems = realloc(pems, capacity * sizeof(char*));
+            if (new_pems) pems = new_pems;
+            size_t *new_lens = realloc(lens, capacity * sizeof(size_t));
+            if (new_lens) lens = new_lens;
+            KeyFileId *new_ids = realloc(ids, capacity * sizeof(KeyFileId));
+            if (new_ids) ids = new_ids;
+            if (!new_names || !new_pems || !new_lens || !new_ids)
+                goto cleanup;
+        }
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", PUBLIC_KEY_DIR, ent->d_name);
+        // Stat before reading: a change after this point leaves the entry stale, not wrong.
+        pems[count] = key_file_id(path, &ids[count]) ? read_file(path, &lens[count]) : NULL;
+        if (!pems[count]) {
+            DEBUG_PRINT(1, 1, "Skipping unreadable key file %s", path);
+            continue;
+        }
+        names[count] = strndup(ent->d_name, name_len - ext_len);
+        if (!names[count]) {
+            mem_free(pems[count]);
+            goto cleanup;
+        }
+        count++;
+    }
+
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", KEYRING_FILE);
+    FILE *fp = fopen(tmp_path, "wb");
+    if (!fp) {
+        DEBUG_PRINT(1, 0, "Error opening %s for writing: %s", tmp_path, strerror(errno));
+        goto cleanup;
+    }
+    fprintf(fp, "%s %d\n", KEYRING_MAGIC, count);
+    size_t offset = 0;
+    for (int i = 0; i < count; i++) {
+        const KeyFileId *id = &ids[i];
+        fprintf(fp, "%zu %zu %lld %lld %lld %lld %lld %lld %s\n", offset, lens[i], id->size, id->inode,
+                id->mtime_sec, id->mtime_nsec, id->ctime_sec, id->ctime_nsec, names[i]);
+        offset += lens[i];
+    }
+    for (int i = 0; i < count; i++)
+        fwrite(pems[i], 1, lens[i], fp);
+    if (fclose(fp) != 0 || rename(tmp_path, KEYRING_FILE) != 0) {
+        DEBUG_PRINT(1, 0, "Error writing keyring %s: %s", KEYRING_FILE, strerror(errno));
+        unlink(tmp_path);
+        goto cleanup;
+    }
+    // Pick up the new bundle on the next lookup.
+    clear_public_key_cache();
+    DEBUG_PRINT(1, 3, "Keyring %s written with %d key(s)", KEYRING_FILE, count);
+    ret = count;
+
+cleanup:
+    closedir(dir);
+    for (int i = 0; i < count; i++) {
+        free(names[i]);
+        mem_free(pems[i]);
+    }
+    free(names);
+    free(pems);
+    free(lens);
+    free(ids);
+    return ret;
+}
+
+// Adds an Ed25519 key for a user who only has a legacy RSA key. The new
+// public key is countersigned by the RSA key so verifiers accept it, and the
+// RSA key stays in .username and PUBLIC_KEY_DIR for the user's older blocks.
+static int migrate_keypair(const char *username, EVP_PKEY *rsa_key) {
+    EVP_PKEY *pkey = generate_key(username, BLOCK_VERSION_ED25519);
+    if (!pkey)
+        return 0;
+    int ret = write_public_key(username, pkey, BLOCK_VERSION_ED25519, rsa_key) &&
+              write_private_key_to_username(username, pkey, 1);
+    if (ret)
+        DEBUG_PRINT(2, 3, "Added a countersigned Ed25519 key for user %s", username);
+    else
+        DEBUG_PRINT(2, 0, "Error adding an Ed25519 key for user %s", username);
+    EVP_PKEY_free(pkey);
+    return ret;
 }
 
 // Ensures a key pair exists for the given username.
 // If the .username file does not exist or lacks a valid private key, a new key pair is generated.
 int ensure_keypair(const char *username) {
-    FILE *fp = fopen(USERNAME_FILE, "r");
-    if (!fp) {
+    EVP_PKEY *rsa_key, *ed25519_key;
+    if (!read_private_keys(&rsa_key, &ed25519_key)) {
         DEBUG_PRINT(2, 1, "Private key file %s not found; generating new key pair for %s.", USERNAME_FILE, username);
         return generate_keypair(username);
     }
-    char line[256];
-    int found = 0;
-    while (fgets(line, sizeof(line), fp)) {
-        if (strstr(line, "-----BEGIN") != NULL) {
-            found = 1;
-            break;
-        }
-    }
-    fclose(fp);
-    if (!found) {
+    int ret = 1;
+    if (!rsa_key && !ed25519_key) {
         DEBUG_PRINT(2, 1, "No private key PEM block found in %s; generating new key pair for %s.", USERNAME_FILE, username);
-        return generate_keypair(username);
+        ret = generate_keypair(username);
+    } else if (CURRENT_BLOCK_VERSION == BLOCK_VERSION_ED25519 && !ed25519_key) {
+        DEBUG_PRINT(2, 1, "User %s only has an RSA key; migrating to Ed25519.", username);
+        ret = migrate_keypair(username, rsa_key);
+    } else {
+        DEBUG_PRINT(2, 3, "Private key exists for user %s in %s.", username, USERNAME_FILE);
     }
-    DEBUG_PRINT(2, 3, "Private key exists for user %s in %s.", username, USERNAME_FILE);
-    return 1;
+    EVP_PKEY_free(rsa_key);
+    EVP_PKEY_free(ed25519_key);
+    return ret;
+}
+
+/*
+ * Signing session.
+ *
+ * The local player's private keys are read from .username once per run and
+ * kept as live handles, so sealing a block at game over is only the signature
+ * operation. If keys have to be generated (or migrated), that happens on a
+ * background thread; signers wait for it only if they get there first.
+ */
+enum { SESSION_NONE, SESSION_LOADING, SESSION_READY, SESSION_FAILED };
+
+static pthread_mutex_t g_session_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_session_ready = PTHREAD_COND_INITIALIZER;
+static int g_session_state = SESSION_NONE;
+static char g_session_user[256];
+static EVP_PKEY *g_session_rsa = NULL;
+static EVP_PKEY *g_session_ed25519 = NULL;
+static pthread_t g_session_thread;
+static int g_session_thread_started = 0;
+
+// Warns if a session key does not match the public key verifiers will use;
+// blocks signed with it would be rejected as cheating.
+static void check_session_key(EVP_PKEY *pkey, int version) {
+    unsigned char *der = NULL;
+    unsigned char local[KEY_FINGERPRINT_LEN], published[KEY_FINGERPRINT_LEN];
+    int der_len = i2d_PUBKEY(pkey, &der);
+    if (der_len <= 0)
+        return;
+    SHA256(der, (size_t)der_len, local);
+    OPENSSL_free(der);
+    if (!get_public_key_fingerprint(g_session_user, version, published))
+        DEBUG_PRINT(2, 1, "No published version %d public key for %s; its blocks will not verify", version, g_session_user);
+    else if (memcmp(local, published, KEY_FINGERPRINT_LEN) != 0)
+        DEBUG_PRINT(2, 0, "Private key in %s does not match the published version %d key for %s", USERNAME_FILE, version, g_session_user);
+}
+
+static void publish_session_keys(EVP_PKEY *rsa_key, EVP_PKEY *ed25519_key) {
+    if (rsa_key)
+        check_session_key(rsa_key, BLOCK_VERSION_RSA);
+    if (ed25519_key)
+        check_session_key(ed25519_key, BLOCK_VERSION_ED25519);
+    int state = (rsa_key || ed25519_key) ? SESSION_READY : SESSION_FAILED;
+    pthread_mutex_lock(&g_session_lock);
+    g_session_rsa = rsa_key;
+    g_session_ed25519 = ed25519_key;
+    g_session_state = state;
+    pthread_cond_broadcast(&g_session_ready);
+    pthread_mutex_unlock(&g_session_lock);
+    if (state == SESSION_READY)
+        DEBUG_PRINT(2, 3, "Signing keys for %s loaded for this session", g_session_user);
+    else
+        DEBUG_PRINT(2, 0, "No signing key available for %s this session", g_session_user);
+}
+
+static void *session_keygen_thread(void *arg) {
+    (void)arg;
+    EVP_PKEY *rsa_key = NULL, *ed25519_key = NULL;
+    trace_thread_name("key generation");
+    TRACE_SCOPE("generate signing keys") {
+        if (ensure_keypair(g_session_user))
+            read_private_keys(&rsa_key, &ed25519_key);
+    }
+    publish_session_keys(rsa_key, ed25519_key);
+    return NULL;
+}
+
+int signing_session_begin(const char *username) {
+    signing_session_end();
+    snprintf(g_session_user, sizeof(g_session_user), "%s", username);
+    EVP_PKEY *rsa_key, *ed25519_key;
+    int have_file = read_private_keys(&rsa_key, &ed25519_key);
+    int current = (CURRENT_BLOCK_VERSION == BLOCK_VERSION_ED25519) ? ed25519_key != NULL : rsa_key != NULL;
+    if (have_file && current) {
+        publish_session_keys(rsa_key, ed25519_key);
+        return 1;
+    }
+    EVP_PKEY_free(rsa_key);
+    EVP_PKEY_free(ed25519_key);
+
+    pthread_mutex_lock(&g_session_lock);
+    g_session_state = SESSION_LOADING;
+    pthread_mutex_unlock(&g_session_lock);
+    if (pthread_create(&g_session_thread, NULL, session_keygen_thread, NULL) == 0) {
+        g_session_thread_started = 1;
+        DEBUG_PRINT(2, 2, "Generating signing keys for %s in the background", username);
+        return 1;
+    }
+    DEBUG_PRINT(2, 1, "Could not start key generation thread; generating keys for %s now", username);
+    session_keygen_thread(NULL);
+    return g_session_state == SESSION_READY;
+}
+
+void* signing_session_key(const char *username, int version) {
+    EVP_PKEY *pkey = NULL;
+    pthread_mutex_lock(&g_session_lock);
+    if (g_session_state != SESSION_NONE && strcmp(g_session_user, username) == 0) {
+        while (g_session_state == SESSION_LOADING)
+            pthread_cond_wait(&g_session_ready, &g_session_lock);
+        if (version == BLOCK_VERSION_ED25519)
+            pkey = g_session_ed25519;
+        else if (version == BLOCK_VERSION_RSA)
+            pkey = g_session_rsa;
+    }
+    pthread_mutex_unlock(&g_session_lock);
+    return pkey;
+}
+
+void signing_session_end(void) {
+    if (g_session_thread_started) {
+        pthread_join(g_session_thread, NULL);
+        g_session_thread_started = 0;
+    }
+    pthread_mutex_lock(&g_session_lock);
+    EVP_PKEY_free(g_session_rsa);
+    EVP_PKEY_free(g_session_ed25519);
+    g_session_rsa = NULL;
+    g_session_ed25519 = NULL;
+    g_session_state = SESSION_NONE;
+    pthread_mutex_unlock(&g_session_lock);
 }
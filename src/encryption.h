@@ -8,27 +8,100 @@
 #define USERNAME_FILE ".username"
 #endif
 
-// Computes a SHA-256 hash over the input data (a null-terminated string)
-// and writes the hex digest (65 bytes) into output_hash.
-void hash_score(const char *data, char *output_hash);
+#ifndef PUBLIC_KEY_DIR
+#define PUBLIC_KEY_DIR "highscore/public_keys"
+#endif
+
+// Public keys live in PUBLIC_KEY_DIR as <username>_public.pem (legacy RSA,
+// block version 1) and <username>_ed25519.pem (block version 2). An Ed25519
+// key file for a user who also has an RSA key must carry a countersignature
+// made with that RSA key; otherwise the Ed25519 key is rejected.
+
+// Optional bundle of every public key in PUBLIC_KEY_DIR with an index, so the
+// verifier can mmap one file instead of opening one PEM per user.
+#ifndef KEYRING_FILE
+#define KEYRING_FILE "highscore/public_keys.keyring"
+#endif
+
+// Computes a SHA-256 hash over len bytes of data and writes the raw digest
+// (32 bytes) into output_hash.
+void hash_score(const char *data, size_t len, unsigned char *output_hash);
 
-// Generates a new RSA key pair for the given username.
+// Writes len bytes as lowercase hex plus a NUL terminator (2 * len + 1 bytes) into out.
+void hex_encode(const unsigned char *in, size_t len, char *out);
+
+// Decodes exactly 2 * out_len hex digits from hex into out.
+// Returns 1 on success, 0 if hex is too short or holds a non-hex character.
+int hex_decode(const char *hex, unsigned char *out, size_t out_len);
+
+// Generates a new key pair of CURRENT_BLOCK_VERSION's scheme for the given username.
 // The private key is stored in the .username file (private, not pushed),
 // and the public key is stored in the highscore/public_keys directory.
 // Returns 1 on success, 0 on failure.
 int generate_keypair(const char *username);
 
-// Loads the private key associated with the given username from the .username file.
+// Loads the private key that signs blocks of the given version (BLOCK_VERSION_*)
+// from the .username file, which may hold one PEM block per scheme.
 // Returns a pointer to an EVP_PKEY on success, or NULL on failure.
-void* load_private_key(const char *username);
+void* load_private_key(const char *username, int version);
 
-// Loads the public key associated with the given username from highscore/public_keys.
+// Loads username's public key for the given block version from highscore/public_keys.
+// Does not check countersignatures; use get_public_key for verification.
 // Returns a pointer to an EVP_PKEY on success, or NULL on failure.
-void* load_public_key(const char *username);
+void* load_public_key(const char *username, int version);
+
+// Returns username's public key for the given block version from the
+// in-process cache, loading it (from the keyring if present, otherwise from
+// its PEM file) on first use and again whenever the key file has changed.
+// The caller gets its own reference and must release it with EVP_PKEY_free.
+// Returns NULL if no usable public key exists for the user.
+void* get_public_key(const char *username, int version);
+
+// Length in bytes of a public key fingerprint (SHA-256 of the DER encoding).
+#define KEY_FINGERPRINT_LEN 32
+
+// Copies the fingerprint of username's public key for the given block version
+// into fingerprint (KEY_FINGERPRINT_LEN bytes), loading the key through the cache if needed.
+// Returns 1 on success, 0 if the user has no such public key.
+int get_public_key_fingerprint(const char *username, int version, unsigned char *fingerprint);
+
+// Frees every cached public key and unmaps the keyring.
+void clear_public_key_cache(void);
+
+// Writes the path of username's public key file for the given block version
+// into out. Returns 0 if the version is unknown or the path does not fit.
+int public_key_file_path(const char *username, int version, char *out, size_t out_size);
+
+// Writes a public key file received from elsewhere (e.g. a ledger replica)
+// unless one already exists; existing keys are never replaced. The key is
+// checked like any other when it is first used. Returns 1 if written, 0 if
+// the user already has that key file, or -1 on failure.
+int install_public_key(const char *username, int version, const char *pem, size_t len);
+
+// Writes KEYRING_FILE from all .pem files in PUBLIC_KEY_DIR.
+// Returns the number of keys bundled, or -1 on failure.
+int build_keyring(void);
 
 // Ensures a key pair exists for the given username.
 // If not, a new key pair is generated and stored in the proper locations.
+// Users who only have a legacy RSA key get an Ed25519 key added, countersigned
+// by the RSA key, so their old blocks stay verifiable.
 int ensure_keypair(const char *username);
 
+// Starts a signing session for the local player: loads username's private
+// keys from .username once and keeps them for the rest of the run. If keys
+// must be generated or migrated, that runs on a background thread.
+// Returns 0 if no key could be made available.
+int signing_session_begin(const char *username);
+
+// Returns the session's private key for the given block version, waiting for
+// background key generation if it is still running. The key is owned by the
+// session: callers must not free it. Returns NULL if username is not the
+// session user or has no key of that version.
+void* signing_session_key(const char *username, int version);
+
+// Waits for any background key generation and frees the session keys.
+void signing_session_end(void);
+
 #endif // ENCRYPTION_H
 
@@ -31,7 +31,7 @@ void enemy_shoot(Enemy *enemy, BulletPool *pool, float player_x, float player_y)
     DEBUG_PRINT(3, 2, "Enemy SHOOTER fired bullet towards player at angle %.2f", angle);
 }
 
-void split_enemy(Enemy enemies[], int index) {
+void split_enemy(Enemy enemies[], int count, int index) {
     // Only proceed if the enemy is indeed a splitter.
     if (enemies[index].type != ENEMY_SPLITTER)
         return;
@@ -45,7 +45,7 @@ void split_enemy(Enemy enemies[], int index) {
     for (int i = 0; i < 2; i++) {
         int slot = -1;
         // Find an inactive enemy slot.
-        for (int j = 0; j < MAX_ENEMIES; j++) {
+        for (int j = 0; j < count; j++) {
             if (!enemies[j].active) {
                 slot = j;
                 break;
@@ -88,8 +88,8 @@ static void rotate_toward(float *current, float target, float maxDelta) {
 }
 
 // Initialize all enemies and their additional fields.
-void init_enemies(Enemy enemies[]) {
-    for (int i = 0; i < MAX_ENEMIES; i++) {
+void init_enemies(Enemy enemies[], int count) {
+    for (int i = 0; i < count; i++) {
         enemies[i].active = 0;
         enemies[i].timer = 0;
         enemies[i].shootTimer = 0;
@@ -99,12 +99,12 @@ void init_enemies(Enemy enemies[]) {
         // Initialize angle so that by default it faces right (0° means to the right)
         enemies[i].angle = 0.0f;
     }
-    DEBUG_PRINT(2, 3, "Enemies initialized: %d enemies set inactive", MAX_ENEMIES);
+    DEBUG_PRINT(2, 3, "Enemies initialized: %d enemies set inactive", count);
 }
 
 // Update enemies with different behaviors based on type.
-void update_enemies(Enemy enemies[], float player_x, float player_y, float player_angle, float difficulty, BulletPool* pool) {
-    for (int i = 0; i < MAX_ENEMIES; i++) {
+void update_enemies(Enemy enemies[], int count, float player_x, float player_y, float player_angle, float difficulty, BulletPool* pool) {
+    for (int i = 0; i < count; i++) {
         if (!enemies[i].active)
             continue;
 
@@ -432,13 +432,15 @@ void update_enemies(Enemy enemies[], float player_x, float player_y, float playe
         DEBUG_PRINT(3, 2, "Updated enemy (type %d) at (%.2f, %.2f), distance=%.2f",
                     enemies[i].type, enemies[i].x, enemies[i].y, distance);
     } // end for
+}
 
-    // Resolve collisions between all active enemies.
-    for (int i = 0; i < MAX_ENEMIES; i++) {
+// Push apart every pair of active enemies that overlap.
+void resolve_enemy_collisions(Enemy enemies[], int count) {
+    for (int i = 0; i < count; i++) {
         if (!enemies[i].active)
             continue;
         float radius_i = get_collision_radius(enemies[i].type);
-        for (int j = i + 1; j < MAX_ENEMIES; j++) {
+        for (int j = i + 1; j < count; j++) {
             if (!enemies[j].active)
                 continue;
             float radius_j = get_collision_radius(enemies[j].type);
@@ -479,9 +481,9 @@ static void filledRotatedEllipse(SDL_Renderer *renderer, int cx, int cy, int rx,
 }
 
 // Draw enemies with different shapes/colors based on type.
-void draw_enemies(Enemy enemies[], SDL_Renderer* renderer, float cam_x, float cam_y) {
+void draw_enemies(Enemy enemies[], int count, SDL_Renderer* renderer, float cam_x, float cam_y) {
     int drawn = 0;
-    for (int i = 0; i < MAX_ENEMIES; i++) {
+    for (int i = 0; i < count; i++) {
         if (!enemies[i].active)
             continue;
         if (enemies[i].type == ENEMY_STEALTH && !enemies[i].visible)
@@ -572,9 +574,32 @@ void draw_enemies(Enemy enemies[], SDL_Renderer* renderer, float cam_x, float ca
     DEBUG_PRINT(3, 2, "Drawn %d active enemies", drawn);
 }
 
+void place_enemy(Enemy *enemy, EnemyType type, float x, float y) {
+    enemy->x = x;
+    enemy->y = y;
+    enemy->type = type;
+    switch (type) {
+        case ENEMY_BASIC: enemy->health = 3; break;
+        case ENEMY_SHOOTER: enemy->health = 3; enemy->shootTimer = 120; break;
+        case ENEMY_TANK: enemy->health = 10; break;
+        case ENEMY_EVASIVE: enemy->health = 3; break;
+        case ENEMY_FAST: enemy->health = 2; break;
+        case ENEMY_SPLITTER: enemy->health = 3; break;
+        case ENEMY_STEALTH: enemy->health = 3; break;
+        case ENEMY_SHIELD: enemy->health = 3; break;
+        case ENEMY_BOSS1: enemy->health = 25; break;
+        case ENEMY_BOSS2: enemy->health = 50; break;
+        case ENEMY_BOSS3: enemy->health = 75; break;
+        default: enemy->health = 3; break;
+    }
+    enemy->active = 1;
+    enemy->timer = 0;
+    enemy->visible = 1;
+}
+
 // Spawn an enemy with type selected based on the current score.
-void spawn_enemy(Enemy enemies[], float player_x, float player_y, int score) {
-    for (int i = 0; i < MAX_ENEMIES; i++) {
+void spawn_enemy(Enemy enemies[], int count, float player_x, float player_y, int score) {
+    for (int i = 0; i < count; i++) {
         if (!enemies[i].active) {
             float angle = (rand() % 360) * (M_PI / 180.0f);
             float distance = 150 + rand() % 150;  // 150 to 300 units away
@@ -634,23 +659,7 @@ void spawn_enemy(Enemy enemies[], float player_x, float player_y, int score) {
                     
                 }
             }
-            switch (enemies[i].type) {
-                case ENEMY_BASIC: enemies[i].health = 3; break;
-                case ENEMY_SHOOTER: enemies[i].health = 3; enemies[i].shootTimer = 120; break;
-                case ENEMY_TANK: enemies[i].health = 10; break;
-                case ENEMY_EVASIVE: enemies[i].health = 3; break;
-                case ENEMY_FAST: enemies[i].health = 2; break;
-                case ENEMY_SPLITTER: enemies[i].health = 3; break;
-                case ENEMY_STEALTH: enemies[i].health = 3; break;
-                case ENEMY_SHIELD: enemies[i].health = 3; break;
-                case ENEMY_BOSS1: enemies[i].health = 25; break;
-                case ENEMY_BOSS2: enemies[i].health = 50; break;
-                case ENEMY_BOSS3: enemies[i].health = 75; break;
-                default: enemies[i].health = 3; break;
-            }
-            enemies[i].active = 1;
-            enemies[i].timer = 0;
-            enemies[i].visible = 1;
+            place_enemy(&enemies[i], enemies[i].type, enemies[i].x, enemies[i].y);
             DEBUG_PRINT(3, 3, "Spawned enemy type %d at (%.2f, %.2f) with health %d", 
                         enemies[i].type, enemies[i].x, enemies[i].y, enemies[i].health);
             break;
@@ -33,21 +33,30 @@ typedef struct {
     float angle; // field for the enemy to rotate
 } Enemy;
 
+// Every function taking an enemy array works on its first count slots
+// (the game uses MAX_ENEMIES).
+
 // Initializes the enemy array.
-void init_enemies(Enemy enemies[]);
+void init_enemies(Enemy enemies[], int count);
 
 // Updates enemy behavior based on player position and difficulty.
-void update_enemies(Enemy enemies[], float player_x, float player_y, float player_angle, float difficulty, BulletPool* pool);
+void update_enemies(Enemy enemies[], int count, float player_x, float player_y, float player_angle, float difficulty, BulletPool* pool);
+
+// Separates overlapping active enemies; run after update_enemies.
+void resolve_enemy_collisions(Enemy enemies[], int count);
 
 // Draws enemies with different visual styles based on their type.
-void draw_enemies(Enemy enemies[], SDL_Renderer* renderer, float cam_x, float cam_y);
+void draw_enemies(Enemy enemies[], int count, SDL_Renderer* renderer, float cam_x, float cam_y);
+
+// Activates enemy as a fresh enemy of type at (x, y), with that type's health.
+void place_enemy(Enemy *enemy, EnemyType type, float x, float y);
 
 // Spawns an enemy based on the current score.
-void spawn_enemy(Enemy enemies[], float player_x, float player_y, int score);
+void spawn_enemy(Enemy enemies[], int count, float player_x, float player_y, int score);
 
 // Declaration for enemy_shoot, which fires a bullet from a shooter enemy toward the player.
 void enemy_shoot(Enemy *enemy, BulletPool *pool, float player_x, float player_y);
 
-void split_enemy(Enemy enemies[], int index); 
+void split_enemy(Enemy enemies[], int count, int index);
 #endif
 
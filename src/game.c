@@ -6,10 +6,23 @@
 #include "score.h"
 #include "blockchain.h"
 #include "signature.h"
+#include "verify_pool.h"
+#include "checkpoint.h"
+#include "ledgerd.h"
 #include "encryption.h"
 #include "debug.h"
 #include "config.h"
 #include "menus.h"
+#include "dev_ai.h"
+#include "collisions.h"
+#include "profiler.h"
+#include "perf_counters.h"
+#include "memtrack.h"
+#include "telemetry.h"
+#include "perf_overlay.h"
+#include "replay.h"
+#include "scenario.h"
+#include "text.h"
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
@@ -24,238 +37,10 @@
 #include <errno.h>
 
 #define FRAME_DELAY 15   // milliseconds per frame
-#define BLOCKCHAIN_FILE "highscore/blockchain.txt"
-#define DIFFICULTY 4     // PoW difficulty: number of leading zeros required
 
 int shakeTimer = 0;
 float shakeMagnitude = 0.0f;
 
-// Helper function to render text using SDL_ttf.
-void render_text(SDL_Renderer* renderer, TTF_Font* font, int x, int y, const char* text, SDL_Color color) {
-    SDL_Surface* surface = TTF_RenderText_Blended(font, text, color);
-    if (!surface)
-        return;
-    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-    SDL_Rect dst = { x, y, surface->w, surface->h };
-    SDL_RenderCopy(renderer, texture, NULL, &dst);
-    SDL_DestroyTexture(texture);
-    SDL_FreeSurface(surface);
-}
-
-/*
- * dev_ai_control controls the player AI behavior in auto dev mode.
- *
- * Operation Overview:
- *
- * 1. Visibility & Target Selection:
- *    - The camera origin is computed from (player->x - screen_width/2, player->y - screen_height/2).
- *    - For each active enemy, its screen position is computed.
- *      Enemies outside a 50-pixel margin are skipped.
- *    - The closest visible enemy is selected as the target.
- *
- * 2. Enemy Bullet Detection:
- *    - The bullet pool is scanned for active enemy bullets.
- *      Any enemy bullet within BULLET_DANGER_DISTANCE (150 units) adds a repulsion force (scaled by BULLET_REPULSION_FACTOR)
- *      and sets a flag to force bullet-evading behavior.
- *
- * 3. Shield Activation & Evasion:
- *    - The shield is activated if the target is very close (less than SHIELD_DISTANCE) or if an enemy bullet is dangerously close.
- *    - If enemy bullets are dangerously close (enemyBulletTooClose is true), the AI forces the shield and immediately
- *      rotates away from the bullet threat using the computed repulsion vector, applies reverse thrust, and returns.
- *
- * 4. Offensive Engagement:
- *    - If no dangerous bullet is present and a target exists, the desired angle is computed using:
- *         desired_angle = atan2(target->y - player->y, target->x - player->x) * (180/π) + 180
- *      so that when drawn (using (player->angle - 90)) the ship’s tip (model point (0, -size)) points toward the target.
- *    - The AI rotates toward that angle at OFFENSIVE_ROTATION_SPEED.
- *    - If the target is far (distance > SHOOTING_RANGE) and nearly aligned (angle difference < 10°), thrust is applied.
- *      If within range, the ship brakes to stabilize before shooting.
- *    - If aligned within 5° and within range, a bullet is fired from the ship’s tip.
- *
- * Note: CENTER_BONUS is currently logged for potential future use.
- */
-
-void dev_ai_control(Player *player, Enemy enemies[], BulletPool *bulletPool, int screen_width, int screen_height) {
-
-    // AI parameters.
-    const float SHOOTING_RANGE            = 300.0f;
-    const float DANGER_DISTANCE           = 80.0f;
-    const float SHIELD_DISTANCE           = 50.0f;
-    const float BULLET_DANGER_DISTANCE    = 150.0f;  // Increased danger distance for bullets.
-    const float BULLET_REPULSION_FACTOR   = 3.0f;    // Scale factor for bullet repulsion.
-
-    float best_distance = 1e9;
-    Enemy *target = NULL;
-    float repulsion_x = 0.0f, repulsion_y = 0.0f;
-    int enemyBulletTooClose = 0;  // Flag to indicate dangerous enemy bullets.
-
-    // Calculate camera origin.
-    float cam_x = player->x - screen_width / 2.0f;
-    float cam_y = player->y - screen_height / 2.0f;
-
-    // Evaluate all active enemies.
-    for (int i = 0; i < MAX_ENEMIES; i++) {
-        if (!enemies[i].active)
-            continue;
-
-        // Skip stealth enemies that are invisible
-        if (enemies[i].type == ENEMY_STEALTH && !enemies[i].visible)
-            continue;
-
-        float dx = enemies[i].x - player->x;
-        float dy = enemies[i].y - player->y;
-        float distance = sqrtf(dx * dx + dy * dy);
-
-        // Compute enemy's screen position.
-        float enemy_screen_x = enemies[i].x - cam_x;
-        float enemy_screen_y = enemies[i].y - cam_y;
-        if (enemy_screen_x < -50 || enemy_screen_x > screen_width + 50 ||
-            enemy_screen_y < -50 || enemy_screen_y > screen_height + 50) {
-            DEBUG_PRINT(1, 2, "Enemy %d: offscreen (screen pos: %.2f, %.2f), skipped", i, enemy_screen_x, enemy_screen_y);
-            continue;
-        }
-        float center_dx = enemy_screen_x - screen_width / 2.0f;
-        float center_dy = enemy_screen_y - screen_height / 2.0f;
-        float screen_dist = sqrtf(center_dx * center_dx + center_dy * center_dy);
-        DEBUG_PRINT(1, 2, "Enemy %d: distance=%.2f, screen pos=(%.2f, %.2f), center_dist=%.2f", i, distance, enemy_screen_x, enemy_screen_y, screen_dist);
-
-        if (distance < best_distance) {
-            best_distance = distance;
-            target = &enemies[i];
-            DEBUG_PRINT(1, 2, "New target selected: enemy %d, distance=%.2f", i, distance);
-        }
-        if (distance < DANGER_DISTANCE) {
-            repulsion_x -= (dx / distance) * (DANGER_DISTANCE - distance);
-            repulsion_y -= (dy / distance) * (DANGER_DISTANCE - distance);
-            DEBUG_PRINT(1, 2, "Enemy %d: repulsion added (%.2f, %.2f)", i, repulsion_x, repulsion_y);
-        }
-    }
-
-    // Evaluate enemy bullets.
-    for (int i = 0; i < bulletPool->count; i++) {
-        if (bulletPool->bullets[i].active && bulletPool->bullets[i].isEnemy == 1) {
-            float bx = bulletPool->bullets[i].x - player->x;
-            float by = bulletPool->bullets[i].y - player->y;
-            float bdist = sqrtf(bx * bx + by * by);
-            DEBUG_PRINT(1, 2, "Enemy bullet %d: bdist=%.2f", i, bdist);
-            if (bdist < BULLET_DANGER_DISTANCE) {
-                enemyBulletTooClose = 1;
-                repulsion_x -= (bx / bdist) * (BULLET_DANGER_DISTANCE - bdist) * BULLET_REPULSION_FACTOR;
-                repulsion_y -= (by / bdist) * (BULLET_DANGER_DISTANCE - bdist) * BULLET_REPULSION_FACTOR;
-                DEBUG_PRINT(1, 2, "Enemy bullet %d: repulsion added (%.2f, %.2f)", i, repulsion_x, repulsion_y);
-            }
-        }
-    }
-    if (enemyBulletTooClose) {
-        DEBUG_PRINT(1, 3, "Enemy bullets are dangerously close; forcing shield activation and bullet evasion.");
-        activate_shield(player, 1);
-        // Evasion for bullets takes precedence: rotate away from bullet threat.
-        float flee_angle = atan2f(repulsion_y, repulsion_x) * (180.0f / M_PI) + 90.0f;
-        float angle_adjust = flee_angle - player->angle;
-        while (angle_adjust > 180.0f) angle_adjust -= 360.0f;
-        while (angle_adjust < -180.0f) angle_adjust += 360.0f;
-        DEBUG_PRINT(1, 2, "Bullet Evasion: flee_angle=%.2f, angle_adjust=%.2f", flee_angle, angle_adjust);
-        if (fabs(angle_adjust) < AI_EVASION_ROTATION_SPEED)
-            player->angle = flee_angle;
-        else if (angle_adjust > 0)
-            player->angle += AI_EVASION_ROTATION_SPEED;
-        else
-            player->angle -= AI_EVASION_ROTATION_SPEED;
-        DEBUG_PRINT(1, 3, "Bullet Evasion: new angle=%.2f", player->angle);
-        reverse_thrust(player);
-        DEBUG_PRINT(1, 3, "Bullet Evasion: applying reverse thrust");
-        return; // Do not continue offensive behavior while bullets are too close.
-    }
-
-    // Shield activation based on enemy target (if no dangerous bullets).
-    if (target != NULL) {
-        float dx = target->x - player->x;
-        float dy = target->y - player->y;
-        float dist = sqrtf(dx * dx + dy * dy);
-        DEBUG_PRINT(1, 2, "Target distance for shield check: %.2f", dist);
-        if (dist < SHIELD_DISTANCE) {
-            activate_shield(player, 1);
-            DEBUG_PRINT(1, 3, "Shield activated (target distance %.2f < %.2f)", dist, SHIELD_DISTANCE);
-            float tip_x, tip_y;
-            get_ship_tip(player, &tip_x, &tip_y);
-            shoot_bullet(bulletPool, tip_x, tip_y, player->angle, 0);
-        } else {
-            activate_shield(player, 0);
-            DEBUG_PRINT(1, 3, "Shield deactivated (target distance %.2f >= %.2f)", dist, SHIELD_DISTANCE);
-        }
-    } else {
-        activate_shield(player, 0);
-        DEBUG_PRINT(1, 3, "No target found; shield deactivated");
-    }
-    
-    // Evasion from enemy repulsion (if any remains after bullet evasion).
-    if (fabs(repulsion_x) > 0.01f || fabs(repulsion_y) > 0.01f) {
-        float flee_angle = atan2f(repulsion_y, repulsion_x) * (180.0f / M_PI) + 90.0f;
-        float angle_adjust = flee_angle - player->angle;
-        while (angle_adjust > 180.0f) angle_adjust -= 360.0f;
-        while (angle_adjust < -180.0f) angle_adjust += 360.0f;
-        DEBUG_PRINT(1, 2, "Evasion (enemies): flee_angle=%.2f, angle_adjust=%.2f", flee_angle, angle_adjust);
-        if (fabs(angle_adjust) < AI_EVASION_ROTATION_SPEED)
-            player->angle = flee_angle;
-        else if (angle_adjust > 0)
-            player->angle += AI_EVASION_ROTATION_SPEED;
-        else
-            player->angle -= AI_EVASION_ROTATION_SPEED;
-        DEBUG_PRINT(1, 3, "Evasion (enemies): new angle=%.2f", player->angle);
-        reverse_thrust(player);
-        DEBUG_PRINT(1, 3, "Evasion (enemies): applying reverse thrust");
-        return; // Evasion takes precedence.
-    }
-    
-    // Offensive engagement.
-    if (target != NULL) {
-        float desired_angle = atan2f(target->y - player->y, target->x - player->x) * (180.0f / M_PI) + 180.0f;
-        float angle_adjust = desired_angle - player->angle;
-        while (angle_adjust > 180.0f) angle_adjust -= 360.0f;
-        while (angle_adjust < -180.0f) angle_adjust += 360.0f;
-        DEBUG_PRINT(1, 2, "Offense: desired_angle=%.2f, angle_adjust=%.2f", desired_angle, angle_adjust);
-        if (fabs(angle_adjust) < AI_OFFENSIVE_ROTATION_SPEED)
-            player->angle = desired_angle;
-        else if (angle_adjust > 0)
-            player->angle += AI_OFFENSIVE_ROTATION_SPEED;
-        else
-            player->angle -= AI_OFFENSIVE_ROTATION_SPEED;
-        DEBUG_PRINT(1, 3, "Offense: new angle=%.2f", player->angle);
-    
-        float dx = target->x - player->x;
-        float dy = target->y - player->y;
-        float distance = sqrtf(dx * dx + dy * dy);
-        DEBUG_PRINT(1, 2, "Offense: distance to target = %.2f", distance);
-        
-        if (distance > SHOOTING_RANGE) {
-            if (fabs(angle_adjust) < 10.0f) {
-                thrust_player(player);
-                DEBUG_PRINT(1, 3, "Offense: enemy far and aligned, applying thrust to approach");
-            } else {
-                DEBUG_PRINT(1, 3, "Offense: enemy far but not aligned (angle_adjust=%.2f), no thrust", angle_adjust);
-            }
-        } else {
-            player->vx *= 0.8f;
-            player->vy *= 0.8f;
-            DEBUG_PRINT(1, 3, "Offense: enemy within shooting range, braking to stabilize");
-            float tip_x, tip_y;
-            get_ship_tip(player, &tip_x, &tip_y);
-            shoot_bullet(bulletPool, tip_x, tip_y, player->angle, 0);
-        }
-    
-        if (fabs(angle_adjust) < 5.0f && distance <= SHOOTING_RANGE) {
-            float tip_x, tip_y;
-            get_ship_tip(player, &tip_x, &tip_y);
-            shoot_bullet(bulletPool, tip_x, tip_y, player->angle, 0);
-            DEBUG_PRINT(1, 3, "Offense: aligned (angle_adjust=%.2f) and within range, shooting", angle_adjust);
-        } else {
-            DEBUG_PRINT(1, 2, "Offense: not shooting (angle_adjust=%.2f, distance=%.2f)", angle_adjust, distance);
-        }
-    } else {
-        DEBUG_PRINT(1, 3, "No target detected: remaining stationary");
-    }
-}
-
 // Prompt the user for a username via the SDL window.
 // If Esc is pressed, the input immediately becomes "default".
 char* prompt_username(SDL_Renderer* renderer, TTF_Font* font, int screen_width, int screen_height) {
@@ -298,11 +83,12 @@ char* prompt_username(SDL_Renderer* renderer, TTF_Font* font, int screen_width,
     
     SDL_StopTextInput();
     DEBUG_PRINT(3, 2, "Username entered: %s", input);
-    return strdup(input);
+    return mem_strdup(MEM_USER, input);
 }
 
 // Reads the blockchain file and returns the top score for the given username.
 // If found, copies that block into topBlock (if not NULL) and returns its score; otherwise, returns -1.
+// The user's blocks are collected first and their signatures verified in parallel.
 int get_user_top_score(const char *username, ScoreBlock *topBlock) {
     FILE *fp = fopen(BLOCKCHAIN_FILE, "r");
     if (!fp) {
@@ -310,80 +96,203 @@ int get_user_top_score(const char *username, ScoreBlock *topBlock) {
         return -1;
     }
     char line[2048];
+    ScoreBlock *blocks = NULL;
+    int count = 0, capacity = 0, index = 0;
     int topScore = -1;
     ScoreBlock temp;
-    char prev_hash_buf[129] = {0};
     while (fgets(line, sizeof(line), fp)) {
-        int ret = sscanf(line,
-            "{\"username\":\"%49[^\"]\", \"score\":%d, \"timestamp\":%ld, \"proof_of_work\":\"%64[^\"]\", \"signature\":\"%512[^\"]\", \"prev_hash\":\"%128[^\"]\", \"nonce\":%u}",
-            temp.username, &temp.score, &temp.timestamp, temp.proof_of_work, temp.signature, prev_hash_buf, &temp.nonce);
-        if (ret == 7 && strcmp(temp.username, username) == 0) {
-            prev_hash_buf[64] = '\0';
-            strcpy(temp.prev_hash, prev_hash_buf);
-            if (verify_score_signature(&temp, username, temp.signature)) {
-                if (temp.score > topScore) {
-                    topScore = temp.score;
-                    if (topBlock)
-                        *topBlock = temp;
-                }
-            } else {
-                DEBUG_PRINT(2, 0, "Invalid signature for user %s in blockchain record", username);
+        if (!parse_score_block(line, &temp))
+            continue;
+        int status = checkpoint_block_status(index++);
+        if (strcmp(temp.username, username) != 0 || status == 0)
+            continue;
+        // Covered by a trusted checkpoint: no need to check the signature again.
+        if (status == 1) {
+            if (temp.score > topScore) {
+                topScore = temp.score;
+                if (topBlock)
+                    *topBlock = temp;
             }
+            continue;
         }
+        if (count == capacity) {
+            int new_capacity = capacity ? capacity * 2 : 64;
+            ScoreBlock *grown = mem_realloc(MEM_LEDGER, blocks, new_capacity * sizeof(ScoreBlock));
+            if (!grown) {
+                DEBUG_PRINT(2, 0, "Out of memory collecting blocks for user %s", username);
+                break;
+            }
+            blocks = grown;
+            capacity = new_capacity;
+        }
+        blocks[count++] = temp;
     }
     fclose(fp);
+
+    unsigned char *valid = count ? mem_alloc(MEM_LEDGER, count) : NULL;
+    if (valid) {
+        verify_blocks_parallel(blocks, count, valid);
+        for (int i = 0; i < count; i++) {
+            if (!valid[i]) {
+                DEBUG_PRINT(2, 0, "Invalid signature for user %s in blockchain record", username);
+                continue;
+            }
+            if (blocks[i].score > topScore) {
+                topScore = blocks[i].score;
+                if (topBlock)
+                    *topBlock = blocks[i];
+            }
+        }
+    }
+    mem_free(valid);
+    mem_free(blocks);
     DEBUG_PRINT(2, 2, "Top score for user %s: %d", username, topScore);
     return topScore;
 }
 
-void game_loop() {
+// Creates the window, renderer and HUD font. A fullscreen window takes the
+// desktop's size, which is stored in screen_width/screen_height. Returns 0
+// (with everything released again) on failure.
+static int open_game_window(SDL_Window **win, SDL_Renderer **renderer, TTF_Font **font,
+                            int *screen_width, int *screen_height, int fullscreen) {
     Uint32 windowFlags = SDL_WINDOW_SHOWN; // | SDL_WINDOW_RESIZABLE;
-    if (g_fullscreen) {
+    if (fullscreen) {
         windowFlags |= SDL_WINDOW_FULLSCREEN_DESKTOP;
     }
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
         DEBUG_PRINT(1, 0, "SDL_Init Error: %s", SDL_GetError());
-        return;
+        return 0;
     }
     if (TTF_Init() != 0) {
         DEBUG_PRINT(1, 0, "TTF_Init Error: %s", TTF_GetError());
         SDL_Quit();
-        return;
+        return 0;
     }
 
-    int screen_width = 800, screen_height = 600;
-    SDL_Window* win = SDL_CreateWindow("QuantumStriker", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, screen_width, screen_height, windowFlags);
-    if (!win) {
+    *win = SDL_CreateWindow("QuantumStriker", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, *screen_width, *screen_height, windowFlags);
+    if (!*win) {
         DEBUG_PRINT(1, 0, "SDL_CreateWindow Error: %s", SDL_GetError());
         TTF_Quit();
         SDL_Quit();
-        return;
+        return 0;
     }
 
-    if (g_fullscreen) {
+    if (fullscreen) {
         SDL_DisplayMode mode;
         if (SDL_GetCurrentDisplayMode(0, &mode) == 0) {
-            screen_width = mode.w;
-            screen_height = mode.h;
+            *screen_width = mode.w;
+            *screen_height = mode.h;
         }
     }
     
-    SDL_Renderer* renderer = SDL_CreateRenderer(win, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-    if (!renderer) {
+    *renderer = SDL_CreateRenderer(*win, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    if (!*renderer) {
         DEBUG_PRINT(1, 0, "SDL_CreateRenderer Error: %s", SDL_GetError());
-        SDL_DestroyWindow(win);
+        SDL_DestroyWindow(*win);
         TTF_Quit();
         SDL_Quit();
-        return;
+        return 0;
     }
     
-    TTF_Font* font = TTF_OpenFont("src/Arial.ttf", 16);
-    if (!font) {
+    *font = TTF_OpenFont("src/Arial.ttf", 16);
+    if (!*font) {
         DEBUG_PRINT(1, 0, "TTF_OpenFont Error: %s", TTF_GetError());
-        SDL_DestroyRenderer(renderer);
-        SDL_DestroyWindow(win);
+        SDL_DestroyRenderer(*renderer);
+        SDL_DestroyWindow(*win);
         TTF_Quit();
         SDL_Quit();
+        return 0;
+    }
+    return 1;
+}
+
+static void close_game_window(SDL_Window *win, SDL_Renderer *renderer, TTF_Font *font) {
+    free_text_atlas();
+    TTF_CloseFont(font);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(win);
+    TTF_Quit();
+    SDL_Quit();
+}
+
+// Publishes the state at the end of a frame for --telemetry.
+static void publish_telemetry(int frame, uint64_t *last_ns, const Player *player, int score, int kills,
+                              const BulletPool *pool, int active_enemies, int enemy_count,
+                              int enemy_high_water, long frame_allocations) {
+    TelemetryFrame t;
+    memset(&t, 0, sizeof(t));
+    t.frame = (uint64_t)frame;
+    t.time_ns = profiler_now_ns();
+    t.frame_ms = *last_ns ? (float)((t.time_ns - *last_ns) / 1e6) : 0.0f;
+    *last_ns = t.time_ns;
+    t.profiling = g_profiler_enabled;
+    for (int s = 0; g_profiler_enabled && s < PROF_STAGE_COUNT && s < TELEMETRY_STAGES; s++)
+        t.stage_ms[s] = profiler_frame_ms(s, 0);
+    t.state = TELEMETRY_RUNNING;
+    t.score = score;
+    t.kills = kills;
+    t.health = player->health;
+    for (int i = 0; i < pool->count; i++)
+        t.live_bullets += pool->bullets[i].active != 0;
+    t.bullet_capacity = pool->count;
+    t.bullet_high_water = pool->high_water;
+    t.active_enemies = active_enemies;
+    t.enemy_capacity = enemy_count;
+    t.enemy_high_water = enemy_high_water;
+    t.frame_allocations = frame_allocations;
+    MemStats heap;
+    mem_stats(MEM_TAG_COUNT, &heap);
+    t.heap_bytes = heap.current_bytes;
+    t.heap_peak_bytes = heap.peak_bytes;
+    telemetry_publish(&t);
+}
+
+// Prints how a --replay went and whether it reproduced the recorded session.
+static void report_replay(int frames, int score, int kills, uint64_t start_ns) {
+    double seconds = (profiler_now_ns() - start_ns) / 1e9;
+    printf("Replayed %d frame(s) in %.2f s (%.1f frames/s): score %d, %d enemies killed\n",
+           frames, seconds, seconds > 0 ? frames / seconds : 0.0, score, kills);
+    ReplayFrame rest;
+    while (replay_read_frame(&rest))
+        ;
+    int recorded_score, recorded_kills, recorded_frames;
+    if (!replay_recorded_result(&recorded_score, &recorded_kills, &recorded_frames))
+        printf("The recording has no final result to compare with (it was cut short)\n");
+    else if (recorded_score == score && recorded_kills == kills && recorded_frames == frames)
+        printf("The replay matches the recording\n");
+    else
+        printf("The replay diverged: the recording ended after %d frame(s) with score %d, %d enemies killed\n",
+               recorded_frames, recorded_score, recorded_kills);
+}
+
+void game_loop() {
+    // A replay takes the settings the session was recorded with.
+    ReplayHeader replay = {0};
+    int replaying = g_replay_path != NULL;
+    if (replaying) {
+        if (!replay_open(g_replay_path, &replay))
+            return;
+        g_dev_auto_mode = replay.dev_auto_mode;
+        g_forced_enemy_type = replay.forced_enemy_type;
+    }
+    // A scenario scripts the world; its sessions are not scored.
+    Scenario scenario = {0};
+    int scripted = g_scenario_path != NULL;
+    if (scripted && !scenario_load(g_scenario_path, FRAME_DELAY, &scenario)) {
+        replay_close();
+        return;
+    }
+    int headless = (replaying || scripted) && g_headless;
+
+    int screen_width = replaying ? replay.screen_width : 800;
+    int screen_height = replaying ? replay.screen_height : 600;
+    SDL_Window* win = NULL;
+    SDL_Renderer* renderer = NULL;
+    TTF_Font* font = NULL;
+    if (!headless &&
+        !open_game_window(&win, &renderer, &font, &screen_width, &screen_height, g_fullscreen && !replaying)) {
+        replay_close();
+        scenario_free(&scenario);
         return;
     }
 
@@ -392,33 +301,37 @@ void game_loop() {
         explosions[k].lifetime = 0;
     }
 
-    // Get or prompt username.
-    char *orig_username = load_username();
-    if (!orig_username) {
-        orig_username = prompt_username(renderer, font, screen_width, screen_height);
-        if (!orig_username)
-            orig_username = strdup("default");
-        save_username(orig_username);
-    }
-    if (!ensure_keypair(orig_username)) {
-        DEBUG_PRINT(2, 0, "Key pair generation failed for user %s", orig_username);
-    }
-    DEBUG_PRINT(2, 3, "Starting game with username: %s", orig_username);
-
     char *username = NULL;
-    if (g_dev_auto_mode) {
-        // Append "DevAI" 
-        username = malloc(strlen(orig_username) + 6); // "DevAi" (5) + '\0' (1)
-        if (username) {
-            strcpy(username, orig_username);
-            strcat(username, "DevAI");
+    if (!replaying && !scripted) {
+        // Get or prompt username.
+        char *orig_username = load_username();
+        if (!orig_username) {
+            orig_username = prompt_username(renderer, font, screen_width, screen_height);
+            if (!orig_username)
+                orig_username = mem_strdup(MEM_USER, "default");
+            save_username(orig_username);
+        }
+        // Load the signing key now (generating it in the background if needed)
+        // so sealing the score at game over is just the signature.
+        if (!signing_session_begin(orig_username)) {
+            DEBUG_PRINT(2, 0, "Key pair generation failed for user %s", orig_username);
+        }
+        DEBUG_PRINT(2, 3, "Starting game with username: %s", orig_username);
+
+        if (g_dev_auto_mode) {
+            // Append "DevAI" 
+            username = mem_alloc(MEM_USER, strlen(orig_username) + 6); // "DevAi" (5) + '\0' (1)
+            if (username) {
+                strcpy(username, orig_username);
+                strcat(username, "DevAI");
+            } else {
+                username = mem_strdup(MEM_USER, orig_username);
+            }
+            mem_free(orig_username);
         } else {
-            username = strdup(orig_username);
+            // not in dev auto mode. DONT DEREFERENCE A NULL POINTER
+            username = orig_username;
         }
-        free(orig_username);
-    } else {
-        // not in dev auto mode. DONT DEREFERENCE A NULL POINTER
-        username = orig_username;
     }
 
     // Initialize game objects.
@@ -430,12 +343,26 @@ void game_loop() {
         DEBUG_PRINT(1, 3, "AI energy overridden to %f", player.energy);
         DEBUG_PRINT(1, 3, "AI health overridden to %d", player.health);
     }
+    if (scenario.player_health > 0)
+        player.health = scenario.player_health;
 
     BulletPool bulletPool;
     init_bullet_pool(&bulletPool);
     
-    Enemy enemies[MAX_ENEMIES];
-    init_enemies(enemies);
+    int enemy_count = scripted ? scenario.enemy_capacity : MAX_ENEMIES;
+    Enemy *enemies = mem_alloc(MEM_ENEMIES, enemy_count * sizeof(Enemy));
+    if (!enemies) {
+        DEBUG_PRINT(0, 0, "Cannot allocate %d enemies", enemy_count);
+        free_bullet_pool(&bulletPool);
+        if (!headless)
+            close_game_window(win, renderer, font);
+        replay_close();
+        scenario_free(&scenario);
+        signing_session_end();
+        mem_free(username);
+        return;
+    }
+    init_enemies(enemies, enemy_count);
     
     int enemiesKilled = 0;
     int score = 0;
@@ -443,6 +370,12 @@ void game_loop() {
     int spawnTimer = 0;
     int frame = 0;
     int running = 1;
+    int show_overlay = 0;
+    int profile_requested = g_profiler_enabled;  // --profile keeps it on without the overlay
+    int visible_background = 0;
+    long frame_allocations = 0;  // heap allocations this thread made in the last frame
+    int allocating_frames = 0, last_allocating_frame = 0;
+    int enemy_high_water = 0;
     SDL_Event e;
     
     // Ensure highscore directory exists.
@@ -454,182 +387,217 @@ void game_loop() {
             DEBUG_PRINT(2, 3, "Highscore directory created");
     }
     
-    srand((unsigned int)time(NULL));
+    unsigned int seed = replaying ? replay.seed : scenario.has_seed ? scenario.seed : (unsigned int)time(NULL);
+    srand(seed);
+    int recording = 0;
+    if (g_record_path) {
+        ReplayHeader header = { seed, screen_width, screen_height, g_dev_auto_mode, g_forced_enemy_type };
+        recording = replay_record_open(g_record_path, &header);
+    }
+    uint64_t replay_start_ns = profiler_now_ns();
+    int telemetry = 0;
+    uint64_t telemetry_ns = 0;
+    if (g_telemetry_name) {
+        const char *stage_names[PROF_STAGE_COUNT];
+        for (int s = 0; s < PROF_STAGE_COUNT; s++)
+            stage_names[s] = profiler_stage_name(s);
+        telemetry = telemetry_open(g_telemetry_name, stage_names, PROF_STAGE_COUNT);
+    }
     
     // Main game loop.
     while (running) {
+        // Everything the simulation reads from outside this frame: keys,
+        // events and the score clock.
+        ReplayFrame input = {0};
+        long allocations_at_start = mem_thread_allocations();
+        if (replaying && (g_exit_requested || !replay_read_frame(&input)))
+            break;
         frame++;
         spawnTimer++;
+        if (g_counters_enabled) {
+            long live = 0;
+            for (int i = 0; i < bulletPool.count; i++)
+                live += bulletPool.bullets[i].active != 0;
+            for (int j = 0; j < enemy_count; j++)
+                live += enemies[j].active != 0;
+            profiler_set_entities(live);
+        }
+        if (replaying ? (input.events & REPLAY_EVENT_INTERRUPT) : g_exit_requested) {
+            player.health = 0;
+            input.events |= REPLAY_EVENT_INTERRUPT;
+        }
         
-        const Uint8 *keystate = SDL_GetKeyboardState(NULL);
-        float speedMultiplier = (keystate[SDL_SCANCODE_LCTRL] || keystate[SDL_SCANCODE_RCTRL]) ? 2.0f : 1.0f;
+        PROFILE_STAGE(PROF_INPUT) {
+            if (!replaying && !headless)
+                input.keys = replay_keys_from_state(SDL_GetKeyboardState(NULL));
+            float speedMultiplier = (input.keys & (REPLAY_KEY_LCTRL | REPLAY_KEY_RCTRL)) ? 2.0f : 1.0f;
         
-        // Player controls:
-        if (!g_dev_auto_mode) {
-            if (keystate[SDL_SCANCODE_LEFT])
-                rotate_player(&player, -2 * speedMultiplier);
-            if (keystate[SDL_SCANCODE_RIGHT])
-                rotate_player(&player, 2 * speedMultiplier);
-            // Ship sizing keys:
-            if (keystate[SDL_SCANCODE_DOWN])
-                decrease_ship_size(&player);
-            if (keystate[SDL_SCANCODE_UP])
-                increase_ship_size(&player);
-            if (keystate[SDL_SCANCODE_RSHIFT])
-                reset_ship_size(&player);
-            if (keystate[SDL_SCANCODE_W])
-                thrust_player(&player);
-            if (keystate[SDL_SCANCODE_S])
-                reverse_thrust(&player);
-            if (keystate[SDL_SCANCODE_A])
-                strafe_left(&player);
-            if (keystate[SDL_SCANCODE_D])
-                strafe_right(&player);
-            if (keystate[SDL_SCANCODE_SPACE]) {
-                float tip_x, tip_y;
-                get_ship_tip(&player, &tip_x, &tip_y);
-                shoot_bullet(&bulletPool, tip_x, tip_y, player.angle, 0); // 0: player's bullet
+            // Player controls:
+            if (!g_dev_auto_mode) {
+                if (input.keys & REPLAY_KEY_LEFT)
+                    rotate_player(&player, -2 * speedMultiplier);
+                if (input.keys & REPLAY_KEY_RIGHT)
+                    rotate_player(&player, 2 * speedMultiplier);
+                // Ship sizing keys:
+                if (input.keys & REPLAY_KEY_DOWN)
+                    decrease_ship_size(&player);
+                if (input.keys & REPLAY_KEY_UP)
+                    increase_ship_size(&player);
+                if (input.keys & REPLAY_KEY_RSHIFT)
+                    reset_ship_size(&player);
+                if (input.keys & REPLAY_KEY_W)
+                    thrust_player(&player);
+                if (input.keys & REPLAY_KEY_S)
+                    reverse_thrust(&player);
+                if (input.keys & REPLAY_KEY_A)
+                    strafe_left(&player);
+                if (input.keys & REPLAY_KEY_D)
+                    strafe_right(&player);
+                if (input.keys & REPLAY_KEY_SPACE) {
+                    float tip_x, tip_y;
+                    get_ship_tip(&player, &tip_x, &tip_y);
+                    shoot_bullet(&bulletPool, tip_x, tip_y, player.angle, 0); // 0: player's bullet
+                }
+                if (input.keys & REPLAY_KEY_E)
+                    activate_shield(&player, 1);
+                else
+                    activate_shield(&player, 0);
+            } else {
+                // In dev auto mode 
+                DEBUG_PRINT(2, 2, "Entering dev_ai_control (screen %dx%d)", screen_width, screen_height);
+                dev_ai_control(&player, enemies, enemy_count, &bulletPool, screen_width, screen_height);
             }
-            if (keystate[SDL_SCANCODE_E])
-                activate_shield(&player, 1);
-            else
-                activate_shield(&player, 0);
-        } else {
-            // In dev auto mode 
-            DEBUG_PRINT(2, 2, "Entering dev_ai_control (screen %dx%d)", screen_width, screen_height);
-            dev_ai_control(&player, enemies, &bulletPool, screen_width, screen_height);
         }
         
-        while (SDL_PollEvent(&e)) {
-            if (e.type == SDL_QUIT)
+        PROFILE_STAGE(PROF_EVENTS) {
+            if (input.events & REPLAY_EVENT_QUIT)
                 running = 0;
-            else if (e.type == SDL_KEYDOWN &&
-                     (e.key.keysym.sym == SDLK_ESCAPE || e.key.keysym.sym == SDLK_q)) {
-                // Call pause menu.
-                extern int pause_menu(SDL_Renderer*, TTF_Font*, int, int);
-                int resume = pause_menu(renderer, font, screen_width, screen_height);
-                if (!resume) {
-                    player.health = 0;
-                    DEBUG_PRINT(2, 0, "Quit selected from apuse menu. Game ended");
-                } else {
-                    DEBUG_PRINT(2, 3, "Resume selected from pause menu");
+            if (input.events & REPLAY_EVENT_PAUSE_QUIT)
+                player.health = 0;
+            while (!headless && SDL_PollEvent(&e)) {
+                if (e.type == SDL_QUIT) {
+                    running = 0;
+                    input.events |= REPLAY_EVENT_QUIT;
+                } else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F3) {
+                    show_overlay = !show_overlay;
+                    g_profiler_enabled = show_overlay || profile_requested;
+                } else if (!replaying && e.type == SDL_KEYDOWN &&
+                         (e.key.keysym.sym == SDLK_ESCAPE || e.key.keysym.sym == SDLK_q)) {
+                    // Call pause menu.
+                    extern int pause_menu(SDL_Renderer*, TTF_Font*, int, int);
+                    int resume = pause_menu(renderer, font, screen_width, screen_height);
+                    if (!resume) {
+                        player.health = 0;
+                        input.events |= REPLAY_EVENT_PAUSE_QUIT;
+                        DEBUG_PRINT(2, 0, "Quit selected from apuse menu. Game ended");
+                    } else {
+                        input.events |= REPLAY_EVENT_PAUSE;
+                        DEBUG_PRINT(2, 3, "Resume selected from pause menu");
+                    }
                 }
             }
         }
         
         // Update game objects.
-        update_player(&player);
-        wrap_player_position(&player);
-        update_shield_energy(&player);
-        update_bullets(&bulletPool);
-        
-        float baseRate = 0.5f;
-        float rateIncrease = score / 500.0f;
-        float desiredSpawnRate = baseRate + rateIncrease;
-        if (g_dev_auto_mode) {
-            desiredSpawnRate *= AI_PROGRESS_MULTIPLIER;
+        PROFILE_STAGE(PROF_UPDATE_PLAYER) {
+            update_player(&player);
+            wrap_player_position(&player);
+            update_shield_energy(&player);
+            update_bullets(&bulletPool);
         }
-        if (desiredSpawnRate > 15.0f)
-            desiredSpawnRate = 15.0f;
-        float spawnIntervalSeconds = 1.0f / desiredSpawnRate;
-        int spawnIntervalFrames = (int)(spawnIntervalSeconds / (FRAME_DELAY / 1000.0f));
         
-        // Spawn enemy based on current score.
-        if (spawnTimer > spawnIntervalFrames) {
-            spawn_enemy(enemies, player.x, player.y, score);
-            spawnTimer = 0;
-            DEBUG_PRINT(3, 2, "Enemy spawned; spawnTimer reset");
+        PROFILE_STAGE(PROF_SPAWN) {
+            float baseRate = 0.5f;
+            float rateIncrease = score / 500.0f;
+            float desiredSpawnRate = baseRate + rateIncrease;
+            if (g_dev_auto_mode) {
+                desiredSpawnRate *= AI_PROGRESS_MULTIPLIER;
+            }
+            if (desiredSpawnRate > 15.0f)
+                desiredSpawnRate = 15.0f;
+            float spawnIntervalSeconds = 1.0f / desiredSpawnRate;
+            int spawnIntervalFrames = (int)(spawnIntervalSeconds / (FRAME_DELAY / 1000.0f));
+        
+            if (scripted)
+                scenario_apply(&scenario, frame, player.x, player.y, enemies, enemy_count, &bulletPool);
+        
+            // Spawn enemy based on current score.
+            if ((!scripted || scenario.natural_spawns) && spawnTimer > spawnIntervalFrames) {
+                spawn_enemy(enemies, enemy_count, player.x, player.y, score);
+                spawnTimer = 0;
+                DEBUG_PRINT(3, 2, "Enemy spawned; spawnTimer reset");
+            }
         }
         
         float diffScale = 1.0f + (((score > 5000 ? 5000 : score) / 1000.0f)) * (g_dev_auto_mode ? AI_PROGRESS_MULTIPLIER : 1.0f);
-        update_enemies(enemies, player.x, player.y, player.angle, diffScale, &bulletPool);
+        PROFILE_STAGE(PROF_UPDATE_ENEMIES) {
+            update_enemies(enemies, enemy_count, player.x, player.y, player.angle, diffScale, &bulletPool);
+            resolve_enemy_collisions(enemies, enemy_count);
+        }
         
         // Process collisions between player's bullets and enemies.
-        for (int i = 0; i < bulletPool.count; i++) {
-            if (bulletPool.bullets[i].active && bulletPool.bullets[i].isEnemy == 0) {
-                for (int j = 0; j < MAX_ENEMIES; j++) {
-                    if (enemies[j].active) {
-                        float dx = bulletPool.bullets[i].x - enemies[j].x;
-                        float dy = bulletPool.bullets[i].y - enemies[j].y;
-                        float dist = sqrtf(dx * dx + dy * dy);
-                        if (dist < COLLISIONTHRESHOLD) {
-                            if (!(g_dev_auto_mode && AI_PIERCING_SHOT)) {
-                                bulletPool.bullets[i].active = 0;
-                            }
-                            //enemies[j].health -= bulletPool.bullets[i].damage;
-                            //DEBUG_PRINT(3, 2, "Player bullet hit enemy %d; new health = %d", j, enemies[j].health);
-                            if (enemies[j].type == ENEMY_SHIELD && enemies[j].shieldActive) {
-                                DEBUG_PRINT(3, 2, "Shielded enemy %d hit: no damage taken.", j);
-                                bulletPool.bullets[i].active = 0;
-                            } else {
-                                enemies[j].health -= bulletPool.bullets[i].damage;
-                                DEBUG_PRINT(3, 2, "Player bullet hit enemy %d; new health = %d", j, enemies[j].health);
-                            }
-                            if (enemies[j].health <= 0) {
-                                for (int k = 0; k < MAX_EXPLOSIONS; k++) {
-                                    if (explosions[k].lifetime <= 0) {
-                                        explosions[k].x = enemies[j].x;
-                                        explosions[k].y = enemies[j].y;
-                                        explosions[k].radius = 5.0f;
-                                        explosions[k].lifetime = 30; // lasts 30 frames
-                                        if (enemies[j].type == ENEMY_SPLITTER) {
-                                            split_enemy(enemies, j);
-                                        }
-                                        break;
-                                    }
-                                }
-                                enemies[j].active = 0;
-                                enemiesKilled++;
-                                DEBUG_PRINT(3, 3, "Enemy %d destroyed; total enemies killed = %d", j, enemiesKilled);
-                            }
-                        }
-                    }
-                }
-            }
-        }
+        PROFILE_STAGE(PROF_HIT_ENEMIES)
+            enemiesKilled += hit_enemies(&bulletPool, enemies, enemy_count, explosions);
         
         // Process collisions between enemy bullets and the player.
-        for (int i = 0; i < bulletPool.count; i++) {
-            if (bulletPool.bullets[i].active && bulletPool.bullets[i].isEnemy == 1) {
-                float dx = bulletPool.bullets[i].x - player.x;
-                float dy = bulletPool.bullets[i].y - player.y;
-                float dist = sqrtf(dx * dx + dy * dy);
-                if (dist < 15) {
-                    if (!player.shieldActive) {
-                        player.health -= 1;
-                        shakeTimer = 20;
-                        shakeMagnitude = 10.0f;
-                        DEBUG_PRINT(3, 2, "Player hit by enemy bullet; health reduced to %d", player.health);
-                    } else {
-                        DEBUG_PRINT(3, 2, "Enemy bullet blocked by shield.");
+        PROFILE_STAGE(PROF_HIT_PLAYER)
+            for (int i = 0; i < bulletPool.count; i++) {
+                if (bulletPool.bullets[i].active && bulletPool.bullets[i].isEnemy == 1) {
+                    float dx = bulletPool.bullets[i].x - player.x;
+                    float dy = bulletPool.bullets[i].y - player.y;
+                    float dist = sqrtf(dx * dx + dy * dy);
+                    if (dist < 15) {
+                        if (!player.shieldActive) {
+                            player.health -= 1;
+                            shakeTimer = 20;
+                            shakeMagnitude = 10.0f;
+                            DEBUG_PRINT(3, 2, "Player hit by enemy bullet; health reduced to %d", player.health);
+                        } else {
+                            DEBUG_PRINT(3, 2, "Enemy bullet blocked by shield.");
+                        }
+                        bulletPool.bullets[i].active = 0;
                     }
-                    bulletPool.bullets[i].active = 0;
                 }
             }
-        }
 
         // Process collisions between enemies and the player.
-        for (int j = 0; j < MAX_ENEMIES; j++) {
-            if (enemies[j].active) {
-                float dx = player.x - enemies[j].x;
-                float dy = player.y - enemies[j].y;
-                float dist = sqrtf(dx * dx + dy * dy);
-                if (dist < 20) {
-                    if (!player.shieldActive) {
-                        player.health -= 1;
-                        shakeTimer = 20;
-                        shakeMagnitude = 10.0f;
-                        DEBUG_PRINT(3, 2, "Player hit by enemy %d; health reduced to %d", j, player.health);
+        int live_enemies = 0;
+        PROFILE_STAGE(PROF_RAM_PLAYER)
+            for (int j = 0; j < enemy_count; j++) {
+                if (enemies[j].active) {
+                    live_enemies++;
+                    float dx = player.x - enemies[j].x;
+                    float dy = player.y - enemies[j].y;
+                    float dist = sqrtf(dx * dx + dy * dy);
+                    if (dist < 20) {
+                        if (!player.shieldActive) {
+                            player.health -= 1;
+                            shakeTimer = 20;
+                            shakeMagnitude = 10.0f;
+                            DEBUG_PRINT(3, 2, "Player hit by enemy %d; health reduced to %d", j, player.health);
+                        }
+                        enemies[j].active = 0;
                     }
-                    enemies[j].active = 0;
                 }
             }
-        }
+        if (live_enemies > enemy_high_water)
+            enemy_high_water = live_enemies;
         
-        time_t now = time(NULL);
+        // Scenarios run on simulated time so a headless run scores the same.
+        time_t now = replaying ? startTime + (time_t)input.clock
+                   : scripted  ? startTime + (time_t)((long)frame * FRAME_DELAY / 1000)
+                               : time(NULL);
         score = (int)(now - startTime) + (enemiesKilled * 10);
+        if (recording) {
+            input.clock = (uint32_t)(now - startTime);
+            replay_record_frame(&input);
+        }
         
-        if (player.health <= 0) {
+        if (scripted && frame == scenario.duration_frames)
+            running = 0;
+        if (player.health <= 0 && (replaying || scripted)) {
+            break;
+        } else if (player.health <= 0) {
             DEBUG_PRINT(2, 2, "Game over. Using username: %s", username);
             
             ScoreBlock lastBlock = {0};
@@ -638,32 +606,24 @@ void game_loop() {
             strncpy(newBlock.username, username, sizeof(newBlock.username)-1);
             newBlock.score = score;
             newBlock.timestamp = now;
+            newBlock.version = CURRENT_BLOCK_VERSION;
             if (!exists) {
-                memset(newBlock.prev_hash, '0', HASH_STR_LEN - 1);
-                newBlock.prev_hash[HASH_STR_LEN - 1] = '\0';
-                add_score_block(&newBlock, NULL, DIFFICULTY);
+                add_score_block(&newBlock, NULL, POW_DIFFICULTY_AUTO);
                 DEBUG_PRINT(2, 3, "Genesis block created for user %s", username);
             } else {
-                strncpy(newBlock.prev_hash, lastBlock.proof_of_work, HASH_STR_LEN);
-                newBlock.prev_hash[HASH_STR_LEN - 1] = '\0';
-                add_score_block(&newBlock, &lastBlock, DIFFICULTY);
+                add_score_block(&newBlock, &lastBlock, POW_DIFFICULTY_AUTO);
                 DEBUG_PRINT(2, 3, "New block chained to last block for user %s", username);
             }
             
-            if (!sign_score(&newBlock, username, newBlock.signature)) {
+            if (!sign_score(&newBlock)) {
                 DEBUG_PRINT(2, 0, "Failed to sign score block for user %s", username);
             } else {
-                FILE *fp = fopen(BLOCKCHAIN_FILE, "a");
-                if (fp) {
-                    fprintf(fp,
-                        "{\"username\":\"%s\", \"score\":%d, \"timestamp\":%ld, \"proof_of_work\":\"%s\", \"signature\":\"%s\", \"prev_hash\":\"%s\", \"nonce\":%u}\n",
-                        newBlock.username, newBlock.score, newBlock.timestamp,
-                        newBlock.proof_of_work, newBlock.signature, newBlock.prev_hash, newBlock.nonce);
-                    fclose(fp);
+                // A running ledgerd verifies and appends it; otherwise append directly.
+                int submitted = ledgerd_submit(&newBlock);
+                if (submitted < 0)
+                    submitted = append_score_block(&newBlock);
+                if (submitted)
                     DEBUG_PRINT(2, 3, "Score block appended for user %s", username);
-                } else {
-                    DEBUG_PRINT(2, 0, "Failed to open blockchain file for appending");
-                }
             }
             
             SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
@@ -692,45 +652,99 @@ void game_loop() {
             shakeTimer--;
         }
         
-        draw_background(renderer, cam_x, cam_y, screen_width, screen_height);
-        SDL_Color white = {255, 255, 255, 255};
-        char hud[200];
-        if (g_dev_auto_mode) {
-            sprintf(hud, "Health: %d  Energy: %.1f  Score: %d  X: %.1f  Y: %.1f  Angle: %.1f", 
-                    player.health, player.energy, score, player.x, player.y, player.angle);
-        } else {
-            sprintf(hud, "Health: %d  Energy: %.1f  Score: %d  X: %.1f  Y: %.1f  Angle: %.1f",
-                    player.health, player.energy, score, player.x, player.y, player.angle);
-        }
-        render_text(renderer, font, 10, 10, hud, white);
-        draw_bullets(&bulletPool, renderer, cam_x, cam_y);
-        draw_enemies(enemies, renderer, cam_x, cam_y);
-        draw_player(&player, renderer, screen_width/2, screen_height/2);
+        if (!headless) {
+            PROFILE_STAGE(PROF_BACKGROUND)
+                visible_background = draw_background(renderer, cam_x, cam_y, screen_width, screen_height);
+            SDL_Color white = {255, 255, 255, 255};
+            PROFILE_STAGE(PROF_HUD) {
+                char hud[200];
+                if (g_dev_auto_mode) {
+                    sprintf(hud, "Health: %d  Energy: %.1f  Score: %d  X: %.1f  Y: %.1f  Angle: %.1f", 
+                            player.health, player.energy, score, player.x, player.y, player.angle);
+                } else {
+                    sprintf(hud, "Health: %d  Energy: %.1f  Score: %d  X: %.1f  Y: %.1f  Angle: %.1f",
+                            player.health, player.energy, score, player.x, player.y, player.angle);
+                }
+                render_text(renderer, font, 10, 10, hud, white);
+            }
+            PROFILE_STAGE(PROF_DRAW_BULLETS)
+                draw_bullets(&bulletPool, renderer, cam_x, cam_y);
+            PROFILE_STAGE(PROF_DRAW_ENEMIES)
+                draw_enemies(enemies, enemy_count, renderer, cam_x, cam_y);
+            PROFILE_STAGE(PROF_DRAW_PLAYER)
+                draw_player(&player, renderer, screen_width/2, screen_height/2);
+
+            PROFILE_STAGE(PROF_EXPLOSIONS)
+                for (int k = 0; k < MAX_EXPLOSIONS; k++) {
+                    if (explosions[k].lifetime > 0) {
+                        explosions[k].radius += 1.0f;  // Expand explosion radius
+                        int alpha = (int)(255 * ((float)explosions[k].lifetime / 30.0f)); // Fade effect
+                        filledCircleRGBA(renderer, (int)(explosions[k].x - cam_x), (int)(explosions[k].y - cam_y),
+                                         (int)explosions[k].radius, 255, 165, 0, alpha);
+                        explosions[k].lifetime--;
+                    }
+                }
 
-        for (int k = 0; k < MAX_EXPLOSIONS; k++) {
-            if (explosions[k].lifetime > 0) {
-                explosions[k].radius += 1.0f;  // Expand explosion radius
-                int alpha = (int)(255 * ((float)explosions[k].lifetime / 30.0f)); // Fade effect
-                filledCircleRGBA(renderer, (int)(explosions[k].x - cam_x), (int)(explosions[k].y - cam_y),
-                                 (int)explosions[k].radius, 255, 165, 0, alpha);
-                explosions[k].lifetime--;
+            if (show_overlay) {
+                PROFILE_STAGE(PROF_OVERLAY) {
+                    PerfCounts counts = { 0, bulletPool.count, 0, visible_background,
+                                          bulletPool.high_water, enemy_high_water, frame_allocations };
+                    for (int i = 0; i < bulletPool.count; i++)
+                        counts.live_bullets += bulletPool.bullets[i].active != 0;
+                    for (int j = 0; j < enemy_count; j++)
+                        counts.active_enemies += enemies[j].active != 0;
+                    draw_perf_overlay(renderer, font, &counts, screen_width, screen_height);
+                }
             }
+            
+            PROFILE_STAGE(PROF_PRESENT)
+                SDL_RenderPresent(renderer);
+            PROFILE_STAGE(PROF_SLEEP)
+                SDL_Delay(FRAME_DELAY);
         }
-        
-        SDL_RenderPresent(renderer);
-        SDL_Delay(FRAME_DELAY);
-        if (g_exit_requested) {
-            player.health = 0;
+        profiler_frame_end();
+        // Once the pools have grown to fit and the glyph atlas is built, a
+        // frame should not touch the heap.
+        frame_allocations = mem_thread_allocations() - allocations_at_start;
+        if (frame_allocations) {
+            allocating_frames++;
+            last_allocating_frame = frame;
+            DEBUG_PRINT(2, 1, "Frame %d made %ld heap allocation(s)", frame, frame_allocations);
         }
+        if (telemetry)
+            publish_telemetry(frame, &telemetry_ns, &player, score, enemiesKilled, &bulletPool,
+                              live_enemies, enemy_count, enemy_high_water, frame_allocations);
     }
     
+    if (telemetry)
+        telemetry_close();
+    if (recording)
+        replay_record_close(score, enemiesKilled, frame);
+    if (replaying) {
+        report_replay(frame, score, enemiesKilled, replay_start_ns);
+        replay_close();
+    } else if (scripted) {
+        double seconds = (profiler_now_ns() - replay_start_ns) / 1e9;
+        printf("Scenario %s: %d frame(s) in %.2f s (%.1f frames/s): score %d, %d enemies killed, health %d\n",
+               g_scenario_path, frame, seconds, seconds > 0 ? frame / seconds : 0.0, score, enemiesKilled,
+               player.health);
+    }
+    scenario_free(&scenario);
+    if (g_profiler_enabled) {
+        profiler_print_summary(stdout);
+        mem_print_summary(stdout);
+        printf("Frames with heap allocations: %d of %d (the last: frame %d)%s\n",
+               allocating_frames, frame, last_allocating_frame,
+               mem_counts_all_allocations() ? "" : " -- tracked subsystems only; build with MEMTRACK_INTERPOSE=1 to count all");
+        printf("High water: %d of %d bullet slots, %d of %d enemies\n",
+               bulletPool.high_water, bulletPool.count, enemy_high_water, enemy_count);
+    }
     free_bullet_pool(&bulletPool);
-    TTF_CloseFont(font);
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(win);
-    TTF_Quit();
-    SDL_Quit();
+    mem_free(enemies);
+    if (!headless)
+        close_game_window(win, renderer, font);
     
-    free(username);
+    signing_session_end();
+    mem_free(username);
 }
 
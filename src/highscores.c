@@ -3,117 +3,269 @@
 #include <string.h>
 #include <time.h>
 #include "config.h"       // Make sure HIGHSCORE_FLAG_MAX_ENTRY_NUMBER is defined here.
+#include "highscores.h"
 #include "blockchain.h"   // For ScoreBlock structure and HASH_STR_LEN.
-#include "signature.h"    // For verify_score_signature
-
-// Helper function to strip "DevAI" suffix from a username, if present.
-static void strip_devai_suffix(char *username, size_t max_len) {
-    (void)max_len; // suppressed warning; 
-                   // for future implementation with buffer checks
-    const char *suffix = "DevAI";
-    size_t ulen = strlen(username);
-    size_t slen = strlen(suffix);
-    
-    if (ulen >= slen && strcmp(username + ulen - slen, suffix) == 0) {
-        username[ulen - slen] = '\0';
+#include "verify_pool.h"  // For verify_blocks_parallel
+#include "checkpoint.h"   // For checkpoint_block_status
+#include "usermap.h"      // For the per-user best scores
+#include "ledgerd.h"       // For leaderboard queries to a running daemon
+#include "score_buckets.h" // For the days of a --since/--until window
+#include "debug.h"
+#include "trace.h"
+#include "memtrack.h"
+
+int highscore_ranks_higher(const UserBest *a, const UserBest *b) {
+    if (a->score != b->score)
+        return a->score > b->score;
+    if (a->timestamp != b->timestamp)
+        return a->timestamp < b->timestamp;
+    return a->username && b->username && strcmp(a->username, b->username) < 0;
+}
+
+// Records block as the best for its base username (with "DevAI" stripped)
+// if it beats the current one.
+static void record_best(UserMap *best, const ScoreBlock *block) {
+    char base_username[USERNAME_MAX];
+    block_signer_name(block, base_username, sizeof(base_username));
+    void **slot = usermap_slot(best, base_username);
+    if (!slot) {
+        DEBUG_PRINT(2, 0, "Out of memory tracking scores for %s", base_username);
+        return;
+    }
+    UserBest candidate = { NULL, block->score, block->timestamp };
+    UserBest *entry = *slot;
+    if (!entry) {
+        entry = mem_alloc(MEM_LEDGER, sizeof(UserBest));
+        if (!entry)
+            return;
+        *entry = candidate;
+        *slot = entry;
+    } else if (highscore_ranks_higher(&candidate, entry)) {
+        entry->score = candidate.score;
+        entry->timestamp = candidate.timestamp;
     }
 }
 
-// Comparison function for qsort: descending order by score.
-static int compare_score(const void *a, const void *b) {
-    const ScoreBlock *A = (const ScoreBlock *)a;
-    const ScoreBlock *B = (const ScoreBlock *)b;
-    return B->score - A->score;
+// BLOCK_INVALID_* flags of block, given whether its signature verified.
+// Every reader of the ledger applies the same proof-of-work floor.
+static int block_problems(const ScoreBlock *block, int signature_ok) {
+    return (verify_block_pow(block, MIN_DIFFICULTY) ? 0 : BLOCK_INVALID_POW) |
+           (signature_ok ? 0 : BLOCK_INVALID_SIGNATURE);
 }
 
-// Reads the blockchain file, validates each block using the base username (with "DevAI" stripped),
-// and stores valid entries in the blocks array.
-static int read_and_validate_blocks(ScoreBlock *blocks) {
-    FILE *fp = fopen("highscore/blockchain.txt", "r");
-    if (!fp) {
-        printf("Blockchain file not found.\n");
-        return 0;
+long stream_verified_blocks(FILE *fp, long limit, long *record, BlockVisitor visit, void *ctx) {
+    ScoreBlock *batch = mem_alloc(MEM_LEDGER, HIGHSCORE_BATCH_BLOCKS * sizeof(ScoreBlock));
+    long *records = mem_alloc(MEM_LEDGER, HIGHSCORE_BATCH_BLOCKS * sizeof(long));
+    unsigned char *valid = mem_alloc(MEM_LEDGER, HIGHSCORE_BATCH_BLOCKS);
+    if (!batch || !records || !valid) {
+        DEBUG_PRINT(2, 0, "Out of memory allocating a %d-block batch", HIGHSCORE_BATCH_BLOCKS);
+        mem_free(batch);
+        mem_free(records);
+        mem_free(valid);
+        return -1;
     }
 
-    int count = 0;
+    long consumed = 0;
+    int eof = 0;
     char line[2048];
+    uint64_t trace_t0 = TRACE_BEGIN();
+    while (!eof) {
+        int pending = 0;
+        while (pending < HIGHSCORE_BATCH_BLOCKS) {
+            if ((limit >= 0 && consumed >= limit) || !fgets(line, sizeof(line), fp)) {
+                eof = 1;
+                break;
+            }
+            size_t len = strlen(line);
+            if ((len == 0 || line[len - 1] != '\n') && feof(fp)) {
+                eof = 1;  // a record still being written; leave it for the next pass
+                break;
+            }
+            consumed += (long)len;
+            if (!parse_score_block(line, &batch[pending]))
+                continue;
+            // Signatures covered by a trusted checkpoint were verified when it was made.
+            long index = (*record)++;
+            int status = checkpoint_block_status((int)index);
+            if (status == CHECKPOINT_UNCOVERED)
+                records[pending++] = index;
+            else
+                visit(&batch[pending], index, block_problems(&batch[pending], status), ctx);
+        }
 
-    while (fgets(line, sizeof(line), fp)) {
-        if (strlen(line) == 0) continue;
-
-        ScoreBlock block;
-        char prev_hash_buf[HASH_STR_LEN * 2] = {0}; // temporary buffer
-
-        int ret = sscanf(line,
-            "{\"username\":\"%49[^\"]\", \"score\":%d, \"timestamp\":%ld, \"proof_of_work\":\"%64[^\"]\", \"signature\":\"%512[^\"]\", \"prev_hash\":\"%64[^\"]\", \"nonce\":%u}",
-            block.username, &block.score, &block.timestamp,
-            block.proof_of_work, block.signature, prev_hash_buf, &block.nonce);
-
-        if (ret != 7) continue;
-
-        // Ensure prev_hash is properly null-terminated
-        strncpy(block.prev_hash, prev_hash_buf, HASH_STR_LEN - 1);
-        block.prev_hash[HASH_STR_LEN - 1] = '\0';
-
-        // Copy the username and strip "DevAI" for verification
-        char base_username[128];
-        strncpy(base_username, block.username, sizeof(base_username) - 1);
-        base_username[sizeof(base_username) - 1] = '\0';
-        strip_devai_suffix(base_username, sizeof(base_username));
-
-        // Validate digital signature using the base username
-        if (!verify_score_signature(&block, base_username, block.signature)) continue;
-
-        blocks[count++] = block;
-        if (count >= MAX_BLOCKS) break;
+        // Validate digital signatures using the base username
+        verify_blocks_parallel(batch, pending, valid);
+        for (int i = 0; i < pending; i++)
+            visit(&batch[i], records[i], block_problems(&batch[i], valid[i]), ctx);
     }
+    TRACE_END("stream_verified_blocks", trace_t0);
 
-    fclose(fp);
-    return count;
+    mem_free(batch);
+    mem_free(records);
+    mem_free(valid);
+    return consumed;
 }
 
-// Displays the high score table.
-void display_highscores(void) {
-    ScoreBlock blocks[MAX_BLOCKS];
-    int count = read_and_validate_blocks(blocks);
+typedef struct {
+    UserMap *best;
+    int valid;
+    long first, last;  // days counted
+} BestScan;
 
-    if (count == 0) {
-        printf("No valid blockchain entries found.\n");
+// Folds one streamed block into the per-user best map if it is valid and
+// falls within the scan's days.
+static void visit_best(const ScoreBlock *block, long record, int invalid, void *ctx) {
+    BestScan *scan = ctx;
+    (void)record;
+    if (invalid)
         return;
+    if (scan->first != SCORE_DAY_FIRST || scan->last != SCORE_DAY_LAST) {
+        long day = score_day(block->timestamp);
+        if (day < scan->first || day > scan->last)
+            return;
     }
+    record_best(scan->best, block);
+    scan->valid++;
+}
 
-    // Convert usernames to base form (without "DevAI") for display
-    for (int i = 0; i < count; i++) {
-        char base_username[128];
-        strncpy(base_username, blocks[i].username, sizeof(base_username) - 1);
-        base_username[sizeof(base_username) - 1] = '\0';
-        strip_devai_suffix(base_username, sizeof(base_username));
+// Streams the blockchain file and folds valid blocks into the per-user best
+// map. Memory use depends on the batch size and the number of users, not on
+// the length of the chain.
+// Returns the number of valid blocks counted, or -1 if the file could not be read.
+static int stream_valid_blocks(UserMap *best, long first, long last) {
+    FILE *fp = fopen(BLOCKCHAIN_FILE, "r");
+    if (!fp) {
+        printf("Blockchain file not found.\n");
+        return -1;
+    }
+    BestScan scan = { best, 0, first, last };
+    long record = 0;
+    long consumed = stream_verified_blocks(fp, -1, &record, visit_best, &scan);
+    fclose(fp);
+    return consumed < 0 ? -1 : scan.valid;
+}
 
-        strncpy(blocks[i].username, base_username, sizeof(blocks[i].username) - 1);
-        blocks[i].username[sizeof(blocks[i].username) - 1] = '\0';
+// Restores the min-heap property (worst-ranked entry at the root) from index i down.
+static void heap_sift_down(UserBest **heap, int size, int i) {
+    for (;;) {
+        int worst = i;
+        int left = 2 * i + 1, right = left + 1;
+        if (left < size && highscore_ranks_higher(heap[worst], heap[left]))
+            worst = left;
+        if (right < size && highscore_ranks_higher(heap[worst], heap[right]))
+            worst = right;
+        if (worst == i)
+            return;
+        UserBest *tmp = heap[i];
+        heap[i] = heap[worst];
+        heap[worst] = tmp;
+        i = worst;
     }
+}
 
-    // Sort valid blocks by score in descending order
-    qsort(blocks, count, sizeof(ScoreBlock), compare_score);
+static void heap_sift_up(UserBest **heap, int i) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!highscore_ranks_higher(heap[parent], heap[i]))
+            return;
+        UserBest *tmp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = tmp;
+        i = parent;
+    }
+}
 
-    // Limit the number of entries displayed
-    int display_count = (count < HIGHSCORE_FLAG_MAX_ENTRY_NUMBER) ? count : HIGHSCORE_FLAG_MAX_ENTRY_NUMBER;
+// Selects the top k users into out (best first) with a bounded min-heap.
+// Returns the number of entries written.
+static int select_top_users(UserMap *best, UserBest **out, int k) {
+    int size = 0;
+    for (size_t i = 0; i < best->capacity; i++) {
+        if (!USERMAP_OCCUPIED(best, i))
+            continue;
+        UserBest *entry = best->values[i];
+        entry->username = best->keys[i];
+        if (size < k) {
+            out[size] = entry;
+            heap_sift_up(out, size++);
+        } else if (highscore_ranks_higher(entry, out[0])) {
+            out[0] = entry;
+            heap_sift_down(out, size, 0);
+        }
+    }
+    // Pop the worst entry to the back until the heap is empty: best first.
+    for (int n = size - 1; n > 0; n--) {
+        UserBest *tmp = out[0];
+        out[0] = out[n];
+        out[n] = tmp;
+        heap_sift_down(out, n, 0);
+    }
+    return size;
+}
 
+static void print_table(const LeaderboardEntry *rows, int count) {
     // Print header
     printf("+----------------------+------------+---------------------+\n");
     printf("| Username             | High Score | Timestamp           |\n");
     printf("+----------------------+------------+---------------------+\n");
 
     // Display each entry
-    for (int i = 0; i < display_count; i++) {
+    for (int i = 0; i < count; i++) {
         char timestr[64];
-        time_t t = blocks[i].timestamp;
+        time_t t = rows[i].timestamp;
         struct tm *tm_info = localtime(&t);
         strftime(timestr, sizeof(timestr), "%Y-%m-%d %H:%M:%S", tm_info);
 
-        printf("| %-20s | %10d | %-19s |\n", blocks[i].username, blocks[i].score, timestr);
+        printf("| %-20s | %10d | %-19s |\n", rows[i].username, rows[i].score, timestr);
     }
 
     printf("+----------------------+------------+---------------------+\n");
 }
 
+// Displays the high score table.
+void display_highscores(long first, long last) {
+    LeaderboardEntry rows[HIGHSCORE_FLAG_MAX_ENTRY_NUMBER];
+
+    if (first != SCORE_DAY_FIRST || last != SCORE_DAY_LAST) {
+        char from[16] = "the start", to[16] = "today";
+        if (first != SCORE_DAY_FIRST)
+            format_score_day(first, from, sizeof(from));
+        if (last != SCORE_DAY_LAST)
+            format_score_day(last, to, sizeof(to));
+        printf("High scores from %s to %s\n", from, to);
+    }
+
+    // A running daemon already holds the verified index; audits verify here.
+    if (!checkpoint_audit_enabled()) {
+        int served = ledgerd_top(rows, HIGHSCORE_FLAG_MAX_ENTRY_NUMBER, first, last);
+        if (served > 0) {
+            print_table(rows, served);
+            return;
+        }
+        if (served == 0) {
+            printf("No valid blockchain entries found.\n");
+            return;
+        }
+    }
+
+    UserMap best;
+    usermap_init(&best);
+    int count = stream_valid_blocks(&best, first, last);
+
+    if (count <= 0) {
+        if (count == 0)
+            printf("No valid blockchain entries found.\n");
+        usermap_free(&best, mem_free);
+        return;
+    }
+
+    UserBest *top[HIGHSCORE_FLAG_MAX_ENTRY_NUMBER];
+    int display_count = select_top_users(&best, top, HIGHSCORE_FLAG_MAX_ENTRY_NUMBER);
+    DEBUG_PRINT(2, 2, "%d valid block(s) from %zu user(s)", count, best.count);
+    for (int i = 0; i < display_count; i++) {
+        snprintf(rows[i].username, sizeof(rows[i].username), "%s", top[i]->username);
+        rows[i].score = top[i]->score;
+        rows[i].timestamp = top[i]->timestamp;
+    }
+    print_table(rows, display_count);
+    usermap_free(&best, mem_free);
+}
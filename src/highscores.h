@@ -2,10 +2,48 @@
 #ifndef HIGHSCORES_H
 #define HIGHSCORES_H
 
+#include <stdio.h>
+#include <time.h>
+#include "blockchain.h"
+
+// Best valid score seen so far for one base username.
+typedef struct {
+    const char *username;  // points at the user map's key
+    int score;
+    time_t timestamp;
+} UserBest;
+
+// Ranking order: higher score first, then the earlier block, then by name so
+// the table is stable. Returns 1 if a ranks above b.
+int highscore_ranks_higher(const UserBest *a, const UserBest *b);
+
+// Why stream_verified_blocks rejects a block; 0 means it is valid.
+#define BLOCK_INVALID_POW 1        // proof-of-work wrong or below MIN_DIFFICULTY
+#define BLOCK_INVALID_SIGNATURE 2  // signature does not verify with the signer's key
+
+// Called by stream_verified_blocks for every well-formed record. record is its
+// index among the well-formed records of the file; invalid is 0 if its
+// proof-of-work meets MIN_DIFFICULTY and its signature verifies with the
+// signer's key (or a trusted checkpoint says it did), else BLOCK_INVALID_* flags.
+typedef void (*BlockVisitor)(const ScoreBlock *block, long record, int invalid, void *ctx);
+
+// Reads the complete lines of fp from its current position in batches of
+// HIGHSCORE_BATCH_BLOCKS, checks proof-of-work, verifies signatures in
+// parallel, and calls visit for each well-formed record (within a batch,
+// checkpointed blocks come first). *record is the index of the next
+// well-formed record and is advanced. Reading stops after limit bytes (-1:
+// at the end of the file). A final line without its newline is a record
+// still being written and is left for the next pass. Returns the number of
+// bytes consumed, or -1 on failure.
+long stream_verified_blocks(FILE *fp, long limit, long *record, BlockVisitor visit, void *ctx);
+
 // Displays the high score table by reading and validating the blockchain.
 // It groups entries by the base username (stripping any "DevAI" suffix)
-// and then displays up to HIGHSCORE_FLAG_MAX_ENTRY_NUMBER entries.
-void display_highscores(void);
+// and then displays the best score of up to HIGHSCORE_FLAG_MAX_ENTRY_NUMBER users.
+// Only blocks from local days first..last count (SCORE_DAY_FIRST and
+// SCORE_DAY_LAST for all time). The table comes from a running leaderboard
+// daemon when there is one (except in audit mode).
+void display_highscores(long first, long last);
 
 #endif // HIGHSCORES_H
 
@@ -0,0 +1,656 @@
+#include "ledger_sync.h"
+#include "blockchain.h"
+#include "encryption.h"
+#include "verify_pool.h"
+#include "usermap.h"
+#include "config.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define SYNC_PROTOCOL_VERSION 1
+
+// Ancestors asked for per PATH request while looking for a divergence point.
+#define SYNC_PATH_STEP 64
+
+// Largest public key file sent or accepted (an RSA key with its countersigned
+// Ed25519 successor is far below this).
+#define SYNC_KEY_MAX 16384
+
+// Protocol lines: a record plus a short keyword.
+#define SYNC_LINE_MAX (BLOCK_LINE_MAX + 64)
+
+// Blocks are indexed by the tail of their proof_of_work; the leading bytes
+// are zeros by design and would only collide.
+#define SYNC_KEY_OFFSET 16
+#define SYNC_KEY_LEN (HASH_LEN - SYNC_KEY_OFFSET)
+
+// What one side knows about one block of a user's chain.
+typedef struct {
+    unsigned char pow[HASH_LEN];
+    unsigned char prev[HASH_LEN];
+    off_t offset;  // of its record in BLOCKCHAIN_FILE; -1 if received this session
+} SyncBlock;
+
+// One user's chain in file order, plus what the peer reported for it.
+typedef struct {
+    SyncBlock *blocks;
+    int count, capacity;
+    int remote_known;                    // the peer has this user
+    unsigned char remote_head[HASH_LEN];
+    long remote_length;
+    int received;                        // the peer sent blocks for this user
+} SyncChain;
+
+// Where a block with a given proof_of_work sits: chain->blocks[block].
+typedef struct {
+    unsigned char key[SYNC_KEY_LEN];
+    SyncChain *chain;  // NULL marks an empty slot
+    int block;
+} SyncEntry;
+
+// Every block of every chain, so lookups do not scan the chains.
+typedef struct {
+    SyncEntry *entries;
+    size_t capacity;  // power of two
+    size_t count;
+} SyncIndex;
+
+typedef struct {
+    UserMap chains;   // username -> SyncChain*
+    SyncIndex index;  // proof_of_work -> block
+    FILE *file;       // BLOCKCHAIN_FILE, re-read to send records (NULL if absent)
+} Replica;
+
+// A run of blocks to send: chain->blocks[start..count).
+typedef struct {
+    SyncChain *chain;
+    int start;
+} Push;
+
+// A public key file to send: its signer and key version.
+typedef struct {
+    char signer[USERNAME_MAX];
+    int version;
+} KeyRef;
+
+// A key file installed from the peer this session.
+typedef struct {
+    char path[512];
+    char signer[USERNAME_MAX];
+    int used;  // signs at least one accepted block
+} InstalledKey;
+
+static const unsigned char zero_hash[HASH_LEN];
+
+static void free_chain(void *value) {
+    SyncChain *chain = value;
+    free(chain->blocks);
+    free(chain);
+}
+
+static SyncChain *chain_for(Replica *replica, const char *username) {
+    void **slot = usermap_slot(&replica->chains, username);
+    if (!slot)
+        return NULL;
+    if (!*slot)
+        *slot = calloc(1, sizeof(SyncChain));
+    return *slot;
+}
+
+// Finds the slot holding key (SYNC_KEY_LEN bytes) or the empty slot for it.
+static size_t find_entry(const SyncIndex *index, const unsigned char *key) {
+    uint32_t h;
+    memcpy(&h, key, sizeof(h));
+    size_t mask = index->capacity - 1;
+    size_t i = h & mask;
+    while (index->entries[i].chain && memcmp(index->entries[i].key, key, SYNC_KEY_LEN) != 0)
+        i = (i + 1) & mask;
+    return i;
+}
+
+// Records chain->blocks[block]. A proof_of_work already indexed keeps its
+// first block, so walking prev_hash links always moves to earlier blocks.
+static int index_insert(SyncIndex *index, SyncChain *chain, int block) {
+    if ((index->count + 1) * 2 > index->capacity) {
+        SyncIndex grown = { NULL, index->capacity ? index->capacity * 2 : 1024, 0 };
+        grown.entries = calloc(grown.capacity, sizeof(SyncEntry));
+        if (!grown.entries)
+            return 0;
+        for (size_t i = 0; i < index->capacity; i++) {
+            SyncEntry *e = &index->entries[i];
+            if (e->chain)
+                grown.entries[find_entry(&grown, e->key)] = *e;
+        }
+        grown.count = index->count;
+        free(index->entries);
+        *index = grown;
+    }
+    const unsigned char *key = chain->blocks[block].pow + SYNC_KEY_OFFSET;
+    SyncEntry *e = &index->entries[find_entry(index, key)];
+    if (e->chain)
+        return 1;
+    memcpy(e->key, key, SYNC_KEY_LEN);
+    e->chain = chain;
+    e->block = block;
+    index->count++;
+    return 1;
+}
+
+// Returns the index in chain of the block with this proof_of_work, or -1 if
+// chain has no such block.
+static int find_block(const Replica *replica, const SyncChain *chain, const unsigned char *pow) {
+    const SyncIndex *index = &replica->index;
+    if (!index->capacity)
+        return -1;
+    const SyncEntry *e = &index->entries[find_entry(index, pow + SYNC_KEY_OFFSET)];
+    if (e->chain != chain || memcmp(chain->blocks[e->block].pow, pow, HASH_LEN) != 0)
+        return -1;
+    return e->block;
+}
+
+static int chain_push(Replica *replica, SyncChain *chain, const ScoreBlock *block, off_t offset) {
+    if (chain->count == chain->capacity) {
+        int capacity = chain->capacity ? chain->capacity * 2 : 8;
+        SyncBlock *grown = realloc(chain->blocks, (size_t)capacity * sizeof(SyncBlock));
+        if (!grown)
+            return 0;
+        chain->blocks = grown;
+        chain->capacity = capacity;
+    }
+    SyncBlock *b = &chain->blocks[chain->count++];
+    memcpy(b->pow, block->proof_of_work, HASH_LEN);
+    memcpy(b->prev, block->prev_hash, HASH_LEN);
+    b->offset = offset;
+    return index_insert(&replica->index, chain, chain->count - 1);
+}
+
+// Indexes every user's chain in BLOCKCHAIN_FILE (no verification: only the
+// blocks exchanged are verified, by their receiver).
+static int load_replica(Replica *replica) {
+    usermap_init(&replica->chains);
+    replica->index = (SyncIndex){ NULL, 0, 0 };
+    replica->file = fopen(BLOCKCHAIN_FILE, "r");
+    if (!replica->file)
+        return errno == ENOENT;
+    char line[2048];
+    ScoreBlock block;
+    off_t offset = 0;
+    while (fgets(line, sizeof(line), replica->file)) {
+        off_t start = offset;
+        offset += (off_t)strlen(line);
+        if (!parse_score_block(line, &block))
+            continue;
+        SyncChain *chain = chain_for(replica, block.username);
+        if (!chain || !chain_push(replica, chain, &block, start)) {
+            DEBUG_PRINT(2, 0, "Out of memory indexing %s", BLOCKCHAIN_FILE);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void free_replica(Replica *replica) {
+    if (replica->file)
+        fclose(replica->file);
+    usermap_free(&replica->chains, free_chain);
+    free(replica->index.entries);
+}
+
+// Reads one protocol line without its newline. Returns 0 at end of input.
+static int read_line(FILE *in, char *line, size_t size) {
+    if (!fgets(line, (int)size, in))
+        return 0;
+    line[strcspn(line, "\n")] = '\0';
+    return 1;
+}
+
+static void send_heads(const Replica *replica, FILE *out) {
+    size_t users = 0;
+    for (size_t i = 0; i < replica->chains.capacity; i++) {
+        if (USERMAP_OCCUPIED(&replica->chains, i) && ((SyncChain*)replica->chains.values[i])->count > 0)
+            users++;
+    }
+    fprintf(out, "HEADS %zu\n", users);
+    for (size_t i = 0; i < replica->chains.capacity; i++) {
+        if (!USERMAP_OCCUPIED(&replica->chains, i))
+            continue;
+        const SyncChain *chain = replica->chains.values[i];
+        if (chain->count == 0)
+            continue;
+        char hex[HASH_STR_LEN];
+        hex_encode(chain->blocks[chain->count - 1].pow, HASH_LEN, hex);
+        fprintf(out, "%s %d %s\n", hex, chain->count, replica->chains.keys[i]);
+    }
+}
+
+static int read_heads(Replica *replica, FILE *in) {
+    char line[SYNC_LINE_MAX];
+    long count;
+    if (!read_line(in, line, sizeof(line)) || sscanf(line, "HEADS %ld", &count) != 1)
+        return 0;
+    for (long i = 0; i < count; i++) {
+        char hex[HASH_STR_LEN], username[USERNAME_MAX];
+        long length;
+        if (!read_line(in, line, sizeof(line)) ||
+            sscanf(line, "%64s %ld %49[^\n]", hex, &length, username) != 3)
+            return 0;
+        SyncChain *chain = chain_for(replica, username);
+        if (!chain || !hex_decode(hex, chain->remote_head, HASH_LEN))
+            return 0;
+        chain->remote_known = 1;
+        chain->remote_length = length;
+    }
+    return 1;
+}
+
+// Chooses the chains the peer lacks a suffix of: it does not have the user,
+// or its head is an earlier block of our chain. Also tallies the report.
+static int plan_pushes(const Replica *replica, Push **out, SyncReport *report) {
+    Push *pushes = malloc((replica->chains.count + 1) * sizeof(Push));
+    int count = 0;
+    if (!pushes)
+        return -1;
+    for (size_t i = 0; i < replica->chains.capacity; i++) {
+        if (!USERMAP_OCCUPIED(&replica->chains, i))
+            continue;
+        SyncChain *chain = replica->chains.values[i];
+        report->users++;
+        if (chain->count == 0)
+            continue;
+        if (!chain->remote_known) {
+            pushes[count++] = (Push){ chain, 0 };
+            continue;
+        }
+        int head = chain->count - 1;
+        if (memcmp(chain->blocks[head].pow, chain->remote_head, HASH_LEN) == 0) {
+            report->in_sync++;
+            continue;
+        }
+        int known = find_block(replica, chain, chain->remote_head);
+        if (known >= 0 && known < head)
+            pushes[count++] = (Push){ chain, known + 1 };
+    }
+    *out = pushes;
+    return count;
+}
+
+// Reads a whole public key file; returns its length or -1.
+static long read_key_file(const char *path, char *buf, size_t size) {
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+    size_t len = fread(buf, 1, size, fp);
+    int too_long = !feof(fp);
+    fclose(fp);
+    return too_long ? -1 : (long)len;
+}
+
+// Sends the planned blocks (as their stored records) and the public keys
+// that sign them.
+static int send_blocks(Replica *replica, const Push *pushes, int count, FILE *out, SyncReport *report) {
+    long records = 0;
+    for (int p = 0; p < count; p++)
+        records += pushes[p].chain->count - pushes[p].start;
+    char *lines = malloc((size_t)(records ? records : 1) * BLOCK_LINE_MAX);
+    UserMap keys;  // key file path -> KeyRef*
+    usermap_init(&keys);
+    if (!lines)
+        return 0;
+
+    long n = 0;
+    for (int p = 0; p < count; p++) {
+        const SyncChain *chain = pushes[p].chain;
+        for (int b = pushes[p].start; b < chain->count; b++) {
+            char *line = lines + (size_t)n * BLOCK_LINE_MAX;
+            ScoreBlock block;
+            if (!replica->file || fseeko(replica->file, chain->blocks[b].offset, SEEK_SET) != 0 ||
+                !fgets(line, BLOCK_LINE_MAX, replica->file) || !parse_score_block(line, &block))
+                continue;
+            char signer[USERNAME_MAX], path[512];
+            block_signer_name(&block, signer, sizeof(signer));
+            if (public_key_file_path(signer, block.version, path, sizeof(path))) {
+                void **slot = usermap_slot(&keys, path);
+                if (slot && !*slot && (*slot = malloc(sizeof(KeyRef))) != NULL) {
+                    KeyRef *key = *slot;
+                    strcpy(key->signer, signer);
+                    key->version = block.version;
+                }
+            }
+            n++;
+        }
+    }
+
+    // Keys first, so the receiver can verify the records that follow.
+    static char pem[SYNC_KEY_MAX];
+    long sendable = 0;
+    for (size_t i = 0; i < keys.capacity; i++) {
+        if (USERMAP_OCCUPIED(&keys, i) && keys.values[i] && access(keys.keys[i], R_OK) == 0)
+            sendable++;
+    }
+    fprintf(out, "BLOCKS %ld %ld\n", sendable, n);
+    for (size_t i = 0; i < keys.capacity; i++) {
+        if (!USERMAP_OCCUPIED(&keys, i) || !keys.values[i] || access(keys.keys[i], R_OK) != 0)
+            continue;
+        const KeyRef *key = keys.values[i];
+        long len = read_key_file(keys.keys[i], pem, sizeof(pem));
+        if (len < 0)
+            len = 0;  // still announced; an empty key is simply not installed
+        fprintf(out, "KEY %d %ld %s\n", key->version, len, key->signer);
+        fwrite(pem, 1, (size_t)len, out);
+    }
+    for (long i = 0; i < n; i++)
+        fputs(lines + (size_t)i * BLOCK_LINE_MAX, out);
+    fflush(out);
+    report->sent += n;
+    usermap_free(&keys, free);
+    free(lines);
+    return !ferror(out);
+}
+
+// Receives a BLOCKS message, verifies each block against our copy of its
+// chain, appends the accepted ones and answers with APPLIED.
+static int receive_blocks(Replica *replica, FILE *in, FILE *out, SyncReport *report) {
+    char line[SYNC_LINE_MAX];
+    long key_count, count;
+    if (!read_line(in, line, sizeof(line)) || sscanf(line, "BLOCKS %ld %ld", &key_count, &count) != 2 ||
+        key_count < 0 || count < 0)
+        return 0;
+
+    InstalledKey *installed = calloc((size_t)key_count + 1, sizeof(InstalledKey));
+    ScoreBlock *blocks = malloc((size_t)(count ? count : 1) * sizeof(ScoreBlock));
+    unsigned char *sig_ok = malloc((size_t)(count ? count : 1));
+    int installed_count = 0, ok = installed && blocks && sig_ok;
+    static char pem[SYNC_KEY_MAX];
+    for (long k = 0; ok && k < key_count; k++) {
+        int version;
+        long len;
+        char signer[USERNAME_MAX];
+        if (!read_line(in, line, sizeof(line)) ||
+            sscanf(line, "KEY %d %ld %49[^\n]", &version, &len, signer) != 3 ||
+            len < 0 || len > SYNC_KEY_MAX || fread(pem, 1, (size_t)len, in) != (size_t)len) {
+            ok = 0;
+            break;
+        }
+        InstalledKey *key = &installed[installed_count];
+        if (len > 0 && install_public_key(signer, version, pem, (size_t)len) == 1 &&
+            public_key_file_path(signer, version, key->path, sizeof(key->path))) {
+            strcpy(key->signer, signer);
+            installed_count++;
+        }
+    }
+    long parsed = 0;
+    for (long i = 0; ok && i < count; i++) {
+        if (!read_line(in, line, sizeof(line))) {
+            ok = 0;
+            break;
+        }
+        if (parse_score_block(line, &blocks[parsed]))
+            parsed++;
+        else
+            report->rejected++;
+    }
+    if (!ok) {
+        free(installed);
+        free(blocks);
+        free(sig_ok);
+        return 0;
+    }
+
+    verify_blocks_parallel(blocks, (int)parsed, sig_ok);
+    long accepted = 0;
+    for (long i = 0; i < parsed; i++) {
+        ScoreBlock *block = &blocks[i];
+        SyncChain *chain = chain_for(replica, block->username);
+        if (!chain)
+            break;
+        chain->received = 1;
+        const unsigned char *head = chain->count ? chain->blocks[chain->count - 1].pow : zero_hash;
+        const char *reason = NULL;
+        if (memcmp(block->prev_hash, head, HASH_LEN) != 0)
+            reason = "does not extend our copy of the chain";
+        else if (!verify_block_pow(block, MIN_DIFFICULTY))
+            reason = "bad proof-of-work";
+        else if (!sig_ok[i])
+            reason = "bad signature";
+        if (reason || !chain_push(replica, chain, block, -1)) {
+            DEBUG_PRINT(0, 1, "sync: rejected a block for %s: %s", block->username, reason ? reason : "out of memory");
+            report->rejected++;
+            continue;
+        }
+        char signer[USERNAME_MAX];
+        block_signer_name(block, signer, sizeof(signer));
+        for (int k = 0; k < installed_count; k++) {
+            if (strcmp(installed[k].signer, signer) == 0)
+                installed[k].used = 1;
+        }
+        blocks[accepted++] = *block;
+    }
+    if (accepted > 0 && !append_score_blocks(blocks, (int)accepted)) {
+        report->rejected += accepted;
+        accepted = 0;
+    }
+    report->received += accepted;
+    // Keys that came with rejected blocks only are not kept.
+    for (int k = 0; k < installed_count; k++) {
+        if (!installed[k].used || accepted == 0) {
+            unlink(installed[k].path);
+            clear_public_key_cache();
+        }
+    }
+    fprintf(out, "APPLIED %ld %ld\n", accepted, parsed - accepted + (count - parsed));
+    fflush(out);
+    free(installed);
+    free(blocks);
+    free(sig_ok);
+    return 1;
+}
+
+static int read_applied(FILE *in) {
+    char line[SYNC_LINE_MAX];
+    long accepted, rejected;
+    if (!read_line(in, line, sizeof(line)) || sscanf(line, "APPLIED %ld %ld", &accepted, &rejected) != 2)
+        return 0;
+    if (rejected)
+        DEBUG_PRINT(0, 1, "sync: the peer rejected %ld of %ld block(s)", rejected, accepted + rejected);
+    return 1;
+}
+
+// Answers PATH: up to max ancestors of the given block, walking prev_hash.
+static void answer_path(Replica *replica, const char *request, FILE *out) {
+    int max;
+    char hex[HASH_STR_LEN], username[USERNAME_MAX];
+    unsigned char pow[HASH_LEN];
+    const SyncChain *chain = NULL;
+    int at = -1;
+    if (sscanf(request, "PATH %d %64s %49[^\n]", &max, hex, username) == 3 && hex_decode(hex, pow, HASH_LEN) &&
+        (chain = usermap_get(&replica->chains, username)) != NULL)
+        at = find_block(replica, chain, pow);
+    int ancestors[SYNC_PATH_STEP];
+    int n = 0;
+    while (at >= 0 && n < max && n < SYNC_PATH_STEP) {
+        const unsigned char *prev = chain->blocks[at].prev;
+        int parent = memcmp(prev, zero_hash, HASH_LEN) == 0 ? -1 : find_block(replica, chain, prev);
+        at = parent < at ? parent : -1;
+        if (at >= 0)
+            ancestors[n++] = at;
+    }
+    fprintf(out, "HASHES %d\n", n);
+    for (int i = 0; i < n; i++) {
+        hex_encode(chain->blocks[ancestors[i]].pow, HASH_LEN, hex);
+        fprintf(out, "%s\n", hex);
+    }
+    fflush(out);
+}
+
+// Walks the peer's copy of chain back from its head until reaching a block
+// we also have, and reports the fork.
+static int report_divergence(const Replica *replica, const char *username, const SyncChain *chain,
+                             FILE *in, FILE *out) {
+    unsigned char cursor[HASH_LEN];
+    memcpy(cursor, chain->remote_head, HASH_LEN);
+    long remote_branch = 1;  // the peer's head
+    int common = -1;
+    char line[SYNC_LINE_MAX], hex[HASH_STR_LEN];
+    for (;;) {
+        int n;
+        hex_encode(cursor, HASH_LEN, hex);
+        fprintf(out, "PATH %d %s %s\n", SYNC_PATH_STEP, hex, username);
+        fflush(out);
+        if (!read_line(in, line, sizeof(line)) || sscanf(line, "HASHES %d", &n) != 1)
+            return 0;
+        for (int i = 0; i < n; i++) {
+            if (!read_line(in, line, sizeof(line)) || !hex_decode(line, cursor, HASH_LEN))
+                return 0;
+            if (common < 0) {
+                common = find_block(replica, chain, cursor);
+                if (common < 0)
+                    remote_branch++;
+            }
+        }
+        if (common >= 0 || n == 0)
+            break;
+    }
+    if (common >= 0) {
+        hex_encode(chain->blocks[common].pow, HASH_LEN, hex);
+        DEBUG_PRINT(0, 1, "sync: %s diverged after block %.16s: %d local and %ld remote block(s) since",
+                    username, hex, chain->count - common - 1, remote_branch);
+    } else {
+        DEBUG_PRINT(0, 1, "sync: %s has no block in common: %d local and %ld remote block(s)",
+                    username, chain->count, remote_branch);
+    }
+    return 1;
+}
+
+// Runs the initiator's side of a session over in/out.
+static int sync_session(Replica *replica, FILE *in, FILE *out, SyncReport *report) {
+    char line[SYNC_LINE_MAX];
+    int version;
+    fprintf(out, "SYNC %d\n", SYNC_PROTOCOL_VERSION);
+    send_heads(replica, out);
+    fflush(out);
+    if (!read_line(in, line, sizeof(line)) || sscanf(line, "SYNC %d", &version) != 1 ||
+        version != SYNC_PROTOCOL_VERSION || !read_heads(replica, in)) {
+        DEBUG_PRINT(0, 0, "sync: the peer did not answer with its heads");
+        return 0;
+    }
+    Push *pushes = NULL;
+    int push_count = plan_pushes(replica, &pushes, report);
+    int ok = push_count >= 0 && send_blocks(replica, pushes, push_count, out, report) &&
+             read_applied(in) && receive_blocks(replica, in, out, report);
+    free(pushes);
+    if (!ok)
+        return 0;
+
+    for (size_t i = 0; i < replica->chains.capacity; i++) {
+        if (!USERMAP_OCCUPIED(&replica->chains, i))
+            continue;
+        SyncChain *chain = replica->chains.values[i];
+        if (!chain->remote_known || chain->received || chain->count == 0 ||
+            find_block(replica, chain, chain->remote_head) >= 0)
+            continue;
+        report->diverged++;
+        if (!report_divergence(replica, replica->chains.keys[i], chain, in, out))
+            return 0;
+    }
+    fprintf(out, "DONE\n");
+    fflush(out);
+    return !ferror(out);
+}
+
+int ledger_sync_with(const char *command, SyncReport *report) {
+    memset(report, 0, sizeof(*report));
+    Replica replica;
+    if (!load_replica(&replica)) {
+        free_replica(&replica);
+        return 0;
+    }
+    int to_peer[2], from_peer[2];
+    if (pipe(to_peer) != 0 || pipe(from_peer) != 0) {
+        DEBUG_PRINT(0, 0, "sync: pipe failed: %s", strerror(errno));
+        free_replica(&replica);
+        return 0;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(to_peer[0], STDIN_FILENO);
+        dup2(from_peer[1], STDOUT_FILENO);
+        close(to_peer[0]);
+        close(to_peer[1]);
+        close(from_peer[0]);
+        close(from_peer[1]);
+        execl("/bin/sh", "sh", "-c", command, (char*)NULL);
+        _exit(127);
+    }
+    close(to_peer[0]);
+    close(from_peer[1]);
+    if (pid < 0) {
+        DEBUG_PRINT(0, 0, "sync: cannot start the peer: %s", strerror(errno));
+        close(to_peer[1]);
+        close(from_peer[0]);
+        free_replica(&replica);
+        return 0;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    FILE *out = fdopen(to_peer[1], "w");
+    FILE *in = fdopen(from_peer[0], "r");
+    int ok = in && out && sync_session(&replica, in, out, report);
+    if (out)
+        fclose(out);
+    if (in)
+        fclose(in);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    free_replica(&replica);
+    return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int ledger_sync_serve(SyncReport *report) {
+    memset(report, 0, sizeof(*report));
+    // The protocol owns the real stdout; anything else printed goes to stderr.
+    fflush(stdout);
+    int proto_fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    FILE *out = proto_fd >= 0 ? fdopen(proto_fd, "w") : NULL;
+    FILE *in = stdin;
+    Replica replica;
+    int loaded = out != NULL;
+    int ok = loaded && load_replica(&replica);
+
+    char line[SYNC_LINE_MAX];
+    int version;
+    if (ok && (!read_line(in, line, sizeof(line)) || sscanf(line, "SYNC %d", &version) != 1 ||
+               version != SYNC_PROTOCOL_VERSION || !read_heads(&replica, in)))
+        ok = 0;
+    Push *pushes = NULL;
+    int push_count = -1;
+    if (ok) {
+        fprintf(out, "SYNC %d\n", SYNC_PROTOCOL_VERSION);
+        send_heads(&replica, out);
+        fflush(out);
+        // Planned before receiving, so blocks that just arrived are not echoed back.
+        push_count = plan_pushes(&replica, &pushes, report);
+        ok = push_count >= 0 && receive_blocks(&replica, in, out, report) &&
+             send_blocks(&replica, pushes, push_count, out, report) && read_applied(in);
+    }
+    free(pushes);
+    while (ok && read_line(in, line, sizeof(line)) && strcmp(line, "DONE") != 0) {
+        if (strncmp(line, "PATH ", 5) == 0)
+            answer_path(&replica, line, out);
+        else
+            ok = 0;
+    }
+    if (out)
+        fclose(out);
+    if (loaded)
+        free_replica(&replica);
+    return ok;
+}
@@ -0,0 +1,51 @@
+#ifndef LEDGER_SYNC_H
+#define LEDGER_SYNC_H
+
+// Delta synchronization between two ledger replicas (game directories).
+//
+// The two sides exchange the head (latest proof_of_work) and length of every
+// per-user chain. A side whose copy of a chain contains the other side's head
+// sends only the blocks after it, together with the public keys that sign
+// them; the receiver checks proof-of-work, linkage and signatures of just
+// those blocks and appends the accepted ones in one write. Chains where
+// neither head is known to the other side have diverged: the initiator walks
+// the peer's prev_hash links back to the last common block and reports both
+// branches, but neither branch is copied.
+//
+// Each side reads its ledger once per session to learn the chains, indexing
+// every block by proof_of_work in a hash table; that scan (parsing only, no
+// verification) is linear in the ledger. Everything after it - lookups,
+// messages and verification - grows with the number of users and the blocks
+// that differ, not with the length of the chains.
+//
+// The protocol is line-based and half-duplex:
+//   initiator: SYNC 1, HEADS <n> + n "<head hex> <length> <username>"
+//   peer:      SYNC 1, HEADS <n> + lines
+//   initiator: BLOCKS <keys> <records>; each key is "KEY <version> <bytes> <username>"
+//              followed by the PEM bytes, then one record line per block
+//   peer:      APPLIED <accepted> <rejected>, then its own BLOCKS
+//   initiator: APPLIED <accepted> <rejected>
+//   initiator: PATH <max> <hex> <username> (repeatable); peer: HASHES <n> + n hex lines
+//   initiator: DONE
+
+typedef struct {
+    long users;      // distinct users across both replicas
+    long in_sync;    // users whose chains were already identical
+    long sent;       // blocks sent to the peer
+    long received;   // blocks received and appended
+    long rejected;   // blocks received but rejected
+    long diverged;   // users whose chains have forked between the replicas
+} SyncReport;
+
+// Synchronizes the ledger in the current directory with a peer started by
+// running command through /bin/sh with its stdin and stdout connected to
+// this process, e.g. "cd ../mirror && ./QuantumStriker --sync-serve".
+// Fills report and returns 1 if the session completed, 0 otherwise.
+int ledger_sync_with(const char *command, SyncReport *report);
+
+// Serves one sync session for the ledger in the current directory on stdin
+// and stdout (stdout is redirected to stderr for everything else).
+// Returns 1 if the session completed, 0 otherwise.
+int ledger_sync_serve(SyncReport *report);
+
+#endif // LEDGER_SYNC_H
@@ -0,0 +1,538 @@
+#include "ledgerd.h"
+#include "highscores.h"
+#include "signature.h"
+#include "usermap.h"
+#include "config.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Longest request line: SUBMIT plus one record.
+#define LEDGERD_REQUEST_MAX (BLOCK_LINE_MAX + 16)
+
+// Best valid score of one base username, with its own copy of the name.
+typedef struct {
+    UserBest best;
+    char name[USERNAME_MAX];
+} RankedUser;
+
+typedef struct {
+    ScoreBlock block;
+    int reasons;  // BLOCK_INVALID_*
+} InvalidBlock;
+
+// Everything the daemon knows about BLOCKCHAIN_FILE.
+typedef struct {
+    UserMap tips;                        // exact username -> ScoreBlock* (latest by timestamp)
+    UserMap best;                        // base username -> RankedUser*
+    ScoreBuckets days;                   // per-day top users, for ranged TOP
+    RankedUser *top[LEDGERD_TOP_MAX];    // best first
+    int top_count;
+    InvalidBlock *invalid;
+    size_t invalid_count, invalid_capacity;
+    long records;                        // well-formed records indexed
+    off_t offset;                        // bytes of BLOCKCHAIN_FILE indexed
+    dev_t dev;
+    ino_t ino;
+} LedgerIndex;
+
+// Client sockets are non-blocking: replies are queued in out and written
+// as the client reads them, so one slow reader cannot stall the others.
+typedef struct {
+    int fd;  // -1 if the slot is free
+    size_t len;
+    char buf[LEDGERD_REQUEST_MAX];
+    char *out;            // queued reply bytes not yet sent
+    size_t out_len, out_sent, out_capacity;
+    int closing;          // no more requests; close once out is sent
+} Client;
+
+// Reply being assembled for one request.
+typedef struct {
+    char *data;
+    size_t len, capacity;
+    int lines;
+} Reply;
+
+static volatile sig_atomic_t g_ledgerd_stop = 0;
+
+static void handle_stop(int sig) {
+    (void)sig;
+    g_ledgerd_stop = 1;
+}
+
+static void index_init(LedgerIndex *ix) {
+    memset(ix, 0, sizeof(*ix));
+    usermap_init(&ix->tips);
+    usermap_init(&ix->best);
+    score_buckets_init(&ix->days);
+}
+
+static void index_free(LedgerIndex *ix) {
+    usermap_free(&ix->tips, free);
+    usermap_free(&ix->best, free);
+    score_buckets_free(&ix->days);
+    free(ix->invalid);
+}
+
+// Moves user up the top list after its best score improved.
+static void rank_user(LedgerIndex *ix, RankedUser *user) {
+    int pos = -1;
+    for (int i = 0; i < ix->top_count && pos < 0; i++) {
+        if (ix->top[i] == user)
+            pos = i;
+    }
+    if (pos < 0) {
+        if (ix->top_count < LEDGERD_TOP_MAX)
+            pos = ix->top_count++;
+        else if (highscore_ranks_higher(&user->best, &ix->top[ix->top_count - 1]->best))
+            pos = ix->top_count - 1;
+        else
+            return;
+        ix->top[pos] = user;
+    }
+    // Best scores only ever improve, so a user only moves up.
+    while (pos > 0 && highscore_ranks_higher(&user->best, &ix->top[pos - 1]->best)) {
+        ix->top[pos] = ix->top[pos - 1];
+        ix->top[--pos] = user;
+    }
+}
+
+static void index_best(LedgerIndex *ix, const ScoreBlock *block) {
+    char base_username[USERNAME_MAX];
+    block_signer_name(block, base_username, sizeof(base_username));
+    void **slot = usermap_slot(&ix->best, base_username);
+    if (!slot) {
+        DEBUG_PRINT(2, 0, "Out of memory tracking scores for %s", base_username);
+        return;
+    }
+    score_buckets_add(&ix->days, base_username, block->score, block->timestamp);
+    RankedUser *user = *slot;
+    UserBest candidate = { base_username, block->score, block->timestamp };
+    if (!user) {
+        user = malloc(sizeof(RankedUser));
+        if (!user)
+            return;
+        strcpy(user->name, base_username);
+        *slot = user;
+    } else if (!highscore_ranks_higher(&candidate, &user->best)) {
+        return;
+    }
+    user->best = (UserBest){ user->name, block->score, block->timestamp };
+    rank_user(ix, user);
+}
+
+static void index_invalid(LedgerIndex *ix, const ScoreBlock *block, int reasons) {
+    if (ix->invalid_count == ix->invalid_capacity) {
+        size_t capacity = ix->invalid_capacity ? ix->invalid_capacity * 2 : 16;
+        InvalidBlock *grown = realloc(ix->invalid, capacity * sizeof(InvalidBlock));
+        if (!grown)
+            return;
+        ix->invalid = grown;
+        ix->invalid_capacity = capacity;
+    }
+    ix->invalid[ix->invalid_count].block = *block;
+    ix->invalid[ix->invalid_count++].reasons = reasons;
+}
+
+static void visit_block(const ScoreBlock *block, long record, int invalid, void *ctx) {
+    LedgerIndex *ix = ctx;
+    (void)record;
+    // The latest block is the chain head new blocks link to, valid or not.
+    void **slot = usermap_slot(&ix->tips, block->username);
+    if (slot) {
+        ScoreBlock *tip = *slot;
+        if (!tip && (tip = malloc(sizeof(ScoreBlock))) != NULL) {
+            *tip = *block;
+            *slot = tip;
+        } else if (tip && block->timestamp > tip->timestamp) {
+            *tip = *block;
+        }
+    }
+    if (invalid)
+        index_invalid(ix, block, invalid);
+    else
+        index_best(ix, block);
+}
+
+// Waits for a whole-file advisory lock of the given type.
+static int lock_chain(int fd, short type) {
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    while (fcntl(fd, F_SETLKW, &fl) != 0) {
+        if (errno != EINTR)
+            return 0;
+    }
+    return 1;
+}
+
+// Brings the index up to date with BLOCKCHAIN_FILE: new records are read
+// incrementally; a replaced or truncated file is indexed again from scratch.
+// Keys that players add or replace while the daemon runs need nothing here:
+// the public key cache reloads a key whose file changed.
+static int refresh_index(LedgerIndex *ix) {
+    struct stat st;
+    if (stat(BLOCKCHAIN_FILE, &st) != 0)
+        st.st_size = 0;
+    if (st.st_size < ix->offset || (ix->offset > 0 && (st.st_dev != ix->dev || st.st_ino != ix->ino))) {
+        DEBUG_PRINT(0, 1, "ledgerd: %s was replaced, indexing it again", BLOCKCHAIN_FILE);
+        index_free(ix);
+        index_init(ix);
+    }
+    if (st.st_size == ix->offset)
+        return 1;
+
+    // Writers append whole records under F_WRLCK, so the length seen under
+    // the read lock ends on a record boundary. The file is append-only, so
+    // everything before it can be verified after the lock is released,
+    // without holding up a game appending its score meanwhile.
+    int fd = open(BLOCKCHAIN_FILE, O_RDONLY);
+    struct stat locked_st;
+    int snapshot = fd >= 0 && lock_chain(fd, F_RDLCK);
+    if (snapshot) {
+        snapshot = fstat(fd, &locked_st) == 0;
+        lock_chain(fd, F_UNLCK);
+    }
+    if (!snapshot) {
+        DEBUG_PRINT(2, 0, "ledgerd: cannot read %s: %s", BLOCKCHAIN_FILE, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return 0;
+    }
+    FILE *fp = fdopen(fd, "r");
+    long consumed = -1;
+    if (fp && fseeko(fp, ix->offset, SEEK_SET) == 0)
+        consumed = stream_verified_blocks(fp, locked_st.st_size > ix->offset ? (long)(locked_st.st_size - ix->offset) : 0,
+                                          &ix->records, visit_block, ix);
+    ix->dev = st.st_dev;
+    ix->ino = st.st_ino;
+    if (consumed > 0)
+        ix->offset += consumed;
+    if (fp)
+        fclose(fp);
+    else
+        close(fd);
+    return consumed >= 0;
+}
+
+static void reply_line(Reply *reply, const char *fmt, ...) {
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        size_t room = reply->capacity - reply->len;
+        int n = vsnprintf(reply->data ? reply->data + reply->len : NULL, room, fmt, ap);
+        va_end(ap);
+        if (n < 0)
+            return;
+        if ((size_t)n < room) {
+            reply->len += (size_t)n;
+            reply->lines++;
+            return;
+        }
+        size_t capacity = reply->capacity ? reply->capacity * 2 : 4096;
+        while (capacity - reply->len <= (size_t)n)
+            capacity *= 2;
+        char *grown = realloc(reply->data, capacity);
+        if (!grown)
+            return;
+        reply->data = grown;
+        reply->capacity = capacity;
+    }
+}
+
+// Appends len bytes to the client's output queue. If memory runs out the
+// client is dropped rather than sent a truncated reply.
+static void queue_output(Client *client, const char *data, size_t len) {
+    if (client->out_len + len > client->out_capacity) {
+        size_t capacity = client->out_capacity ? client->out_capacity : 4096;
+        while (capacity < client->out_len + len)
+            capacity *= 2;
+        char *grown = realloc(client->out, capacity);
+        if (!grown) {
+            client->closing = 1;
+            client->out_len = client->out_sent = 0;
+            return;
+        }
+        client->out = grown;
+        client->out_capacity = capacity;
+    }
+    memcpy(client->out + client->out_len, data, len);
+    client->out_len += len;
+}
+
+// Sends as much queued output as the socket takes without blocking.
+// Returns 0 if the client has gone away.
+static int flush_output(Client *client) {
+    while (client->out_sent < client->out_len) {
+        ssize_t n = send(client->fd, client->out + client->out_sent, client->out_len - client->out_sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        client->out_sent += (size_t)n;
+    }
+    client->out_len = client->out_sent = 0;
+    return 1;
+}
+
+static void send_error(Client *client, const char *reason) {
+    char line[128];
+    int n = snprintf(line, sizeof(line), "ERR %s\n", reason);
+    queue_output(client, line, (size_t)n);
+}
+
+// Queues "OK <lines>" and the reply body.
+static void send_reply(Client *client, const Reply *reply) {
+    char header[32];
+    int n = snprintf(header, sizeof(header), "OK %d\n", reply->lines);
+    queue_output(client, header, (size_t)n);
+    if (reply->len)
+        queue_output(client, reply->data, reply->len);
+}
+
+// Appends the record line of block to reply, after an optional prefix.
+static void reply_record(Reply *reply, const char *prefix, const ScoreBlock *block) {
+    char record[BLOCK_LINE_MAX];
+    if (format_score_block(block, record, sizeof(record)) < 0)
+        return;
+    reply_line(reply, "%s%s", prefix, record);
+}
+
+// Verifies a submitted block against the index and appends it.
+// Returns NULL on success or the reason it was rejected.
+static const char *submit_block(LedgerIndex *ix, const char *record) {
+    ScoreBlock block;
+    if (!parse_score_block(record, &block))
+        return "malformed record";
+    if (!verify_block_pow(&block, MIN_DIFFICULTY))
+        return "bad proof-of-work";
+    static const unsigned char genesis[HASH_LEN];
+    const ScoreBlock *tip = usermap_get(&ix->tips, block.username);
+    if (memcmp(block.prev_hash, tip ? tip->proof_of_work : genesis, HASH_LEN) != 0)
+        return "prev_hash is not the user's latest block";
+    char signer[USERNAME_MAX];
+    block_signer_name(&block, signer, sizeof(signer));
+    if (!verify_score_signature(&block, signer))
+        return "bad signature";
+    if (!append_score_block(&block))
+        return "append failed";
+    refresh_index(ix);
+    return NULL;
+}
+
+static void handle_request(LedgerIndex *ix, Client *client, char *line) {
+    Reply reply = { NULL, 0, 0, 0 };
+    refresh_index(ix);
+    DEBUG_PRINT(2, 2, "ledgerd: request \"%.40s\"", line);
+    if (strncmp(line, "TOP ", 4) == 0) {
+        int k = 0;
+        long first, last;
+        if (sscanf(line + 4, "%d %ld %ld", &k, &first, &last) == 3) {
+            LeaderboardEntry rows[SCORE_BUCKET_TOP_K];
+            int count = score_buckets_top(&ix->days, first, last, rows, k < SCORE_BUCKET_TOP_K ? k : SCORE_BUCKET_TOP_K);
+            for (int i = 0; i < count; i++)
+                reply_line(&reply, "%d %ld %s\n", rows[i].score, (long)rows[i].timestamp, rows[i].username);
+        } else {
+            for (int i = 0; i < k && i < ix->top_count; i++) {
+                const UserBest *best = &ix->top[i]->best;
+                reply_line(&reply, "%d %ld %s\n", best->score, (long)best->timestamp, best->username);
+            }
+        }
+    } else if (strncmp(line, "BEST ", 5) == 0) {
+        const RankedUser *user = usermap_get(&ix->best, line + 5);
+        if (user)
+            reply_line(&reply, "%d %ld\n", user->best.score, (long)user->best.timestamp);
+    } else if (strncmp(line, "LAST ", 5) == 0) {
+        const ScoreBlock *tip = usermap_get(&ix->tips, line + 5);
+        if (tip)
+            reply_record(&reply, "", tip);
+    } else if (strcmp(line, "INVALID") == 0) {
+        static const char *reason_names[] = { "", "pow ", "signature ", "pow,signature " };
+        for (size_t i = 0; i < ix->invalid_count; i++)
+            reply_record(&reply, reason_names[ix->invalid[i].reasons], &ix->invalid[i].block);
+    } else if (strncmp(line, "SUBMIT ", 7) == 0) {
+        const char *error = submit_block(ix, line + 7);
+        if (error) {
+            DEBUG_PRINT(2, 1, "ledgerd: rejected a block: %s", error);
+            send_error(client, error);
+            return;
+        }
+    } else {
+        send_error(client, "unknown request");
+        return;
+    }
+    send_reply(client, &reply);
+    free(reply.data);
+}
+
+// Reads what the client sent and handles every complete request line in its
+// buffer, queueing the replies. At end of input the client is marked closing.
+// Returns 0 if the client should be disconnected now.
+static int serve_client(LedgerIndex *ix, Client *client) {
+    ssize_t n = read(client->fd, client->buf + client->len, sizeof(client->buf) - 1 - client->len);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+        return 1;
+    if (n < 0)
+        return 0;
+    if (n == 0) {
+        client->closing = 1;
+        return 1;
+    }
+    client->len += (size_t)n;
+    client->buf[client->len] = '\0';
+    char *start = client->buf, *nl;
+    while ((nl = strchr(start, '\n')) != NULL) {
+        *nl = '\0';
+        if (nl > start && nl[-1] == '\r')
+            nl[-1] = '\0';
+        handle_request(ix, client, start);
+        start = nl + 1;
+    }
+    client->len -= (size_t)(start - client->buf);
+    memmove(client->buf, start, client->len);
+    if (client->len == sizeof(client->buf) - 1) {
+        send_error(client, "request too long");
+        client->closing = 1;
+    }
+    return 1;
+}
+
+static void close_client(Client *client) {
+    close(client->fd);
+    free(client->out);
+    memset(client, 0, sizeof(*client));
+    client->fd = -1;
+}
+
+// Binds LEDGERD_SOCKET, replacing a stale socket file but not a live daemon.
+static int open_listener(void) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(LEDGERD_SOCKET) >= sizeof(addr.sun_path)) {
+        DEBUG_PRINT(0, 0, "ledgerd: socket path %s is too long", LEDGERD_SOCKET);
+        return -1;
+    }
+    strcpy(addr.sun_path, LEDGERD_SOCKET);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+        DEBUG_PRINT(0, 0, "ledgerd: another daemon is already serving %s", LEDGERD_SOCKET);
+        close(fd);
+        return -1;
+    }
+    unlink(LEDGERD_SOCKET);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, LEDGERD_MAX_CLIENTS) != 0) {
+        DEBUG_PRINT(0, 0, "ledgerd: cannot listen on %s: %s", LEDGERD_SOCKET, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int ledgerd_run(void) {
+    LedgerIndex ix;
+    index_init(&ix);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!refresh_index(&ix)) {
+        index_free(&ix);
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("ledgerd: %ld block(s) from %zu user(s) indexed in %.1f ms, %zu invalid\n",
+           ix.records, ix.best.count,
+           (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6, ix.invalid_count);
+
+    int listen_fd = open_listener();
+    if (listen_fd < 0) {
+        index_free(&ix);
+        return 1;
+    }
+    // No SA_RESTART, so a signal interrupts poll().
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    printf("ledgerd: serving %s\n", LEDGERD_SOCKET);
+    fflush(stdout);
+
+    static Client clients[LEDGERD_MAX_CLIENTS];
+    struct pollfd fds[LEDGERD_MAX_CLIENTS + 1];
+    for (int i = 0; i < LEDGERD_MAX_CLIENTS; i++)
+        clients[i].fd = -1;
+    while (!g_ledgerd_stop) {
+        fds[0] = (struct pollfd){ listen_fd, POLLIN, 0 };
+        // A client with queued output is not read from until it has taken
+        // it, which bounds the memory one client can tie up.
+        for (int i = 0; i < LEDGERD_MAX_CLIENTS; i++) {
+            short events = clients[i].out_len > 0 ? POLLOUT : clients[i].closing ? 0 : POLLIN;
+            fds[i + 1] = (struct pollfd){ clients[i].fd, events, 0 };
+        }
+        if (poll(fds, LEDGERD_MAX_CLIENTS + 1, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            DEBUG_PRINT(0, 0, "ledgerd: poll failed: %s", strerror(errno));
+            break;
+        }
+        for (int i = 0; i < LEDGERD_MAX_CLIENTS; i++) {
+            Client *client = &clients[i];
+            if (client->fd < 0 || !fds[i + 1].revents)
+                continue;
+            int ok = 1;
+            if (fds[i + 1].revents & POLLIN)
+                ok = serve_client(&ix, client);
+            else if (fds[i + 1].revents & (POLLERR | POLLHUP | POLLNVAL) && !(fds[i + 1].revents & POLLOUT))
+                ok = 0;
+            if (ok && client->out_len > 0)
+                ok = flush_output(client);
+            if (!ok || (client->closing && client->out_len == 0))
+                close_client(client);
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, NULL, NULL);
+            int slot = 0;
+            while (slot < LEDGERD_MAX_CLIENTS && clients[slot].fd >= 0)
+                slot++;
+            if (fd >= 0 && slot == LEDGERD_MAX_CLIENTS) {
+                static const char busy[] = "ERR too many clients\n";
+                if (send(fd, busy, sizeof(busy) - 1, MSG_NOSIGNAL | MSG_DONTWAIT) < 0)
+                    DEBUG_PRINT(2, 1, "ledgerd: could not turn a client away: %s", strerror(errno));
+                close(fd);
+            } else if (fd >= 0 && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0) {
+                DEBUG_PRINT(2, 0, "ledgerd: cannot make a client socket non-blocking: %s", strerror(errno));
+                close(fd);
+            } else if (fd >= 0) {
+                clients[slot].fd = fd;
+                clients[slot].len = 0;
+            }
+        }
+    }
+
+    for (int i = 0; i < LEDGERD_MAX_CLIENTS; i++) {
+        if (clients[i].fd >= 0)
+            close_client(&clients[i]);
+    }
+    close(listen_fd);
+    unlink(LEDGERD_SOCKET);
+    index_free(&ix);
+    printf("ledgerd: stopped\n");
+    return 0;
+}
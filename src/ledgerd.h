@@ -0,0 +1,47 @@
+#ifndef LEDGERD_H
+#define LEDGERD_H
+
+#include "blockchain.h"
+#include "score_buckets.h"
+
+// Unix-domain socket the leaderboard daemon listens on.
+#ifndef LEDGERD_SOCKET
+#define LEDGERD_SOCKET "highscore/.ledgerd.sock"
+#endif
+
+// Protocol: one request per line. A reply is either "OK <n>" followed by n
+// lines, or a single "ERR <reason>" line. Clients may send several requests
+// on one connection, or one request and then shut down their side.
+//
+//   TOP <k> [<first> <last>]
+//                     "<score> <timestamp> <username>" per base username, best first;
+//                     with day numbers (see score_buckets.h), only blocks of those days
+//   BEST <username>   "<score> <timestamp>" of the base username, if it has a valid block
+//   LAST <username>   the user's latest record exactly as in BLOCKCHAIN_FILE, if any
+//   INVALID           "<reasons> <record>" per block failing verification; reasons
+//                     is "pow", "signature" or "pow,signature"
+//   SUBMIT <record>   verifies a sealed and signed record and appends it (OK 0)
+
+// Loads and verifies BLOCKCHAIN_FILE once, then serves queries and block
+// submissions on LEDGERD_SOCKET from an in-memory index until SIGINT or
+// SIGTERM. Blocks appended to the file by other processes are picked up
+// before the next request is answered. Returns 0 on a clean shutdown.
+int ledgerd_run(void);
+
+// Client side. Each call returns -1 if no daemon answers, so the caller can
+// fall back to reading BLOCKCHAIN_FILE itself.
+
+// Writes up to k leaderboard rows (best first) into out; returns the count.
+// first and last bound the days counted (SCORE_DAY_FIRST and SCORE_DAY_LAST
+// for all time).
+int ledgerd_top(LeaderboardEntry *out, int k, long first, long last);
+
+// Copies username's latest block into out. Returns 1 if found, 0 if the user
+// has no block.
+int ledgerd_last_block(const char *username, ScoreBlock *out);
+
+// Hands a sealed and signed block to the daemon, which verifies and appends
+// it. Returns 1 if appended, 0 if rejected.
+int ledgerd_submit(const ScoreBlock *block);
+
+#endif // LEDGERD_H
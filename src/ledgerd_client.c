@@ -0,0 +1,117 @@
+#include "ledgerd.h"
+#include "config.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+// Sends one request to the daemon and returns a stream positioned after the
+// "OK <n>" header, with *lines set to n. Returns NULL if no daemon answers;
+// an "ERR" reply is copied into error (if given) and also returns NULL.
+static FILE *ledgerd_request(const char *request, int *lines, char *error, size_t error_size) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, LEDGERD_SOCKET, sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return NULL;
+    struct timeval timeout = { LEDGERD_TIMEOUT_MS / 1000, (LEDGERD_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return NULL;
+    }
+    size_t len = strlen(request);
+    const char *p = request;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            close(fd);
+            return NULL;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    shutdown(fd, SHUT_WR);
+    FILE *in = fdopen(fd, "r");
+    if (!in) {
+        close(fd);
+        return NULL;
+    }
+    char header[BLOCK_LINE_MAX] = "";
+    if (fgets(header, sizeof(header), in) && sscanf(header, "OK %d", lines) == 1)
+        return in;
+    if (error && strncmp(header, "ERR ", 4) == 0) {
+        size_t n = strcspn(header + 4, "\n");
+        if (n >= error_size)
+            n = error_size - 1;
+        memcpy(error, header + 4, n);
+        error[n] = '\0';
+    }
+    fclose(in);
+    return NULL;
+}
+
+int ledgerd_top(LeaderboardEntry *out, int k, long first, long last) {
+    char request[80];
+    int lines = 0, count = 0;
+    if (first == SCORE_DAY_FIRST && last == SCORE_DAY_LAST)
+        snprintf(request, sizeof(request), "TOP %d\n", k);
+    else
+        snprintf(request, sizeof(request), "TOP %d %ld %ld\n", k, first, last);
+    FILE *in = ledgerd_request(request, &lines, NULL, 0);
+    if (!in)
+        return -1;
+    char line[BLOCK_LINE_MAX];
+    while (count < lines && count < k && fgets(line, sizeof(line), in)) {
+        long timestamp;
+        LeaderboardEntry *row = &out[count];
+        if (sscanf(line, "%d %ld %49[^\n]", &row->score, &timestamp, row->username) != 3)
+            break;
+        row->timestamp = (time_t)timestamp;
+        count++;
+    }
+    fclose(in);
+    DEBUG_PRINT(2, 2, "ledgerd served %d leaderboard row(s)", count);
+    return count;
+}
+
+int ledgerd_last_block(const char *username, ScoreBlock *out) {
+    char request[USERNAME_MAX + 8];
+    int lines = 0;
+    snprintf(request, sizeof(request), "LAST %s\n", username);
+    FILE *in = ledgerd_request(request, &lines, NULL, 0);
+    if (!in)
+        return -1;
+    char line[BLOCK_LINE_MAX];
+    int found = lines > 0 && fgets(line, sizeof(line), in) && parse_score_block(line, out);
+    fclose(in);
+    return found;
+}
+
+int ledgerd_submit(const ScoreBlock *block) {
+    char request[BLOCK_LINE_MAX + 8];
+    char error[128] = "";
+    int lines = 0;
+    memcpy(request, "SUBMIT ", 7);
+    if (format_score_block(block, request + 7, sizeof(request) - 7) < 0)
+        return 0;
+    FILE *in = ledgerd_request(request, &lines, error, sizeof(error));
+    if (in) {
+        fclose(in);
+        return 1;
+    }
+    if (error[0] == '\0')
+        return -1;
+    DEBUG_PRINT(2, 0, "ledgerd rejected the block for %s: %s", block->username, error);
+    return 0;
+}
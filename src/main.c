@@ -4,10 +4,25 @@
 #include "debug.h"
 #include "config.h"
 #include "enemy.h"
+#include "encryption.h"
+#include "checkpoint.h"
+#include "verify_chain.h"
+#include "ledgerd.h"
+#include "ledger_sync.h"
+#include "score_buckets.h"
+#include "profiler.h"
+#include "trace.h"
+#include "perf_counters.h"
+#include "telemetry.h"
 int g_fullscreen = 0;
 int g_testing_mode = 0;
 int g_dev_auto_mode = 0;
 int g_forced_enemy_type = -1; // -1 means "not set"
+const char *g_record_path = NULL;
+const char *g_replay_path = NULL;
+const char *g_scenario_path = NULL;
+const char *g_telemetry_name = NULL;
+int g_headless = 0;
 
 #include <stdio.h>
 #include <string.h>
@@ -35,13 +50,32 @@ int main(int argc, char *argv[]) {
             return 0;
         } else if (strcmp(argv[i], "--help") == 0) {
             DEBUG_PRINT(2, 3, "Help flag active");
-            printf("Usage: %s [--version] [--help] [--debug <1-3>] [--fullscreen] [--highscores]\n", argv[0]);
+            printf("Usage: %s [--version] [--help] [--debug <1-3>] [--log [file]] [--fullscreen] [--profile] [--trace <file>] [--counters] [--telemetry [name]] [--record <file>] [--replay <file>] [--scenario <file>] [--headless] [--highscores [--since <day>] [--until <day>]] [--build-keyring] [--audit] [--checkpoint] [--prove <hash>] [--verify-proof <file>] [--verify-chain] [--ledgerd] [--sync <command>] [--sync-serve]\n", argv[0]);
             printf("\n");
             printf("  --version    Print the version number\n");
             printf("  --help       Show this help message\n");
             printf("  --debug      Enable debug mode with a level (1-3)\n");
+            printf("  --log        Write debug output to a file (default " DEBUG_LOG_DEFAULT_PATH ") instead of the terminal; level 2 unless --debug is given\n");
             printf("  --fullscreen Fullscreen mode \n");
+            printf("  --profile    Time every frame stage and print min/avg/p99 at exit (F3 shows the overlay)\n");
+            printf("  --trace      Write a Chrome/Perfetto timeline of frames and ledger work to a file at exit (put first)\n");
+            printf("  --counters   Count cycles, instructions, cache and branch misses per frame stage and ledger operation; print IPC and misses per call and per entity at exit (put first)\n");
+            printf("  --telemetry  Publish frame times, entity counts, score and heap use in shared memory (default " TELEMETRY_DEFAULT_NAME ") for tools/telemetry_watch\n");
+            printf("  --record     Save this game's inputs and RNG seed to a file for --replay\n");
+            printf("  --replay     Play a recorded game again, frame for frame\n");
+            printf("  --scenario   Run a scripted stress scene (enemy and bullet populations, schedule, duration); not scored\n");
+            printf("  --headless   Run --replay or --scenario without a window\n");
             printf("  --highscores Display a table of all high scores\n");
+            printf("    --since / --until  Only count days from/to today, week, month or YYYY-MM-DD\n");
+            printf("  --build-keyring Bundle all public keys into one indexed keyring file\n");
+            printf("  --audit      Verify every block, ignoring checkpoints and caches (put before --highscores)\n");
+            printf("  --checkpoint Append a signed Merkle checkpoint over the current chain\n");
+            printf("  --prove      Print an inclusion proof for the block with this proof_of_work\n");
+            printf("  --verify-proof Check an inclusion proof against the signed checkpoints\n");
+            printf("  --verify-chain Check every user's hash chain, proof-of-work and signatures\n");
+            printf("  --ledgerd    Serve the verified leaderboard and block submissions on a local socket\n");
+            printf("  --sync       Exchange missing blocks with a replica reached through a shell command\n");
+            printf("  --sync-serve Answer one --sync session on stdin/stdout\n");
             return 0;
         } else if (strcmp(argv[i], "--debug") == 0) {
             g_debug_enabled = 1;
@@ -55,14 +89,123 @@ int main(int argc, char *argv[]) {
             DEBUG_PRINT(1, 3, "Debug mode on.");
             DEBUG_PRINT(2, 3, "Debug mode enabled with level %d", g_debug_level);
             DEBUG_PRINT(3, 3, "Debug mode enabled with level %d. Highest debug enabled.", g_debug_level);
+        } else if (strcmp(argv[i], "--log") == 0) {
+            const char *path = NULL;
+            if (i + 1 < argc && strncmp(argv[i+1], "--", 2) != 0)
+                path = argv[++i];
+            if (!debug_log_open(path))
+                return 1;
+            if (!g_debug_enabled) {
+                g_debug_enabled = 1;
+                g_debug_level = 2;
+            }
+            DEBUG_PRINT(2, 3, "Logging debug output at level %d", g_debug_level);
         } else if (strcmp(argv[i], "--fullscreen") == 0) {
 
             g_fullscreen = 1;
             DEBUG_PRINT(0, 3, "Fullscreen flag activated.");
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            if (i + 1 >= argc) {
+                printf("Usage: %s --trace <file.json> [other options]\n", argv[0]);
+                return 1;
+            }
+            if (!trace_start(argv[++i]))
+                return 1;
+        } else if (strcmp(argv[i], "--record") == 0 || strcmp(argv[i], "--replay") == 0 ||
+                   strcmp(argv[i], "--scenario") == 0) {
+            if (i + 1 >= argc) {
+                printf("Usage: %s %s <file> [other options]\n", argv[0], argv[i]);
+                return 1;
+            }
+            if (strcmp(argv[i], "--record") == 0)
+                g_record_path = argv[++i];
+            else if (strcmp(argv[i], "--replay") == 0)
+                g_replay_path = argv[++i];
+            else
+                g_scenario_path = argv[++i];
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            g_headless = 1;
+        } else if (strcmp(argv[i], "--telemetry") == 0) {
+            g_telemetry_name = TELEMETRY_DEFAULT_NAME;
+            if (i + 1 < argc && strncmp(argv[i+1], "--", 2) != 0)
+                g_telemetry_name = argv[++i];
+        } else if (strcmp(argv[i], "--counters") == 0) {
+            perf_counters_start();
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            g_profiler_enabled = 1;
+            DEBUG_PRINT(0, 3, "Frame profiler enabled.");
         } else if (strcmp(argv[i], "--highscores") == 0) {
             #include "highscores.h"
-            display_highscores();
+            long first = SCORE_DAY_FIRST, last = SCORE_DAY_LAST;
+            for (i++; i + 1 < argc; i += 2) {
+                long *bound = strcmp(argv[i], "--since") == 0 ? &first
+                            : strcmp(argv[i], "--until") == 0 ? &last : NULL;
+                if (!bound)
+                    break;
+                if (!parse_score_day(argv[i+1], bound)) {
+                    printf("Invalid day \"%s\": use today, week, month or YYYY-MM-DD\n", argv[i+1]);
+                    return 1;
+                }
+            }
+            display_highscores(first, last);
+            return 0;
+        } else if (strcmp(argv[i], "--build-keyring") == 0) {
+            int keys = build_keyring();
+            if (keys < 0)
+                return 1;
+            printf("Keyring %s written with %d public key(s).\n", KEYRING_FILE, keys);
+            return 0;
+        } else if (strcmp(argv[i], "--audit") == 0) {
+            checkpoint_set_audit(1);
+            DEBUG_PRINT(0, 3, "Audit mode: checkpoints and the verification cache are ignored.");
+        } else if (strcmp(argv[i], "--checkpoint") == 0) {
+            int covered = checkpoint_create();
+            if (covered < 0)
+                return 1;
+            printf("Checkpoint over %d block(s) appended to %s.\n", covered, CHECKPOINT_FILE);
             return 0;
+        } else if (strcmp(argv[i], "--prove") == 0) {
+            if (i + 1 >= argc) {
+                printf("Usage: %s --prove <proof_of_work>\n", argv[0]);
+                return 1;
+            }
+            return checkpoint_prove(argv[i+1], stdout) ? 0 : 1;
+        } else if (strcmp(argv[i], "--verify-proof") == 0) {
+            FILE *proof = (i + 1 < argc) ? fopen(argv[i+1], "r") : NULL;
+            if (!proof) {
+                printf("Usage: %s --verify-proof <file>\n", argv[0]);
+                return 1;
+            }
+            int ok = checkpoint_verify_proof(proof);
+            fclose(proof);
+            printf("Inclusion proof %s.\n", ok ? "verified" : "rejected");
+            return ok ? 0 : 1;
+        } else if (strcmp(argv[i], "--verify-chain") == 0) {
+            ChainReport report;
+            if (!verify_chain_file(MIN_DIFFICULTY, &report))
+                return 1;
+            printf("%ld block(s) in %ld user chain(s): %ld valid\n", report.blocks, report.users, report.valid);
+            printf("  bad proof-of-work: %ld, below difficulty: %ld, bad signature: %ld\n",
+                   report.bad_pow, report.low_difficulty, report.bad_signature);
+            printf("  forks: %ld, orphans: %ld, duplicates: %ld\n", report.forks, report.orphans, report.duplicates);
+            return chain_report_clean(&report) ? 0 : 1;
+        } else if (strcmp(argv[i], "--ledgerd") == 0) {
+            return ledgerd_run();
+        } else if (strcmp(argv[i], "--sync") == 0) {
+            if (i + 1 >= argc) {
+                printf("Usage: %s --sync \"<command that runs --sync-serve in the other replica>\"\n", argv[0]);
+                return 1;
+            }
+            SyncReport report;
+            int ok = ledger_sync_with(argv[i+1], &report);
+            printf("%ld user(s), %ld already in sync: sent %ld block(s), received %ld, rejected %ld\n",
+                   report.users, report.in_sync, report.sent, report.received, report.rejected);
+            if (report.diverged)
+                printf("  %ld user chain(s) have diverged and were left as they are\n", report.diverged);
+            return ok ? 0 : 1;
+        } else if (strcmp(argv[i], "--sync-serve") == 0) {
+            SyncReport report;
+            return ledger_sync_serve(&report) ? 0 : 1;
         } else if (strcmp(argv[i], "--development") == 0) {
             // Check if a Sub-argument is provided. 
             if (i + 1 >= argc) {
@@ -150,6 +293,10 @@ int main(int argc, char *argv[]) {
             return 1;
         }
     }
+    if (g_headless && !g_replay_path && !g_scenario_path) {
+        printf("--headless only works together with --replay <file> or --scenario <file>\n");
+        return 1;
+    }
     // No command-line options provided; run the game.
     game_loop();
     return 0;
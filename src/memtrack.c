@@ -0,0 +1,214 @@
+#include "memtrack.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Built with -DMEMTRACK_INTERPOSE=1 (the game's profiling builds) and glibc,
+// every heap allocation of the process is counted per thread by defining
+// malloc and friends here; they forward to glibc's allocator, which exports
+// its entry points as __libc_*. Calls from libraries (SDL, SDL_ttf, OpenSSL)
+// and from glibc itself land here too. Otherwise, and under a sanitizer that
+// brings its own malloc, the process allocator is left alone and only mem_*
+// calls are counted.
+#if MEMTRACK_INTERPOSE && defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#define MEMTRACK_COUNT_ALL 1
+#endif
+
+// Header in front of every block, padded so the block keeps malloc's alignment.
+typedef union {
+    struct {
+        size_t size;
+        int tag;
+    } info;
+    long double align_ld;
+    void *align_ptr;
+    long long align_ll;
+} MemHeader;
+
+static const char *tag_names[MEM_TAG_COUNT] = {
+    "bullets", "enemies", "scenario", "usernames", "keys", "ledger"
+};
+
+// Per tag, plus the total in the last row. Updated with atomics.
+static size_t current_bytes[MEM_TAG_COUNT + 1];
+static size_t peak_bytes[MEM_TAG_COUNT + 1];
+static long allocation_count[MEM_TAG_COUNT + 1];
+static long free_count[MEM_TAG_COUNT + 1];
+static __thread long tls_allocations = 0;
+
+static void raise_peak(int row, size_t now) {
+    size_t peak = __atomic_load_n(&peak_bytes[row], __ATOMIC_RELAXED);
+    while (now > peak &&
+           !__atomic_compare_exchange_n(&peak_bytes[row], &peak, now, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+// Records size bytes more (grow) or fewer for tag; counts a call when counted.
+static void account(int tag, size_t size, int grow, int counted) {
+    int rows[2] = { tag, MEM_TAG_COUNT };
+    for (int i = 0; i < 2; i++) {
+        if (grow) {
+            raise_peak(rows[i], __atomic_add_fetch(&current_bytes[rows[i]], size, __ATOMIC_RELAXED));
+            if (counted)
+                __atomic_add_fetch(&allocation_count[rows[i]], 1, __ATOMIC_RELAXED);
+        } else {
+            __atomic_sub_fetch(&current_bytes[rows[i]], size, __ATOMIC_RELAXED);
+            if (counted)
+                __atomic_add_fetch(&free_count[rows[i]], 1, __ATOMIC_RELAXED);
+        }
+    }
+#ifndef MEMTRACK_COUNT_ALL
+    if (grow && counted)
+        tls_allocations++;
+#endif
+}
+
+void *mem_alloc(MemTag tag, size_t size) {
+    if (size > (size_t)-1 - sizeof(MemHeader))
+        return NULL;
+    MemHeader *header = malloc(sizeof(MemHeader) + size);
+    if (!header)
+        return NULL;
+    header->info.size = size;
+    header->info.tag = tag;
+    account(tag, size, 1, 1);
+    return header + 1;
+}
+
+void *mem_calloc(MemTag tag, size_t count, size_t size) {
+    if (size && count > (size_t)-1 / size)
+        return NULL;
+    void *ptr = mem_alloc(tag, count * size);
+    if (ptr)
+        memset(ptr, 0, count * size);
+    return ptr;
+}
+
+void *mem_realloc(MemTag tag, void *ptr, size_t size) {
+    if (!ptr)
+        return mem_alloc(tag, size);
+    if (size > (size_t)-1 - sizeof(MemHeader))
+        return NULL;
+    MemHeader *header = (MemHeader*)ptr - 1;
+    size_t old_size = header->info.size;
+    int old_tag = header->info.tag;
+    MemHeader *grown = realloc(header, sizeof(MemHeader) + size);
+    if (!grown)
+        return NULL;
+    grown->info.size = size;
+    if (size >= old_size)
+        account(old_tag, size - old_size, 1, size > old_size);
+    else
+        account(old_tag, old_size - size, 0, 0);
+    return grown + 1;
+}
+
+char *mem_strdup(MemTag tag, const char *s) {
+    size_t len = strlen(s) + 1;
+    char *copy = mem_alloc(tag, len);
+    if (copy)
+        memcpy(copy, s, len);
+    return copy;
+}
+
+void mem_free(void *ptr) {
+    if (!ptr)
+        return;
+    MemHeader *header = (MemHeader*)ptr - 1;
+    account(header->info.tag, header->info.size, 0, 1);
+    free(header);
+}
+
+void mem_stats(int tag, MemStats *out) {
+    memset(out, 0, sizeof(*out));
+    if (tag < 0 || tag > MEM_TAG_COUNT)
+        return;
+    out->current_bytes = __atomic_load_n(&current_bytes[tag], __ATOMIC_RELAXED);
+    out->peak_bytes = __atomic_load_n(&peak_bytes[tag], __ATOMIC_RELAXED);
+    out->allocations = __atomic_load_n(&allocation_count[tag], __ATOMIC_RELAXED);
+    out->frees = __atomic_load_n(&free_count[tag], __ATOMIC_RELAXED);
+}
+
+#ifdef MEMTRACK_COUNT_ALL
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+    tls_allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    tls_allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (size)
+        tls_allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+void *reallocarray(void *ptr, size_t count, size_t size) {
+    if (size && count > (size_t)-1 / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return realloc(ptr, count * size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    tls_allocations++;
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **out, size_t alignment, size_t size) {
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+    void *ptr = memalign(alignment, size);
+    if (!ptr)
+        return ENOMEM;
+    *out = ptr;
+    return 0;
+}
+#endif
+
+long mem_thread_allocations(void) {
+    return tls_allocations;
+}
+
+int mem_counts_all_allocations(void) {
+#ifdef MEMTRACK_COUNT_ALL
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+const char *mem_tag_name(int tag) {
+    return tag >= 0 && tag < MEM_TAG_COUNT ? tag_names[tag] : "total";
+}
+
+void mem_print_summary(FILE *out) {
+    MemStats stats;
+    fprintf(out, "Heap by subsystem, in KiB:\n");
+    fprintf(out, "  %-10s %10s %10s %8s %8s\n", "tag", "current", "peak", "allocs", "frees");
+    for (int i = 0; i <= MEM_TAG_COUNT; i++) {
+        mem_stats(i, &stats);
+        if (i < MEM_TAG_COUNT && stats.allocations == 0)
+            continue;
+        fprintf(out, "  %-10s %10.1f %10.1f %8ld %8ld\n", mem_tag_name(i), stats.current_bytes / 1024.0,
+                stats.peak_bytes / 1024.0, stats.allocations, stats.frees);
+    }
+}
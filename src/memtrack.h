@@ -0,0 +1,57 @@
+#ifndef MEMTRACK_H
+#define MEMTRACK_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Heap accounting per subsystem. mem_alloc and friends behave like malloc
+// and friends but keep the size and tag in a small header in front of each
+// block, so current and peak bytes and the number of allocations can be
+// reported per tag. Memory from them must be released with mem_free (and
+// not handed to code that calls free on it).
+
+typedef enum {
+    MEM_BULLETS,    // bullet pool
+    MEM_ENEMIES,    // enemy array
+    MEM_SCENARIO,   // --scenario groups
+    MEM_USER,       // usernames
+    MEM_KEYS,       // key files read for signing and verification
+    MEM_LEDGER,     // block batches and leaderboard tables
+    MEM_TAG_COUNT
+} MemTag;
+
+typedef struct {
+    size_t current_bytes;
+    size_t peak_bytes;
+    long allocations;  // mem_alloc, mem_calloc, mem_strdup and growing mem_realloc calls
+    long frees;
+} MemStats;
+
+void *mem_alloc(MemTag tag, size_t size);
+void *mem_calloc(MemTag tag, size_t count, size_t size);
+
+// Resizes a block from these functions; ptr may be NULL. The block keeps its tag.
+void *mem_realloc(MemTag tag, void *ptr, size_t size);
+
+char *mem_strdup(MemTag tag, const char *s);
+void mem_free(void *ptr);
+
+// Statistics of tag (MEM_TAG_COUNT: all tags together).
+void mem_stats(int tag, MemStats *out);
+
+// Heap allocations made by the calling thread so far; the difference
+// across a frame is that frame's allocation count. Only mem_* calls are
+// counted, unless mem_counts_all_allocations says otherwise.
+long mem_thread_allocations(void);
+
+// 1 if memtrack.c was built with MEMTRACK_INTERPOSE=1 on glibc, so that
+// mem_thread_allocations counts every malloc, calloc, realloc and aligned
+// allocation, including those made inside SDL and other libraries.
+int mem_counts_all_allocations(void);
+
+const char *mem_tag_name(int tag);
+
+// Prints current and peak bytes and allocation counts per tag.
+void mem_print_summary(FILE *out);
+
+#endif // MEMTRACK_H
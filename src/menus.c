@@ -1,5 +1,6 @@
 #include "menus.h"
 #include "debug.h"
+#include "text.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <string.h>
@@ -26,8 +27,6 @@ int pause_menu(SDL_Renderer *renderer, TTF_Font *font, int screen_width, int scr
         // Render centered.
         // (In a full implementation, you might use proper layout.)
         // Draw "PAUSED"
-        // (Assuming render_text is defined in your code base.)
-        extern void render_text(SDL_Renderer*, TTF_Font*, int, int, const char*, SDL_Color);
         render_text(renderer, font, screen_width/2 - 50, screen_height/2 - 80, "PAUSED", white);
         render_text(renderer, font, screen_width/2 - 70, screen_height/2 - 40, "Press Q/Escape to Resume", white);
         render_text(renderer, font, screen_width/2 - 50, screen_height/2, "Press X to Quit", white);
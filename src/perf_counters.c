@@ -0,0 +1,238 @@
+#define _DEFAULT_SOURCE  // syscall()
+#include "perf_counters.h"
+#include "config.h"
+#include "debug.h"
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+int g_counters_enabled = 0;
+
+static const struct {
+    const char *name;
+    uint64_t config;
+} counter_events[PERF_COUNTER_COUNT] = {
+    { "cycles", PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions", PERF_COUNT_HW_INSTRUCTIONS },
+    { "cache misses", PERF_COUNT_HW_CACHE_MISSES },
+    { "branch misses", PERF_COUNT_HW_BRANCH_MISSES }
+};
+
+typedef struct {
+    uint64_t value[PERF_COUNTER_COUNT];
+} PerfSample;
+
+// The counters of one thread, opened as a group so one read() returns all
+// of them from the same instant.
+typedef struct {
+    int fds[PERF_COUNTER_COUNT];    // -1 if the counter is unavailable
+    int slot[PERF_COUNTER_COUNT];   // position in the group read, -1 if unavailable
+    int leader;                     // fd the group is read from
+    int members;
+    int depth;                      // open regions, possibly beyond PERF_COUNTERS_DEPTH
+    int valid[PERF_COUNTERS_DEPTH];
+    PerfSample stack[PERF_COUNTERS_DEPTH];
+} PerfThread;
+
+typedef struct {
+    const char *name;
+    long calls, entities;
+    uint64_t total[PERF_COUNTER_COUNT];
+} PerfRegion;
+
+static PerfRegion regions[PERF_COUNTERS_REGIONS];  // in order of first use
+static int region_count = 0;
+static long regions_dropped = 0;
+static unsigned available = 0;  // bit per PerfCounter the first thread opened
+static pthread_mutex_t regions_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t thread_key;  // closes a thread's counters when it exits
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+static __thread PerfThread *tls_perf_thread = NULL;
+static __thread int tls_perf_error = 0;  // errno of a failed open; no retry
+
+static void close_thread(void *arg) {
+    PerfThread *t = arg;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (t->fds[i] >= 0)
+            close(t->fds[i]);
+    }
+    free(t);
+}
+
+static void create_thread_key(void) {
+    pthread_key_create(&thread_key, close_thread);
+}
+
+// The calling thread's counters, opened on first use; NULL if none can be.
+static PerfThread *perf_thread(void) {
+    if (tls_perf_thread || tls_perf_error)
+        return tls_perf_thread;
+    PerfThread *t = calloc(1, sizeof(PerfThread));
+    if (!t) {
+        tls_perf_error = ENOMEM;
+        return NULL;
+    }
+    t->leader = -1;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = counter_events[i].config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // This thread, on any CPU; the first counter that opens leads the group.
+        t->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, t->leader, 0);
+        if (t->fds[i] < 0) {
+            t->slot[i] = -1;
+            if (!tls_perf_error)
+                tls_perf_error = errno;
+            continue;
+        }
+        if (t->leader < 0)
+            t->leader = t->fds[i];
+        t->slot[i] = t->members++;
+    }
+    if (t->members == 0) {
+        free(t);
+        return NULL;
+    }
+    tls_perf_error = 0;
+    pthread_once(&thread_key_once, create_thread_key);
+    pthread_setspecific(thread_key, t);
+    tls_perf_thread = t;
+    return t;
+}
+
+static int read_sample(const PerfThread *t, PerfSample *out) {
+    uint64_t buf[3 + PERF_COUNTER_COUNT];  // nr, time enabled, time running, values
+    ssize_t n = read(t->leader, buf, sizeof(buf));
+    if (n < (ssize_t)((3 + t->members) * sizeof(uint64_t)))
+        return 0;
+    // When the kernel has to time-share the PMU, scale up to the full time.
+    double scale = buf[2] ? (double)buf[1] / (double)buf[2] : 0.0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        out->value[i] = t->slot[i] >= 0 ? (uint64_t)(buf[3 + t->slot[i]] * scale) : 0;
+    return 1;
+}
+
+void perf_counters_begin(void) {
+    PerfThread *t = perf_thread();
+    if (!t)
+        return;
+    if (t->depth < PERF_COUNTERS_DEPTH)
+        t->valid[t->depth] = read_sample(t, &t->stack[t->depth]);
+    t->depth++;
+}
+
+void perf_counters_end(const char *name, long entities) {
+    PerfThread *t = tls_perf_thread;
+    if (!t || t->depth == 0)
+        return;
+    t->depth--;
+    PerfSample now;
+    if (t->depth >= PERF_COUNTERS_DEPTH || !t->valid[t->depth] || !read_sample(t, &now))
+        return;
+    const PerfSample *start = &t->stack[t->depth];
+
+    pthread_mutex_lock(&regions_lock);
+    PerfRegion *region = NULL;
+    for (int i = 0; i < region_count && !region; i++) {
+        if (regions[i].name == name || strcmp(regions[i].name, name) == 0)
+            region = &regions[i];
+    }
+    if (!region && region_count < PERF_COUNTERS_REGIONS) {
+        region = &regions[region_count++];
+        region->name = name;
+    }
+    if (region) {
+        region->calls++;
+        region->entities += entities;
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+            region->total[i] += now.value[i] > start->value[i] ? now.value[i] - start->value[i] : 0;
+    } else {
+        regions_dropped++;
+    }
+    pthread_mutex_unlock(&regions_lock);
+}
+
+// Prints value / count, or n/a if the counter or the count is missing.
+static void print_ratio(FILE *out, int width, int counter, double value, double count) {
+    if (!(available & (1u << counter)) || count <= 0)
+        fprintf(out, " %*s", width, "n/a");
+    else
+        fprintf(out, " %*.2f", width, value / count);
+}
+
+void perf_counters_print_summary(FILE *out) {
+    pthread_mutex_lock(&regions_lock);
+    if (region_count > 0) {
+        fprintf(out, "Hardware counters per region (user space; a region includes the regions inside it):\n");
+        fprintf(out, "  %-24s %8s %12s %6s %11s %11s %11s %11s\n", "region", "calls", "cycles/call", "IPC",
+                "cmiss/call", "bmiss/call", "cmiss/ent", "bmiss/ent");
+        for (int i = 0; i < region_count; i++) {
+            const PerfRegion *r = &regions[i];
+            fprintf(out, "  %-24s %8ld", r->name, r->calls);
+            print_ratio(out, 12, PERF_CYCLES, (double)r->total[PERF_CYCLES], (double)r->calls);
+            if (available & (1u << PERF_CYCLES))
+                print_ratio(out, 6, PERF_INSTRUCTIONS, (double)r->total[PERF_INSTRUCTIONS], (double)r->total[PERF_CYCLES]);
+            else
+                fprintf(out, " %6s", "n/a");
+            print_ratio(out, 11, PERF_CACHE_MISSES, (double)r->total[PERF_CACHE_MISSES], (double)r->calls);
+            print_ratio(out, 11, PERF_BRANCH_MISSES, (double)r->total[PERF_BRANCH_MISSES], (double)r->calls);
+            print_ratio(out, 11, PERF_CACHE_MISSES, (double)r->total[PERF_CACHE_MISSES], (double)r->entities);
+            print_ratio(out, 11, PERF_BRANCH_MISSES, (double)r->total[PERF_BRANCH_MISSES], (double)r->entities);
+            fprintf(out, "\n");
+        }
+        if (regions_dropped)
+            fprintf(out, "  (%ld measurement(s) of further regions dropped; raise PERF_COUNTERS_REGIONS)\n",
+                    regions_dropped);
+    }
+    pthread_mutex_unlock(&regions_lock);
+}
+
+static void print_summary_at_exit(void) {
+    g_counters_enabled = 0;
+    perf_counters_print_summary(stdout);
+}
+
+// Why perf_event_open failed, in words.
+static const char *unavailable_reason(int error) {
+    switch (error) {
+        case EACCES:
+        case EPERM:
+            return "not permitted; lower /proc/sys/kernel/perf_event_paranoid or grant CAP_PERFMON";
+        case ENOENT:
+        case EOPNOTSUPP:
+            return "no hardware counters on this CPU or virtual machine";
+        case ENOSYS:
+            return "kernel built without perf events";
+        default:
+            return strerror(error);
+    }
+}
+
+int perf_counters_start(void) {
+    if (g_counters_enabled)
+        return 1;
+    PerfThread *t = perf_thread();
+    if (!t) {
+        DEBUG_PRINT(0, 1, "Hardware counters unavailable (%s); --counters does nothing",
+                    unavailable_reason(tls_perf_error));
+        return 0;
+    }
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (t->slot[i] >= 0)
+            available |= 1u << i;
+        else
+            DEBUG_PRINT(0, 1, "Hardware counter for %s unavailable; reported as n/a", counter_events[i].name);
+    }
+    g_counters_enabled = 1;
+    atexit(print_summary_at_exit);
+    return 1;
+}
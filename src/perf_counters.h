@@ -0,0 +1,43 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Hardware counters for --counters: cycles, instructions, cache misses and
+// branch misses of the calling thread (user space only), read with Linux
+// perf_event_open around every profiler stage and traced ledger operation.
+// Each thread opens its own counter group the first time it measures.
+// Counters the kernel or CPU does not offer (containers, VMs,
+// perf_event_paranoid) are reported as n/a; without any, measuring does
+// nothing.
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTER_COUNT
+} PerfCounter;
+
+// Regions are only measured while this is set.
+extern int g_counters_enabled;
+
+// Opens the counters of the calling thread and, if any work, enables
+// measuring and prints the per-region summary at exit. Returns 1 if at
+// least one counter is available.
+int perf_counters_start(void);
+
+// Starts a region on the calling thread. Regions may nest; each one counts
+// everything inside it.
+void perf_counters_begin(void);
+
+// Ends the innermost region and adds its counts to the totals of name (a
+// string literal or other static string). entities is the number of
+// bullets and enemies it worked on, or 0 if that does not apply.
+void perf_counters_end(const char *name, long entities);
+
+// Prints calls, cycles, IPC and misses per call and per entity of every region.
+void perf_counters_print_summary(FILE *out);
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,95 @@
+#include "perf_overlay.h"
+#include "profiler.h"
+#include "config.h"
+#include "memtrack.h"
+#include "text.h"
+#include <stdio.h>
+
+#define GRAPH_HEIGHT 100
+#define LINE_HEIGHT 14
+
+static const SDL_Color stage_colors[PROF_STAGE_COUNT] = {
+    {230, 230, 230, 255}, {150, 150, 150, 255}, { 80, 160, 255, 255}, {  0, 200, 200, 255},
+    {  0, 120, 255, 255}, {255,  80,  80, 255}, {255, 140,  60, 255}, {255, 200,  60, 255},
+    {120, 220,  80, 255}, {200, 120, 255, 255}, {255, 120, 200, 255}, {180,  80, 160, 255},
+    { 60, 200, 120, 255}, {255, 165,   0, 255}, {255, 255, 255, 255}, {100, 100, 220, 255},
+    { 40,  40,  60, 255}
+};
+
+void draw_perf_overlay(SDL_Renderer* renderer, TTF_Font* font, const PerfCounts* counts, int screen_width, int screen_height) {
+    SDL_BlendMode blend;
+    SDL_GetRenderDrawBlendMode(renderer, &blend);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+
+    // Panel along the right edge: graph on top, then the table.
+    int width = PROFILER_HISTORY + 20;
+    int height = GRAPH_HEIGHT + (PROF_STAGE_COUNT + 6) * LINE_HEIGHT + 30;
+    int x0 = screen_width - width - 10;
+    int y0 = 10;
+    if (height > screen_height - 20)
+        height = screen_height - 20;
+    SDL_Rect panel = { x0, y0, width, height };
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 170);
+    SDL_RenderFillRect(renderer, &panel);
+
+    // Stacked frame-time graph, newest frame on the right.
+    int gx = x0 + 10, gy = y0 + 10 + GRAPH_HEIGHT;
+    float scale = (float)GRAPH_HEIGHT / PROFILER_GRAPH_MS;
+    int frames = profiler_frames();
+    for (int age = 0; age < frames; age++) {
+        int column = gx + PROFILER_HISTORY - 1 - age;
+        float bottom = 0.0f;
+        for (int s = 0; s < PROF_STAGE_COUNT && bottom < GRAPH_HEIGHT; s++) {
+            float top = bottom + profiler_frame_ms(s, age) * scale;
+            if (top > GRAPH_HEIGHT)
+                top = GRAPH_HEIGHT;
+            if ((int)top > (int)bottom) {
+                SDL_Color c = stage_colors[s];
+                SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, 220);
+                SDL_RenderDrawLine(renderer, column, gy - (int)bottom, column, gy - (int)top + 1);
+            }
+            bottom = top;
+        }
+    }
+    // 60 fps budget line.
+    int budget_y = gy - (int)(16.7f * scale);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 120);
+    SDL_RenderDrawLine(renderer, gx, budget_y, gx + PROFILER_HISTORY - 1, budget_y);
+
+    SDL_Color white = {255, 255, 255, 255};
+    char line[128];
+    int y = gy + 6;
+    ProfStats stats;
+    profiler_stats(PROF_STAGE_COUNT, &stats);
+    snprintf(line, sizeof(line), "frame %.2f ms  avg %.2f  p99 %.2f", stats.last_ms, stats.avg_ms, stats.p99_ms);
+    render_text(renderer, font, gx, y, line, white);
+    y += LINE_HEIGHT + 2;
+    snprintf(line, sizeof(line), "bullets %d/%d  enemies %d  bg %d",
+             counts->live_bullets, counts->bullet_capacity, counts->active_enemies, counts->visible_background);
+    render_text(renderer, font, gx, y, line, white);
+    y += LINE_HEIGHT + 2;
+    snprintf(line, sizeof(line), "high water: bullets %d  enemies %d", counts->bullet_high_water, counts->enemy_high_water);
+    render_text(renderer, font, gx, y, line, white);
+    y += LINE_HEIGHT + 2;
+    MemStats heap;
+    mem_stats(MEM_TAG_COUNT, &heap);
+    snprintf(line, sizeof(line), "heap %.0f KiB  peak %.0f  allocs/frame %ld",
+             heap.current_bytes / 1024.0, heap.peak_bytes / 1024.0, counts->frame_allocations);
+    render_text(renderer, font, gx, y, line, white);
+    y += LINE_HEIGHT + 4;
+    snprintf(line, sizeof(line), "%-14s %6s %6s %6s", "ms", "min", "avg", "p99");
+    render_text(renderer, font, gx + 12, y, line, white);
+    y += LINE_HEIGHT;
+    for (int s = 0; s < PROF_STAGE_COUNT && y + LINE_HEIGHT <= y0 + height; s++) {
+        profiler_stats(s, &stats);
+        SDL_Color c = stage_colors[s];
+        SDL_Rect swatch = { gx, y + 3, 8, 8 };
+        SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, 255);
+        SDL_RenderFillRect(renderer, &swatch);
+        snprintf(line, sizeof(line), "%-14s %6.2f %6.2f %6.2f", profiler_stage_name(s), stats.min_ms, stats.avg_ms, stats.p99_ms);
+        render_text(renderer, font, gx + 12, y, line, white);
+        y += LINE_HEIGHT;
+    }
+
+    SDL_SetRenderDrawBlendMode(renderer, blend);
+}
@@ -0,0 +1,23 @@
+#ifndef PERF_OVERLAY_H
+#define PERF_OVERLAY_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+// Entity counts shown next to the frame profile.
+typedef struct {
+    int live_bullets;
+    int bullet_capacity;
+    int active_enemies;
+    int visible_background;  // background objects drawn this frame
+    int bullet_high_water;   // most bullet slots / enemies in use so far
+    int enemy_high_water;
+    long frame_allocations;  // heap allocations made by the last frame
+} PerfCounts;
+
+// Draws the profiler overlay: a stacked graph of the recorded frame times
+// (one column per frame, one colour per stage), min/avg/p99 per stage, the
+// entity counts and the heap use. Toggled in game with F3.
+void draw_perf_overlay(SDL_Renderer* renderer, TTF_Font* font, const PerfCounts* counts, int screen_width, int screen_height);
+
+#endif
@@ -0,0 +1,128 @@
+#include "profiler.h"
+#include "config.h"
+#include "perf_counters.h"
+#include <stdlib.h>
+#include <string.h>
+
+int g_profiler_enabled = 0;
+
+static const char *stage_names[PROF_STAGE_COUNT + 1] = {
+    "input", "events", "update player", "spawn", "update enemies",
+    "hit enemies", "hit player", "ram player", "background", "hud",
+    "draw bullets", "draw enemies", "draw player", "explosions", "overlay",
+    "present", "sleep", "frame"
+};
+
+// Stages whose work grows with the number of bullets and enemies.
+static const char stage_loops_entities[PROF_STAGE_COUNT] = {
+    [PROF_UPDATE_PLAYER] = 1, [PROF_UPDATE_ENEMIES] = 1, [PROF_HIT_ENEMIES] = 1,
+    [PROF_HIT_PLAYER] = 1, [PROF_RAM_PLAYER] = 1, [PROF_DRAW_BULLETS] = 1, [PROF_DRAW_ENEMIES] = 1
+};
+
+static uint64_t current[PROF_STAGE_COUNT];                        // this frame so far
+static float history[PROFILER_HISTORY][PROF_STAGE_COUNT + 1];    // ms; last column is the whole frame
+static int history_next = 0, history_count = 0;
+static uint64_t frame_start = 0;
+static uint64_t trace_frame_start = 0;
+static long frame_entities = 0;
+
+uint64_t profiler_now_ns(void) {
+    return trace_now_ns();
+}
+
+uint64_t profiler_stage_begin(void) {
+    if (g_counters_enabled)
+        perf_counters_begin();
+    return profiler_now_ns();
+}
+
+void profiler_set_entities(long count) {
+    frame_entities = count;
+}
+
+void profiler_add(ProfStage stage, uint64_t start_ns) {
+    uint64_t now = profiler_now_ns();
+    if (g_counters_enabled)
+        perf_counters_end(stage_names[stage], stage_loops_entities[stage] ? frame_entities : 0);
+    if (g_profiler_enabled)
+        current[stage] += now - start_ns;
+    if (g_trace_enabled)
+        trace_complete(stage_names[stage], start_ns, now);
+}
+
+void profiler_frame_end(void) {
+    if (g_trace_enabled) {
+        uint64_t now = trace_now_ns();
+        if (trace_frame_start)
+            trace_complete("frame", trace_frame_start, now);
+        trace_frame_start = now;
+    }
+    if (!g_profiler_enabled) {
+        frame_start = 0;  // the next enabled frame starts a fresh measurement
+        return;
+    }
+    uint64_t now = profiler_now_ns();
+    if (frame_start) {
+        float *row = history[history_next];
+        for (int i = 0; i < PROF_STAGE_COUNT; i++)
+            row[i] = (float)(current[i] / 1e6);
+        row[PROF_STAGE_COUNT] = (float)((now - frame_start) / 1e6);
+        history_next = (history_next + 1) % PROFILER_HISTORY;
+        if (history_count < PROFILER_HISTORY)
+            history_count++;
+    }
+    memset(current, 0, sizeof(current));
+    frame_start = now;
+}
+
+static int compare_floats(const void *a, const void *b) {
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+int profiler_stats(int stage, ProfStats *out) {
+    memset(out, 0, sizeof(*out));
+    if (history_count == 0 || stage < 0 || stage > PROF_STAGE_COUNT)
+        return 0;
+    float sorted[PROFILER_HISTORY];
+    double sum = 0;
+    for (int i = 0; i < history_count; i++) {
+        sorted[i] = history[i][stage];
+        sum += sorted[i];
+    }
+    qsort(sorted, (size_t)history_count, sizeof(float), compare_floats);
+    int p99 = (history_count * 99 + 99) / 100 - 1;  // ceil(0.99 n) - 1
+    out->min_ms = sorted[0];
+    out->avg_ms = sum / history_count;
+    out->p99_ms = sorted[p99];
+    out->last_ms = profiler_frame_ms(stage, 0);
+    return history_count;
+}
+
+float profiler_frame_ms(int stage, int age) {
+    if (age < 0 || age >= history_count || stage < 0 || stage > PROF_STAGE_COUNT)
+        return 0.0f;
+    int row = (history_next - 1 - age + PROFILER_HISTORY) % PROFILER_HISTORY;
+    return history[row][stage];
+}
+
+int profiler_frames(void) {
+    return history_count;
+}
+
+const char *profiler_stage_name(int stage) {
+    return stage >= 0 && stage <= PROF_STAGE_COUNT ? stage_names[stage] : "?";
+}
+
+void profiler_print_summary(FILE *out) {
+    ProfStats stats;
+    int frames = profiler_stats(PROF_STAGE_COUNT, &stats);
+    if (frames == 0)
+        return;
+    fprintf(out, "Frame profile over the last %d frame(s), in ms:\n", frames);
+    fprintf(out, "  %-15s %8s %8s %8s\n", "stage", "min", "avg", "p99");
+    for (int i = 0; i <= PROF_STAGE_COUNT; i++) {
+        profiler_stats(i, &stats);
+        fprintf(out, "  %-15s %8.3f %8.3f %8.3f\n", profiler_stage_name(i), stats.min_ms, stats.avg_ms, stats.p99_ms);
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "trace.h"
+
+// Per-stage frame profiler for game_loop. Each stage's time is summed over a
+// frame; profiler_frame_end stores the frame in a ring of PROFILER_HISTORY
+// frames that the statistics and the overlay read. While --trace records,
+// every stage and frame is also a trace event, and under --counters every
+// stage is a hardware counter region.
+
+// Stages of one frame, in the order they run.
+typedef enum {
+    PROF_INPUT,            // keyboard state, player controls / dev AI
+    PROF_EVENTS,           // SDL event queue, pause menu
+    PROF_UPDATE_PLAYER,    // player, shield and bullet movement
+    PROF_SPAWN,            // enemy spawning
+    PROF_UPDATE_ENEMIES,   // update_enemies
+    PROF_HIT_ENEMIES,      // player bullets vs enemies
+    PROF_HIT_PLAYER,       // enemy bullets vs player
+    PROF_RAM_PLAYER,       // enemies vs player
+    PROF_BACKGROUND,       // draw_background
+    PROF_HUD,              // render_text of the HUD
+    PROF_DRAW_BULLETS,
+    PROF_DRAW_ENEMIES,
+    PROF_DRAW_PLAYER,
+    PROF_EXPLOSIONS,
+    PROF_OVERLAY,          // the profiler overlay itself
+    PROF_PRESENT,          // SDL_RenderPresent (waits for vsync)
+    PROF_SLEEP,            // SDL_Delay
+    PROF_STAGE_COUNT
+} ProfStage;
+
+typedef struct {
+    double min_ms, avg_ms, p99_ms, last_ms;
+} ProfStats;
+
+// Timers only read the clock while this is set (toggled with F3, or --profile).
+extern int g_profiler_enabled;
+
+// Monotonic time in nanoseconds.
+uint64_t profiler_now_ns(void);
+
+// Start of a stage: the time, after starting its counter region when
+// counting. Stages must not nest.
+uint64_t profiler_stage_begin(void);
+
+// Adds the time since start_ns to stage in the current frame (and records it
+// as a trace event when tracing, and its counters when counting).
+void profiler_add(ProfStage stage, uint64_t start_ns);
+
+// Bullets and enemies alive this frame, which the counters of the stages
+// that loop over them are divided by.
+void profiler_set_entities(long count);
+
+// Closes the current frame and records its stage times and wall time.
+// Call once per frame even when profiling is off.
+void profiler_frame_end(void);
+
+// Fills out with the rolling statistics of stage over the recorded frames
+// (stage == PROF_STAGE_COUNT gives the whole frame). Returns the number of
+// frames they cover.
+int profiler_stats(int stage, ProfStats *out);
+
+// Milliseconds spent in stage (PROF_STAGE_COUNT: whole frame) age frames ago,
+// 0 being the latest recorded frame. Returns 0 beyond the recorded history.
+float profiler_frame_ms(int stage, int age);
+
+// Number of frames recorded so far, up to PROFILER_HISTORY.
+int profiler_frames(void);
+
+const char *profiler_stage_name(int stage);
+
+// Prints the statistics table of every stage.
+void profiler_print_summary(FILE *out);
+
+// Times the statement or block that follows as stage; costs one branch when
+// none of the profiler, tracing or counters is on. Do not leave the block
+// with break or return.
+//   PROFILE_STAGE(PROF_BACKGROUND) draw_background(...);
+#define PROFILE_STAGE(stage) \
+    for (uint64_t prof_t0_ = (g_profiler_enabled | g_trace_enabled | g_counters_enabled) ? profiler_stage_begin() : 0, \
+         prof_once_ = 1; prof_once_; \
+         prof_once_ = 0, prof_t0_ ? profiler_add((stage), prof_t0_) : (void)0)
+
+#endif // PROFILER_H
@@ -0,0 +1,183 @@
+#include "replay.h"
+#include "debug.h"
+#include <stdio.h>
+#include <string.h>
+
+/* File layout (integers little-endian):
+ *   "QSREPLAY", version byte, then the five ReplayHeader fields as int32
+ *   per frame: events byte, keys uint16, clock step byte (seconds since the
+ *              previous frame; 255 is followed by the absolute clock as uint32)
+ *   trailer:   REPLAY_END byte, then score, kills and frames as int32
+ */
+#define REPLAY_MAGIC "QSREPLAY"
+#define REPLAY_VERSION 1
+#define REPLAY_END 0x80
+#define REPLAY_CLOCK_ABSOLUTE 255
+
+static FILE *replay_file = NULL;
+static uint32_t replay_clock = 0;
+static int replay_has_result = 0;
+static int32_t replay_result[3];  // score, kills, frames
+
+static const struct {
+    SDL_Scancode scancode;
+    uint16_t bit;
+} replay_keymap[] = {
+    { SDL_SCANCODE_LCTRL, REPLAY_KEY_LCTRL },   { SDL_SCANCODE_RCTRL, REPLAY_KEY_RCTRL },
+    { SDL_SCANCODE_LEFT, REPLAY_KEY_LEFT },     { SDL_SCANCODE_RIGHT, REPLAY_KEY_RIGHT },
+    { SDL_SCANCODE_DOWN, REPLAY_KEY_DOWN },     { SDL_SCANCODE_UP, REPLAY_KEY_UP },
+    { SDL_SCANCODE_RSHIFT, REPLAY_KEY_RSHIFT }, { SDL_SCANCODE_W, REPLAY_KEY_W },
+    { SDL_SCANCODE_S, REPLAY_KEY_S },           { SDL_SCANCODE_A, REPLAY_KEY_A },
+    { SDL_SCANCODE_D, REPLAY_KEY_D },           { SDL_SCANCODE_SPACE, REPLAY_KEY_SPACE },
+    { SDL_SCANCODE_E, REPLAY_KEY_E }
+};
+
+uint16_t replay_keys_from_state(const Uint8 *keystate) {
+    uint16_t keys = 0;
+    for (size_t i = 0; i < sizeof(replay_keymap) / sizeof(replay_keymap[0]); i++) {
+        if (keystate[replay_keymap[i].scancode])
+            keys |= replay_keymap[i].bit;
+    }
+    return keys;
+}
+
+static void put_u16(uint16_t value) {
+    fputc(value & 0xff, replay_file);
+    fputc(value >> 8, replay_file);
+}
+
+static void put_i32(int32_t value) {
+    uint32_t u = (uint32_t)value;
+    for (int i = 0; i < 4; i++)
+        fputc((u >> (8 * i)) & 0xff, replay_file);
+}
+
+// Reads count little-endian bytes; returns 0 at end of file.
+static int get_bytes(uint32_t *value, int count) {
+    *value = 0;
+    for (int i = 0; i < count; i++) {
+        int c = fgetc(replay_file);
+        if (c == EOF)
+            return 0;
+        *value |= (uint32_t)c << (8 * i);
+    }
+    return 1;
+}
+
+int replay_record_open(const char *path, const ReplayHeader *header) {
+    replay_file = fopen(path, "wb");
+    if (!replay_file) {
+        DEBUG_PRINT(0, 0, "Cannot create replay file %s", path);
+        return 0;
+    }
+    fwrite(REPLAY_MAGIC, 1, strlen(REPLAY_MAGIC), replay_file);
+    fputc(REPLAY_VERSION, replay_file);
+    put_i32((int32_t)header->seed);
+    put_i32(header->screen_width);
+    put_i32(header->screen_height);
+    put_i32(header->dev_auto_mode);
+    put_i32(header->forced_enemy_type);
+    replay_clock = 0;
+    DEBUG_PRINT(1, 3, "Recording inputs to %s (seed %u)", path, header->seed);
+    return 1;
+}
+
+void replay_record_frame(const ReplayFrame *frame) {
+    if (!replay_file)
+        return;
+    fputc(frame->events, replay_file);
+    put_u16(frame->keys);
+    uint32_t step = frame->clock - replay_clock;
+    if (frame->clock >= replay_clock && step < REPLAY_CLOCK_ABSOLUTE) {
+        fputc((int)step, replay_file);
+    } else {
+        fputc(REPLAY_CLOCK_ABSOLUTE, replay_file);
+        put_i32((int32_t)frame->clock);
+    }
+    replay_clock = frame->clock;
+}
+
+void replay_record_close(int score, int kills, int frames) {
+    if (!replay_file)
+        return;
+    fputc(REPLAY_END, replay_file);
+    put_i32(score);
+    put_i32(kills);
+    put_i32(frames);
+    if (fclose(replay_file) != 0)
+        DEBUG_PRINT(0, 0, "Error writing the replay file");
+    replay_file = NULL;
+}
+
+int replay_open(const char *path, ReplayHeader *header) {
+    replay_file = fopen(path, "rb");
+    if (!replay_file) {
+        DEBUG_PRINT(0, 0, "Cannot open replay file %s", path);
+        return 0;
+    }
+    char magic[sizeof(REPLAY_MAGIC) - 1];
+    uint32_t fields[5];
+    int ok = fread(magic, 1, sizeof(magic), replay_file) == sizeof(magic) &&
+             memcmp(magic, REPLAY_MAGIC, sizeof(magic)) == 0 &&
+             fgetc(replay_file) == REPLAY_VERSION;
+    for (int i = 0; ok && i < 5; i++)
+        ok = get_bytes(&fields[i], 4);
+    if (!ok) {
+        DEBUG_PRINT(0, 0, "%s is not a replay file of this version", path);
+        replay_close();
+        return 0;
+    }
+    header->seed = fields[0];
+    header->screen_width = (int32_t)fields[1];
+    header->screen_height = (int32_t)fields[2];
+    header->dev_auto_mode = (int32_t)fields[3];
+    header->forced_enemy_type = (int32_t)fields[4];
+    replay_clock = 0;
+    replay_has_result = 0;
+    return 1;
+}
+
+int replay_read_frame(ReplayFrame *frame) {
+    if (!replay_file)
+        return 0;
+    int events = fgetc(replay_file);
+    if (events == EOF)
+        return 0;
+    uint32_t value;
+    if (events == REPLAY_END) {
+        replay_has_result = 1;
+        for (int i = 0; i < 3 && replay_has_result; i++) {
+            replay_has_result = get_bytes(&value, 4);
+            replay_result[i] = (int32_t)value;
+        }
+        return 0;
+    }
+    uint32_t keys, step;
+    if (!get_bytes(&keys, 2) || !get_bytes(&step, 1))
+        return 0;
+    if (step == REPLAY_CLOCK_ABSOLUTE) {
+        if (!get_bytes(&replay_clock, 4))
+            return 0;
+    } else {
+        replay_clock += step;
+    }
+    frame->events = (uint8_t)events;
+    frame->keys = (uint16_t)keys;
+    frame->clock = replay_clock;
+    return 1;
+}
+
+int replay_recorded_result(int *score, int *kills, int *frames) {
+    if (!replay_has_result)
+        return 0;
+    *score = replay_result[0];
+    *kills = replay_result[1];
+    *frames = replay_result[2];
+    return 1;
+}
+
+void replay_close(void) {
+    if (replay_file)
+        fclose(replay_file);
+    replay_file = NULL;
+}
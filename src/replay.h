@@ -0,0 +1,78 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+
+// Input recording (--record) and replay (--replay) of a game_loop session.
+// A session is deterministic given the RNG seed, the screen size the dev AI
+// sees, the keys read each frame, the pause menu outcomes and the seconds on
+// the score clock, so that is all a replay file holds: a small header and
+// about 4 bytes per frame.
+
+// Keys game_loop reads, as bits of ReplayFrame.keys.
+enum {
+    REPLAY_KEY_LCTRL  = 1 << 0,
+    REPLAY_KEY_RCTRL  = 1 << 1,
+    REPLAY_KEY_LEFT   = 1 << 2,
+    REPLAY_KEY_RIGHT  = 1 << 3,
+    REPLAY_KEY_DOWN   = 1 << 4,
+    REPLAY_KEY_UP     = 1 << 5,
+    REPLAY_KEY_RSHIFT = 1 << 6,
+    REPLAY_KEY_W      = 1 << 7,
+    REPLAY_KEY_S      = 1 << 8,
+    REPLAY_KEY_A      = 1 << 9,
+    REPLAY_KEY_D      = 1 << 10,
+    REPLAY_KEY_SPACE  = 1 << 11,
+    REPLAY_KEY_E      = 1 << 12
+};
+
+// Events that changed the session, as bits of ReplayFrame.events.
+enum {
+    REPLAY_EVENT_QUIT       = 1 << 0,  // window closed: the loop ends without a game over
+    REPLAY_EVENT_PAUSE      = 1 << 1,  // pause menu opened and resumed
+    REPLAY_EVENT_PAUSE_QUIT = 1 << 2,  // "quit" chosen in the pause menu
+    REPLAY_EVENT_INTERRUPT  = 1 << 3   // SIGINT seen before this frame
+};
+
+typedef struct {
+    uint32_t seed;          // srand seed of the session
+    int32_t screen_width;
+    int32_t screen_height;
+    int32_t dev_auto_mode;
+    int32_t forced_enemy_type;
+} ReplayHeader;
+
+typedef struct {
+    uint16_t keys;    // REPLAY_KEY_* held this frame
+    uint8_t events;   // REPLAY_EVENT_* that happened this frame
+    uint32_t clock;   // whole seconds since the session started
+} ReplayFrame;
+
+// The REPLAY_KEY_* bits of an SDL_GetKeyboardState array.
+uint16_t replay_keys_from_state(const Uint8 *keystate);
+
+// Creates path and writes header. Returns 1 on success, 0 on error.
+int replay_record_open(const char *path, const ReplayHeader *header);
+
+// Appends one frame; call once per simulated frame, in order.
+void replay_record_frame(const ReplayFrame *frame);
+
+// Writes the session's outcome (checked when it is replayed) and closes the file.
+void replay_record_close(int score, int kills, int frames);
+
+// Opens a recording and reads its header. Returns 1 on success, 0 if path
+// cannot be read or is not a replay file.
+int replay_open(const char *path, ReplayHeader *header);
+
+// Reads the next frame. Returns 1 if one was read, 0 at the end of the recording.
+int replay_read_frame(ReplayFrame *frame);
+
+// Once replay_read_frame has returned 0: the outcome stored by
+// replay_record_close. Returns 0 if the recording stops without one
+// (the recording program was killed).
+int replay_recorded_result(int *score, int *kills, int *frames);
+
+void replay_close(void);
+
+#endif // REPLAY_H
@@ -0,0 +1,249 @@
+#include "scenario.h"
+#include "config.h"
+#include "debug.h"
+#include "memtrack.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define SCENARIO_MAX_TOKENS 16
+
+static const char *enemy_type_names[] = {
+    "BASIC", "SHOOTER", "TANK", "EVASIVE", "FAST", "SPLITTER",
+    "STEALTH", "SHIELD", "BOSS1", "BOSS2", "BOSS3"
+};
+
+static int parse_enemy_type(const char *name) {
+    for (int i = 0; i < (int)(sizeof(enemy_type_names) / sizeof(enemy_type_names[0])); i++) {
+        if (strcasecmp(name, enemy_type_names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static int parse_number(const char *text, double *value) {
+    char *end;
+    *value = strtod(text, &end);
+    return end != text && *end == '\0';
+}
+
+// Parses "SHAPE args..." from tokens into group; returns 0 on a bad shape.
+static int parse_shape(char **tokens, int count, ScenarioGroup *group) {
+    static const struct { const char *name; ScenarioShape shape; int args; } shapes[] = {
+        { "point", SCENARIO_POINT, 2 }, { "ring", SCENARIO_RING, 2 },
+        { "grid", SCENARIO_GRID, 1 },   { "box", SCENARIO_BOX, 4 }
+    };
+    if (count < 1)
+        return 0;
+    for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++) {
+        if (strcmp(tokens[0], shapes[i].name) != 0)
+            continue;
+        if (count != shapes[i].args + 1)
+            return 0;
+        for (int a = 0; a < shapes[i].args; a++) {
+            double value;
+            if (!parse_number(tokens[a + 1], &value))
+                return 0;
+            group->args[a] = (float)value;
+        }
+        group->shape = shapes[i].shape;
+        return 1;
+    }
+    return 0;
+}
+
+static int seconds_to_frames(double seconds, int frame_ms) {
+    return (int)lround(seconds * 1000.0 / frame_ms);
+}
+
+// Parses one directive; returns an error message or NULL.
+static const char *parse_line(char **tokens, int count, int frame_ms, Scenario *scenario, int *enemy_total) {
+    ScenarioGroup group = {0};
+    group.first_frame = 1;
+    double value;
+    // Schedule prefixes.
+    while (count >= 2 && (strcmp(tokens[0], "at") == 0 || strcmp(tokens[0], "every") == 0)) {
+        if (!parse_number(tokens[1], &value) || value < 0)
+            return "expected a number of seconds";
+        if (tokens[0][0] == 'a') {
+            group.first_frame = 1 + seconds_to_frames(value, frame_ms);
+        } else {
+            group.every_frames = seconds_to_frames(value, frame_ms);
+            if (group.every_frames < 1)
+                return "every needs a period of at least one frame";
+        }
+        tokens += 2;
+        count -= 2;
+    }
+    const char *directive = tokens[0];
+    int scheduled = group.first_frame != 1 || group.every_frames;
+
+    if (strcmp(directive, "enemies") == 0 || strcmp(directive, "bullets") == 0) {
+        group.is_bullets = directive[0] == 'b';
+        if (count < 4)
+            return group.is_bullets ? "usage: bullets COUNT player|enemy SHAPE ..." : "usage: enemies TYPE COUNT SHAPE ...";
+        const char *count_text = group.is_bullets ? tokens[1] : tokens[2];
+        const char *kind = group.is_bullets ? tokens[2] : tokens[1];
+        if (!parse_number(count_text, &value) || value < 1 || value > 10000000 || value != floor(value))
+            return "expected a positive whole count";
+        group.count = (int)value;
+        if (group.is_bullets) {
+            if (strcmp(kind, "player") != 0 && strcmp(kind, "enemy") != 0)
+                return "bullets belong to player or enemy";
+            group.type = kind[0] == 'e';
+        } else {
+            group.type = parse_enemy_type(kind);
+            if (group.type < 0)
+                return "unknown enemy type (BASIC, SHOOTER, TANK, EVASIVE, FAST, SPLITTER, STEALTH, SHIELD, BOSS1-3)";
+            *enemy_total += group.count;
+        }
+        if (!parse_shape(tokens + 3, count - 3, &group))
+            return "expected point X Y, ring MIN MAX, grid SPACING or box X0 Y0 X1 Y1";
+        ScenarioGroup *grown = mem_realloc(MEM_SCENARIO, scenario->groups, (scenario->group_count + 1) * sizeof(ScenarioGroup));
+        if (!grown)
+            return "out of memory";
+        scenario->groups = grown;
+        scenario->groups[scenario->group_count++] = group;
+        return NULL;
+    }
+
+    if (scheduled)
+        return "only enemies and bullets can be scheduled";
+    if (strcmp(directive, "spawning") == 0 && count == 2 &&
+        (strcmp(tokens[1], "on") == 0 || strcmp(tokens[1], "off") == 0)) {
+        scenario->natural_spawns = strcmp(tokens[1], "on") == 0;
+        return NULL;
+    }
+    if (count != 2 || !parse_number(tokens[1], &value) || value < 0)
+        return "unknown directive or bad value";
+    if (strcmp(directive, "seed") == 0) {
+        scenario->seed = (unsigned int)value;
+        scenario->has_seed = 1;
+    } else if (strcmp(directive, "duration") == 0) {
+        scenario->duration_frames = seconds_to_frames(value, frame_ms);
+    } else if (strcmp(directive, "capacity") == 0) {
+        scenario->enemy_capacity = (int)value;
+    } else if (strcmp(directive, "health") == 0) {
+        scenario->player_health = (int)value;
+    } else {
+        return "unknown directive";
+    }
+    return NULL;
+}
+
+int scenario_load(const char *path, int frame_ms, Scenario *scenario) {
+    memset(scenario, 0, sizeof(*scenario));
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        DEBUG_PRINT(0, 0, "Cannot open scenario file %s", path);
+        return 0;
+    }
+    char line[512];
+    int line_no = 0, enemy_total = 0, capacity_set = 0;
+    const char *error = NULL;
+    while (!error && fgets(line, sizeof(line), fp)) {
+        line_no++;
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+        char *tokens[SCENARIO_MAX_TOKENS];
+        int count = 0;
+        for (char *tok = strtok(line, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n")) {
+            if (count == SCENARIO_MAX_TOKENS) {
+                error = "too many words";
+                break;
+            }
+            tokens[count++] = tok;
+        }
+        if (error || count == 0)
+            continue;
+        if (strcmp(tokens[0], "capacity") == 0)
+            capacity_set = 1;
+        error = parse_line(tokens, count, frame_ms, scenario, &enemy_total);
+    }
+    fclose(fp);
+    if (error) {
+        DEBUG_PRINT(0, 0, "%s:%d: %s", path, line_no, error);
+        scenario_free(scenario);
+        return 0;
+    }
+    if (!capacity_set)
+        scenario->enemy_capacity = enemy_total;
+    if (scenario->enemy_capacity < MAX_ENEMIES)
+        scenario->enemy_capacity = MAX_ENEMIES;
+    DEBUG_PRINT(1, 3, "Scenario %s: %d group(s), %d enemy slot(s), %d frame(s)", path,
+                scenario->group_count, scenario->enemy_capacity, scenario->duration_frames);
+    return 1;
+}
+
+void scenario_free(Scenario *scenario) {
+    mem_free(scenario->groups);
+    scenario->groups = NULL;
+    scenario->group_count = 0;
+}
+
+static float random_between(float lo, float hi) {
+    return lo + (hi - lo) * ((float)rand() / (float)RAND_MAX);
+}
+
+// Position of member i of group, relative to the player.
+static void group_position(const ScenarioGroup *group, int i, float *x, float *y) {
+    switch (group->shape) {
+    case SCENARIO_POINT:
+    default:
+        *x = group->args[0];
+        *y = group->args[1];
+        break;
+    case SCENARIO_RING: {
+        // Uniform over the annulus area.
+        float r0 = group->args[0], r1 = group->args[1];
+        float r = sqrtf(random_between(r0 * r0, r1 * r1));
+        float angle = random_between(0.0f, 2.0f * (float)M_PI);
+        *x = cosf(angle) * r;
+        *y = sinf(angle) * r;
+        break;
+    }
+    case SCENARIO_GRID: {
+        int side = (int)ceilf(sqrtf((float)group->count));
+        float origin = -(side - 1) * group->args[0] / 2;
+        *x = origin + (i % side) * group->args[0];
+        *y = origin + (i / side) * group->args[0];
+        break;
+    }
+    case SCENARIO_BOX:
+        *x = random_between(group->args[0], group->args[2]);
+        *y = random_between(group->args[1], group->args[3]);
+        break;
+    }
+}
+
+void scenario_apply(const Scenario *scenario, int frame, float player_x, float player_y,
+                    Enemy enemies[], int enemy_count, BulletPool *pool) {
+    for (int g = 0; g < scenario->group_count; g++) {
+        const ScenarioGroup *group = &scenario->groups[g];
+        int since = frame - group->first_frame;
+        if (since < 0 || (since > 0 && (!group->every_frames || since % group->every_frames)))
+            continue;
+        int slot = 0, placed = 0;
+        for (int i = 0; i < group->count; i++) {
+            float x, y;
+            group_position(group, i, &x, &y);
+            if (group->is_bullets) {
+                shoot_bullet(pool, player_x + x, player_y + y, random_between(0.0f, 360.0f), group->type);
+                placed++;
+                continue;
+            }
+            while (slot < enemy_count && enemies[slot].active)
+                slot++;
+            if (slot == enemy_count)
+                break;
+            place_enemy(&enemies[slot], (EnemyType)group->type, player_x + x, player_y + y);
+            enemies[slot].angle = random_between(0.0f, 360.0f);
+            placed++;
+        }
+        DEBUG_PRINT(2, 2, "Scenario frame %d: placed %d of %d %s", frame, placed, group->count,
+                    group->is_bullets ? "bullet(s)" : enemy_type_names[group->type]);
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include "bullet.h"
+#include "enemy.h"
+
+// Scripted worlds for --scenario: a text file that fills the world with
+// enemies and bullets at the start and on a schedule, for reproducible
+// stress scenes. One directive per line, '#' starts a comment:
+//
+//   seed 42                  srand seed (default: the time)
+//   duration 60              end the session after 60 simulated seconds
+//   capacity 5000            enemy slots (default: every enemy line's count
+//                            added up, at least MAX_ENEMIES)
+//   health 100000            the player's starting health
+//   spawning on              keep the normal score-based spawns (default off)
+//   enemies EVASIVE 2000 ring 300 1500
+//   bullets 20000 enemy box -2000 -2000 2000 2000
+//   at 10 enemies BOSS1 3 ring 400 500
+//   every 5 bullets 500 player point 0 0
+//
+// enemies takes an EnemyType name without ENEMY_ (BASIC ... BOSS3) and a
+// count; bullets takes a count and their owner (player or enemy), flying in
+// random directions. The shape places them relative to the player:
+// point X Y, ring MIN_RADIUS MAX_RADIUS, grid SPACING (a square grid) or
+// box X0 Y0 X1 Y1. A line starting with "at T" waits until T seconds in,
+// "every P" repeats it every P seconds (both may be combined).
+
+typedef enum {
+    SCENARIO_POINT,
+    SCENARIO_RING,
+    SCENARIO_GRID,
+    SCENARIO_BOX
+} ScenarioShape;
+
+typedef struct {
+    int is_bullets;
+    int type;             // EnemyType, or for bullets 1 = enemy bullets
+    int count;
+    ScenarioShape shape;
+    float args[4];
+    int first_frame;      // frame (from 1) the group appears on
+    int every_frames;     // repeat period in frames; 0 = once
+} ScenarioGroup;
+
+typedef struct {
+    unsigned int seed;
+    int has_seed;
+    int duration_frames;  // 0 = until the player dies or quits
+    int enemy_capacity;
+    int player_health;    // 0 = the usual health
+    int natural_spawns;
+    ScenarioGroup *groups;
+    int group_count;
+} Scenario;
+
+// Parses path; frame_ms is the simulated length of a frame, used to turn
+// seconds into frames. Reports the first error with its line number.
+// Returns 1 on success, 0 on error.
+int scenario_load(const char *path, int frame_ms, Scenario *scenario);
+
+void scenario_free(Scenario *scenario);
+
+// Places every group due on frame around the player. Enemies that find no
+// free slot among the first enemy_count are dropped.
+void scenario_apply(const Scenario *scenario, int frame, float player_x, float player_y,
+                    Enemy enemies[], int enemy_count, BulletPool *pool);
+
+#endif // SCENARIO_H
@@ -1,5 +1,8 @@
 #include "score.h"
+#include "ledgerd.h"
 #include "debug.h"
+#include "trace.h"
+#include "memtrack.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,7 +10,6 @@
 
 #define USERNAME_FILE ".username"
 #define HIGHSCORE_DIR "highscore"
-#define BLOCKCHAIN_FILE "highscore/blockchain.txt"
 
 int load_highscore_for_username(const char *username) {
     char path[256];
@@ -52,7 +54,7 @@ char* load_username() {
     fclose(file);
     buffer[strcspn(buffer, "\n")] = 0;
     DEBUG_PRINT(2, 2, "Username loaded: %s", buffer);
-    return strdup(buffer);
+    return mem_strdup(MEM_USER, buffer);
 }
 
 void save_username(const char *username) {
@@ -69,9 +71,15 @@ void save_username(const char *username) {
 /* NEW FUNCTION: get_last_block_for_user
    Scans the blockchain file and returns the block with the highest timestamp
    for the given username. Copies that block into lastBlock and returns 1 if found,
-   or returns 0 if no block exists for that user.
+   or returns 0 if no block exists for that user. A running ledgerd answers
+   from its index instead.
 */
 int get_last_block_for_user(const char *username, ScoreBlock *lastBlock) {
+    int served = ledgerd_last_block(username, lastBlock);
+    if (served >= 0) {
+        DEBUG_PRINT(2, 2, "Latest block for user %s served by ledgerd", username);
+        return served;
+    }
     FILE *fp = fopen(BLOCKCHAIN_FILE, "r");
     if (!fp) {
         DEBUG_PRINT(2, 1, "Blockchain file %s not found.", BLOCKCHAIN_FILE);
@@ -80,14 +88,9 @@ int get_last_block_for_user(const char *username, ScoreBlock *lastBlock) {
     char line[2048];
     int found = 0;
     ScoreBlock temp;
-    char prev_hash_buf[129] = {0};  // Buffer for prev_hash (128 chars + null)
+    TRACE_SCOPE("get_last_block_for_user")
     while (fgets(line, sizeof(line), fp)) {
-        int ret = sscanf(line,
-            "{\"username\":\"%49[^\"]\", \"score\":%d, \"timestamp\":%ld, \"proof_of_work\":\"%64[^\"]\", \"signature\":\"%512[^\"]\", \"prev_hash\":\"%128[^\"]\", \"nonce\":%u}",
-            temp.username, &temp.score, &temp.timestamp, temp.proof_of_work, temp.signature, prev_hash_buf, &temp.nonce);
-        if (ret == 7 && strcmp(temp.username, username) == 0) {
-            prev_hash_buf[64] = '\0';
-            strcpy(temp.prev_hash, prev_hash_buf);
+        if (parse_score_block(line, &temp) && strcmp(temp.username, username) == 0) {
             if (!found || temp.timestamp > lastBlock->timestamp) {
                 *lastBlock = temp;  // copy the block structure
                 found = 1;
@@ -5,6 +5,7 @@
 
 int load_highscore_for_username(const char *username);
 void save_highscore_for_username(const char *username, int score);
+// The name on the first line of USERNAME_FILE, or NULL; release with mem_free.
 char* load_username();
 void save_username(const char *username);
 int get_last_block_for_user(const char *username, ScoreBlock *lastBlock);
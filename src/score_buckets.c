@@ -0,0 +1,199 @@
+#include "score_buckets.h"
+#include "highscores.h"
+#include "usermap.h"
+#include "config.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int entry_ranks_higher(const LeaderboardEntry *a, const LeaderboardEntry *b) {
+    UserBest x = { a->username, a->score, a->timestamp };
+    UserBest y = { b->username, b->score, b->timestamp };
+    return highscore_ranks_higher(&x, &y);
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const LeaderboardEntry *x = *(const LeaderboardEntry * const *)a;
+    const LeaderboardEntry *y = *(const LeaderboardEntry * const *)b;
+    return entry_ranks_higher(x, y) ? -1 : entry_ranks_higher(y, x) ? 1 : 0;
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date.
+static long days_from_civil(long y, int m, int d) {
+    y -= m <= 2;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void civil_from_days(long z, long *y, int *m, int *d) {
+    z += 719468;
+    long era = (z >= 0 ? z : z - 146096) / 146097;
+    long doe = z - era * 146097;
+    long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long mp = (5 * doy + 2) / 153;
+    *d = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *y = yoe + era * 400 + (*m <= 2);
+}
+
+void score_buckets_init(ScoreBuckets *buckets) {
+    memset(buckets, 0, sizeof(*buckets));
+}
+
+void score_buckets_free(ScoreBuckets *buckets) {
+    for (size_t i = 0; i < buckets->count; i++)
+        free(buckets->buckets[i].top);
+    free(buckets->buckets);
+    score_buckets_init(buckets);
+}
+
+// Returns the bucket for day, inserting an empty one in order if needed.
+// Blocks mostly arrive in time order, so the last bucket is checked first.
+static ScoreBucket *bucket_for(ScoreBuckets *buckets, long day) {
+    size_t lo = 0, hi = buckets->count;
+    if (hi > 0 && buckets->buckets[hi - 1].day <= day)
+        lo = hi - 1;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (buckets->buckets[mid].day < day)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < buckets->count && buckets->buckets[lo].day == day)
+        return &buckets->buckets[lo];
+
+    if (buckets->count == buckets->capacity) {
+        size_t capacity = buckets->capacity ? buckets->capacity * 2 : 64;
+        ScoreBucket *grown = realloc(buckets->buckets, capacity * sizeof(ScoreBucket));
+        if (!grown)
+            return NULL;
+        buckets->buckets = grown;
+        buckets->capacity = capacity;
+    }
+    ScoreBucket *bucket = &buckets->buckets[lo];
+    memmove(bucket + 1, bucket, (buckets->count - lo) * sizeof(ScoreBucket));
+    buckets->count++;
+    bucket->day = day;
+    bucket->top = NULL;
+    bucket->count = 0;
+    return bucket;
+}
+
+int score_buckets_add(ScoreBuckets *buckets, const char *username, int score, time_t timestamp) {
+    ScoreBucket *bucket = bucket_for(buckets, score_day(timestamp));
+    if (!bucket)
+        return 0;
+    if (!bucket->top && !(bucket->top = malloc(SCORE_BUCKET_TOP_K * sizeof(LeaderboardEntry)))) {
+        DEBUG_PRINT(2, 0, "Out of memory adding a score bucket");
+        return 0;
+    }
+    LeaderboardEntry candidate;
+    snprintf(candidate.username, sizeof(candidate.username), "%s", username);
+    candidate.score = score;
+    candidate.timestamp = timestamp;
+
+    int pos = -1;
+    for (int i = 0; i < bucket->count && pos < 0; i++) {
+        if (strcmp(bucket->top[i].username, username) == 0)
+            pos = i;
+    }
+    if (pos >= 0) {
+        if (!entry_ranks_higher(&candidate, &bucket->top[pos]))
+            return 1;
+    } else if (bucket->count < SCORE_BUCKET_TOP_K) {
+        pos = bucket->count++;
+    } else if (entry_ranks_higher(&candidate, &bucket->top[bucket->count - 1])) {
+        // A user dropped here ranks below everyone kept, and the kept users
+        // only improve, so the dropped score can never reach this day's top.
+        pos = bucket->count - 1;
+    } else {
+        return 1;
+    }
+    // The entry only improves, so it only moves up.
+    while (pos > 0 && entry_ranks_higher(&candidate, &bucket->top[pos - 1])) {
+        bucket->top[pos] = bucket->top[pos - 1];
+        pos--;
+    }
+    bucket->top[pos] = candidate;
+    return 1;
+}
+
+int score_buckets_top(const ScoreBuckets *buckets, long first, long last, LeaderboardEntry *out, int k) {
+    UserMap best;  // username -> best LeaderboardEntry* of the range
+    usermap_init(&best);
+    for (size_t b = 0; b < buckets->count; b++) {
+        const ScoreBucket *bucket = &buckets->buckets[b];
+        if (bucket->day < first || bucket->day > last)
+            continue;
+        for (int i = 0; i < bucket->count; i++) {
+            void **slot = usermap_slot(&best, bucket->top[i].username);
+            if (slot && (!*slot || entry_ranks_higher(&bucket->top[i], *slot)))
+                *slot = &bucket->top[i];
+        }
+    }
+    const LeaderboardEntry **rows = malloc((best.count ? best.count : 1) * sizeof(*rows));
+    int count = 0;
+    if (rows) {
+        for (size_t i = 0; i < best.capacity; i++) {
+            if (USERMAP_OCCUPIED(&best, i))
+                rows[count++] = best.values[i];
+        }
+        qsort(rows, (size_t)count, sizeof(*rows), compare_entries);
+        if (count > k)
+            count = k;
+        for (int i = 0; i < count; i++)
+            out[i] = *rows[i];
+    }
+    free(rows);
+    usermap_free(&best, NULL);
+    return count;
+}
+
+long score_day(time_t t) {
+    struct tm tm;
+    localtime_r(&t, &tm);
+    return days_from_civil(tm.tm_year + 1900L, tm.tm_mon + 1, tm.tm_mday);
+}
+
+int parse_score_day(const char *text, long *day) {
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    long today = days_from_civil(tm.tm_year + 1900L, tm.tm_mon + 1, tm.tm_mday);
+    if (strcmp(text, "today") == 0) {
+        *day = today;
+        return 1;
+    }
+    if (strcmp(text, "week") == 0) {
+        *day = today - (tm.tm_wday + 6) % 7;
+        return 1;
+    }
+    if (strcmp(text, "month") == 0) {
+        *day = today - (tm.tm_mday - 1);
+        return 1;
+    }
+    long y;
+    int m, d;
+    char extra;
+    if (sscanf(text, "%ld-%d-%d%c", &y, &m, &d, &extra) != 3 || m < 1 || m > 12 || d < 1 || d > 31)
+        return 0;
+    *day = days_from_civil(y, m, d);
+    // Reject dates such as 2025-02-30 that roll over into the next month.
+    long cy;
+    int cm, cd;
+    civil_from_days(*day, &cy, &cm, &cd);
+    return cy == y && cm == m && cd == d;
+}
+
+void format_score_day(long day, char *out, size_t out_size) {
+    long y;
+    int m, d;
+    civil_from_days(day, &y, &m, &d);
+    snprintf(out, out_size, "%04ld-%02d-%02d", y, m, d);
+}
@@ -0,0 +1,59 @@
+#ifndef SCORE_BUCKETS_H
+#define SCORE_BUCKETS_H
+
+#include <limits.h>
+#include <time.h>
+#include "blockchain.h"
+
+// Time-windowed leaderboards. Valid blocks are grouped into one bucket per
+// local calendar day; each bucket keeps only the SCORE_BUCKET_TOP_K best
+// users of that day (each user's best score within the day). A user in the
+// top k of a range of days is necessarily in the top k of the day holding
+// their best score of the range, so merging the buckets of the range gives
+// the exact answer for any k up to SCORE_BUCKET_TOP_K, at a cost of
+// O(days x SCORE_BUCKET_TOP_K) whatever the length of the chain.
+
+// Day numbers count local calendar days from 1970-01-01.
+#define SCORE_DAY_FIRST LONG_MIN  // open start of a range
+#define SCORE_DAY_LAST LONG_MAX   // open end of a range
+
+// One leaderboard row.
+typedef struct {
+    char username[USERNAME_MAX];
+    int score;
+    time_t timestamp;
+} LeaderboardEntry;
+
+typedef struct {
+    long day;
+    LeaderboardEntry *top;  // best first
+    int count;
+} ScoreBucket;
+
+typedef struct {
+    ScoreBucket *buckets;  // ordered by day
+    size_t count, capacity;
+} ScoreBuckets;
+
+void score_buckets_init(ScoreBuckets *buckets);
+void score_buckets_free(ScoreBuckets *buckets);
+
+// Folds a valid block of base username into the bucket of its day.
+// Returns 0 only on allocation failure.
+int score_buckets_add(ScoreBuckets *buckets, const char *username, int score, time_t timestamp);
+
+// Writes the best k users (k <= SCORE_BUCKET_TOP_K) over days first..last
+// (inclusive) into out, best first, and returns the count.
+int score_buckets_top(const ScoreBuckets *buckets, long first, long last, LeaderboardEntry *out, int k);
+
+// Returns the local calendar day of t.
+long score_day(time_t t);
+
+// Parses a day for --since/--until: "today", "week" (since Monday),
+// "month" (since the 1st) or YYYY-MM-DD. Returns 1 on success.
+int parse_score_day(const char *text, long *day);
+
+// Formats day as YYYY-MM-DD into out (at least 11 bytes).
+void format_score_day(long day, char *out, size_t out_size);
+
+#endif // SCORE_BUCKETS_H
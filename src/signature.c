@@ -1,24 +1,26 @@
 #include "signature.h"
 #include "encryption.h"
 #include "debug.h"
+#include "trace.h"
 #include <openssl/evp.h>
 #include <openssl/err.h>
 #include <string.h>
 #include <stdio.h>
 
-// Helper: create a string representation of the block data to sign (excluding proof, signature, nonce).
-static void get_block_data_string(const ScoreBlock *block, char *buffer, size_t bufsize) {
-    snprintf(buffer, bufsize, "%s|%d|%ld|%s|%u",
-             block->username,
-             block->score,
-             block->timestamp,
-             block->prev_hash,
-             block->nonce);
+// Digest used with each block version's key: RSA signs a SHA-256 digest,
+// while Ed25519 hashes internally and must be given no digest.
+static const EVP_MD *block_digest(int version) {
+    return version == BLOCK_VERSION_RSA ? EVP_sha256() : NULL;
 }
 
-int sign_score(const ScoreBlock *block, const char *username, char *signature_hex) {
+int sign_message(const char *message, const char *username, int version,
+                 unsigned char *signature, size_t *signature_len) {
     int ret = 0;
-    EVP_PKEY *pkey = load_private_key(username);
+    // Prefer the session's live key; outside a session, load it from disk.
+    EVP_PKEY *owned = NULL;
+    EVP_PKEY *pkey = signing_session_key(username, version);
+    if (!pkey)
+        pkey = owned = load_private_key(username, version);
     if (!pkey) {
         DEBUG_PRINT(2, 0, "Failed to load private key for %s", username);
         return 0;
@@ -26,93 +28,108 @@ int sign_score(const ScoreBlock *block, const char *username, char *signature_he
     EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
     if (!mdctx) {
         DEBUG_PRINT(2, 0, "Failed to allocate EVP_MD_CTX for user %s", username);
-        EVP_PKEY_free(pkey);
+        EVP_PKEY_free(owned);
         return 0;
     }
-    if (EVP_DigestSignInit(mdctx, NULL, EVP_sha256(), NULL, pkey) != 1) {
+    if (EVP_DigestSignInit(mdctx, NULL, block_digest(version), NULL, pkey) != 1) {
         DEBUG_PRINT(2, 0, "EVP_DigestSignInit failed for user %s", username);
         goto cleanup;
     }
 
-    char data[512];
-    get_block_data_string(block, data, sizeof(data));
-    if (EVP_DigestSignUpdate(mdctx, data, strlen(data)) != 1) {
-        DEBUG_PRINT(2, 0, "EVP_DigestSignUpdate failed for user %s", username);
+    // One-shot signing: Ed25519 cannot be fed incrementally.
+    *signature_len = SIG_MAX_LEN;
+    if (EVP_DigestSign(mdctx, signature, signature_len, (const unsigned char*)message, strlen(message)) != 1) {
+        DEBUG_PRINT(2, 0, "EVP_DigestSign failed for user %s", username);
         goto cleanup;
     }
-
-    size_t sig_len = 0;
-    if (EVP_DigestSignFinal(mdctx, NULL, &sig_len) != 1) {
-        DEBUG_PRINT(2, 0, "EVP_DigestSignFinal (first call) failed for user %s", username);
-        goto cleanup;
-    }
-    unsigned char *sig = (unsigned char*)malloc(sig_len);
-    if (!sig) {
-        DEBUG_PRINT(2, 0, "Memory allocation for signature failed for user %s", username);
-        goto cleanup;
-    }
-    if (EVP_DigestSignFinal(mdctx, sig, &sig_len) != 1) {
-        DEBUG_PRINT(2, 0, "EVP_DigestSignFinal (second call) failed for user %s", username);
-        free(sig);
-        goto cleanup;
-    }
-
-    // Convert binary signature to hex string.
-    for (size_t i = 0; i < sig_len; i++) {
-        sprintf(signature_hex + (i * 2), "%02x", sig[i]);
-    }
-    signature_hex[sig_len * 2] = '\0';
-    free(sig);
     ret = 1;
 cleanup:
     EVP_MD_CTX_free(mdctx);
-    EVP_PKEY_free(pkey);
+    EVP_PKEY_free(owned);
     return ret;
 }
 
-int verify_score_signature(const ScoreBlock *block, const char *username, const char *signature_hex) {
-    int ret = 0;
-    EVP_PKEY *pkey = load_public_key(username);
-    if (!pkey) {
-        DEBUG_PRINT(2, 0, "Failed to load public key for %s", username);
+int sign_score(ScoreBlock *block) {
+    // Sign as the player whose key verifiers will use: a "DevAI" block is
+    // signed with the player's own key.
+    char signer[USERNAME_MAX];
+    char data[BLOCK_DATA_MAX];
+    size_t sig_len = 0;
+    uint64_t trace_t0 = TRACE_BEGIN();
+    block_signer_name(block, signer, sizeof(signer));
+    int ok = block_data_string(block, data, sizeof(data)) >= 0 &&
+             sign_message(data, signer, block->version, block->signature, &sig_len);
+    TRACE_END("sign_score", trace_t0);
+    if (!ok)
+        return 0;
+    block->signature_len = (unsigned short)sig_len;
+    return 1;
+}
+
+void *verify_ctx_new(void) {
+    return EVP_MD_CTX_new();
+}
+
+void verify_ctx_free(void *ctx) {
+    EVP_MD_CTX_free((EVP_MD_CTX*)ctx);
+}
+
+// Verifies signature over message with username's key for the given version.
+static int verify_message_ctx(EVP_MD_CTX *mdctx, const char *message, const char *username,
+                              int version, const unsigned char *signature, size_t sig_len) {
+    if (sig_len == 0 || sig_len > SIG_MAX_LEN) {
+        DEBUG_PRINT(2, 0, "Signature for user %s has invalid length %zu", username, sig_len);
         return 0;
     }
-    EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
-    if (!mdctx) {
-        DEBUG_PRINT(2, 0, "Failed to allocate EVP_MD_CTX for verification for user %s", username);
-        EVP_PKEY_free(pkey);
+    EVP_PKEY *pkey = get_public_key(username, version);
+    if (!pkey) {
+        DEBUG_PRINT(2, 0, "Failed to load version %d public key for %s", version, username);
         return 0;
     }
-    if (EVP_DigestVerifyInit(mdctx, NULL, EVP_sha256(), NULL, pkey) != 1) {
+
+    // Reset so the same context can be reused for the next block.
+    EVP_MD_CTX_reset(mdctx);
+    int ret = 0;
+    if (EVP_DigestVerifyInit(mdctx, NULL, block_digest(version), NULL, pkey) != 1) {
         DEBUG_PRINT(2, 0, "EVP_DigestVerifyInit failed for user %s", username);
-        goto cleanup;
+    } else {
+        ret = (EVP_DigestVerify(mdctx, signature, sig_len, (const unsigned char*)message, strlen(message)) == 1);
+        if (!ret)
+            DEBUG_PRINT(2, 0, "Signature verification failed for user %s", username);
     }
+    EVP_PKEY_free(pkey);
+    return ret;
+}
 
-    char data[512];
-    get_block_data_string(block, data, sizeof(data));
-    if (EVP_DigestVerifyUpdate(mdctx, data, strlen(data)) != 1) {
-        DEBUG_PRINT(2, 0, "EVP_DigestVerifyUpdate failed for user %s", username);
-        goto cleanup;
-    }
+int verify_score_signature_ctx(void *ctx, const ScoreBlock *block, const char *username) {
+    char data[BLOCK_DATA_MAX];
+    uint64_t trace_t0 = TRACE_BEGIN();
+    int ret = block_data_string(block, data, sizeof(data)) >= 0 &&
+              verify_message_ctx((EVP_MD_CTX*)ctx, data, username, block->version,
+                                 block->signature, block->signature_len);
+    TRACE_END("verify_score_signature", trace_t0);
+    return ret;
+}
 
-    // Convert hex signature back to binary.
-    size_t sig_len = strlen(signature_hex) / 2;
-    unsigned char *sig = (unsigned char*)malloc(sig_len);
-    if (!sig) {
-        DEBUG_PRINT(2, 0, "Memory allocation for signature verification failed for user %s", username);
-        goto cleanup;
-    }
-    for (size_t i = 0; i < sig_len; i++) {
-        sscanf(signature_hex + 2*i, "%2hhx", &sig[i]);
-    }
-    ret = (EVP_DigestVerifyFinal(mdctx, sig, sig_len) == 1);
-    if (!ret) {
-        DEBUG_PRINT(2, 0, "Signature verification failed for user %s", username);
+int verify_message_signature(const char *message, const char *username, int version,
+                             const unsigned char *signature, size_t signature_len) {
+    EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
+    if (!mdctx) {
+        DEBUG_PRINT(2, 0, "Failed to allocate EVP_MD_CTX for verification for user %s", username);
+        return 0;
     }
-    free(sig);
-cleanup:
+    int ret = verify_message_ctx(mdctx, message, username, version, signature, signature_len);
     EVP_MD_CTX_free(mdctx);
-    EVP_PKEY_free(pkey);
     return ret;
 }
 
+int verify_score_signature(const ScoreBlock *block, const char *username) {
+    void *ctx = verify_ctx_new();
+    if (!ctx) {
+        DEBUG_PRINT(2, 0, "Failed to allocate EVP_MD_CTX for verification for user %s", username);
+        return 0;
+    }
+    int ret = verify_score_signature_ctx(ctx, block, username);
+    verify_ctx_free(ctx);
+    return ret;
+}
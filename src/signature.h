@@ -4,14 +4,35 @@
 #include "blockchain.h"
 #include <stddef.h>
 
-// Signs the block data using the provided private key.
-// The signature is output as a hex string into 'signature' (which has space for at least SIG_STR_LEN bytes).
+// Signs the block data with the private key of the block's signer (its
+// username without any "DevAI" suffix, see block_signer_name), using the
+// signing session's key when one is active.
+// The raw signature is stored in block->signature and block->signature_len.
 // Returns 1 on success, 0 on failure.
-int sign_score(const ScoreBlock *block, const char *username, char *signature);
+int sign_score(ScoreBlock *block);
+
+// Signs an arbitrary NUL-terminated message with username's private key for the
+// given block version (BLOCK_VERSION_*). The raw signature is written to
+// signature (at least SIG_MAX_LEN bytes) and its length to *signature_len.
+// Returns 1 on success, 0 on failure.
+int sign_message(const char *message, const char *username, int version,
+                 unsigned char *signature, size_t *signature_len);
+
+// Verifies a signature made by sign_message. Returns 1 if valid, 0 otherwise.
+int verify_message_signature(const char *message, const char *username, int version,
+                             const unsigned char *signature, size_t signature_len);
 
 // Verifies the block's signature using the public key associated with username.
 // Returns 1 if the signature is valid, 0 otherwise.
-int verify_score_signature(const ScoreBlock *block, const char *username, const char *signature);
+int verify_score_signature(const ScoreBlock *block, const char *username);
+
+// Allocates a verification context (an EVP_MD_CTX) that can be reused across
+// many verify_score_signature_ctx calls on one thread. Returns NULL on failure.
+void *verify_ctx_new(void);
+void verify_ctx_free(void *ctx);
+
+// Same as verify_score_signature, but reuses ctx instead of allocating one.
+int verify_score_signature_ctx(void *ctx, const ScoreBlock *block, const char *username);
 
 #endif // SIGNATURE_H
 
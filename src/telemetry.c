@@ -0,0 +1,103 @@
+#include "telemetry.h"
+#include "config.h"
+#include "debug.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static TelemetryBlock *g_block = NULL;
+static char g_name[256];
+
+int telemetry_open(const char *name, const char *const *stage_names, int stage_count) {
+    if (name[0] != '/' || strchr(name + 1, '/') || strlen(name) >= sizeof(g_name)) {
+        DEBUG_PRINT(0, 0, "Telemetry name must look like /name, got %s", name);
+        return 0;
+    }
+    // A fresh segment each run, so readers of an old one see it end.
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        DEBUG_PRINT(0, 0, "Cannot create shared memory %s: %s", name, strerror(errno));
+        return 0;
+    }
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, sizeof(TelemetryBlock)) == 0)
+        map = mmap(NULL, sizeof(TelemetryBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        DEBUG_PRINT(0, 0, "Cannot map shared memory %s: %s", name, strerror(errno));
+        shm_unlink(name);
+        return 0;
+    }
+    TelemetryBlock *block = map;
+    block->version = TELEMETRY_VERSION;
+    block->size = sizeof(TelemetryBlock);
+    block->pid = (int32_t)getpid();
+    block->stage_count = stage_count < TELEMETRY_STAGES ? stage_count : TELEMETRY_STAGES;
+    for (int i = 0; i < block->stage_count; i++)
+        snprintf(block->stage_names[i], TELEMETRY_STAGE_NAME, "%s", stage_names[i]);
+    // Readers check the magic last, once the rest is in place.
+    __atomic_store_n(&block->magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+    g_block = block;
+    snprintf(g_name, sizeof(g_name), "%s", name);
+    DEBUG_PRINT(1, 3, "Publishing telemetry in shared memory %s", name);
+    return 1;
+}
+
+void telemetry_publish(const TelemetryFrame *frame) {
+    if (!g_block)
+        return;
+    uint32_t seq = g_block->sequence;
+    __atomic_store_n(&g_block->sequence, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&g_block->frame, frame, sizeof(*frame));
+    __atomic_store_n(&g_block->sequence, seq + 2, __ATOMIC_RELEASE);
+}
+
+void telemetry_close(void) {
+    if (!g_block)
+        return;
+    TelemetryFrame last = g_block->frame;
+    last.state = TELEMETRY_ENDED;
+    telemetry_publish(&last);
+    munmap(g_block, sizeof(TelemetryBlock));
+    shm_unlink(g_name);
+    g_block = NULL;
+}
+
+const TelemetryBlock *telemetry_attach(const char *name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(TelemetryBlock))
+        map = mmap(NULL, sizeof(TelemetryBlock), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+    const TelemetryBlock *block = map;
+    if (__atomic_load_n(&block->magic, __ATOMIC_ACQUIRE) != TELEMETRY_MAGIC ||
+        block->version != TELEMETRY_VERSION || block->size != sizeof(TelemetryBlock)) {
+        munmap(map, sizeof(TelemetryBlock));
+        return NULL;
+    }
+    return block;
+}
+
+int telemetry_snapshot(const TelemetryBlock *block, TelemetryFrame *out) {
+    for (int attempt = 0; attempt < TELEMETRY_READ_ATTEMPTS; attempt++) {
+        uint32_t before = __atomic_load_n(&block->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1)
+            continue;
+        memcpy(out, (const void*)&block->frame, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&block->sequence, __ATOMIC_RELAXED) == before)
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+// Live telemetry for --telemetry: game_loop publishes one TelemetryFrame per
+// frame into a POSIX shared-memory segment, and monitors such as
+// tools/telemetry_watch map it read-only. Updates use a seqlock: the game
+// makes the sequence odd, copies the frame in and makes it even again, so
+// it never waits on a reader. A reader copies the frame and retries if the
+// sequence was odd or changed meanwhile.
+
+#define TELEMETRY_DEFAULT_NAME "/quantumstriker"
+#define TELEMETRY_MAGIC 0x46545351u  // "QSTF"
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_STAGES 24          // room for the profiler's stages
+#define TELEMETRY_STAGE_NAME 16
+
+// Game state in TelemetryFrame.state.
+enum {
+    TELEMETRY_RUNNING = 1,
+    TELEMETRY_ENDED = 2
+};
+
+typedef struct {
+    uint64_t frame;
+    uint64_t time_ns;             // monotonic clock at the end of the frame
+    float frame_ms;               // wall time since the previous frame
+    float stage_ms[TELEMETRY_STAGES];  // profiler stages; 0 unless profiling
+    int32_t profiling;
+    int32_t state;
+    int32_t score, kills, health;
+    int32_t live_bullets, bullet_capacity, bullet_high_water;
+    int32_t active_enemies, enemy_capacity, enemy_high_water;
+    int64_t frame_allocations;    // heap allocations made by this frame
+    uint64_t heap_bytes, heap_peak_bytes;
+} TelemetryFrame;
+
+// The segment. Everything before sequence is written once at creation.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;                // sizeof(TelemetryBlock)
+    int32_t pid;
+    int32_t stage_count;
+    char stage_names[TELEMETRY_STAGES][TELEMETRY_STAGE_NAME];
+    uint32_t sequence;            // odd while a frame is being written
+    TelemetryFrame frame;
+} TelemetryBlock;
+
+// Creates (or replaces) the segment name ("/something") with the given
+// stage names. Returns 1 on success, 0 on error.
+int telemetry_open(const char *name, const char *const *stage_names, int stage_count);
+
+// Publishes frame if the segment is open. Never blocks.
+void telemetry_publish(const TelemetryFrame *frame);
+
+// Marks the last frame as ended and removes the segment's name; mapped
+// readers keep the final frame.
+void telemetry_close(void);
+
+// Reader side: maps name read-only. Returns NULL if it does not exist or
+// is not a telemetry segment of this version.
+const TelemetryBlock *telemetry_attach(const char *name);
+
+// Copies a consistent frame out of block. Returns 0 if the writer was busy
+// every time it looked (try again later).
+int telemetry_snapshot(const TelemetryBlock *block, TelemetryFrame *out);
+
+#endif // TELEMETRY_H
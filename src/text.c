@@ -0,0 +1,112 @@
+#include "text.h"
+#include "debug.h"
+
+// Printable ASCII is drawn from a glyph atlas: each character is rendered
+// once with SDL_ttf into one white texture, and a string is a run of copies
+// from it tinted with the text colour. Drawing text then creates no surfaces
+// or textures, so the HUD and the profiler overlay can change every frame
+// without touching the heap. Other characters fall back to SDL_ttf.
+#define ATLAS_FIRST_CHAR 32
+#define ATLAS_LAST_CHAR 126
+#define ATLAS_GLYPHS (ATLAS_LAST_CHAR - ATLAS_FIRST_CHAR + 1)
+#define ATLAS_COLUMNS 16
+
+static SDL_Texture* atlasTexture = NULL;
+static SDL_Renderer* atlasRenderer = NULL;  // what atlasTexture belongs to
+static TTF_Font* atlasFont = NULL;          // what it was rendered from
+static int atlasCellW = 0, atlasCellH = 0;
+static int glyphWidth[ATLAS_GLYPHS];        // advance of each glyph
+
+// Renders every printable ASCII character of font into a new atlas texture.
+// If SDL_ttf or SDL cannot, atlasTexture stays NULL and text for this
+// renderer and font is drawn with SDL_ttf instead of retrying every call.
+static void build_text_atlas(SDL_Renderer* renderer, TTF_Font* font) {
+    SDL_Color white = {255, 255, 255, 255};
+    atlasRenderer = renderer;
+    atlasFont = font;
+    SDL_Surface* glyphs[ATLAS_GLYPHS] = {0};
+    int ok = 1;
+    atlasCellW = 0;
+    atlasCellH = TTF_FontHeight(font);
+    for (int i = 0; ok && i < ATLAS_GLYPHS; i++) {
+        char ch[2] = { (char)(ATLAS_FIRST_CHAR + i), '\0' };
+        glyphs[i] = TTF_RenderText_Blended(font, ch, white);
+        ok = glyphs[i] != NULL;
+        if (ok) {
+            glyphWidth[i] = glyphs[i]->w;
+            if (glyphs[i]->w > atlasCellW)
+                atlasCellW = glyphs[i]->w;
+            if (glyphs[i]->h > atlasCellH)
+                atlasCellH = glyphs[i]->h;
+        }
+    }
+    int rows = (ATLAS_GLYPHS + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS;
+    SDL_Surface* sheet = ok ? SDL_CreateRGBSurfaceWithFormat(0, ATLAS_COLUMNS * atlasCellW, rows * atlasCellH,
+                                                             32, SDL_PIXELFORMAT_ARGB8888) : NULL;
+    if (sheet) {
+        SDL_FillRect(sheet, NULL, SDL_MapRGBA(sheet->format, 255, 255, 255, 0));
+        for (int i = 0; i < ATLAS_GLYPHS; i++) {
+            SDL_Rect dst = { (i % ATLAS_COLUMNS) * atlasCellW, (i / ATLAS_COLUMNS) * atlasCellH, 0, 0 };
+            // Copy the glyph's coverage as it is instead of blending it onto the sheet.
+            SDL_SetSurfaceBlendMode(glyphs[i], SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(glyphs[i], NULL, sheet, &dst);
+        }
+        atlasTexture = SDL_CreateTextureFromSurface(renderer, sheet);
+        SDL_FreeSurface(sheet);
+    }
+    for (int i = 0; i < ATLAS_GLYPHS; i++)
+        SDL_FreeSurface(glyphs[i]);
+    if (!atlasTexture) {
+        DEBUG_PRINT(2, 1, "Could not build the glyph atlas; drawing text with SDL_ttf: %s", SDL_GetError());
+        return;
+    }
+    SDL_SetTextureBlendMode(atlasTexture, SDL_BLENDMODE_BLEND);
+    DEBUG_PRINT(2, 3, "Glyph atlas built: %d glyphs in %dx%d cells", ATLAS_GLYPHS, atlasCellW, atlasCellH);
+}
+
+void free_text_atlas(void) {
+    if (atlasTexture)
+        SDL_DestroyTexture(atlasTexture);
+    atlasTexture = NULL;
+    atlasRenderer = NULL;
+    atlasFont = NULL;
+}
+
+// Draws text with SDL_ttf, rendering a new surface and texture for it.
+static void render_text_ttf(SDL_Renderer* renderer, TTF_Font* font, int x, int y, const char* text, SDL_Color color) {
+    SDL_Surface* surface = TTF_RenderText_Blended(font, text, color);
+    if (!surface)
+        return;
+    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+    SDL_Rect dst = { x, y, surface->w, surface->h };
+    SDL_RenderCopy(renderer, texture, NULL, &dst);
+    SDL_DestroyTexture(texture);
+    SDL_FreeSurface(surface);
+}
+
+void render_text(SDL_Renderer* renderer, TTF_Font* font, int x, int y, const char* text, SDL_Color color) {
+    for (const char* c = text; *c; c++) {
+        if (*c < ATLAS_FIRST_CHAR || *c > ATLAS_LAST_CHAR) {
+            render_text_ttf(renderer, font, x, y, text, color);
+            return;
+        }
+    }
+    if (atlasRenderer != renderer || atlasFont != font) {
+        free_text_atlas();
+        build_text_atlas(renderer, font);
+    }
+    if (!atlasTexture) {
+        render_text_ttf(renderer, font, x, y, text, color);
+        return;
+    }
+    SDL_SetTextureColorMod(atlasTexture, color.r, color.g, color.b);
+    SDL_SetTextureAlphaMod(atlasTexture, color.a);
+    for (const char* c = text; *c; c++) {
+        int i = *c - ATLAS_FIRST_CHAR;
+        SDL_Rect src = { (i % ATLAS_COLUMNS) * atlasCellW, (i / ATLAS_COLUMNS) * atlasCellH, glyphWidth[i], atlasCellH };
+        SDL_Rect dst = { x, y, glyphWidth[i], atlasCellH };
+        if (*c != ' ')
+            SDL_RenderCopy(renderer, atlasTexture, &src, &dst);
+        x += glyphWidth[i];
+    }
+}
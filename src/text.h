@@ -0,0 +1,17 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+// Draws text with its top-left corner at x, y (blended, so it keeps the
+// font's anti-aliasing over whatever is underneath). Printable ASCII comes
+// from a glyph atlas built on the first call for renderer and font, so
+// steady-state calls make no heap allocations.
+void render_text(SDL_Renderer* renderer, TTF_Font* font, int x, int y, const char* text, SDL_Color color);
+
+// Destroys the glyph atlas. Call it before destroying the renderer or
+// closing the font that render_text last drew with.
+void free_text_atlas(void);
+
+#endif
@@ -0,0 +1,161 @@
+#include "trace.h"
+#include "config.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+int g_trace_enabled = 0;
+
+typedef struct {
+    const char *name;
+    uint64_t start_ns, dur_ns;
+} TraceEvent;
+
+typedef struct TraceChunk {
+    struct TraceChunk *next;   // published with release once filled in
+    int count;                 // events written; published with release
+    TraceEvent events[TRACE_CHUNK_EVENTS];
+} TraceChunk;
+
+// One per thread that has recorded an event. Only its owner appends; the
+// writer at exit reads with acquire loads.
+typedef struct TraceThread {
+    struct TraceThread *next;
+    int tid;
+    const char *name;
+    TraceChunk *head, *tail;
+    long dropped;  // events lost to failed allocations
+} TraceThread;
+
+static TraceThread *g_trace_threads = NULL;  // pushed with compare-and-swap
+static int g_trace_next_tid = 1;
+static char g_trace_path[512];
+static uint64_t g_trace_origin_ns;
+static __thread TraceThread *tls_trace_thread = NULL;
+
+uint64_t trace_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static TraceThread *trace_thread(void) {
+    TraceThread *self = tls_trace_thread;
+    if (self)
+        return self;
+    self = calloc(1, sizeof(TraceThread));
+    if (!self)
+        return NULL;
+    self->tid = __atomic_fetch_add(&g_trace_next_tid, 1, __ATOMIC_RELAXED);
+    self->next = __atomic_load_n(&g_trace_threads, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&g_trace_threads, &self->next, self, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+    tls_trace_thread = self;
+    return self;
+}
+
+void trace_thread_name(const char *name) {
+    if (!g_trace_enabled)
+        return;
+    TraceThread *self = trace_thread();
+    if (self && !self->name)
+        __atomic_store_n(&self->name, name, __ATOMIC_RELEASE);
+}
+
+void trace_complete(const char *name, uint64_t start_ns, uint64_t end_ns) {
+    TraceThread *self = trace_thread();
+    if (!self)
+        return;
+    TraceChunk *chunk = self->tail;
+    if (!chunk || chunk->count == TRACE_CHUNK_EVENTS) {
+        TraceChunk *fresh = malloc(sizeof(TraceChunk));
+        if (!fresh) {
+            self->dropped++;
+            return;
+        }
+        fresh->next = NULL;
+        fresh->count = 0;
+        if (chunk)
+            __atomic_store_n(&chunk->next, fresh, __ATOMIC_RELEASE);
+        else
+            __atomic_store_n(&self->head, fresh, __ATOMIC_RELEASE);
+        self->tail = chunk = fresh;
+    }
+    TraceEvent *event = &chunk->events[chunk->count];
+    event->name = name;
+    event->start_ns = start_ns;
+    event->dur_ns = end_ns > start_ns ? end_ns - start_ns : 0;
+    __atomic_store_n(&chunk->count, chunk->count + 1, __ATOMIC_RELEASE);
+}
+
+uint64_t trace_begin(void) {
+    if (g_counters_enabled)
+        perf_counters_begin();
+    return trace_now_ns();
+}
+
+void trace_end(const char *name, uint64_t start_ns) {
+    uint64_t now = trace_now_ns();
+    if (g_counters_enabled)
+        perf_counters_end(name, 0);
+    if (g_trace_enabled)
+        trace_complete(name, start_ns, now);
+}
+
+// Writes every recorded event as Chrome trace-event JSON. Runs at exit.
+static void trace_write(void) {
+    g_trace_enabled = 0;
+    FILE *fp = fopen(g_trace_path, "w");
+    if (!fp) {
+        DEBUG_PRINT(2, 0, "Cannot write trace %s", g_trace_path);
+        return;
+    }
+    int pid = (int)getpid();
+    long events = 0, dropped = 0;
+    const char *sep = "";
+    fprintf(fp, "{\"traceEvents\":[\n");
+    for (TraceThread *t = __atomic_load_n(&g_trace_threads, __ATOMIC_ACQUIRE); t; t = t->next) {
+        const char *name = __atomic_load_n(&t->name, __ATOMIC_ACQUIRE);
+        if (name) {
+            fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    sep, pid, t->tid, name);
+            sep = ",\n";
+        }
+        for (TraceChunk *c = __atomic_load_n(&t->head, __ATOMIC_ACQUIRE); c; c = __atomic_load_n(&c->next, __ATOMIC_ACQUIRE)) {
+            int count = __atomic_load_n(&c->count, __ATOMIC_ACQUIRE);
+            for (int i = 0; i < count; i++) {
+                const TraceEvent *e = &c->events[i];
+                fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+                        sep, e->name, (e->start_ns - g_trace_origin_ns) / 1e3, e->dur_ns / 1e3, pid, t->tid);
+                sep = ",\n";
+            }
+            events += count;
+        }
+        dropped += t->dropped;
+    }
+    fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(fp);
+    if (dropped)
+        DEBUG_PRINT(2, 1, "Trace lost %ld event(s) to allocation failures", dropped);
+    DEBUG_PRINT(0, 3, "Wrote %ld trace event(s) to %s", events, g_trace_path);
+}
+
+int trace_start(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        DEBUG_PRINT(0, 0, "Cannot create trace file %s", path);
+        return 0;
+    }
+    fclose(fp);
+    if (!g_trace_path[0])
+        atexit(trace_write);
+    snprintf(g_trace_path, sizeof(g_trace_path), "%s", path);
+    g_trace_origin_ns = trace_now_ns();
+    g_trace_enabled = 1;
+    trace_thread_name("main");
+    return 1;
+}
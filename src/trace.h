@@ -0,0 +1,45 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include "perf_counters.h"
+
+// Timeline recording for --trace. Each thread appends complete events
+// (name, start, duration) to its own chunked buffer without locks; the
+// buffers are written out as Chrome trace-event JSON (chrome://tracing,
+// https://ui.perfetto.dev) when the program exits.
+
+// Events are only recorded while this is set.
+extern int g_trace_enabled;
+
+// Starts recording and arranges for the trace to be written to path at
+// exit. Returns 1 on success, 0 if path cannot be created.
+int trace_start(const char *path);
+
+// Monotonic time in nanoseconds (the clock every event uses).
+uint64_t trace_now_ns(void);
+
+// Records an event named name (a string literal or other static string)
+// for the calling thread.
+void trace_complete(const char *name, uint64_t start_ns, uint64_t end_ns);
+
+// Names the calling thread in the trace unless it already has a name.
+void trace_thread_name(const char *name);
+
+// Start and end of a region that is an event under --trace and a counter
+// region under --counters (see TRACE_BEGIN).
+uint64_t trace_begin(void);
+void trace_end(const char *name, uint64_t start_ns);
+
+// Explicit begin/end for functions with several exits:
+//   uint64_t t0 = TRACE_BEGIN(); ... TRACE_END("name", t0);
+#define TRACE_BEGIN() ((g_trace_enabled | g_counters_enabled) ? trace_begin() : 0)
+#define TRACE_END(name, t0) do { if (t0) trace_end((name), (t0)); } while (0)
+
+// Records the statement or block that follows as an event. Do not leave the
+// block with break or return.
+#define TRACE_SCOPE(name) \
+    for (uint64_t trace_t0_ = TRACE_BEGIN(), trace_once_ = 1; trace_once_; \
+         trace_once_ = 0, trace_t0_ ? trace_end((name), trace_t0_) : (void)0)
+
+#endif // TRACE_H
@@ -0,0 +1,99 @@
+#include "usermap.h"
+#include "debug.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define USERMAP_INITIAL_CAPACITY 64
+
+// FNV-1a over the key bytes.
+static uint32_t hash_key(const char *key) {
+    uint32_t h = 2166136261u;
+    while (*key) {
+        h ^= (unsigned char)*key++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Finds the slot index for key: either the slot holding it or the empty slot
+// where it would be inserted. The table must have at least one empty slot.
+static size_t find_slot(char **keys, size_t capacity, const char *key) {
+    size_t mask = capacity - 1;
+    size_t i = hash_key(key) & mask;
+    while (keys[i] && strcmp(keys[i], key) != 0)
+        i = (i + 1) & mask;
+    return i;
+}
+
+static int grow(UserMap *map) {
+    size_t new_capacity = map->capacity ? map->capacity * 2 : USERMAP_INITIAL_CAPACITY;
+    char **new_keys = calloc(new_capacity, sizeof(char*));
+    void **new_values = calloc(new_capacity, sizeof(void*));
+    if (!new_keys || !new_values) {
+        DEBUG_PRINT(2, 0, "Failed to grow user map to %zu slots", new_capacity);
+        free(new_keys);
+        free(new_values);
+        return 0;
+    }
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (!map->keys[i])
+            continue;
+        size_t j = find_slot(new_keys, new_capacity, map->keys[i]);
+        new_keys[j] = map->keys[i];
+        new_values[j] = map->values[i];
+    }
+    free(map->keys);
+    free(map->values);
+    map->keys = new_keys;
+    map->values = new_values;
+    map->capacity = new_capacity;
+    return 1;
+}
+
+void usermap_init(UserMap *map) {
+    map->keys = NULL;
+    map->values = NULL;
+    map->capacity = 0;
+    map->count = 0;
+}
+
+void usermap_free(UserMap *map, void (*free_value)(void *)) {
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (!map->keys[i])
+            continue;
+        if (free_value)
+            free_value(map->values[i]);
+        free(map->keys[i]);
+    }
+    free(map->keys);
+    free(map->values);
+    usermap_init(map);
+}
+
+void *usermap_get(const UserMap *map, const char *key) {
+    if (map->capacity == 0)
+        return NULL;
+    size_t i = find_slot(map->keys, map->capacity, key);
+    return map->keys[i] ? map->values[i] : NULL;
+}
+
+void **usermap_slot(UserMap *map, const char *key) {
+    if (map->capacity > 0) {
+        size_t i = find_slot(map->keys, map->capacity, key);
+        if (map->keys[i])
+            return &map->values[i];
+    }
+    // Keep the load factor at or below 1/2 so probe sequences stay short.
+    if ((map->count + 1) * 2 > map->capacity && !grow(map))
+        return NULL;
+    size_t i = find_slot(map->keys, map->capacity, key);
+    if (!map->keys[i]) {
+        map->keys[i] = strdup(key);
+        if (!map->keys[i])
+            return NULL;
+        map->values[i] = NULL;
+        map->count++;
+    }
+    return &map->values[i];
+}
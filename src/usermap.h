@@ -0,0 +1,32 @@
+#ifndef USERMAP_H
+#define USERMAP_H
+
+#include <stddef.h>
+
+// Open-addressing hash map from a username (or any short string key) to an
+// opaque pointer. Keys are copied on insert; values are owned by the caller.
+typedef struct {
+    char **keys;
+    void **values;
+    size_t capacity;  // always a power of two (0 until the first insert)
+    size_t count;
+} UserMap;
+
+// Initializes an empty map. No memory is allocated until the first insert.
+void usermap_init(UserMap *map);
+
+// Frees the map's storage. If free_value is not NULL it is called on every value.
+void usermap_free(UserMap *map, void (*free_value)(void *));
+
+// Returns the value stored for key, or NULL if the key is not present.
+void *usermap_get(const UserMap *map, const char *key);
+
+// Returns a pointer to the value slot for key, inserting the key with a NULL
+// value if it is missing. Returns NULL only on allocation failure.
+// The slot stays valid until the next insert.
+void **usermap_slot(UserMap *map, const char *key);
+
+// Iteration helper: for (size_t i = 0; i < map->capacity; i++) if (map->keys[i]) ...
+#define USERMAP_OCCUPIED(map, i) ((map)->keys[(i)] != NULL)
+
+#endif // USERMAP_H
@@ -0,0 +1,240 @@
+#include "verify_cache.h"
+#include "encryption.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+
+/*
+ * File format: the magic line below followed by fixed 96-byte records.
+ * Records are looked up by proof_of_work through an open-addressing index.
+ * The cache is only touched from the thread that drives verification.
+ *
+ * A record covers the signed bytes (block_data_string), the signature and
+ * the signer's key, and is sealed with an HMAC under a random secret kept
+ * in VERIFY_CACHE_KEY_FILE. Editing any signed field of a block makes its
+ * lookup miss, and records written without the secret never match.
+ */
+#define VERIFY_CACHE_MAGIC "QSVCACHE 3\n"
+#define POW_BYTES 32
+#define DIGEST_BYTES 16
+#define SECRET_BYTES 32
+
+typedef struct {
+    unsigned char pow[POW_BYTES];             // raw proof_of_work digest
+    unsigned char data_digest[DIGEST_BYTES];  // truncated SHA-256 of block_data_string
+    unsigned char sig_digest[DIGEST_BYTES];   // truncated SHA-256 of the raw signature
+    unsigned char key_fp[DIGEST_BYTES];       // truncated public key fingerprint
+    unsigned char mac[DIGEST_BYTES];          // truncated HMAC-SHA256 of the fields above
+} VerifyCacheRecord;
+
+static VerifyCacheRecord *g_records = NULL;
+static size_t g_count = 0, g_capacity = 0;
+static uint32_t *g_index = NULL;  // 0 = empty, otherwise record index + 1
+static size_t g_index_capacity = 0;
+static size_t g_flushed = 0;      // records [0, g_flushed) are already on disk
+static int g_loaded = 0;
+static int g_enabled = 1;
+static int g_rewrite = 0;         // file holds superseded records; rewrite on flush
+static unsigned char g_secret[SECRET_BYTES];
+
+// proof_of_work digests start with zero bytes, so hash from the middle.
+static size_t pow_slot(const unsigned char *pow) {
+    uint32_t h;
+    memcpy(&h, pow + POW_BYTES / 2, sizeof(h));
+    return h & (g_index_capacity - 1);
+}
+
+static size_t find_index_slot(const unsigned char *pow) {
+    size_t i = pow_slot(pow);
+    while (g_index[i] && memcmp(g_records[g_index[i] - 1].pow, pow, POW_BYTES) != 0)
+        i = (i + 1) & (g_index_capacity - 1);
+    return i;
+}
+
+static int grow_index(void) {
+    size_t old_capacity = g_index_capacity;
+    uint32_t *old_index = g_index;
+    g_index_capacity = old_capacity ? old_capacity * 2 : 1024;
+    g_index = calloc(g_index_capacity, sizeof(uint32_t));
+    if (!g_index) {
+        g_index = old_index;
+        g_index_capacity = old_capacity;
+        return 0;
+    }
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_index[i])
+            g_index[find_index_slot(g_records[old_index[i] - 1].pow)] = old_index[i];
+    }
+    free(old_index);
+    return 1;
+}
+
+// Inserts rec, replacing any record with the same proof_of_work.
+static void insert_record(const VerifyCacheRecord *rec) {
+    if ((g_count + 1) * 2 > g_index_capacity && !grow_index())
+        return;
+    size_t slot = find_index_slot(rec->pow);
+    if (g_index[slot]) {
+        g_records[g_index[slot] - 1] = *rec;
+        g_rewrite = 1;
+        return;
+    }
+    if (g_count == g_capacity) {
+        size_t new_capacity = g_capacity ? g_capacity * 2 : 1024;
+        VerifyCacheRecord *grown = realloc(g_records, new_capacity * sizeof(VerifyCacheRecord));
+        if (!grown)
+            return;
+        g_records = grown;
+        g_capacity = new_capacity;
+    }
+    g_records[g_count] = *rec;
+    g_index[slot] = (uint32_t)(++g_count);
+}
+
+// Reads the HMAC secret, or creates it (readable by the owner only) on
+// first use. Returns 1 if the secret is new, 0 if it was read, -1 on error.
+static int load_secret(void) {
+    FILE *fp = fopen(VERIFY_CACHE_KEY_FILE, "rb");
+    if (fp) {
+        size_t got = fread(g_secret, 1, SECRET_BYTES, fp);
+        fclose(fp);
+        if (got == SECRET_BYTES)
+            return 0;
+        DEBUG_PRINT(2, 1, "Verification cache key %s is damaged; replacing it", VERIFY_CACHE_KEY_FILE);
+        unlink(VERIFY_CACHE_KEY_FILE);
+    }
+    if (RAND_bytes(g_secret, SECRET_BYTES) != 1)
+        return -1;
+    int fd = open(VERIFY_CACHE_KEY_FILE, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return -1;
+    int ok = write(fd, g_secret, SECRET_BYTES) == SECRET_BYTES;
+    if (close(fd) != 0 || !ok) {
+        unlink(VERIFY_CACHE_KEY_FILE);
+        return -1;
+    }
+    return 1;
+}
+
+static void load_cache(void) {
+    g_loaded = 1;
+    int secret = load_secret();
+    if (secret < 0) {
+        DEBUG_PRINT(2, 1, "Could not set up verification cache key %s: %s; cache disabled",
+                    VERIFY_CACHE_KEY_FILE, strerror(errno));
+        g_enabled = 0;
+        return;
+    }
+    if (secret) {
+        // Records sealed under an earlier secret can never match again.
+        g_rewrite = 1;
+        return;
+    }
+    FILE *fp = fopen(VERIFY_CACHE_FILE, "rb");
+    if (!fp) {
+        DEBUG_PRINT(2, 1, "Verification cache %s not found; starting empty", VERIFY_CACHE_FILE);
+        return;
+    }
+    char magic[sizeof(VERIFY_CACHE_MAGIC)] = {0};
+    if (fread(magic, 1, strlen(VERIFY_CACHE_MAGIC), fp) != strlen(VERIFY_CACHE_MAGIC) ||
+        strcmp(magic, VERIFY_CACHE_MAGIC) != 0) {
+        DEBUG_PRINT(2, 1, "Verification cache %s has an unknown format; it will be rebuilt", VERIFY_CACHE_FILE);
+        fclose(fp);
+        g_rewrite = 1;
+        return;
+    }
+    VerifyCacheRecord rec;
+    while (fread(&rec, sizeof(rec), 1, fp) == 1)
+        insert_record(&rec);
+    fclose(fp);
+    g_flushed = g_count;
+    DEBUG_PRINT(2, 2, "Loaded %zu verified block(s) from %s", g_count, VERIFY_CACHE_FILE);
+}
+
+// Fills rec for block/signer. Returns 0 if the block cannot be cached.
+static int make_record(const ScoreBlock *block, const char *signer, VerifyCacheRecord *rec) {
+    unsigned char fingerprint[KEY_FINGERPRINT_LEN];
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    char data[BLOCK_DATA_MAX];
+    int len = block_data_string(block, data, sizeof(data));
+    if (len < 0 || !get_public_key_fingerprint(signer, block->version, fingerprint))
+        return 0;
+    memcpy(rec->pow, block->proof_of_work, POW_BYTES);
+    SHA256((const unsigned char*)data, (size_t)len, hash);
+    memcpy(rec->data_digest, hash, DIGEST_BYTES);
+    SHA256(block->signature, block->signature_len, hash);
+    memcpy(rec->sig_digest, hash, DIGEST_BYTES);
+    memcpy(rec->key_fp, fingerprint, DIGEST_BYTES);
+    if (!HMAC(EVP_sha256(), g_secret, SECRET_BYTES, (const unsigned char*)rec,
+              offsetof(VerifyCacheRecord, mac), hash, NULL))
+        return 0;
+    memcpy(rec->mac, hash, DIGEST_BYTES);
+    return 1;
+}
+
+int verify_cache_lookup(const ScoreBlock *block, const char *signer) {
+    if (!g_enabled)
+        return 0;
+    if (!g_loaded)
+        load_cache();
+    if (!g_enabled || g_count == 0)
+        return 0;
+    VerifyCacheRecord rec;
+    if (!make_record(block, signer, &rec))
+        return 0;
+    uint32_t idx = g_index[find_index_slot(rec.pow)];
+    return idx && memcmp(&g_records[idx - 1], &rec, sizeof(rec)) == 0;
+}
+
+void verify_cache_record(const ScoreBlock *block, const char *signer) {
+    if (!g_enabled)
+        return;
+    if (!g_loaded)
+        load_cache();
+    VerifyCacheRecord rec;
+    if (g_enabled && make_record(block, signer, &rec))
+        insert_record(&rec);
+}
+
+void verify_cache_flush(void) {
+    if (!g_enabled || !g_loaded || (!g_rewrite && g_flushed == g_count))
+        return;
+    const char *mode = g_rewrite ? "wb" : "ab";
+    char tmp_path[256];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", VERIFY_CACHE_FILE);
+    const char *path = g_rewrite ? tmp_path : VERIFY_CACHE_FILE;
+    struct stat st;
+    int need_magic = g_rewrite || stat(VERIFY_CACHE_FILE, &st) != 0 || st.st_size == 0;
+    size_t first = g_rewrite ? 0 : g_flushed;
+
+    FILE *fp = fopen(path, mode);
+    if (!fp) {
+        DEBUG_PRINT(2, 1, "Could not write verification cache %s: %s", path, strerror(errno));
+        return;
+    }
+    if (need_magic)
+        fputs(VERIFY_CACHE_MAGIC, fp);
+    fwrite(&g_records[first], sizeof(VerifyCacheRecord), g_count - first, fp);
+    if (fclose(fp) != 0 || (g_rewrite && rename(tmp_path, VERIFY_CACHE_FILE) != 0)) {
+        DEBUG_PRINT(2, 1, "Could not write verification cache %s: %s", path, strerror(errno));
+        return;
+    }
+    DEBUG_PRINT(2, 3, "Verification cache %s: %zu record(s) written", VERIFY_CACHE_FILE, g_count - first);
+    g_flushed = g_count;
+    g_rewrite = 0;
+}
+
+void verify_cache_set_enabled(int enabled) {
+    g_enabled = enabled;
+}
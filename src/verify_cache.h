@@ -0,0 +1,34 @@
+#ifndef VERIFY_CACHE_H
+#define VERIFY_CACHE_H
+
+#include "blockchain.h"
+
+// Sidecar file remembering which blocks already passed signature verification.
+// It lives next to, not inside, the tracked chain and is safe to delete.
+#ifndef VERIFY_CACHE_FILE
+#define VERIFY_CACHE_FILE "highscore/.verified_blocks"
+#endif
+
+// Random secret sealing the cache's records, created on first use.
+#ifndef VERIFY_CACHE_KEY_FILE
+#define VERIFY_CACHE_KEY_FILE "highscore/.verified_blocks.key"
+#endif
+
+// Returns 1 if this exact block (its signed data and signature) was verified
+// in an earlier run against signer's current public key, 0 otherwise.
+// Entries recorded under a different key fingerprint never match, so
+// replacing a key file invalidates them automatically.
+int verify_cache_lookup(const ScoreBlock *block, const char *signer);
+
+// Remembers that block's signature verified against signer's current key.
+void verify_cache_record(const ScoreBlock *block, const char *signer);
+
+// Appends the entries recorded since the last flush to VERIFY_CACHE_FILE,
+// or rewrites the file when it holds superseded entries.
+void verify_cache_flush(void);
+
+// Enables or disables the cache for this process (enabled by default).
+// When disabled, lookups always miss and nothing is recorded.
+void verify_cache_set_enabled(int enabled);
+
+#endif // VERIFY_CACHE_H
@@ -0,0 +1,212 @@
+#include "verify_chain.h"
+#include "verify_pool.h"
+#include "checkpoint.h"
+#include "usermap.h"
+#include "config.h"
+#include "debug.h"
+#include "memtrack.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Blocks are indexed by the tail of their proof_of_work; the leading bytes
+// are zeros by design and would only collide.
+#define BLOCK_KEY_OFFSET 16
+#define BLOCK_KEY_LEN (HASH_LEN - BLOCK_KEY_OFFSET)
+
+typedef struct {
+    unsigned char key[BLOCK_KEY_LEN];
+    uint32_t chain;  // owning chain id + 1; 0 marks an empty slot
+} BlockEntry;
+
+// Every block seen so far, mapped to the chain it belongs to.
+typedef struct {
+    BlockEntry *entries;
+    size_t capacity;  // power of two
+    size_t count;
+} BlockIndex;
+
+typedef struct {
+    uint32_t id;
+    unsigned char head[HASH_LEN];  // proof_of_work of the user's latest block
+} ChainHead;
+
+static const unsigned char zero_hash[HASH_LEN];
+
+// Finds the slot holding key (BLOCK_KEY_LEN bytes) or the empty slot for it.
+static size_t find_entry(const BlockIndex *index, const unsigned char *key) {
+    uint32_t h;
+    memcpy(&h, key, sizeof(h));
+    size_t mask = index->capacity - 1;
+    size_t i = h & mask;
+    while (index->entries[i].chain && memcmp(index->entries[i].key, key, BLOCK_KEY_LEN) != 0)
+        i = (i + 1) & mask;
+    return i;
+}
+
+// Returns the chain id + 1 owning pow, or 0 if no such block was seen.
+static uint32_t index_lookup(const BlockIndex *index, const unsigned char *pow) {
+    return index->capacity ? index->entries[find_entry(index, pow + BLOCK_KEY_OFFSET)].chain : 0;
+}
+
+static int index_insert(BlockIndex *index, const unsigned char *pow, uint32_t chain) {
+    if ((index->count + 1) * 2 > index->capacity) {
+        BlockIndex grown = { NULL, index->capacity ? index->capacity * 2 : 4096, 0 };
+        grown.entries = mem_calloc(MEM_LEDGER, grown.capacity, sizeof(BlockEntry));
+        if (!grown.entries)
+            return 0;
+        for (size_t i = 0; i < index->capacity; i++) {
+            BlockEntry *e = &index->entries[i];
+            if (e->chain)
+                grown.entries[find_entry(&grown, e->key)] = *e;
+        }
+        grown.count = index->count;
+        mem_free(index->entries);
+        *index = grown;
+    }
+    BlockEntry *e = &index->entries[find_entry(index, pow + BLOCK_KEY_OFFSET)];
+    memcpy(e->key, pow + BLOCK_KEY_OFFSET, BLOCK_KEY_LEN);
+    e->chain = chain + 1;
+    index->count++;
+    return 1;
+}
+
+// Checks where block attaches to its user's chain and advances the head.
+static void check_link(UserMap *heads, BlockIndex *index, const ScoreBlock *block,
+                       long record, ChainReport *report) {
+    if (index_lookup(index, block->proof_of_work)) {
+        DEBUG_PRINT(0, 1, "Record %ld (%s): duplicate of an earlier block", record, block->username);
+        report->duplicates++;
+        return;
+    }
+    void **slot = usermap_slot(heads, block->username);
+    if (!slot)
+        return;
+    ChainHead *chain = *slot;
+    if (!chain) {
+        chain = mem_calloc(MEM_LEDGER, 1, sizeof(ChainHead));
+        if (!chain)
+            return;
+        chain->id = (uint32_t)report->users++;
+        *slot = chain;
+        if (memcmp(block->prev_hash, zero_hash, HASH_LEN) != 0) {
+            DEBUG_PRINT(0, 1, "Record %ld (%s): orphan, first block of the user is not a genesis block",
+                        record, block->username);
+            report->orphans++;
+        }
+    } else if (memcmp(block->prev_hash, chain->head, HASH_LEN) != 0) {
+        uint32_t owner = index_lookup(index, block->prev_hash);
+        if (memcmp(block->prev_hash, zero_hash, HASH_LEN) == 0 || owner == chain->id + 1) {
+            DEBUG_PRINT(0, 1, "Record %ld (%s): fork, does not extend the user's latest block",
+                        record, block->username);
+            report->forks++;
+        } else {
+            DEBUG_PRINT(0, 1, "Record %ld (%s): orphan, prev_hash is not one of the user's blocks",
+                        record, block->username);
+            report->orphans++;
+        }
+    }
+    // The newest block becomes the head even on a fork, as the game links to it.
+    memcpy(chain->head, block->proof_of_work, HASH_LEN);
+    if (!index_insert(index, block->proof_of_work, chain->id))
+        DEBUG_PRINT(2, 0, "Out of memory indexing block %ld", record);
+}
+
+// Checks the block's proof-of-work against the difficulty it records;
+// returns 1 if it holds.
+static int check_pow(const ScoreBlock *block, int min_difficulty, long record, ChainReport *report) {
+    unsigned char hash[HASH_LEN];
+    compute_block_hash(block, hash);
+    if (memcmp(hash, block->proof_of_work, HASH_LEN) != 0) {
+        DEBUG_PRINT(0, 1, "Record %ld (%s): proof_of_work does not match the block data", record, block->username);
+        report->bad_pow++;
+        return 0;
+    }
+    if (block->difficulty < min_difficulty) {
+        DEBUG_PRINT(0, 1, "Record %ld (%s): sealed at difficulty %d, below the minimum %d",
+                    record, block->username, block->difficulty, min_difficulty);
+        report->low_difficulty++;
+        return 0;
+    }
+    if (!hash_meets_difficulty(block->proof_of_work, block->difficulty)) {
+        DEBUG_PRINT(0, 1, "Record %ld (%s): proof_of_work does not meet its difficulty %d",
+                    record, block->username, block->difficulty);
+        report->low_difficulty++;
+        return 0;
+    }
+    return 1;
+}
+
+static void tally_signature(const ScoreBlock *block, int pow_ok, int sig_ok, long record, ChainReport *report) {
+    if (!sig_ok) {
+        DEBUG_PRINT(0, 1, "Record %ld (%s): invalid signature", record, block->username);
+        report->bad_signature++;
+    } else if (pow_ok) {
+        report->valid++;
+    }
+}
+
+int verify_chain_file(int min_difficulty, ChainReport *report) {
+    memset(report, 0, sizeof(*report));
+    FILE *fp = fopen(BLOCKCHAIN_FILE, "r");
+    if (!fp) {
+        DEBUG_PRINT(1, 0, "Blockchain file %s not found.", BLOCKCHAIN_FILE);
+        return 0;
+    }
+    // Blocks still needing a signature check, with their record index and PoW result.
+    ScoreBlock *batch = mem_alloc(MEM_LEDGER, HIGHSCORE_BATCH_BLOCKS * sizeof(ScoreBlock));
+    long *records = mem_alloc(MEM_LEDGER, HIGHSCORE_BATCH_BLOCKS * sizeof(long));
+    unsigned char *pow_ok = mem_alloc(MEM_LEDGER, HIGHSCORE_BATCH_BLOCKS);
+    unsigned char *sig_ok = mem_alloc(MEM_LEDGER, HIGHSCORE_BATCH_BLOCKS);
+    UserMap heads;
+    BlockIndex index = { NULL, 0, 0 };
+    usermap_init(&heads);
+    int ret = batch && records && pow_ok && sig_ok;
+    uint64_t trace_t0 = TRACE_BEGIN();
+
+    char line[2048];
+    int eof = !ret;
+    while (!eof) {
+        int pending = 0;
+        while (pending < HIGHSCORE_BATCH_BLOCKS) {
+            if (!fgets(line, sizeof(line), fp)) {
+                eof = 1;
+                break;
+            }
+            ScoreBlock *block = &batch[pending];
+            if (!parse_score_block(line, block))
+                continue;
+            long record = report->blocks++;
+            check_link(&heads, &index, block, record, report);
+            int pow_valid = check_pow(block, min_difficulty, record, report);
+            int status = checkpoint_block_status((int)record);
+            if (status == CHECKPOINT_UNCOVERED) {
+                records[pending] = record;
+                pow_ok[pending] = (unsigned char)pow_valid;
+                pending++;
+            } else {
+                tally_signature(block, pow_valid, status, record, report);
+            }
+        }
+        verify_blocks_parallel(batch, pending, sig_ok);
+        for (int i = 0; i < pending; i++)
+            tally_signature(&batch[i], pow_ok[i], sig_ok[i], records[i], report);
+    }
+    TRACE_END("verify_chain_file", trace_t0);
+
+    fclose(fp);
+    mem_free(batch);
+    mem_free(records);
+    mem_free(pow_ok);
+    mem_free(sig_ok);
+    mem_free(index.entries);
+    usermap_free(&heads, mem_free);
+    return ret;
+}
+
+int chain_report_clean(const ChainReport *report) {
+    return report->valid == report->blocks && report->forks == 0 &&
+           report->orphans == 0 && report->duplicates == 0;
+}
@@ -0,0 +1,33 @@
+#ifndef VERIFY_CHAIN_H
+#define VERIFY_CHAIN_H
+
+#include "blockchain.h"
+
+// BLOCKCHAIN_FILE interleaves one hash chain per username: each block's
+// prev_hash is the proof_of_work of that user's previous block (zeros for the
+// user's first block). These counters describe one pass over the file.
+typedef struct {
+    long blocks;          // well-formed records read
+    long users;           // distinct chains (usernames)
+    long valid;           // blocks whose proof-of-work and signature check out
+    long bad_pow;         // proof_of_work does not match the block data
+    long low_difficulty;  // below min_difficulty, or fewer leading zeros than recorded
+    long bad_signature;   // signature does not verify with the signer's key
+    long forks;           // blocks that do not extend their user's latest block
+    long orphans;         // blocks whose prev_hash is not one of their user's blocks
+    long duplicates;      // records repeating an earlier block's proof_of_work
+} ChainReport;
+
+// Verifies every per-user hash chain, each block's proof-of-work at the
+// difficulty it records (at least min_difficulty), and every signature in one
+// streaming pass over BLOCKCHAIN_FILE.
+// Signatures are checked in parallel batches (blocks covered by a trusted
+// checkpoint reuse its result). Memory grows with the number of blocks by a
+// small fixed index entry each, never with whole records. Each problem is
+// reported with its record index. Returns 1 if the file was read, 0 otherwise.
+int verify_chain_file(int min_difficulty, ChainReport *report);
+
+// Returns 1 if report shows no invalid, forked, orphaned or duplicate blocks.
+int chain_report_clean(const ChainReport *report);
+
+#endif // VERIFY_CHAIN_H
@@ -0,0 +1,114 @@
+#include "verify_pool.h"
+#include "verify_cache.h"
+#include "signature.h"
+#include "encryption.h"
+#include "config.h"
+#include "debug.h"
+#include "trace.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Blocks are claimed in chunks so workers touch the shared counter rarely.
+#define VERIFY_CHUNK 16
+
+typedef struct {
+    const ScoreBlock *blocks;
+    const int *pending;  // indices into blocks that still need verifying
+    unsigned char *results;
+    int count;           // number of entries in pending
+    int next;            // next unclaimed pending entry, advanced atomically
+} VerifyWork;
+
+// Worker body: claims chunks until the batch is exhausted, reusing one
+// EVP_MD_CTX for every block this thread verifies.
+static void *verify_worker(void *arg) {
+    VerifyWork *work = (VerifyWork*)arg;
+    trace_thread_name("verify worker");
+    void *ctx = verify_ctx_new();
+    if (!ctx) {
+        DEBUG_PRINT(2, 0, "Verification worker could not allocate a context");
+        return NULL;
+    }
+    char signer[USERNAME_MAX];
+    for (;;) {
+        int start = __atomic_fetch_add(&work->next, VERIFY_CHUNK, __ATOMIC_RELAXED);
+        if (start >= work->count)
+            break;
+        int end = start + VERIFY_CHUNK < work->count ? start + VERIFY_CHUNK : work->count;
+        for (int i = start; i < end; i++) {
+            int b = work->pending[i];
+            const ScoreBlock *block = &work->blocks[b];
+            block_signer_name(block, signer, sizeof(signer));
+            work->results[b] = (unsigned char)verify_score_signature_ctx(ctx, block, signer);
+        }
+    }
+    verify_ctx_free(ctx);
+    return NULL;
+}
+
+static int worker_count_for(int count) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus > 0 ? (int)cpus : 1;
+    if (threads > VERIFY_MAX_THREADS)
+        threads = VERIFY_MAX_THREADS;
+    // No point in starting threads that would not get a full chunk.
+    int max_useful = (count + VERIFY_CHUNK - 1) / VERIFY_CHUNK;
+    if (threads > max_useful)
+        threads = max_useful;
+    return threads > 0 ? threads : 1;
+}
+
+void verify_blocks_parallel(const ScoreBlock *blocks, int count, unsigned char *results) {
+    if (count <= 0)
+        return;
+    int *pending = malloc(count * sizeof(int));
+    if (!pending) {
+        DEBUG_PRINT(2, 0, "Out of memory verifying %d block(s)", count);
+        for (int i = 0; i < count; i++)
+            results[i] = 0;
+        return;
+    }
+
+    // Blocks proven valid in an earlier run are answered from the sidecar
+    // cache; only the misses are handed to the workers.
+    char signer[USERNAME_MAX];
+    int misses = 0;
+    for (int i = 0; i < count; i++) {
+        block_signer_name(&blocks[i], signer, sizeof(signer));
+        results[i] = (unsigned char)verify_cache_lookup(&blocks[i], signer);
+        if (!results[i])
+            pending[misses++] = i;
+    }
+
+    uint64_t trace_t0 = TRACE_BEGIN();
+    VerifyWork work = { blocks, pending, results, misses, 0 };
+    int threads = misses ? worker_count_for(misses) : 0;
+    pthread_t tids[VERIFY_MAX_THREADS];
+    int started = 0;
+    // The calling thread is one of the workers, so start threads - 1 helpers.
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&tids[started], NULL, verify_worker, &work) != 0) {
+            DEBUG_PRINT(2, 1, "Could not start verification thread %d; continuing with %d", t, started + 1);
+            break;
+        }
+        started++;
+    }
+    if (misses)
+        verify_worker(&work);
+    for (int t = 0; t < started; t++)
+        pthread_join(tids[t], NULL);
+    TRACE_END("verify_blocks_parallel", trace_t0);
+
+    for (int i = 0; i < misses; i++) {
+        int b = pending[i];
+        if (!results[b])
+            continue;
+        block_signer_name(&blocks[b], signer, sizeof(signer));
+        verify_cache_record(&blocks[b], signer);
+    }
+    verify_cache_flush();
+    free(pending);
+    DEBUG_PRINT(2, 2, "Verified %d block signature(s): %d cached, %d on %d thread(s)",
+                count, count - misses, misses, misses ? started + 1 : 0);
+}
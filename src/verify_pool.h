@@ -0,0 +1,14 @@
+#ifndef VERIFY_POOL_H
+#define VERIFY_POOL_H
+
+#include "blockchain.h"
+
+// Verifies the signatures of count blocks, fanning the work out over up to
+// VERIFY_MAX_THREADS worker threads. Each block is checked against the key of
+// its signer (see block_signer_name). results[i] is set to 1 if blocks[i] has
+// a valid signature and 0 otherwise, so results stay in input order.
+// Small batches are verified on the calling thread. Blocks found in the
+// verified-block cache are not re-verified, and newly verified ones are added.
+void verify_blocks_parallel(const ScoreBlock *blocks, int count, unsigned char *results);
+
+#endif // VERIFY_POOL_H
@@ -0,0 +1,172 @@
+/*
+ * verify_cache_test: the verified-block cache must not vouch for a block
+ * whose signed fields changed after it was cached.
+ *
+ * Works in a fresh temporary game directory: signs a block with a new
+ * Ed25519 key, verifies it (which records it in the sidecar cache), then
+ * edits each signed field in turn and expects a cache miss and a failed
+ * verification. Then a fresh process, which loads the sidecar from disk,
+ * must not trust a record appended to it by hand without the cache's secret.
+ *
+ * Usage: verify_cache_test   (exit status 0 on success)
+ */
+#include "blockchain.h"
+#include "encryption.h"
+#include "verify_cache.h"
+#include "verify_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+
+#define TEST_USER "cachetest"
+#define RECORD_BYTES 96       // sizeof(VerifyCacheRecord)
+#define DATA_DIGEST_OFFSET 32 // after the proof_of_work
+
+static int failures = 0;
+
+#define EXPECT(cond, what) do {                                 \
+        if (!(cond)) {                                          \
+            fprintf(stderr, "FAIL: %s\n", what);                \
+            failures++;                                         \
+        }                                                       \
+    } while (0)
+
+static EVP_PKEY *make_key(void) {
+    EVP_PKEY *key = NULL;
+    EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_ED25519, NULL);
+    if (!pctx || EVP_PKEY_keygen_init(pctx) != 1 || EVP_PKEY_keygen(pctx, &key) != 1)
+        key = NULL;
+    EVP_PKEY_CTX_free(pctx);
+    if (!key)
+        return NULL;
+    FILE *fp = fopen(PUBLIC_KEY_DIR "/" TEST_USER "_ed25519.pem", "w");
+    int ok = fp && PEM_write_PUBKEY(fp, key) == 1;
+    if (!fp || fclose(fp) != 0 || !ok) {
+        EVP_PKEY_free(key);
+        return NULL;
+    }
+    return key;
+}
+
+static int sign_block(EVP_PKEY *key, ScoreBlock *block) {
+    char data[BLOCK_DATA_MAX];
+    int len = block_data_string(block, data, sizeof(data));
+    size_t sig_len = SIG_MAX_LEN;
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    int ok = ctx && len >= 0 && EVP_DigestSignInit(ctx, NULL, NULL, NULL, key) == 1 &&
+             EVP_DigestSign(ctx, block->signature, &sig_len, (const unsigned char*)data, (size_t)len) == 1;
+    EVP_MD_CTX_free(ctx);
+    block->signature_len = (unsigned short)sig_len;
+    return ok;
+}
+
+static int verify_one(const ScoreBlock *block) {
+    unsigned char result = 0;
+    verify_blocks_parallel(block, 1, &result);
+    return result;
+}
+
+// Expects block, edited after signing, to miss the cache and fail verification.
+static void expect_rejected(const ScoreBlock *block, const char *what) {
+    char message[128];
+    snprintf(message, sizeof(message), "cache hit after editing %s", what);
+    EXPECT(!verify_cache_lookup(block, TEST_USER), message);
+    snprintf(message, sizeof(message), "block verified after editing %s", what);
+    EXPECT(!verify_one(block), message);
+}
+
+// Runs in a child: verifies block, then edits every signed field in turn.
+static int check_edits(const ScoreBlock *block) {
+    EXPECT(!verify_cache_lookup(block, TEST_USER), "cache hit before the block was verified");
+    EXPECT(verify_one(block), "signed block did not verify");
+    EXPECT(verify_cache_lookup(block, TEST_USER), "verified block was not cached");
+
+    ScoreBlock edited = *block;
+    edited.score = 99999;
+    expect_rejected(&edited, "the score");
+    edited = *block;
+    edited.timestamp += 1;
+    expect_rejected(&edited, "the timestamp");
+    edited = *block;
+    edited.nonce ^= 1;
+    expect_rejected(&edited, "the nonce");
+    edited = *block;
+    edited.prev_hash[HASH_LEN - 1] ^= 1;
+    expect_rejected(&edited, "prev_hash");
+    return failures == 0;
+}
+
+// Appends a copy of the last sidecar record with its data digest swapped
+// for that of edited, as someone without the secret would forge it.
+static int forge_record(const ScoreBlock *edited) {
+    unsigned char record[RECORD_BYTES];
+    FILE *fp = fopen(VERIFY_CACHE_FILE, "rb");
+    int ok = fp && fseek(fp, -(long)sizeof(record), SEEK_END) == 0 &&
+             fread(record, sizeof(record), 1, fp) == 1;
+    if (fp)
+        fclose(fp);
+    char data[BLOCK_DATA_MAX];
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    int len = block_data_string(edited, data, sizeof(data));
+    if (!ok || len < 0 || EVP_Digest(data, (size_t)len, hash, NULL, EVP_sha256(), NULL) != 1)
+        return 0;
+    memcpy(record + DATA_DIGEST_OFFSET, hash, 16);
+    fp = fopen(VERIFY_CACHE_FILE, "ab");
+    ok = fp && fwrite(record, sizeof(record), 1, fp) == 1;
+    return fp && fclose(fp) == 0 && ok;
+}
+
+int main(void) {
+    char dir[] = "/tmp/verify_cache_test.XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) != 0 || mkdir("highscore", 0755) != 0 ||
+        mkdir(PUBLIC_KEY_DIR, 0755) != 0) {
+        perror("verify_cache_test: cannot set up a game directory");
+        return 1;
+    }
+    EVP_PKEY *key = make_key();
+    ScoreBlock block;
+    memset(&block, 0, sizeof(block));
+    snprintf(block.username, sizeof(block.username), "%s", TEST_USER);
+    block.score = 3954;
+    block.timestamp = 1700000000L;
+    block.version = BLOCK_VERSION_ED25519;
+    add_score_block(&block, NULL, MIN_DIFFICULTY);
+    if (!key || !sign_block(key, &block)) {
+        fprintf(stderr, "verify_cache_test: cannot create a signed block\n");
+        return 1;
+    }
+    EVP_PKEY_free(key);
+
+    // The edits run in a child, so this process loads the sidecar afresh.
+    pid_t child = fork();
+    if (child == 0)
+        _exit(check_edits(&block) ? 0 : 1);
+    int status = 0;
+    EXPECT(child > 0 && waitpid(child, &status, 0) == child &&
+           WIFEXITED(status) && WEXITSTATUS(status) == 0, "edited blocks were accepted");
+
+    ScoreBlock edited = block;
+    edited.score = 99999;
+    EXPECT(forge_record(&edited), "could not forge a cache record");
+    EXPECT(!verify_one(&edited), "forged cache record was trusted");
+    EXPECT(verify_one(&block), "signed block did not verify after the forgery");
+
+    if (failures) {
+        fprintf(stderr, "verify_cache_test: %d failure(s); files left in %s\n", failures, dir);
+        return 1;
+    }
+    unlink(VERIFY_CACHE_FILE);
+    unlink(VERIFY_CACHE_KEY_FILE);
+    unlink(PUBLIC_KEY_DIR "/" TEST_USER "_ed25519.pem");
+    rmdir(PUBLIC_KEY_DIR);
+    rmdir("highscore");
+    if (chdir("/") == 0)
+        rmdir(dir);
+    printf("verify_cache_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,245 @@
+/*
+ * chaingen: writes a synthetic ledger for benchmarking.
+ *
+ * Creates <dir>/highscore/blockchain.txt with many users' chains interleaved,
+ * one Ed25519 key pair per user (public keys in PUBLIC_KEY_DIR), and a
+ * .username holding the first user's private key so the directory can also
+ * sign new blocks. Every block is PoW-sealed and signed exactly as the game
+ * does it; with -x some blocks get their score changed after signing so the
+ * readers have cheaters to reject.
+ *
+ * Usage: chaingen [-n blocks] [-u users] [-d difficulty] [-t threads]
+ *                 [-x tampered_per_mille] [-s seed] [-k] <dir>
+ * The difficulty defaults to, and may not be below, MIN_DIFFICULTY.
+ */
+#include "blockchain.h"
+#include "encryption.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+
+#define CHAINGEN_MAX_THREADS 64
+#define CHAINGEN_BASE_TIME 1700000000L
+
+typedef struct {
+    char name[USERNAME_MAX];
+    EVP_PKEY *key;
+    unsigned char last_pow[HASH_LEN];
+    int has_prev;
+} GenUser;
+
+typedef struct {
+    GenUser *users;
+    int first, last;       // users [first, last) of this worker
+    int round;
+    int difficulty;
+    int tamper_per_mille;
+    unsigned int seed;
+    char *lines;           // BLOCK_LINE_MAX bytes per user
+    int ok;
+} GenWork;
+
+// Small deterministic PRNG so a seed always produces the same ledger.
+static unsigned int next_random(unsigned int *state) {
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x ? x : 0x9e3779b9u;
+}
+
+static int sign_block(EVP_MD_CTX *ctx, EVP_PKEY *key, ScoreBlock *block) {
+    char data[BLOCK_DATA_MAX];
+    int len = block_data_string(block, data, sizeof(data));
+    size_t sig_len = SIG_MAX_LEN;
+    EVP_MD_CTX_reset(ctx);
+    if (len < 0 || EVP_DigestSignInit(ctx, NULL, NULL, NULL, key) != 1 ||
+        EVP_DigestSign(ctx, block->signature, &sig_len, (const unsigned char*)data, (size_t)len) != 1)
+        return 0;
+    block->signature_len = (unsigned short)sig_len;
+    return 1;
+}
+
+// Seals one block per user in [first, last) for the current round.
+static void *generate_round(void *arg) {
+    GenWork *work = arg;
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    work->ok = ctx != NULL;
+    for (int u = work->first; work->ok && u < work->last; u++) {
+        GenUser *user = &work->users[u];
+        unsigned int state = work->seed ^ (unsigned int)(u * 2654435761u) ^ (unsigned int)work->round * 40503u;
+        ScoreBlock block, prev;
+        memset(&block, 0, sizeof(block));
+        memcpy(block.username, user->name, sizeof(block.username));
+        block.score = (int)(next_random(&state) % 5000);
+        block.timestamp = CHAINGEN_BASE_TIME + (long)work->round * 3600 + u % 3600;
+        block.version = BLOCK_VERSION_ED25519;
+        memcpy(prev.proof_of_work, user->last_pow, HASH_LEN);
+        add_score_block(&block, user->has_prev ? &prev : NULL, work->difficulty);
+        if (!sign_block(ctx, user->key, &block)) {
+            work->ok = 0;
+            break;
+        }
+        memcpy(user->last_pow, block.proof_of_work, HASH_LEN);
+        user->has_prev = 1;
+        if ((int)(next_random(&state) % 1000) < work->tamper_per_mille)
+            block.score += 1000;  // breaks the signature, keeps the format
+        char *line = work->lines + (size_t)u * BLOCK_LINE_MAX;
+        if (format_score_block(&block, line, BLOCK_LINE_MAX) < 0)
+            work->ok = 0;
+    }
+    EVP_MD_CTX_free(ctx);
+    return NULL;
+}
+
+static int make_dir(const char *path) {
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "chaingen: cannot create %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+// Generates the user's key pair and writes its public key file.
+static int make_user_key(GenUser *user) {
+    EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_ED25519, NULL);
+    if (!pctx || EVP_PKEY_keygen_init(pctx) != 1 || EVP_PKEY_keygen(pctx, &user->key) != 1) {
+        EVP_PKEY_CTX_free(pctx);
+        return 0;
+    }
+    EVP_PKEY_CTX_free(pctx);
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s_ed25519.pem", PUBLIC_KEY_DIR, user->name);
+    FILE *fp = fopen(path, "w");
+    if (!fp)
+        return 0;
+    int ok = PEM_write_PUBKEY(fp, user->key) == 1;
+    return fclose(fp) == 0 && ok;
+}
+
+static int write_username_file(const GenUser *user) {
+    FILE *fp = fopen(USERNAME_FILE, "w");
+    if (!fp)
+        return 0;
+    fprintf(fp, "%s\n", user->name);
+    int ok = PEM_write_PrivateKey(fp, user->key, NULL, NULL, 0, NULL, NULL) == 1;
+    return fclose(fp) == 0 && ok;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-n blocks] [-u users] [-d difficulty] [-t threads] "
+                    "[-x tampered_per_mille] [-s seed] [-k] <dir>\n", prog);
+}
+
+int main(int argc, char **argv) {
+    long blocks = 10000;
+    // The lowest difficulty verifiers accept keeps generation fast.
+    int users = 100, difficulty = MIN_DIFFICULTY, threads = 0, tamper = 0, keyring = 0;
+    unsigned int seed = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:u:d:t:x:s:k")) != -1) {
+        switch (opt) {
+        case 'n': blocks = atol(optarg); break;
+        case 'u': users = atoi(optarg); break;
+        case 'd': difficulty = atoi(optarg); break;
+        case 't': threads = atoi(optarg); break;
+        case 'x': tamper = atoi(optarg); break;
+        case 's': seed = (unsigned int)strtoul(optarg, NULL, 10); break;
+        case 'k': keyring = 1; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind != argc - 1 || blocks <= 0 || users <= 0 || difficulty > 64) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (difficulty < MIN_DIFFICULTY) {
+        fprintf(stderr, "chaingen: difficulty %d is below MIN_DIFFICULTY (%d); verifiers would reject every block\n",
+                difficulty, MIN_DIFFICULTY);
+        return 2;
+    }
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    if (threads > CHAINGEN_MAX_THREADS)
+        threads = CHAINGEN_MAX_THREADS;
+    if (threads > users)
+        threads = users;
+
+    // Everything below uses the game's relative paths inside <dir>.
+    if (!make_dir(argv[optind]) || chdir(argv[optind]) != 0 ||
+        !make_dir("highscore") || !make_dir(PUBLIC_KEY_DIR))
+        return 1;
+
+    GenUser *user_list = calloc((size_t)users, sizeof(GenUser));
+    char *lines = malloc((size_t)users * BLOCK_LINE_MAX);
+    FILE *out = fopen(BLOCKCHAIN_FILE, "w");
+    int ret = 1;
+    if (!user_list || !lines || !out) {
+        fprintf(stderr, "chaingen: cannot set up %s\n", BLOCKCHAIN_FILE);
+        goto cleanup;
+    }
+    for (int u = 0; u < users; u++) {
+        snprintf(user_list[u].name, USERNAME_MAX, "user%05d", u);
+        if (!make_user_key(&user_list[u])) {
+            fprintf(stderr, "chaingen: cannot create a key for %s\n", user_list[u].name);
+            goto cleanup;
+        }
+    }
+    if (!write_username_file(&user_list[0]))
+        goto cleanup;
+
+    // Each round adds one block to every user's chain, in parallel; the
+    // round is then written in user order, so chains are interleaved.
+    long rounds = (blocks + users - 1) / users;
+    long written = 0;
+    GenWork work[CHAINGEN_MAX_THREADS];
+    pthread_t tids[CHAINGEN_MAX_THREADS];
+    int started[CHAINGEN_MAX_THREADS];
+    for (long r = 0; r < rounds; r++) {
+        int in_round = (int)(blocks - written < users ? blocks - written : users);
+        for (int t = 0; t < threads; t++) {
+            work[t] = (GenWork){ user_list, in_round * t / threads, in_round * (t + 1) / threads,
+                                 (int)r, difficulty, tamper, seed, lines, 0 };
+            // A slice whose thread cannot start is sealed on this thread instead.
+            started[t] = pthread_create(&tids[t], NULL, generate_round, &work[t]) == 0;
+            if (!started[t])
+                generate_round(&work[t]);
+        }
+        int ok = 1;
+        for (int t = 0; t < threads; t++) {
+            if (started[t])
+                pthread_join(tids[t], NULL);
+            ok &= work[t].ok;
+        }
+        if (!ok) {
+            fprintf(stderr, "chaingen: failed to seal round %ld\n", r);
+            goto cleanup;
+        }
+        for (int u = 0; u < in_round; u++)
+            fputs(lines + (size_t)u * BLOCK_LINE_MAX, out);
+        written += in_round;
+    }
+    if (keyring && build_keyring() < 0)
+        goto cleanup;
+    fprintf(stderr, "chaingen: %ld block(s) from %d user(s) written to %s/%s\n",
+            written, users, argv[optind], BLOCKCHAIN_FILE);
+    ret = 0;
+
+cleanup:
+    if (out && fclose(out) != 0)
+        ret = 1;
+    for (int u = 0; user_list && u < users; u++)
+        EVP_PKEY_free(user_list[u].key);
+    free(user_list);
+    free(lines);
+    return ret;
+}
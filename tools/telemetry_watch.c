@@ -0,0 +1,137 @@
+/*
+ * telemetry_watch: live monitor for a game started with --telemetry.
+ *
+ * Maps the shared-memory segment read-only and samples it every interval:
+ * one line per sample (frame, fps, frame time, score, entities, heap), or
+ * with -g a redrawn screen with a frame-time graph and, when the game runs
+ * with --profile, the time of every stage. Reading never blocks the game.
+ * Waits for the segment to appear and stops when the game ends.
+ *
+ * Usage: telemetry_watch [-n name] [-i interval_ms] [-g] [-1]
+ */
+#include "telemetry.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WATCH_GRAPH_WIDTH 60
+#define WATCH_GRAPH_ROWS 10
+#define WATCH_GRAPH_MS 33.0f  // frame time at the top of the graph
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static void print_line(const TelemetryFrame *t, double fps) {
+    printf("frame %8llu  %6.1f fps  %6.2f ms  score %6d  kills %5d  health %4d  "
+           "bullets %d/%d (hw %d)  enemies %d/%d (hw %d)  heap %.0f KiB (peak %.0f)  allocs %lld\n",
+           (unsigned long long)t->frame, fps, t->frame_ms, t->score, t->kills, t->health,
+           t->live_bullets, t->bullet_capacity, t->bullet_high_water,
+           t->active_enemies, t->enemy_capacity, t->enemy_high_water,
+           t->heap_bytes / 1024.0, t->heap_peak_bytes / 1024.0, (long long)t->frame_allocations);
+}
+
+static void draw_screen(const TelemetryBlock *block, const TelemetryFrame *t, double fps,
+                        const float *history, int next, int filled) {
+    printf("\033[H\033[2J");
+    printf("QuantumStriker telemetry (pid %d)\n\n", block->pid);
+    print_line(t, fps);
+    printf("\nframe time, one column per sample (top = %.0f ms):\n", WATCH_GRAPH_MS);
+    for (int row = WATCH_GRAPH_ROWS; row >= 1; row--) {
+        float level = WATCH_GRAPH_MS * row / WATCH_GRAPH_ROWS;
+        printf("%5.1f |", level);
+        for (int c = 0; c < WATCH_GRAPH_WIDTH; c++) {
+            int age = WATCH_GRAPH_WIDTH - 1 - c;
+            float ms = age < filled ? history[(next - 1 - age + WATCH_GRAPH_WIDTH) % WATCH_GRAPH_WIDTH] : 0.0f;
+            putchar(ms >= level - WATCH_GRAPH_MS / WATCH_GRAPH_ROWS / 2 ? '#' : ' ');
+        }
+        putchar('\n');
+    }
+    if (t->profiling) {
+        printf("\nstages of the last frame, ms:\n");
+        for (int s = 0; s < block->stage_count; s++) {
+            int bar = (int)(t->stage_ms[s] / WATCH_GRAPH_MS * WATCH_GRAPH_WIDTH + 0.5f);
+            if (bar > WATCH_GRAPH_WIDTH)
+                bar = WATCH_GRAPH_WIDTH;
+            printf("  %-15.*s %7.3f %.*s\n", TELEMETRY_STAGE_NAME, block->stage_names[s], t->stage_ms[s], bar,
+                   "############################################################");
+        }
+    } else {
+        printf("\n(start the game with --profile as well to see its stages)\n");
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    const char *name = TELEMETRY_DEFAULT_NAME;
+    int interval_ms = 250, graph = 0, once = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:i:g1")) != -1) {
+        switch (opt) {
+            case 'n': name = optarg; break;
+            case 'i': interval_ms = atoi(optarg); break;
+            case 'g': graph = 1; break;
+            case '1': once = 1; break;
+            default:
+                fprintf(stderr, "Usage: %s [-n name] [-i interval_ms] [-g] [-1]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (interval_ms < 10)
+        interval_ms = 10;
+
+    const TelemetryBlock *block = NULL;
+    int waiting = 0;
+    while (!(block = telemetry_attach(name))) {
+        if (once) {
+            fprintf(stderr, "No telemetry segment %s (is the game running with --telemetry?)\n", name);
+            return 1;
+        }
+        if (!waiting++)
+            fprintf(stderr, "Waiting for %s...\n", name);
+        sleep_ms(interval_ms);
+    }
+
+    float history[WATCH_GRAPH_WIDTH];  // ring of sampled frame times
+    int next = 0, filled = 0;
+    TelemetryFrame t, previous;
+    int have_previous = 0;
+    for (;;) {
+        if (!telemetry_snapshot(block, &t)) {
+            sleep_ms(1);
+            continue;
+        }
+        double fps = 0.0;
+        if (have_previous && t.time_ns > previous.time_ns)
+            fps = (double)(t.frame - previous.frame) * 1e9 / (double)(t.time_ns - previous.time_ns);
+        if (t.frame > 0) {
+            history[next] = t.frame_ms;
+            next = (next + 1) % WATCH_GRAPH_WIDTH;
+            if (filled < WATCH_GRAPH_WIDTH)
+                filled++;
+        }
+        if (graph)
+            draw_screen(block, &t, fps, history, next, filled);
+        else if (t.frame > 0)
+            print_line(&t, fps);
+        fflush(stdout);
+        if (once)
+            return 0;
+        if (t.state == TELEMETRY_ENDED) {
+            printf("The game has ended.\n");
+            return 0;
+        }
+        if (kill(block->pid, 0) != 0 && errno == ESRCH) {
+            printf("The game process is gone.\n");
+            return 1;
+        }
+        previous = t;
+        have_previous = 1;
+        sleep_ms(interval_ms);
+    }
+}